@@ -139,6 +139,12 @@ void NVIC_Configuration(void)
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;     // ȼ
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+	NVIC_InitStructure.NVIC_IRQChannel = DMA_gprs_usart.dma_rx_irq;   // gprsDMAʹжͬһռ಻
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
 
 	NVIC_InitStructure.NVIC_IRQChannel = DMA_s485_usart.dma_tx_irq;   // DMA
@@ -211,6 +217,15 @@ void GPIO_Configuration(void)
     GPIO_Init(Gprs_powerkey.Port, &GPIO_InitStructure);
 	GPIO_ResetBits(Gprs_powerkey.Port, Gprs_powerkey.pin);
 	
+#if GPRS_DTR_ENABLE
+	//DTRֵ͵ƽʱģ˳ģʽ
+	GPIO_InitStructure.GPIO_Pin = Gprs_dtr.pin;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_Init(Gprs_dtr.Port, &GPIO_InitStructure);
+	GPIO_ResetBits(Gprs_dtr.Port, Gprs_dtr.pin);
+#endif
+	
 //    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0|GPIO_Pin_1|GPIO_Pin_2|GPIO_Pin_3|GPIO_Pin_4|GPIO_Pin_5;
 //    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
 //    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
@@ -27,6 +27,9 @@
 
 
 static PPBuf_t	GprsUart_ppbuf;
+//DMAֻյĵڶֽڣһֽβ0
+//صַ֪ͨʱҲԽ
+#define RX_DMA_LEN( buflen)		( ( buflen) - 1)
 
 
 osSemaphoreId SemId_txFinish;                         // Semaphore ID
@@ -121,6 +124,39 @@ int gprs_uart_init(void)
 
 
 
+/*!
+** ޸ĲʣDMAжϵò
+**
+** @param baud µĲ
+** @return ERR_OK ɹ
+**/
+int gprs_uart_set_baud(uint32_t baud)
+{
+	int		wait = 10000;
+	int		tx_ms;
+	
+	if( baud == 0)
+		return ERR_BAD_PARAMETER;
+	//ڷ͵һֽڷ
+	while( USART_GetFlagStatus( GPRS_USART, USART_FLAG_TC) == RESET && wait)
+		wait --;
+	USART_Cmd( GPRS_USART, DISABLE);
+	Conf_GprsUsart.USART_BaudRate = baud;
+	USART_Init( GPRS_USART, &Conf_GprsUsart);
+	USART_Cmd( GPRS_USART, ENABLE);
+	
+	//͵ȴʱҪܷͻ棬õøĲ
+	tx_ms = GPRS_UART_TXBUF_LEN * 10 * 1000 / baud + 1;
+	if( Gprs_uart_ctl.tx_waittime_ms < tx_ms * 2)
+		Gprs_uart_ctl.tx_waittime_ms = tx_ms * 2;
+	return ERR_OK;
+}
+
+uint32_t gprs_uart_get_baud(void)
+{
+	return Conf_GprsUsart.USART_BaudRate;
+}
+
 void regRxIrq_cb(rxirq_cb cb, void *arg)
 {
 	
@@ -366,7 +402,7 @@ void DMA_GprsUart_Init(void)
     DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)(&GPRS_USART->DR);
     DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)rxbuf;         
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;                     
-    DMA_InitStructure.DMA_BufferSize = rxbuflen;                     
+    DMA_InitStructure.DMA_BufferSize = RX_DMA_LEN( rxbuflen);                     
     DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;        
     DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;                 
     DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte; 
@@ -376,6 +412,7 @@ void DMA_GprsUart_Init(void)
     DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;                            
     DMA_Init(DMA_gprs_usart.dma_rx_base, &DMA_InitStructure);               
     DMA_ClearFlag( DMA_gprs_usart.dma_rx_flag);                                
+    DMA_ITConfig(DMA_gprs_usart.dma_rx_base, DMA_IT_TC, ENABLE);            // ջҲҪм䲻пж
     DMA_Cmd(DMA_gprs_usart.dma_rx_base, ENABLE);                            
 
    Gprs_uart_ctl.rxbuf = rxbuf;
@@ -401,6 +438,33 @@ void DMA1_Channel2_IRQHandler(void)
 }
 
 
+//ջ汻ˣݻûн
+//һνصȻ¿ʼգĲһжд
+//Ϳжһһ֡ȴȡ߳Ҳյ
+void DMA1_Channel3_IRQHandler(void)
+{
+	short rxbuflen;
+	char *rxbuf;
+	
+	if(DMA_GetITStatus(DMA1_IT_TC3))
+	{
+		DMA_Cmd(DMA_gprs_usart.dma_rx_base, DISABLE);
+		DMA_ClearFlag( DMA_gprs_usart.dma_rx_flag );
+		
+		Gprs_uart_ctl.recv_size = RX_DMA_LEN( get_loadbuflen( &GprsUart_ppbuf));
+		Gprs_uart_ctl.rxbuf[ Gprs_uart_ctl.recv_size] = '\0';
+		if( GprsRxirqCB.cb != NULL)
+			GprsRxirqCB.cb( Gprs_uart_ctl.rxbuf,  GprsRxirqCB.arg, Gprs_uart_ctl.recv_size);
+		
+		switch_receivebuf( &GprsUart_ppbuf, &rxbuf, &rxbuflen);
+		DMA_gprs_usart.dma_rx_base->CMAR = (uint32_t)rxbuf;
+		DMA_gprs_usart.dma_rx_base->CNDTR = RX_DMA_LEN( rxbuflen);
+		DMA_Cmd( DMA_gprs_usart.dma_rx_base, ENABLE);
+		Gprs_uart_ctl.rxbuf = rxbuf;
+		osSemaphoreRelease( SemId_rxFrame);
+	}
+}
+
 void USART3_IRQHandler(void)
 {
 	uint8_t clear_idle = clear_idle;
@@ -417,22 +481,27 @@ void USART3_IRQHandler(void)
 		
 
 		
-		Gprs_uart_ctl.recv_size = get_loadbuflen( &GprsUart_ppbuf)  - \
+		Gprs_uart_ctl.recv_size = RX_DMA_LEN( get_loadbuflen( &GprsUart_ppbuf))  - \
 		DMA_GetCurrDataCounter(DMA_gprs_usart.dma_rx_base); //ýյֽ
 		
-		if( GprsRxirqCB.cb != NULL)
+		//صַ֪ͨݺ油0
+		Gprs_uart_ctl.rxbuf[ Gprs_uart_ctl.recv_size] = '\0';
+		//պDMAжֵ֮Ŀжϣûµ
+		if( ( GprsRxirqCB.cb != NULL) && Gprs_uart_ctl.recv_size)
 			GprsRxirqCB.cb( Gprs_uart_ctl.rxbuf,  GprsRxirqCB.arg, Gprs_uart_ctl.recv_size);
 		
 		switch_receivebuf( &GprsUart_ppbuf, &rxbuf, &rxbuflen);
 		DMA_gprs_usart.dma_rx_base->CMAR = (uint32_t)rxbuf;
-		DMA_gprs_usart.dma_rx_base->CNDTR = rxbuflen;
+		DMA_gprs_usart.dma_rx_base->CNDTR = RX_DMA_LEN( rxbuflen);
 		DMA_Cmd( DMA_gprs_usart.dma_rx_base, ENABLE);
 		clear_idle = GPRS_USART->SR;
 		clear_idle = GPRS_USART->DR;
 		USART_ReceiveData( USART3 ); // Clear IDLE interrupt flag bit
 		
 		Gprs_uart_ctl.rxbuf = rxbuf;
-		osSemaphoreRelease( SemId_rxFrame);
+		//ж֮Ŀжûݣһ֡Ѿ֪ͨ
+		if( Gprs_uart_ctl.recv_size)
+			osSemaphoreRelease( SemId_rxFrame);
 
 		
 		
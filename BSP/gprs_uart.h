@@ -49,6 +49,15 @@ void gprs_Uart_ioctl(int cmd, ...);
  */
 int gprs_uart_test(char *buf, int size);
 
+/**
+ * @brief ޸gprsڵĲ
+ * 
+ * @param baud µĲ
+ * @return ERR_OK ɹ
+ */
+int gprs_uart_set_baud(uint32_t baud);
+uint32_t gprs_uart_get_baud(void);
+
 typedef void (*rxirq_cb)(void *rxbuf, void *arg, int len);
 void regRxIrq_cb(rxirq_cb cb, void *arg);
 #define GPRS_UART_BUF_LEN		512
@@ -19,6 +19,13 @@ gpio_pins	Gprs_powerkey =  {
 	GPIO_Pin_0
 };
 
+#if GPRS_DTR_ENABLE
+gpio_pins	Gprs_dtr =  {
+	GPIOB,
+	GPIO_Pin_1
+};
+#endif
+
 gpio_pins	W25Q_csPin =  {
 	GPIOA,
 	GPIO_Pin_4
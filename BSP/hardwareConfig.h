@@ -53,6 +53,12 @@ typedef struct
 
 
 extern gpio_pins	Gprs_powerkey;
+//ģDTRţ͸ģʽ˳ģʽ
+//ûŵʱΪ0ʹ"+++"˳
+#define GPRS_DTR_ENABLE		0
+#if GPRS_DTR_ENABLE
+extern gpio_pins	Gprs_dtr;
+#endif
 
 extern gpio_pins	W25Q_csPin;
 extern SPI_instance W25Q_Spi ;
@@ -23,11 +23,28 @@ uint32_t get_time_s(void)
 	
 }
 
+//ĺ49ƣȽϵʱü
 uint32_t get_time_ms(void)
 {
-	return g_time2.time_ms ;
+	return get_tick_ms64();
 	
 }
+
+//ĺ
+//ͺж£ζͬ
+uint64_t get_tick_ms64(void)
+{
+	volatile TIME2_T	*t = &g_time2;
+	uint32_t	s, ms;
+	
+	do
+	{
+		s = t->time_s;
+		ms = t->time_ms;
+	}while( s != t->time_s);
+	return ( uint64_t)s * 1000 + ms;
+}
+
 //runtimes 0 ޴ 0 ָĴ
 void regist_timejob( uint16_t period_ms, time_job job)
 {
@@ -119,6 +136,19 @@ int Ringing(int alarm_id)
 	
 }
 
+//ӻж죬ûõķ-1Ѿ˵ķ0ر
+int Alarm_remain_ms(int alarm_id)
+{
+	uint32_t pass_ms = 0;
+	if( alarm_id >= MAX_ALARM_TOP || Set_AlarmClock_flag[alarm_id] == 0)
+		return -1;
+	pass_ms = g_time2.time_ms + g_time2.time_s *1000 - AlarmStart_ms[alarm_id];
+	if( pass_ms >= Alarmtims_ms[alarm_id])
+		return 0;
+	return Alarmtims_ms[alarm_id] - pass_ms;
+	
+}
+
 void TIM2_IRQHandler(void)          //ʱжԼ10ms
 {
 	time_task_manager *current_job = List_time_job_head;
@@ -2,10 +2,11 @@
 #define _TIMERS_H_
 #include "stdint.h"
 //#define MAX_COMMA 256
-#define MAX_ALARM_TOP		8			//ֵ֧ 4TCPӺ1ģʽת干5
+#define MAX_ALARM_TOP		9			//ֵ֧ 4TCPӵ4·1ģʽת干9
 #define ALARM_CHGWORKINGMODE	0			//485Ĭģʽתģʽʱ
 #define ALARM_SENDTCPBUF		0			//TCPеݵ
 #define ALARM_GPRSLINK(n)		(1+n)			//GPRS link
+#define ALARM_RECONNECT(n)		(5+n)			//GPRS link Ͽ˱
 typedef struct TIME2_T
 {
 	uint32_t		time_ms;
@@ -27,8 +28,10 @@ void regist_timejob( uint16_t period_ms, time_job job);
 void clean_time2_flags(void);
 uint32_t get_time_s(void);
 uint32_t get_time_ms(void);
+uint64_t get_tick_ms64(void);
 void set_alarmclock_s(int alarm_id, int sec);
 void set_alarmclock_ms(int alarm_id, int msec);
 int Ringing(int alarm_id);
+int Alarm_remain_ms(int alarm_id);
 void time_test(void);
 #endif
@@ -0,0 +1,35 @@
+
+#include "cmsis_os.h"                                           // CMSIS RTOS header file
+#include "sdhError.h"
+#include "dtuConfig.h"
+#include "debug.h"
+#include "smsQueue.h"
+/*----------------------------------------------------------------------------
+ *      Thread 'Thread_sms': ģʽ°Ѷе485ݷԱ
+ *---------------------------------------------------------------------------*/
+ 
+void Thread_sms (void const *argument);                             // thread function
+osThreadId tid_Thread_SMS;                                          // thread id
+osThreadDef (Thread_sms, osPriorityNormal, 1, 0);                   // thread object
+
+
+int Init_Thread_sms (void) {
+
+	if( Dtu_config.work_mode != MODE_SMS)
+		return ERR_OK;
+	if( SmsQ_init() != ERR_OK)
+		return(-1);
+	
+	tid_Thread_SMS = osThreadCreate (osThread(Thread_sms), NULL);
+
+	if (!tid_Thread_SMS) return(-1);
+  
+  return(0);
+}
+
+void Thread_sms (void const *argument) {
+  while (1) {    
+		SmsQ_run();
+		osDelay(100);
+  }
+}
@@ -12,6 +12,9 @@
 #include "dtu.h"
 
 #include "modbusRTU_cli.h"
+#include "spool.h"
+#include "mqttClient.h"
+#include "modem.h"
 /*----------------------------------------------------------------------------
  *      Thread 1 'Thread_Name': Sample thread
  *---------------------------------------------------------------------------*/
@@ -57,10 +60,9 @@ static void prnt_485( char *data)
 
 static void GprsShutdown()
 {
-	gprs_t *sim800 ;
-	sim800 = GprsGetInstance();
+	Modem *modem = ModemGetInstance();
 	
-	sim800->tcpClose( sim800, 0);
+	modem->close( modem, 0);
 	//ڶʱرgprs޷ɾָ
 	//ԶҪ.Բرgprs
 //	sim800->shutdown( sim800);
@@ -69,7 +71,7 @@ static void GprsShutdown()
 int Init_ThrdDtu (void) {
 	
 #ifdef NEW_CODE	
-	gprs_t *sim800 ;
+	Modem *modem;
 	DtuContextFactory* factory = DCFctGetInstance();
 	
 	MyContext = factory->createContext( Dtu_config.work_mode);
@@ -80,14 +82,11 @@ int Init_ThrdDtu (void) {
 	prnt_485("gprs threat startup ! \r\n");
 	if( NEED_GPRS( Dtu_config.work_mode)) 
 	{
-		sim800 = GprsGetInstance();
-		if(Dtu_config.multiCent_mode == 0)
-		{
-			
-			Grps_SetCipmode(CIPMODE_TRSP);
-			Grps_SetCipmux(0);
-		}
-		sim800->startup(sim800);
+		modem = ModemGetInstance();
+		Spool_init();
+		MqttClient_init();
+		//ӷʽͽջģ
+		modem->open( modem);
 	}
 	
 	MyContext->init( MyContext, DTU_Buf, DTU_BUF_LEN);
@@ -115,6 +114,8 @@ void thrd_dtu (void const *argument) {
 	{
 		threadActive();
 		MyContext->curState->run( MyContext->curState, MyContext);
+		//һֵ״̬˾ȴ¼
+		MyContext->dispatch( MyContext);
 //		osDelay(10);
 		osThreadYield();         
 		
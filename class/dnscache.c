@@ -0,0 +1,204 @@
+/**
+* @file 		dnscache.c
+* @brief		Ľ.
+* @details		1. ¼IPЧֱIP
+*				2. ֮þɵIPеʱ½
+*				3. ʧ֮һʱڲٽоɵIPþɵ
+*				4. ֻ¼ģ飬ԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "dnscache.h"
+#include <string.h>
+
+static struct {
+	uint16_t	ttl_s;
+	uint16_t	neg_s;
+	dns_entry_t	e[DNS_CACHE_NUM];
+}Dns;
+
+static uint32_t host_hash( const char *host)
+{
+	uint32_t	h = 2166136261u;
+
+	while( *host)
+	{
+		h ^= ( uint8_t)*host ++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+//¼ԭǸ
+static int entry_valid( dns_entry_t *e)
+{
+	return e->host && host_hash( e->host) == e->hash;
+}
+
+static dns_entry_t *find( const char *host)
+{
+	int j;
+
+	for( j = 0; j < DNS_CACHE_NUM; j ++)
+	{
+		if( entry_valid( &Dns.e[ j]) && strcmp( Dns.e[ j].host, host) == 0)
+			return &Dns.e[ j];
+	}
+	return NULL;
+}
+
+//ûеʱÿյĻϵļ¼õʱ滻ûõ
+static dns_entry_t *find_add( const char *host, uint32_t now_s)
+{
+	dns_entry_t	*e = find( host);
+	dns_entry_t	*old = &Dns.e[0];
+	int			j;
+
+	if( e)
+		return e;
+	for( j = 0; j < DNS_CACHE_NUM; j ++)
+	{
+		e = &Dns.e[ j];
+		if( entry_valid( e) == 0)
+			break;
+		if( now_s - e->use_s > now_s - old->use_s)
+			old = e;
+	}
+	if( j == DNS_CACHE_NUM)
+		e = old;
+	memset( e, 0, sizeof( dns_entry_t));
+	e->host = host;
+	e->hash = host_hash( host);
+	e->use_s = now_s;
+	return e;
+}
+
+static int in_neg( dns_entry_t *e, uint32_t now_s)
+{
+	return e->neg && now_s - e->fail_s < Dns.neg_s;
+}
+
+static int can_use( dns_entry_t *e, uint32_t now_s)
+{
+	return e->ip[0] && now_s - e->ok_s < ( uint32_t)Dns.ttl_s + DNS_STALE_S;
+}
+
+void Dns_init( uint16_t ttl_s, uint16_t neg_s)
+{
+	memset( &Dns, 0, sizeof( Dns));
+	Dns.ttl_s = ttl_s;
+	Dns.neg_s = neg_s;
+}
+
+//ֺֻ͵㲢4εĲIPģֱӣý
+int Dns_is_ip( const char *host)
+{
+	int	dots = 0;
+	int	digits = 0;
+
+	for( ; *host; host ++)
+	{
+		if( *host == '.')
+		{
+			if( digits == 0)
+				return 0;
+			dots ++;
+			digits = 0;
+		}
+		else if( *host >= '0' && *host <= '9' && digits < 3)
+			digits ++;
+		else
+			return 0;
+	}
+	return dots == 3 && digits;
+}
+
+/**
+ * @brief ѯҪõIP.
+ *
+ * @param[in]	host	
+ * @param[out]	ip		DNS_HITDNS_STALEʱǿӵIP
+ * @retval	DNS_HIT/DNS_STALE/DNS_MISS/DNS_NEG
+ */
+int Dns_lookup( const char *host, uint32_t now_s, char *ip)
+{
+	dns_entry_t	*e = find( host);
+
+	if( e == NULL)
+		return DNS_MISS;
+	e->use_s = now_s;
+	if( e->ip[0] && e->suspect == 0 && now_s - e->ok_s < Dns.ttl_s)
+	{
+		e->hits ++;
+		strcpy( ip, e->ip);
+		return DNS_HIT;
+	}
+	//սʧܹʧܹIPҲţֻʱ
+	if( in_neg( e, now_s))
+	{
+		if( can_use( e, now_s) == 0)
+			return DNS_NEG;
+	}
+	else if( e->suspect || can_use( e, now_s) == 0)
+		return DNS_MISS;
+	e->hits ++;
+	strcpy( ip, e->ip);
+	return DNS_STALE;
+}
+
+//hostҪһֱЧ¼ָֻ
+void Dns_resolved( const char *host, const char *ip, uint32_t now_s)
+{
+	dns_entry_t	*e = find_add( host, now_s);
+
+	strncpy( e->ip, ip, DNS_IP_LEN - 1);
+	e->ip[ DNS_IP_LEN - 1] = '\0';
+	e->ok_s = now_s;
+	e->suspect = 0;
+	e->neg = 0;
+	e->resolves ++;
+}
+
+//ʧܲɵIP
+void Dns_failed( const char *host, uint32_t now_s)
+{
+	dns_entry_t	*e = find_add( host, now_s);
+
+	e->neg = 1;
+	e->fail_s = now_s;
+	e->fails ++;
+}
+
+//ûIPʧˣ´֮ǰ½
+void Dns_suspect( const char *host)
+{
+	dns_entry_t	*e = find( host);
+
+	if( e)
+		e->suspect = 1;
+}
+
+//Ҫڿеʱ½ûеʱ򷵻NULL
+const char *Dns_refresh_due( uint32_t now_s)
+{
+	dns_entry_t	*e;
+	int			j;
+
+	for( j = 0; j < DNS_CACHE_NUM; j ++)
+	{
+		e = &Dns.e[ j];
+		if( entry_valid( e) == 0 || e->ip[0] == '\0' || in_neg( e, now_s))
+			continue;
+		if( e->suspect || now_s - e->ok_s >= Dns.ttl_s)
+			return e->host;
+	}
+	return NULL;
+}
+
+dns_entry_t *Dns_get( int idx)
+{
+	if( idx >= DNS_CACHE_NUM)
+		return NULL;
+	return &Dns.e[ idx];
+}
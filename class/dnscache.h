@@ -0,0 +1,45 @@
+#ifndef __DNSCACHE_H__
+#define __DNSCACHE_H__
+#include <stdint.h>
+
+//ĵַ棺ԭÿAT+CIPSTARTģÿζҪ½·ϿʱҪȼ
+//AT+CDNSGIPһμֱIP
+//֮󻹿ԼþɵIPͬʱڿеʱ½ʧһʱڲٽ
+//þɵIPʧܵʱ½Ļ˵ַҲܺܿ
+#define DNS_CACHE_NUM		4		//ĵһ
+#define DNS_IP_LEN			16
+
+#define DEF_DNS_TTL_S		3600	//Чʱ䣬AT+CDNSGIPTTLֻ
+#define DEF_DNS_NEG_S		30		//ʧ֮òٽ
+#define DNS_STALE_S			86400	//֮ɵIPʹõʱ䣬˾ҪȽ
+
+//ѯĽ
+#define DNS_HIT				0		//ЧIP
+#define DNS_STALE			1		//ڵIPãҪ½
+#define DNS_MISS			2		//ûпõIPҪϽ
+#define DNS_NEG				3		//սʧܹҲûпõIPβ
+
+typedef struct {
+	const char	*host;			//ָƣʡڴ
+	uint32_t	hash;			//õ޸֮һ£¼
+	char		ip[DNS_IP_LEN];	//Ϊձʾûнɹ
+	uint8_t		suspect;		//IPʧ
+	uint8_t		neg;			//һνʧ
+	uint32_t	ok_s;			//ɹʱ
+	uint32_t	fail_s;			//ʧܵʱ
+	uint32_t	use_s;			//һʹõʱ䣬¼滻ûõ
+	uint16_t	hits;			//ýֱӵĴ
+	uint16_t	resolves;		//ɹĴ
+	uint16_t	fails;			//ʧܵĴ
+}dns_entry_t;
+
+void Dns_init( uint16_t ttl_s, uint16_t neg_s);
+int Dns_is_ip( const char *host);
+int Dns_lookup( const char *host, uint32_t now_s, char *ip);
+void Dns_resolved( const char *host, const char *ip, uint32_t now_s);
+void Dns_failed( const char *host, uint32_t now_s);
+void Dns_suspect( const char *host);
+const char *Dns_refresh_due( uint32_t now_s);
+dns_entry_t *Dns_get( int idx);
+
+#endif
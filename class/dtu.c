@@ -11,6 +11,12 @@
 #include "dtu.h"
 #include "system.h"
 #include "modbusRTU_cli.h"
+#include "smsQueue.h"
+#include "mqttClient.h"
+#include "upframe.h"
+#include "wclock.h"
+#include "dnscache.h"
+#include "modem.h"
 
 
 
@@ -18,6 +24,10 @@
 char	DtuTempBuf[DTUTMP_BUF_LEN];
 
 static WorkState *StateLine[ STATE_Total];
+//״̬¼Ϊ0״ֻ̬ɱ״̬лȥ
+static uint8_t	StateEvent[ STATE_Total];
+
+static int idle_ms( void);
 
 static void Debug_485( char *data)
 {
@@ -77,12 +87,74 @@ END_CTOR
 
 
 //״̬Ļ
+//״̬У¼ֻ֮дЩ¼״̬˾ȴһ¼
+//Լǹ״̬֮е״̬һ
+
+//̻߳ûдʱ򶪵¼ʼ֮е״̬һ
+void Dtu_post( int ev)
+{
+	if( tid_ThrdDtu)
+		osSignalSet( tid_ThrdDtu, ev);
+}
+
+//ģ¼ڴڻص﷢ֻź
+static void dtu_modem_event( int ev, int arg, void *ctx)
+{
+	switch( ev)
+	{
+		case MODEM_EV_RECV:
+			Dtu_post( DTU_EV_RECV);
+			break;
+		case MODEM_EV_CLOSE:
+		case MODEM_EV_DOWN:
+			Dtu_post( DTU_EV_LINK);
+			break;
+		case MODEM_EV_SMS:
+			Dtu_post( DTU_EV_SMS);
+			break;
+	}
+}
+
+//еһ״̬֮һûе״̬ûеĻһ־ͽ
+static void pick_state( StateContext *this, int myState)
+{
+	int i;
+	
+	for( i = myState + 1; i < STATE_Total; i ++)
+	{
+		if( CHK_U8_BIT( this->runSet, i) && StateLine[ i])
+		{
+			this->runSet = CLR_U8_BIT( this->runSet, i);
+			this->curState = StateLine[ i];
+			return;
+		}
+	}
+	this->curState = NULL;
+}
+
+//¼ѡһҪе״̬
+static void select_states( StateContext *this, uint8_t events)
+{
+	int i;
+	
+	this->events = events;
+	this->runSet = 0;
+	for( i = STATE_SelfTest + 1; i < STATE_Total; i ++)
+	{
+		if( StateLine[ i] && ( StateEvent[ i] & events))
+			this->runSet = SET_U8_BIT( this->runSet, i);
+	}
+}
 
 int StateContextInit( StateContext *this, char *buf, int bufLen)
 {
 	
+	Modem	*modem = ModemGetInstance();
+	
 	this->dataBuf = buf;
 	this->bufLen = bufLen;
+	modem->subscribe( modem, MODEM_EV_BIT( MODEM_EV_RECV) | MODEM_EV_BIT( MODEM_EV_CLOSE) | \
+		MODEM_EV_BIT( MODEM_EV_SMS) | MODEM_EV_BIT( MODEM_EV_DOWN), dtu_modem_event, NULL);
 	return ERR_OK;
 }
 
@@ -118,38 +190,47 @@ void switchToSmsMode( StateContext *this)
 	}
 		
 
-	//õǰ״̬ΪŴ
+	//õǰ״̬ΪŴԺɶźӵ¼
+	//·û״̬ˣȴʱ䲻
+	StateEvent[ STATE_SMSHandle] = DTU_EV_SMS | DTU_EV_TIMER;
+	this->runSet = 0;
 	this->curState = StateLine[ STATE_SMSHandle];
 	
 }
 
 void nextState( StateContext *this, int myState)
 {
-	int i = 0;
-	
+	//Լ֮ȥӣģʽûӵ״̬
+	if( myState == STATE_SelfTest && StateLine[ STATE_Connect])
+	{
+		this->curState = StateLine[ STATE_Connect];
+		return;
+	}
+	//Ӻ֮󲻵¼е״̬һ
+	if( myState == STATE_SelfTest || myState == STATE_Connect)
+		select_states( this, DTU_EV_ALL);
+	pick_state( this, myState);
+}
 
+//һֵ״̬ˣȴ¼¼ֻ֮дЩ¼״̬
+//һ֮ǰû¼ʱռCPU
+void dispatch( StateContext *this)
+{
+	osEvent	evt;
+	uint8_t	events;
 	
-	
-	//е״̬֮ĵһڵ״̬
-	//˱״̬״̬ڣǱ״̬
-	for( i = 0; i < STATE_Total; i ++)
+	while( this->curState == NULL)
 	{
-		
-		//ʼ״̬Ӧг
-		//Բѯ״ʱʼ״̬
-		myState ++;
-		if( myState == STATE_Total)
-			myState = 1;
-		if( StateLine[ myState] )
-		{
-			this->curState = StateLine[ myState];
-			break;
-			
-		}
-		
+		evt = osSignalWait( 0, idle_ms());
+		events = 0;
+		if( evt.status == osEventSignal)
+			events = evt.value.signals;
+		//ȴʱߵȴڼӵ
+		if( events == 0 || idle_ms() == 0)
+			events |= DTU_EV_TIMER;
+		select_states( this, events);
+		pick_state( this, STATE_SelfTest);
 	}
-		
-	
 }
 
 int Construct( StateContext *this, Builder *state_builder)
@@ -176,6 +257,14 @@ int Construct( StateContext *this, Builder *state_builder)
 	StateLine[STATE_HeatBeatHandle] = state_builder->builderGprsHeatBeatState( this);
 	StateLine[STATE_CnntManager] = state_builder->builderGprsCnntManagerState( this);
 	StateLine[STATE_SMSHandle] = state_builder->buildGprsDealSMSState( this);
+	
+	StateEvent[STATE_SelfTest] = 0;
+	StateEvent[STATE_Connect] = 0;
+	StateEvent[STATE_EventHandle] = DTU_EV_RECV | DTU_EV_LINK | DTU_EV_SMS | DTU_EV_TIMER;
+	StateEvent[STATE_HeatBeatHandle] = DTU_EV_TIMER | DTU_EV_CONF;
+	StateEvent[STATE_CnntManager] = DTU_EV_LINK | DTU_EV_TIMER;
+	//ģʽ¶ŴֻӲϵʱӹлȥ
+	StateEvent[STATE_SMSHandle] = StateLine[STATE_Connect] ? 0 : DTU_EV_SMS | DTU_EV_TIMER;
 
 	this->curState = StateLine[STATE_SelfTest];
 	
@@ -188,6 +277,7 @@ FUNCTION_SETTING(nextState, nextState);
 FUNCTION_SETTING(setCurState, setCurState);
 FUNCTION_SETTING(construct, Construct);
 FUNCTION_SETTING(switchToSmsMode, switchToSmsMode);
+FUNCTION_SETTING(dispatch, dispatch);
 
 END_ABS_CTOR
 
@@ -291,6 +381,7 @@ END_ABS_CTOR
 int GprsSelfTestRun( WorkState *this, StateContext *context)
 {
 	gprs_t	*this_gprs = GprsGetInstance();
+	Modem	*modem = ModemGetInstance();
 	
 	this->print( this, "[STS] gprs selftest state \r\n");
 
@@ -322,7 +413,7 @@ int GprsSelfTestRun( WorkState *this, StateContext *context)
 	else 
 	{
 		this->print( this, "[STS] detected sim failed,restart gprs\r\n");
-		this_gprs->startup(this_gprs);
+		modem->power( modem, 1);
 		context->setCurState( context, STATE_SelfTest);	
 	}
 	
@@ -345,71 +436,214 @@ FUNCTION_SETTING(WorkState.run, GprsSelfTestRun);
 END_CTOR
 
 ///-----------------------------------------------------------------------------
-//static int cntTry = 5;
-int GprsConnectRun( WorkState *this, StateContext *context)
+//·Ͽʧ֮󣬵ȴһʱ
+//ȴʱÿμӱõޣĶ̨豸ͬʱ
+//ȴӼʱ״̬·¼ճ
+#define RCNT_FAILS_MAX		15
+static struct {
+	uint8_t		fails[IPMUX_NUM];		//ʧܵĴ
+	uint8_t		waiting;				//ڵȴ·
+	uint32_t	up_s[IPMUX_NUM];		//·ӳɹʱ
+	uint32_t	seed;
+}Rcnt;
+
+static void reconnect_backoff( int link)
 {
-	gprs_t	*this_gprs = GprsGetInstance();
-	short cnnt_seq = 0;
-	short run = 1;
+	uint32_t	delay_ms;
+	uint32_t	wait_s;
+	
+	if( link < 0 || link >= IPMUX_NUM)
+		return;
+	if( Rcnt.fails[link] < RCNT_FAILS_MAX)
+		Rcnt.fails[link] ++;
+	
+	wait_s = ( uint32_t)Dtu_config.rcnt_base_s << ( Rcnt.fails[link] - 1);
+	if( wait_s > Dtu_config.rcnt_max_s || wait_s == 0)
+		wait_s = Dtu_config.rcnt_max_s;
+	//ʵʵȴʱ wait_s/2  wait_s ֮
+	Rcnt.seed = Rcnt.seed * 1103515245 + 12345 + get_time_ms();
+	delay_ms = wait_s * 500;
+	delay_ms += ( Rcnt.seed >> 8) % ( delay_ms + 1);
+	set_alarmclock_ms( ALARM_RECONNECT(link), delay_ms);
+	Rcnt.waiting = SET_U8_BIT( Rcnt.waiting, link);
+	DPRINTF("[CNN] link %d reconnect after %d ms\n", link, delay_ms);
+}
+
+//·ӳɹ¼ʱ䣬ϿʱжǲڷϿ
+static void reconnect_succeed( int link)
+{
+	Rcnt.up_s[link] = get_time_s();
+	Rcnt.waiting = CLR_U8_BIT( Rcnt.waiting, link);
+}
+
+//Ѿ·Ͽ
+//ӱֵʱ䳬ȴʱ䣬ΪǷϿ·ͷʼ
+static void reconnect_closed( int link)
+{
+	if( link < 0 || link >= IPMUX_NUM)
+		return;
+	if( get_time_s() - Rcnt.up_s[link] > Dtu_config.rcnt_max_s)
+		Rcnt.fails[link] = 0;
+	reconnect_backoff( link);
+}
+
+//ؿԷӵ·
+static uint8_t reconnect_due( uint8_t link_set)
+{
+	int i;
+	
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( CHK_U8_BIT( Rcnt.waiting, i) && Ringing( ALARM_RECONNECT(i)) == ERR_OK)
+			Rcnt.waiting = CLR_U8_BIT( Rcnt.waiting, i);
+	}
+	return link_set & ~Rcnt.waiting;
+}
+
+//һӻжãDTU_IDLE_MS
+//ֻܻڵ״̬ᴦӣеģʽ֮ӹûˣ
+//µû˹أһֱǵڵģ̲߳ͣ
+//ûڵȴ·Ҳù
+static int idle_ms( void)
+{
+	int wait_ms = DTU_IDLE_MS;
+	int ms;
+	int i;
+	
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( StateLine[ STATE_HeatBeatHandle])
+		{
+			ms = Alarm_remain_ms( ALARM_GPRSLINK(i));
+			if( ms >= 0 && ms < wait_ms)
+				wait_ms = ms;
+		}
+		if( StateLine[ STATE_CnntManager] == NULL || CHK_U8_BIT( Rcnt.waiting, i) == 0)
+			continue;
+		ms = Alarm_remain_ms( ALARM_RECONNECT(i));
+		if( ms >= 0 && ms < wait_ms)
+			wait_ms = ms;
+	}
+	return wait_ms;
+}
+
+//ӽ֮ʧܵ·ʼȴ
+static void reconnect_result( uint8_t link_set, int succeed)
+{
+	int i;
+	
+	if( succeed < 0)
+		return;
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( CHK_U8_BIT( link_set, i) == 0)
+			continue;
+		if( CHK_U8_BIT( succeed, i))
+			reconnect_succeed( i);
+		else
+			reconnect_backoff( i);
+	}
+}
+
+//ͬʱ򼯺еķӣȻӽ
+//ȴʱռgprs߳̿Լʹgprs
+//ӳɹ·ϣģ鲻ܹʱERR_DEV_SICK
+static int ConnectCenters( WorkState *this, uint8_t center_set)
+{
+	Modem	*modem = ModemGetInstance();
+	short	center[IPMUX_NUM];		//·Ӧ
+	uint8_t	pending = 0;
+	uint8_t	succeed = 0;
+	short	sick = 0;
+	short	retry = 0;
+	int i = 0;
+	int link = 0;
 	int ret = 0;
-	this->print( this, "[CNN]gprs cnnect state \r\n");
-	Led_level(LED_GPRS_CNNTING);
-	this_gprs->lock( this_gprs);
-	GprsTcpCnnectBeagin();
-	while( run)
+	
+	modem->lock( modem);
+	for( i = 0; i < IPMUX_NUM; i ++)
 	{
-		sprintf( this->dataBuf, "[CNN] cnnnect DC :%d,%s,%d,%s ...", cnnt_seq,Dtu_config.DateCenter_ip[ cnnt_seq],\
-			Dtu_config.DateCenter_port[cnnt_seq],Dtu_config.protocol[cnnt_seq] );
+		if( CHK_U8_BIT( center_set, i) == 0)
+			continue;
+		if( Dtu_config.DateCenter_port[i] <= 0)
+			continue;
+		//·ģʽĶʹ0·
+		link = dsys.gprs.cip_mux ? i : 0;
+		sprintf( this->dataBuf, "[CNN] cnnnect DC :%d,%s,%d,%s ...", i,Dtu_config.DateCenter_ip[ i],\
+			Dtu_config.DateCenter_port[i],Dtu_config.protocol[i] );
 		this->print( this, this->dataBuf);
 		
-		ret = this_gprs->tcpip_cnnt( this_gprs, cnnt_seq,Dtu_config.protocol[cnnt_seq], \
-				Dtu_config.DateCenter_ip[cnnt_seq], Dtu_config.DateCenter_port[cnnt_seq]);
+		Gprs_rudp_set( link, CHK_U8_BIT( Dtu_config.rudp_centers, i));
+		ret = modem->connect( modem, link, Dtu_config.protocol[i], \
+				Dtu_config.DateCenter_ip[i], Dtu_config.DateCenter_port[i]);
 		if( ret == ERR_OK)
 		{
-			while(1)
+			center[link] = i;
+			pending = SET_U8_BIT( pending, link);
+		}
+		else if( ret == ERR_DEV_SICK)
+		{
+			sick = 1;
+			break;
+		}
+		else if( ret == ERR_ADDR_ERROR )
+		{
+			if(Dtu_config.multiCent_mode)
+				Dtu_config.DateCenter_port[i] = -Dtu_config.DateCenter_port[i];
+			Led_level(LED_GPRS_ERR);
+			this->print( this,"[CNN] Addr error !\n");
+		}
+	}
+	modem->unlock( modem);
+	
+	while( pending)
+	{
+		osDelay( CNNT_POLL_MS);
+		modem->lock( modem);
+		link = modem->connected( modem, &ret);
+		if( ( link >= 0) && ( ret == ERR_OK))
+		{
+			//MQTTCONNECTע
+			for( retry = 0; retry < RETRY_TIMES; retry ++)
 			{
-				ret = this_gprs->sendto_tcp( this_gprs, cnnt_seq, Dtu_config.registry_package, strlen(Dtu_config.registry_package) );
-				if( ret == ERR_OK)
-				{
-						
-						this->print(this, "[CNN] succeed !\n");
-						Led_level(LED_GPRS_RUN);
-						if( Dtu_config.multiCent_mode == 0)
-						{
-							//
-							set_alarmclock_s( ALARM_GPRSLINK(0), Dtu_config.hartbeat_timespan_s);
-							run = 0;
-						}
-						else
-						{
-							//
-							set_alarmclock_s( ALARM_GPRSLINK(cnnt_seq), Dtu_config.hartbeat_timespan_s);
-						}
-						break;
-						
-				}
-				else if( ret == ERR_UNINITIALIZED )
-				{
-					this->print( this,"[CNN] can not send data !\n");
+				if( MqttClient_on())
+					ret = MqttClient_link_up( link);
+				else
+					ret = modem->send_link( modem, link, UPF_REGISTER, Dtu_config.registry_package, strlen(Dtu_config.registry_package) );
+				if( ( ret == ERR_OK) || ( ret == ERR_UNINITIALIZED))
 					break;
-				}
-				
-			}	//while(1)
-		}	//if( ret == ERR_OK)
+			}
+			Gprs_link_release( link);
+		}
+		modem->unlock( modem);
+		if( link < 0)
+			continue;
+		
+		pending = CLR_U8_BIT( pending, link);
+		i = center[link];
+		if( ret == ERR_OK)
+		{
+			sprintf( this->dataBuf, "[CNN] DC %d succeed !\n", i);
+			this->print( this, this->dataBuf);
+			Led_level(LED_GPRS_RUN);
+			//
+			set_alarmclock_s( ALARM_GPRSLINK(link), Dtu_config.hartbeat_timespan_s);
+			succeed = SET_U8_BIT( succeed, link);
+		}
+		else if( ret == ERR_UNINITIALIZED )
+		{
+			this->print( this,"[CNN] can not send data !\n");
+		}
 		else if( ret == ERR_DEV_SICK)
 		{
-			this->print(this, "[CNN] SIM card can not work!\n");
-			osDelay(2000);		//170719
-			
-			context->setCurState(context, STATE_SelfTest);	
-			goto exit;
+			sick = 1;
 		}
 		else if( ret == ERR_ADDR_ERROR )
 		{
 			//ֻжģʽ²ȥǷǷַ
 			//ģʽ£Ϸĵַӳɹ-Ͽ ѭҲ᷵ǳɴַҲ
 			if(Dtu_config.multiCent_mode)
-				Dtu_config.DateCenter_port[cnnt_seq] = -Dtu_config.DateCenter_port[cnnt_seq];
+				Dtu_config.DateCenter_port[i] = -Dtu_config.DateCenter_port[i];
 			Led_level(LED_GPRS_ERR);
 			this->print( this,"[CNN] Addr error !\n");
 		}
@@ -418,21 +652,54 @@ int GprsConnectRun( WorkState *this, StateContext *context)
 			
 			this->print(this, "[CNN] connect failed\n");
 		}
-		cnnt_seq ++;
-		osDelay(2000);		//170719
-		if( cnnt_seq >= IPMUX_NUM)
+	}
+	
+	if( sick)
+		return ERR_DEV_SICK;
+	return succeed;
+}
+
+int GprsConnectRun( WorkState *this, StateContext *context)
+{
+	short cnnt_seq = 0;
+	uint8_t	cnnt_set = 0;
+	int ret = 0;
+	this->print( this, "[CNN]gprs cnnect state \r\n");
+	Led_level(LED_GPRS_CNNTING);
+	GprsTcpCnnectBeagin();
+	if( Dtu_config.multiCent_mode)
+	{
+		//ģʽ£ͬʱ
+		cnnt_set = reconnect_due( ( 1 << IPMUX_NUM) - 1);
+		if( cnnt_set)
+			ret = ConnectCenters( this, cnnt_set);
+		reconnect_result( cnnt_set, ret);
+	}
+	else if( reconnect_due( 1))
+	{
+		//ģʽ£˳ӣһͽ
+		//Ķʹ0·һֶûϲſʼȴ
+		for( cnnt_seq = 0; cnnt_seq < IPMUX_NUM; cnnt_seq ++)
 		{
-			
-			cnnt_seq = 0;
-			run = 0;
+			ret = ConnectCenters( this, SET_U8_BIT( 0, cnnt_seq));
+			if( ret != 0)
+				break;
 		}
-	}	//while( run)		
+		reconnect_result( 1, ret);
+	}
 	GprsTcpCnnectFinish();	
-	this_gprs->unlock( this_gprs);
+	
+	if( ret == ERR_DEV_SICK)
+	{
+		this->print(this, "[CNN] SIM card can not work!\n");
+		osDelay(2000);		//170719
+		
+		context->setCurState(context, STATE_SelfTest);	
+		return 	ERR_OK;
+	}
 	
 	context->nextState( context, STATE_Connect);
 //	context->setCurState( context, context->gprsEventHandleState);	
-	exit:
 	return 	ERR_OK;
 				
 }
@@ -443,28 +710,62 @@ FUNCTION_SETTING(WorkState.run, GprsConnectRun);
 END_CTOR
 
 ///-----------------------------------------------------------------------------
+//ݵȼmodbus쳣ӦǽģóȵǴ
+//쳣Ӧֻ5ֽڣλ1
+//CRCֽmodbusRTU_cli˵һȷֶ
+static int uplink_class( char *data, int len)
+{
+	uint16_t	crc;
+	
+	if( len == 5 && ( data[1] & 0x80))
+	{
+		crc = CRC16( ( uint8_t *)data, 3);
+		if( crc == ( ( ( uint8_t)data[3] << 8) | ( uint8_t)data[4]) || \
+			crc == ( ( ( uint8_t)data[4] << 8) | ( uint8_t)data[3]))
+			return UPLINK_URGENT;
+	}
+	if( UPLINK_BULK_ENABLE && Dtu_config.bulk_len && len >= Dtu_config.bulk_len)
+		return UPLINK_BULK;
+	return UPLINK_NORMAL;
+}
+
 int TcpModbusAckCB( char *data, int len, void *arg)
 {
-	gprs_t	*this_gprs = GprsGetInstance();
+	Modem	*modem = ModemGetInstance();
 	int 		line = *( int *)arg;
 	int ret = 0;
-	this_gprs->lock( this_gprs);
+	
+	//485һַ
+	if( MqttClient_on())
+		return MqttClient_put( data, len, uplink_class( data, len));
+	modem->lock( modem);
 
-	ret = this_gprs->sendto_tcp( this_gprs, line, data, len);
-	this_gprs->unlock( this_gprs);
+	ret = modem->send_link( modem, line, UPF_DATA, data, len);
+	modem->unlock( modem);
 	
 	return ret;
 }
 
+//MQTTܾӻ߲ӦPINGREQر·ϱϿ¼ӹȥ
+//Ҫgprs
+static void mqtt_drop_link( int link)
+{
+	Modem	*modem = ModemGetInstance();
+	
+	modem->close( modem, link);
+	dsys.gprs.set_tcp_close = SET_U8_BIT( dsys.gprs.set_tcp_close, link);
+	Modem_post( MODEM_EV_CLOSE, link);
+}
+
 static void SMSConfigSystem_ack( char *data, void *arg)
 {
 	int source = *(int *)arg;
-	gprs_t	*this_gprs = GprsGetInstance();
+	Modem	*modem = ModemGetInstance();
 	
-	this_gprs->lock( this_gprs);
+	modem->lock( modem);
 
-	this_gprs->send_text_sms( this_gprs, Dtu_config.admin_Phone[ source], data);
-	this_gprs->unlock( this_gprs);
+	modem->sms_send( modem, Dtu_config.admin_Phone[ source], data);
+	modem->unlock( modem);
 	
 }
 
@@ -473,6 +774,7 @@ static void SMSConfigSystem_ack( char *data, void *arg)
 int GprsEventHandleRun( WorkState *this, StateContext *context)
 {
 	gprs_t	*this_gprs = GprsGetInstance();
+	Modem	*modem = ModemGetInstance();
 	GprsEventHandleState	*self = SUB_PTR( this, WorkState, GprsEventHandleState);
 	
 	int				lszie = 0;
@@ -496,8 +798,12 @@ int GprsEventHandleRun( WorkState *this, StateContext *context)
 		
 	while( 1)
 	{
+		//һδ¼һֽŴ
 		if( safeCount > EVENT_MAX )
+		{
+			Dtu_post( DTU_EV_RECV);
 			break;
+		}
 		safeCount ++;
 
 		lszie = this->bufLen;
@@ -507,9 +813,22 @@ int GprsEventHandleRun( WorkState *this, StateContext *context)
 			
 			break;
 		}
-		this_gprs->lock( this_gprs);		
-		ret = this_gprs->deal_tcprecv_event(this_gprs, this->dataBuf,  &lszie);
-		this_gprs->unlock( this_gprs);
+		modem->lock( modem);		
+		ret = modem->recv( modem, this->dataBuf,  &lszie);
+		//MQTTֻѶϵݽ洦
+		if( ret >= 0 && MqttClient_on())
+		{
+			lszie = MqttClient_input( ret, this->dataBuf, lszie);
+			if( lszie < 0)
+				mqtt_drop_link( ret);
+			if( lszie <= 0)
+			{
+				modem->unlock( modem);
+				continue;
+			}
+			this->dataBuf[ lszie] = '\0';
+		}
+		modem->unlock( modem);
 		if( ret >= 0)
 		{
 			//յӣⷢ
@@ -520,7 +839,7 @@ int GprsEventHandleRun( WorkState *this, StateContext *context)
 			if( pp)
 			{
 				this->print( this, "[EHA] switch to SMSMODE\r\n");
-				this_gprs->tcpClose( this_gprs, ret);
+				modem->close( modem, ret);
 				context->switchToSmsMode( context);
 //				Dtu_config.work_mode = MODE_SMS;
 	//					context->setCurState( context, context->gprsDealSMSState);	
@@ -537,9 +856,9 @@ int GprsEventHandleRun( WorkState *this, StateContext *context)
 		lszie = this->bufLen;
 		memset( DtuTempBuf, 0, sizeof( DtuTempBuf));
 		
-		this_gprs->lock( this_gprs);	
-		smsSeq = this_gprs->deal_smsrecv_event( this_gprs, this->dataBuf,  &lszie, DtuTempBuf);			
-		this_gprs->unlock( this_gprs);
+		modem->lock( modem);	
+		smsSeq = modem->sms_recv( modem, this->dataBuf,  &lszie, DtuTempBuf);			
+		modem->unlock( modem);
 		if( smsSeq > 0)
 		{
 			for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
@@ -554,18 +873,19 @@ int GprsEventHandleRun( WorkState *this, StateContext *context)
 				}
 					
 			}
-			this_gprs->delete_sms( this_gprs, smsSeq);
+			modem->sms_delete( modem, smsSeq);
 //			this_gprs->free_event( this_gprs, gprs_event);
 			continue;
 		}
 				
-		ret = this_gprs->deal_tcpclose_event( this_gprs);
+		ret = modem->closed( modem);
 		if( ret >= 0)
 		{	
 			Led_level(LED_GPRS_DISCNNT);
 			sprintf( this->dataBuf, "[EHA] tcp close : %d ", ret);
 			this->print( this, this->dataBuf);
-			osDelay(10000);
+			//ȴʱӹȥ
+			reconnect_closed( dsys.gprs.cip_mux ? ret : 0);
 		}
 //		this_gprs->free_event( this_gprs, gprs_event);
 					
@@ -597,21 +917,54 @@ int Ser485ModbusAckCB( char *data, int len, void *arg)
 int GprsHeatBeatRun( WorkState *this, StateContext *context)
 {
 	gprs_t	*this_gprs = GprsGetInstance();
+	Modem	*modem = ModemGetInstance();
 	int i = 0;
 //	this->print( this, "gprs heatbeat state \r\n");
 
 	
 	for( i = 0; i < IPMUX_NUM; i ++)
 	{
+		//ڱ޸ˣʱе·µ¼ʱ
+		if( ( context->events & DTU_EV_CONF) && Alarm_remain_ms( ALARM_GPRSLINK(i)) >= 0)
+			set_alarmclock_s( ALARM_GPRSLINK(i), Dtu_config.hartbeat_timespan_s);
+		//ģTCPӣ÷UDP·ûб
+		//ӻҪص߳һֱܵȴ
+		if( dsys.gprs.tka_on && CHK_U8_BIT( Dtu_config.tka_links, i) && Gprs_link_udp( i) == 0)
+		{
+			Ringing( ALARM_GPRSLINK(i));
+			continue;
+		}
+		//ʱӣһݷͲ
 		if( Ringing(ALARM_GPRSLINK(i)) == ERR_OK)
 		{
 			set_alarmclock_s( ALARM_GPRSLINK(i), Dtu_config.hartbeat_timespan_s);
-			this_gprs->lock( this_gprs);			
-			this_gprs->sendto_tcp( this_gprs, i, Dtu_config.heatbeat_package, strlen( Dtu_config.heatbeat_package));	
-			this_gprs->unlock( this_gprs);
+			modem->lock( modem);			
+			//MQTTPINGREQ
+			if( MqttClient_on())
+			{
+				if( MqttClient_ping( i) == ERR_DEV_TIMEOUT)
+					mqtt_drop_link( i);
+			}
+			else
+				modem->send_link( modem, i, UPF_HEARTBEAT, Dtu_config.heatbeat_package, strlen( Dtu_config.heatbeat_package));	
+			modem->unlock( modem);
 		
 		}	
 	}
+	//ģʱУ׼ʱ䣬SNTPҪȼ룬Է߳
+	if( Dtu_config.time_src != WCLK_SRC_OFF && Wclock_due( get_time_s()))
+	{
+		this_gprs->lock( this_gprs);
+		Gprs_time_sync( this_gprs);
+		this_gprs->unlock( this_gprs);
+	}
+	//ڵ·ʱ½Ͽֱ֮µIP
+	if( Dtu_config.dns_ttl_s && Dns_refresh_due( get_time_s()))
+	{
+		this_gprs->lock( this_gprs);
+		Gprs_dns_refresh( this_gprs);
+		this_gprs->unlock( this_gprs);
+	}
 
 			
 //	context->setCurState( context, context->gprsCnntManagerState);	
@@ -634,7 +987,9 @@ int  GprsCnntManagerRun( WorkState *this, StateContext *context)
 	gprs_t	*this_gprs = GprsGetInstance();
 	int cnntNum = 0;	
 	int	safecount = 0;
+	uint8_t	cnntSet = 0;
 	int	i;
+	int	ret;
 //	this->print( this, "gprs cnnt manager state \r\n");
 
 	//޷ʱ¶
@@ -642,6 +997,12 @@ int  GprsCnntManagerRun( WorkState *this, StateContext *context)
 	cnntNum = this_gprs->get_firstCnt_seq(this_gprs);
 	if( cnntNum < 0)
 	{
+		//ûʱ䣬ȴ¼
+		if( reconnect_due( Dtu_config.multiCent_mode ? ( 1 << IPMUX_NUM) - 1 : 1) == 0)
+		{
+			context->nextState( context, STATE_CnntManager);
+			return ERR_OK;
+		}
 		strcpy( this->dataBuf, "[CMN] None connnect, reconnect...");
 		this->print( this, this->dataBuf);
 		if(this_gprs->get_sim_info(this_gprs) != ERR_OK)
@@ -674,39 +1035,24 @@ int  GprsCnntManagerRun( WorkState *this, StateContext *context)
 		return ERR_OK;
 	}
 	
-	//ĵĻδϵ·
+	//ĵĻδϵ·ͬʱ
 	if( Dtu_config.multiCent_mode)
 	{
-		
-		this_gprs->lock( this_gprs);
-		
-		while( 1)
+		cnntSet = 0;
+		for( safecount = 0; safecount < IPMUX_NUM; safecount ++)
 		{
 			cnntNum = this_gprs->get_firstDiscnt_seq(this_gprs);
 			if( cnntNum >= 0)
-			{
-//				sprintf( this->dataBuf, "cnnnect DC :%d,%s,%d,%s ...", cnntNum ,Dtu_config.DateCenter_ip[ cnntNum],\
-//					Dtu_config.DateCenter_port[ cnntNum],Dtu_config.protocol[ cnntNum] );
-//				this->print( this, this->dataBuf);
-				if( this_gprs->tcpip_cnnt( this_gprs, cnntNum, Dtu_config.protocol[ cnntNum], Dtu_config.DateCenter_ip[cnntNum], Dtu_config.DateCenter_port[cnntNum]) == ERR_OK)
-				{
-					this_gprs->sendto_tcp( this_gprs, cnntNum, Dtu_config.registry_package, strlen(Dtu_config.registry_package) );
-//					this->print( this," succeed !\n");
-				}
-//				else
-//				{
-//					this->print( this, " failed !\n");
-//					
-//				}
-			}
-			safecount ++;
-			if( safecount > IPMUX_NUM)
-				break;
+				cnntSet = SET_U8_BIT( cnntSet, cnntNum);
+		}
+		cnntSet = reconnect_due( cnntSet);
+		if( cnntSet)
+		{
+			ret = ConnectCenters( this, cnntSet);
+			reconnect_result( cnntSet, ret);
 		}
-
-		this_gprs->unlock( this_gprs);		
 	}		
-	context->setCurState( context, STATE_EventHandle );	
+	context->nextState( context, STATE_CnntManager);
 	return 	ERR_OK;		
 }
 
@@ -716,11 +1062,13 @@ FUNCTION_SETTING(WorkState.run, GprsCnntManagerRun);
 END_CTOR
 ///-----------------------------------------------------------------------------
 
+//û¶֪ͨʱѯŵļģ©֪ͨҲܴ
+#define SMS_POLL_S		10
 int GprsDealSMSRun( WorkState *this, StateContext *context)
 {
-	gprs_t	*this_gprs = GprsGetInstance();
+	Modem	*modem = ModemGetInstance();
 	GprsDealSMSState	*self = SUB_PTR( this, WorkState, GprsDealSMSState);
-	static	uint8_t skip = 0;		//Ϊ˱ÿζĲѯ
+	static	uint32_t poll_s = 0;		//Ϊ˱ÿζĲѯ
 	
 	int			lszie = 0;
 	short 		i = 0;
@@ -733,23 +1081,22 @@ int GprsDealSMSRun( WorkState *this, StateContext *context)
 
 	Led_level(LED_GPRS_SMS);
 	context->nextState( context, STATE_SMSHandle);
+	//ģʽӲϵʱģȥ
+	context->setCurState( context, STATE_Connect);
 	
-	if( skip)
-	{
-		skip --;
+	if( ( context->events & DTU_EV_SMS) == 0 && get_time_s() - poll_s < SMS_POLL_S)
 		return 	ERR_OK;
-	}
 	this->print( this, "[SMS] gprs deal sms state \r\n");
-	skip = 255;
-	this_gprs->lock( this_gprs);
+	poll_s = get_time_s();
+	modem->lock( modem);
 	while( 1)
 	{
 		lszie = this->bufLen;
-		smsSeq = this_gprs->read_phnNmbr_TextSMS( this_gprs, DtuTempBuf, this->dataBuf,   this->dataBuf, &lszie);				
+		smsSeq = modem->sms_read( modem, this->dataBuf, &lszie, DtuTempBuf);				
 		if( smsSeq >= 0)
 		{
 			//յ»ؾͲ
-			skip = 0;
+			poll_s = get_time_s() - SMS_POLL_S;
 			for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
 			{
 				if( compare_phoneNO( DtuTempBuf, Dtu_config.admin_Phone[i]) == 0)
@@ -765,7 +1112,7 @@ int GprsDealSMSRun( WorkState *this, StateContext *context)
 				}
 				
 			}
-			this_gprs->delete_sms( this_gprs, smsSeq);
+			modem->sms_delete( modem, smsSeq);
 		}	
 		else
 		{
@@ -776,7 +1123,7 @@ int GprsDealSMSRun( WorkState *this, StateContext *context)
 			break;
 		}
 	}	
-	this_gprs->unlock( this_gprs);
+	modem->unlock( modem);
 
 	return 	ERR_OK;
 				
@@ -1127,6 +1474,18 @@ BusinessProcess *GetForwardSMS(void)
 	
 }
 
+BusinessProcess *GetForwardMqtt(void)
+{
+	static ForwardMqtt *singleton = NULL;
+	if( singleton == NULL)
+	{
+		singleton = ForwardMqtt_new();
+		
+	}
+	return ( BusinessProcess *)singleton;
+	
+}
+
 // ҵʵ
 int Emptyprocess( char *data, int len, hookFunc cb, void *arg)
 {
@@ -1184,27 +1543,11 @@ END_CTOR
 
 int ForwardNetProcess( char *data, int len, hookFunc cb, void *arg)
 {
-	gprs_t	*this_gprs = GprsGetInstance();
-	int i = 0;
-//	this_gprs->lock( this_gprs);
-	
-	if( Dtu_config.multiCent_mode == 0)
-	{
-		//
-		set_alarmclock_s( ALARM_GPRSLINK(0), Dtu_config.hartbeat_timespan_s);
-		
-	}
-	else
-	{
-		//
-		for( i = 0; i < IPMUX_NUM; i ++)
-			set_alarmclock_s( ALARM_GPRSLINK(i), Dtu_config.hartbeat_timespan_s);
-	}
-	
+	Modem	*modem = ModemGetInstance();
 	
+	//ȥʱ
 
-	this_gprs->sendto_tcp_buf( this_gprs, data, len);
-//	this_gprs->unlock( this_gprs);
+	modem->send( modem, data, len, uplink_class( data, len));
 	
 	return ERR_OK;
 }
@@ -1213,39 +1556,24 @@ CTOR( ForwardNet)
 FUNCTION_SETTING( BusinessProcess.process, ForwardNetProcess);
 END_CTOR
 
+//ݷŷͶУɶ̷߳ͣȴ
 int ForwardSMSProcess( char *data, int len, hookFunc cb, void *arg)
 {
-	gprs_t	*this_gprs = GprsGetInstance();
-	int	ret;
-	short i = 0;
-	short count = 0;
-	
-	this_gprs->lock( this_gprs);
-	for( i = 0; i < ADMIN_PHNOE_NUM; )
-	{
-		ret = this_gprs->send_text_sms( this_gprs, Dtu_config.admin_Phone[i], data);
-		if( ret == ERR_FAIL)
-		{
-			count ++;
-			if( count > 3)	//3
-			{
-				i ++;
-				count = 0;
-			}
-			
-		}
-		
-		else 
-		{
-			i ++;
-			count = 0;
-		}
-	}
-	this_gprs->unlock( this_gprs);
-	
+	SmsQ_put( data, len);
 	return ERR_OK;
 }
 
 CTOR( ForwardSMS)
 FUNCTION_SETTING( BusinessProcess.process, ForwardSMSProcess);
 END_CTOR
+
+//ʹMQTTЭʱ485ݰַϲ󷢲
+int ForwardMqttProcess( char *data, int len, hookFunc cb, void *arg)
+{
+	MqttClient_put( data, len, uplink_class( data, len));
+	return ERR_OK;
+}
+
+CTOR( ForwardMqtt)
+FUNCTION_SETTING( BusinessProcess.process, ForwardMqttProcess);
+END_CTOR
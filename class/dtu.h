@@ -7,6 +7,16 @@
 #define DTUTMP_BUF_LEN		64
 extern char	DtuTempBuf[DTUTMP_BUF_LEN];
 
+//DTU̵߳¼̵߳źű־ݣڻصҲԷ
+//߳û¼ʱȴյ¼ֻ֮дЩ¼״̬
+#define DTU_EV_RECV			0x01		//·յ
+#define DTU_EV_LINK			0x02		//·Ͽ˻ģػ
+#define DTU_EV_SMS			0x04		//յ˶
+#define DTU_EV_TIMER		0x08		//ӵˣߵȴʱ
+#define DTU_EV_CONF			0x10		//ñ޸
+#define DTU_EV_ALL			0x1f
+#define DTU_IDLE_MS			5000		//ûӵʱĵȴʱ
+
 typedef int ( *hookFunc)( char *data, int len, void *arg);
 ABS_CLASS( StateContext);
 INTERFACE( BusinessProcess);
@@ -54,12 +64,15 @@ ABS_CLASS( StateContext)
 //	WorkState *gprsHeatBeatState;
 //	WorkState *gprsCnntManagerState;
 	WorkState *curState;
+	uint8_t		events;			//һҪ¼
+	uint8_t		runSet;			//һֻûе״̬
 	
 	int (*init)( StateContext *this, char *buf, int bufLen);
 	void ( *setCurState)( StateContext *this, int targetState);
 	void	(*nextState)( StateContext *this, int myState); 
 	int ( *construct)( StateContext *this , Builder *state_builder);
 	void (*switchToSmsMode)( StateContext *this);
+	void (*dispatch)( StateContext *this);		//һֵ״̬ˣȴ¼
 	//abs
 	int (*initState)( StateContext *this);
 };
@@ -249,6 +262,12 @@ CLASS( ForwardSMS)
 	IMPLEMENTS( BusinessProcess);
 	
 	
+};
+CLASS( ForwardMqtt)
+{
+	IMPLEMENTS( BusinessProcess);
+	
+	
 };
 
 BusinessProcess *GetEmptyProcess(void);
@@ -257,8 +276,10 @@ BusinessProcess *GetConfigSystem(void);
 BusinessProcess *GetForwardSer485(void);
 BusinessProcess *GetForwardNet(void);
 BusinessProcess *GetForwardSMS(void);
+BusinessProcess *GetForwardMqtt(void);
 
 int Ser485ModbusAckCB( char *data, int len, void *arg);
+void Dtu_post( int ev);
 
 
 
@@ -8,10 +8,27 @@
 #include "TTextConfProt.h"
 #include "times.h"
 #include "led.h"
+#include "spool.h"
+#include "route.h"
+#include "wclock.h"
+#include "dnscache.h"
+#include "smsQueue.h"
 #include "modbusRTU_cli.h"
+#include "system.h"
+#include "gprs_uart.h"
+#include "dtu.h"
+#include "upframe.h"
+#include <stddef.h>
 #define CONFIG_BUF_LEN  512
 sdhFile *DtuCfg_file;
 DtuCfg_t	Dtu_config;
+//ýṹsys.cfgĴСʱڱڱʱβֶζ0
+typedef char DtuCfg_size_check[ ( sizeof( DtuCfg_t) <= DTUCONF_SIZE) ? 1 : -1];
+//ɵӰ汾Ľṹ峤ȣʱⲿã¼ӵֶĬֵ
+static const uint16_t Cfg_sub_len[ DTU_CONFGILE_SUB_VER] = {
+	0,
+	offsetof( DtuCfg_t, spool_size_kb),		//Ӱ汾1
+};
 static other_ack g_other_ack = NULL;
 static	void *g_ack_arg = NULL;
 
@@ -71,6 +88,8 @@ int Config_server( char *data, other_ack ack, void *arg)
 		g_ack_arg = arg;
 		dtu_conf(data);
 		decodeTTCP_finish();
+		//֪ͨDTỤ߳ЩЧ
+		Dtu_post( DTU_EV_CONF);
 		return 0;
 	}
 	g_other_ack = NULL;
@@ -108,6 +127,38 @@ void set_default( DtuCfg_t *conf)
 		
 	}
 	memcpy( &conf->the_485cfg, &Conf_S485Usart_default, sizeof( Conf_S485Usart_default));
+	conf->spool_size_kb = SPOOL_DEF_SIZE_KB;
+	conf->spool_rate_Bps = 0;
+	conf->spool_drop = SPOOL_DROP_OLD;
+	conf->rcnt_base_s = DEF_RCNT_BASE_S;
+	conf->rcnt_max_s = DEF_RCNT_MAX_S;
+	conf->tka_links = 0;
+	conf->ipr_baud = DEF_IPR_BAUD;
+	conf->ipr_cur = 0;
+	conf->ipr_nego = 1;
+	conf->rxget_on = 0;
+	conf->ack_win = 0;
+	conf->rudp_centers = 0;
+	conf->mqtt_on = 0;
+	conf->mqtt_qos = 0;
+	conf->mqtt_batch_ms = DEF_MQTT_BATCH_MS;
+	conf->mqtt_adc_s = 0;
+	conf->mqtt_user[0] = '\0';
+	conf->mqtt_pass[0] = '\0';
+	strcpy( conf->mqtt_topic[ MQTT_TOPIC_RTU], DEF_MQTT_TOPIC);
+	strcpy( conf->mqtt_topic[ MQTT_TOPIC_ADC], DEF_MQTT_ADC_TOPIC);
+	strcpy( conf->mqtt_topic[ MQTT_TOPIC_SUB], DEF_MQTT_SUB_TOPIC);
+	conf->bulk_len = 0;
+	conf->upf_on = 0;
+	conf->upf_lz = 0;
+	conf->route_mode = ROUTE_ALL;
+	conf->route_primary = 0;
+	conf->time_src = WCLK_SRC_NITZ;
+	conf->batch_s = 0;
+	strcpy( conf->ntp_server, DEF_NTP_SERVER);
+	conf->dns_ttl_s = DEF_DNS_TTL_S;
+	conf->dns_neg_s = DEF_DNS_NEG_S;
+	conf->sms_pdu = 0;
 	
 	for( i = 0; i < IPMUX_NUM; i++)
 	{
@@ -121,7 +172,7 @@ void set_default( DtuCfg_t *conf)
 
 static int get_dtuCfg(DtuCfg_t *conf)
 {
-	
+	int		old_len = 0;
 	
 	DtuCfg_file	= fs_open( DTUCONF_filename);
 	DPRINTF(" fs_open  %p \n", DtuCfg_file);
@@ -130,23 +181,40 @@ static int get_dtuCfg(DtuCfg_t *conf)
 		//todo: 2017-02-04 21:40:21 ˴ʱ8s
 		fs_read( DtuCfg_file, (uint8_t *)conf, sizeof( DtuCfg_t));
 		DPRINTF(" fs_read  done \n");
-		if( conf->ver[0] == DTU_CONFGILE_MAIN_VER &&  conf->ver[1] == DTU_CONFGILE_SUB_VER)
+		if( conf->ver[0] == DTU_CONFGILE_MAIN_VER &&  conf->ver[1] == DTU_CONFGILE_SUB_VER && \
+			fs_du( DtuCfg_file) >= sizeof( DtuCfg_t))
 		{
 			
 			return ERR_OK;
 		}
+		if( conf->ver[0] == DTU_CONFGILE_MAIN_VER && conf->ver[1] > 0 && conf->ver[1] < DTU_CONFGILE_SUB_VER)
+		{
+			DPRINTF(" sys.cfg upgrade from sub ver %d \n", conf->ver[1]);
+			old_len = Cfg_sub_len[ conf->ver[1]];
+		}
 	}
-	else
+	
+	//ȫĬֵɵӰ汾ٴļѾĲ
+	set_default( conf);
+	if( old_len)
+	{
+		fs_lseek( DtuCfg_file, 0, RD_SEEK_SET);
+		fs_read( DtuCfg_file, (uint8_t *)conf, old_len);
+		conf->ver[1] = DTU_CONFGILE_SUB_VER;
+	}
+	//ɰ汾ļװڵĽṹ壬дȥβᱻصҪ´Сؽ
+	if( DtuCfg_file && fs_du( DtuCfg_file) < sizeof( DtuCfg_t))
+	{
+		DPRINTF(" sys.cfg too small %d, recreate \n", fs_du( DtuCfg_file));
+		fs_delete( DtuCfg_file);
+		DtuCfg_file = NULL;
+	}
+	if( DtuCfg_file == NULL)
 	{
-		DtuCfg_file	= fs_creator( DTUCONF_filename, sizeof( DtuCfg_t));
+		DtuCfg_file	= fs_creator( DTUCONF_filename, DTUCONF_SIZE);
 		DPRINTF(" fs_creator  %p \n", DtuCfg_file);
-			
 	}
 	
-	
-	
-	set_default( conf);
-	
 	if( DtuCfg_file)
 	{
 		fs_lseek( DtuCfg_file, WR_SEEK_SET, 0);
@@ -188,6 +256,17 @@ static void dtu_conf(char *data)
 	char *parg;
 	int 	i_data = 0;
 	short		i = 0, j = 0;
+	uint16_t	u16_sent, u16_fail;
+	uint32_t	u32_unacked, u32_stall;
+	trspMode_t	*p_trsp;
+	gprs_boot_t	*p_boot;
+	rudp_t		*p_rudp;
+	mqtt_stat_t	*p_mqtt;
+	uplink_lat_t	*p_lat;
+	uint32_t	u32_raw, u32_out;
+	route_center_t	*p_center;
+	wclock_stat_t	*p_clk;
+	dns_entry_t	*p_dns;
 	char		tmpbuf[8];
 	char		com_Wordbits[4] = { '8', '9', 0, 0};
 	char		com_stopbit[4] = { '1', '2',0,0};
@@ -304,6 +383,12 @@ static void dtu_conf(char *data)
 					i++;
 					break;
 				case 3:
+					if( strcmp( parg, "TCP") && strcmp( parg, "UDP"))
+					{
+						strcpy( data, "ERROR");
+						ack_str( data);
+						goto exit;
+					}
 					strcpy( Dtu_config.protocol[ i_data], parg);
 					
 					strcpy( data, "OK");
@@ -849,6 +934,649 @@ static void dtu_conf(char *data)
 				
 			}
 		}
+		//SPOL=KB,,ٶB/s
+		else if( strcmp(pcmd ,"SPOL") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d,%d,%d,%d%%,%d,%d", Dtu_config.spool_size_kb, Dtu_config.spool_drop, \
+						Dtu_config.spool_rate_Bps, Spool_usage(), Spool_count(), Spool_drop_count());
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			switch(i)
+			{
+				case 0:
+					if( i_data != 0 && ( i_data < SPOOL_SIZE_KB_MIN || i_data > SPOOL_SIZE_KB_MAX))
+					{
+						strcpy( data, "ERROR");
+						ack_str( data);
+						goto exit;
+					}
+					Dtu_config.spool_size_kb = i_data;
+					i++;
+					break;
+				case 1:
+					if( i_data != SPOOL_DROP_NEW && i_data != SPOOL_DROP_OLD)
+					{
+						strcpy( data, "ERROR");
+						ack_str( data);
+						goto exit;
+					}
+					Dtu_config.spool_drop = i_data;
+					i++;
+					break;
+				case 2:
+					Dtu_config.spool_rate_Bps = i_data;
+					i++;
+					break;
+				default:
+					strcpy( data, "ERROR");
+					ack_str( data);
+					goto exit;
+			}
+		}
+		//RCNT=ʼȴ,ȴ
+		else if( strcmp(pcmd ,"RCNT") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d,%d", Dtu_config.rcnt_base_s, Dtu_config.rcnt_max_s);
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			switch(i)
+			{
+				case 0:
+					if( i_data < 1 || i_data > 0xffff)
+					{
+						strcpy( data, "ERROR");
+						ack_str( data);
+						goto exit;
+					}
+					Dtu_config.rcnt_base_s = i_data;
+					i++;
+					break;
+				case 1:
+					if( i_data < Dtu_config.rcnt_base_s || i_data > 0xffff)
+					{
+						strcpy( data, "ERROR");
+						ack_str( data);
+						goto exit;
+					}
+					Dtu_config.rcnt_max_s = i_data;
+					i++;
+					break;
+				default:
+					strcpy( data, "ERROR");
+					ack_str( data);
+					goto exit;
+			}
+		}
+		//TKA=·ϣÿһλӦһ·Ч
+		else if( strcmp(pcmd ,"TKA") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d,%d", Dtu_config.tka_links, dsys.gprs.tka_on);
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i != 0 || i_data < 0 || i_data >= ( 1 << IPMUX_NUM))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.tka_links = i_data;
+			i++;
+		}
+		//IPR=߲ʣ0ʾЭ̣´οЧ
+		else if( strcmp(pcmd ,"IPR") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أ߲,ģ鵱ǰĲ,ڵǰĲ
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d,%d,%d", ( int)Dtu_config.ipr_baud, ( int)Dtu_config.ipr_cur, ( int)gprs_uart_get_baud());
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i != 0 || GprsIprCheck( i_data) != ERR_OK)
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.ipr_baud = i_data;
+			Dtu_config.ipr_nego = 1;
+			i++;
+		}
+		//RXGET=1 ʹȡģʽ0 ʹģͣЧ
+		else if( strcmp(pcmd ,"RXGET") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أ,ǷѾ,ÿ· ģȡֽ/ֽ
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d,%d", Dtu_config.rxget_on, Gprs_rxget_on());
+				for( j = 0; j < IPMUX_NUM; j ++)
+					sprintf( data + strlen( data), ",%d/%d", Gprs_get_rxpending( j), ( int)Gprs_get_rxdrop( j));
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i != 0 || ( i_data != 0 && i_data != 1))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.rxget_on = i_data;
+			i++;
+		}
+		//ACKW=ʹֽ0ʾ
+		else if( strcmp(pcmd ,"ACKW") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أ,ÿ· δȷϵֽ/Ϊȴʱms
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d", Dtu_config.ack_win);
+				for( j = 0; j < IPMUX_NUM; j ++)
+				{
+					Gprs_get_txwin( j, &u32_unacked, &u32_stall);
+					sprintf( data + strlen( data), ",%d/%d", ( int)u32_unacked, ( int)u32_stall);
+				}
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i != 0 || i_data < 0 || i_data > 0xffff)
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.ack_win = i_data;
+			i++;
+		}
+		//RUDP=ļϣÿһλӦһģֻUDPãЧ
+		else if( strcmp(pcmd ,"RUDP") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أ,ÿ· ط/֡/յظ֡ûõ·-
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d", Dtu_config.rudp_centers);
+				for( j = 0; j < IPMUX_NUM; j ++)
+				{
+					p_rudp = Gprs_get_rudp( j);
+					if( p_rudp == NULL)
+						strcat( data, ",-");
+					else
+						sprintf( data + strlen( data), ",%d/%d/%d", ( int)p_rudp->retrans, ( int)p_rudp->lost, ( int)p_rudp->dup);
+				}
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			//ûбɿUDPʱֻó0
+			if( i != 0 || i_data < 0 || i_data >= ( 1 << IPMUX_NUM) || ( RUDP_ENABLE == 0 && i_data))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.rudp_centers = i_data;
+			i++;
+		}
+		//MQTT=,QoS,ϲȴms,ADCsֻǰ漸Ч
+		else if( strcmp(pcmd ,"MQTT") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أõ4,/ϲ֡/ط/ķ/ķ
+			if( parg[0] == '?')
+			{
+				p_mqtt = MqttClient_stat();
+				sprintf( data, "%d,%d,%d,%d,%d/%d/%d/%d/%d", Dtu_config.mqtt_on, Dtu_config.mqtt_qos, \
+						Dtu_config.mqtt_batch_ms, Dtu_config.mqtt_adc_s, ( int)p_mqtt->pub, ( int)p_mqtt->frames, \
+						( int)p_mqtt->retrans, ( int)p_mqtt->lost, ( int)p_mqtt->drop);
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			switch( i)
+			{
+				case 0:
+				case 1:
+					if( i_data != 0 && i_data != 1)
+						break;
+					//ûбMQTTʱ
+					if( i == 0 && i_data && MQTT_ENABLE == 0)
+						break;
+					if( i == 0)
+						Dtu_config.mqtt_on = i_data;
+					else
+						Dtu_config.mqtt_qos = i_data;
+					i ++;
+					continue;
+				case 2:
+				case 3:
+					if( i_data < 0 || i_data > 0xffff)
+						break;
+					if( i == 2)
+						Dtu_config.mqtt_batch_ms = i_data;
+					else
+						Dtu_config.mqtt_adc_s = i_data;
+					i ++;
+					continue;
+			}
+			strcpy( data, "ERROR");
+			ack_str( data);
+			goto exit;
+		}
+		//MQTTU=û,룬ûΪյʱ򲻴û룬Ч
+		else if( strcmp(pcmd ,"MQTTU") == 0)
+		{
+			if( parg == NULL)
+			{
+				if( i == 0)
+					Dtu_config.mqtt_user[0] = '\0';
+				if( i < 2)
+					Dtu_config.mqtt_pass[0] = '\0';
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//벻
+			if( parg[0] == '?' && i == 0)
+			{
+				strcpy( data, Dtu_config.mqtt_user);
+				ack_str( data);
+				goto exit;
+			}
+			if( i > 1 || strlen( parg) >= sizeof( Dtu_config.mqtt_user))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			strcpy( i == 0 ? Dtu_config.mqtt_user : Dtu_config.mqtt_pass, parg);
+			i++;
+		}
+		//MQTTT=,  0485ݵķ⣬1ADCݵķ⣬2⣬Ϊ
+		//%idtu_id%aRTUַ%cADCͨţЧ
+		else if( strcmp(pcmd ,"MQTTT") == 0)
+		{
+			if( parg == NULL)
+			{
+				if( i == 1)
+					Dtu_config.mqtt_topic[ j][0] = '\0';
+				strcpy( data, i == 0 ? "ERROR" : "OK");
+				ack_str( data);
+				goto exit;
+			}
+			if( parg[0] == '?' && i == 0)
+			{
+				sprintf( data, "%s,%s,%s", Dtu_config.mqtt_topic[ MQTT_TOPIC_RTU], \
+						Dtu_config.mqtt_topic[ MQTT_TOPIC_ADC], Dtu_config.mqtt_topic[ MQTT_TOPIC_SUB]);
+				ack_str( data);
+				goto exit;
+			}
+			if( i == 0)
+			{
+				j = atoi( parg);
+				if( j < 0 || j >= MQTT_TOPIC_NUM)
+				{
+					strcpy( data, "ERROR");
+					ack_str( data);
+					goto exit;
+				}
+				i++;
+				continue;
+			}
+			if( i > 1 || strlen( parg) >= MQTT_TOPIC_LEN)
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			strcpy( Dtu_config.mqtt_topic[ j], parg);
+			i++;
+		}
+		//UPLINK=ݵСȣ0ʾ
+		else if( strcmp(pcmd ,"UPLINK") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أݵС, ͨ иԵ ʹ/֡/p50/p99/ĵȴʱms
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d", Dtu_config.bulk_len);
+				for( j = 0; j < UPLINK_CLASS_NUM; j ++)
+				{
+					p_lat = Gprs_get_uplink_lat( j);
+					sprintf( data + strlen( data), ",%d/%d/%d/%d/%d", ( int)p_lat->sends, ( int)p_lat->drop, \
+							( int)Uplink_lat_pct( p_lat, 50), ( int)Uplink_lat_pct( p_lat, 99), ( int)p_lat->max_ms);
+				}
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			//ûбݶеʱֻó0
+			if( i != 0 || i_data < 0 || i_data > 0xffff || ( UPLINK_BULK_ENABLE == 0 && i_data))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.bulk_len = i_data;
+			i++;
+		}
+		//FRAME=Ƿʹö֡,Ƿѹ
+		else if( strcmp(pcmd ,"FRAME") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, i == 0 ? "ERROR" : "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أǷʹö֡,Ƿѹ,ǰֽ,ֽ
+			if( parg[0] == '?' && i == 0)
+			{
+				Gprs_get_upf( &u32_raw, &u32_out);
+				sprintf( data, "%d,%d,%u,%u", Dtu_config.upf_on, Dtu_config.upf_lz, ( unsigned int)u32_raw, ( unsigned int)u32_out);
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			//ûбѹʱѹ
+			if( i > 1 || ( i_data != 0 && i_data != 1) || ( i == 1 && i_data && UPF_LZ_ENABLE == 0))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			if( i == 0)
+				Dtu_config.upf_on = i_data;
+			else
+				Dtu_config.upf_lz = i_data;
+			i++;
+		}
+		//ROUTE=·ɷʽ,  ʽ0ģ1л2ֵ
+		else if( strcmp(pcmd ,"ROUTE") == 0)
+		{
+			if( parg == NULL)
+			{
+				if( i == 0)
+				{
+					strcpy( data, "ERROR");
+				}
+				else
+				{
+					Route_init( Dtu_config.route_mode, Dtu_config.route_primary);
+					strcpy( data, "OK");
+				}
+				ack_str( data);
+				goto exit;
+			}
+			//أʽ,,ʹõ,л,ÿĵ Ƿ/RTT ms/ʧܴ/ʱûȷϵĴ
+			if( parg[0] == '?' && i == 0)
+			{
+				sprintf( data, "%d,%d,%d,%d", Dtu_config.route_mode, Dtu_config.route_primary, Route_active(), \
+						( int)Route_failovers());
+				for( j = 0; j < IPMUX_NUM; j ++)
+				{
+					p_center = Route_get( j);
+					sprintf( data + strlen( data), ",%d/%d/%d/%d", p_center->healthy, p_center->srtt_ms, \
+							( int)p_center->fails, ( int)p_center->stalls);
+				}
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i > 1 || i_data < 0 || ( i == 0 && i_data > ROUTE_BALANCE) || ( i == 1 && i_data >= IPMUX_NUM))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			if( i == 0)
+				Dtu_config.route_mode = i_data;
+			else
+				Dtu_config.route_primary = i_data;
+			i++;
+		}
+		//TIME=Դ,ϲȴʱs,SNTP  Դ0У׼1·ʱ䣬2ģSNTP
+		else if( strcmp(pcmd ,"TIME") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, i == 0 ? "ERROR" : "OK");
+				ack_str( data);
+				goto exit;
+			}
+			//أԴ,ϲȴʱ,,ǷУ׼,UTC,ƫppm,һεms,У׼,,һУ׼ڶ֮ǰ
+			if( parg[0] == '?' && i == 0)
+			{
+				p_clk = Wclock_stat();
+				sprintf( data, "%d,%d,%s,%d,%u,%d,%d,%u,%u,%u", Dtu_config.time_src, Dtu_config.batch_s, \
+						Dtu_config.ntp_server, p_clk->synced, ( unsigned int)( Wclock_now_ms() / 1000), p_clk->ppm, \
+						( int)p_clk->last_err_ms, ( unsigned int)p_clk->syncs, ( unsigned int)p_clk->steps, \
+						( unsigned int)( get_time_s() - p_clk->last_sync_s));
+				ack_str( data);
+				goto exit;
+			}
+			if( i == 2)
+			{
+				if( strlen( parg) >= NTP_SERVER_LEN)
+				{
+					strcpy( data, "ERROR");
+					ack_str( data);
+					goto exit;
+				}
+				strcpy( Dtu_config.ntp_server, parg);
+				i++;
+				continue;
+			}
+			i_data = atoi( parg);
+			if( i > 2 || i_data < 0 || ( i == 0 && i_data > WCLK_SRC_NTP) || ( i == 1 && i_data > TIME_BATCH_S_MAX))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			if( i == 0)
+				Dtu_config.time_src = i_data;
+			else
+				Dtu_config.batch_s = i_data;
+			i++;
+		}
+		//DNS=Чʱs,ʧ֮ٽʱs  Чʱ0ʾ
+		else if( strcmp(pcmd ,"DNS") == 0)
+		{
+			if( parg == NULL)
+			{
+				if( i == 0)
+				{
+					strcpy( data, "ERROR");
+				}
+				else
+				{
+					Dns_init( Dtu_config.dns_ttl_s, Dtu_config.dns_neg_s);
+					strcpy( data, "OK");
+				}
+				ack_str( data);
+				goto exit;
+			}
+			//أЧʱ,ٽʱ,ÿ¼ /IP//ֱӴ/ɹ/ʧܴ
+			if( parg[0] == '?' && i == 0)
+			{
+				sprintf( data, "%d,%d", Dtu_config.dns_ttl_s, Dtu_config.dns_neg_s);
+				for( j = 0; j < DNS_CACHE_NUM; j ++)
+				{
+					p_dns = Dns_get( j);
+					if( p_dns->host == NULL)
+						continue;
+					sprintf( data + strlen( data), ",%s/%s/%u/%d/%d/%d", p_dns->host, p_dns->ip, \
+							( unsigned int)( get_time_s() - p_dns->ok_s), p_dns->hits, p_dns->resolves, p_dns->fails);
+				}
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i > 1 || i_data < 0 || i_data > 0xffff)
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			if( i == 0)
+				Dtu_config.dns_ttl_s = i_data;
+			else
+				Dtu_config.dns_neg_s = i_data;
+			i++;
+		}
+		//CSQ ?  أźǿ,,GSMע״̬,GPRSע״̬,ѹmv,ʱsģ
+		else if( strcmp(pcmd ,"CSQ") == 0)
+		{
+			if( parg == NULL || parg[0] != '?')
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			sprintf( data, "%d,%d,%d,%d,%d,%d", dsys.gprs.signal_strength, dsys.gprs.ber, dsys.gprs.status_gsm, \
+					dsys.gprs.status_gprs, dsys.gprs.voltage_mv, GprsRadioAge());
+			ack_str( data);
+			goto exit;
+		}
+		//TRSP ?  أ״̬,һлʱms,лʱms,˳,ָ,ǷʹDTR
+		else if( strcmp(pcmd ,"TRSP") == 0)
+		{
+			if( parg == NULL || parg[0] != '?')
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			p_trsp = GprsGetTrspMode();
+			sprintf( data, "%d,%d,%d,%d,%d,%d", p_trsp->state, p_trsp->last_ms, p_trsp->max_ms, \
+					p_trsp->esc_count, p_trsp->res_count, GprsTrspDtr());
+			ack_str( data);
+			goto exit;
+		}
+		//BOOT ?  أģظAT,SIM,ע,ȡIP,һ·ʱms,ģǷû¿
+		else if( strcmp(pcmd ,"BOOT") == 0)
+		{
+			if( parg == NULL || parg[0] != '?')
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			p_boot = GprsGetBoot();
+			sprintf( data, "%d,%d,%d,%d,%d,%d", p_boot->at_ms, p_boot->cpin_ms, p_boot->reg_ms, \
+					p_boot->ip_ms, p_boot->data_ms, p_boot->warm);
+			ack_str( data);
+			goto exit;
+		}
+		//SMSPDU=1 PDUʽշ485ݰ8λ뷢ͣһóŷֶΣ0ʾıʽ
+		else if( strcmp(pcmd ,"SMSPDU") == 0)
+		{
+			if( parg == NULL)
+			{
+				strcpy( data, "OK");
+				ack_str( data);
+				goto exit;
+			}
+			if( parg[0] == '?')
+			{
+				sprintf( data, "%d", Dtu_config.sms_pdu);
+				ack_str( data);
+				goto exit;
+			}
+			i_data = atoi( parg);
+			if( i != 0 || ( i_data != 0 && i_data != 1))
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			Dtu_config.sms_pdu = i_data;
+			i++;
+		}
+		//SMSQ ?  أֽ,֡,ÿԱ ɹ//һν
+		else if( strcmp(pcmd ,"SMSQ") == 0)
+		{
+			if( parg == NULL || parg[0] != '?')
+			{
+				strcpy( data, "ERROR");
+				ack_str( data);
+				goto exit;
+			}
+			sprintf( data, "%d,%d", SmsQ_depth(), SmsQ_drop_count());
+			for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+			{
+				SmsQ_status( i, &u16_sent, &u16_fail, &i_data);
+				sprintf( data + strlen( data), ",%d/%d/%d", u16_sent, u16_fail, i_data);
+			}
+			ack_str( data);
+			goto exit;
+		}
 		else if( strcmp(pcmd ,"FACT") == 0)
 		{
 			set_default(&Dtu_config);
@@ -863,6 +1591,8 @@ static void dtu_conf(char *data)
 			ack_str( data);
 			
 			LED_run->destory(LED_run);
+			fs_lock();
+			Spool_sync();
 			fs_flush();
 			if( g_shutdow)
 				g_shutdow();
@@ -881,8 +1611,10 @@ static void dtu_conf(char *data)
 	}
 
 	exit:	
+	fs_lock();
 	fs_lseek( DtuCfg_file, WR_SEEK_SET, 0);
 	fs_write( DtuCfg_file, (uint8_t *)&Dtu_config, sizeof( DtuCfg_t));
 	fs_flush();
+	fs_unlock();
 }
 
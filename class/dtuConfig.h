@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "gprs.h"
+#include "mqttClient.h"
 #include "serial485_uart.h"
 #include "sw_filesys.h"
 #include "system.h"
@@ -19,12 +20,24 @@
 #define NEED_GPRS( mode)				( ( mode) != MODE_LOCALRTU)
 
 #define DTU_CONFGILE_MAIN_VER		2
-#define DTU_CONFGILE_SUB_VER		1
+//µֶֻܼڽṹӰ汾1dtuConfig.cCfg_sub_lenϾɰ汾ĳ
+#define DTU_CONFGILE_SUB_VER		2
 
 #define DEF_PROTOTOCOL "TCP"
 #define DEF_IPADDR "chitic.zicp.net"
 #define DEF_PORTNUM 18897
+#define DEF_RCNT_BASE_S		5			//˱ܵĬϳʼȴʱ
+#define DEF_RCNT_MAX_S		300			//˱ܵĬȴʱ
+#define DEF_IPR_BAUD		460800		//ģЭ̵Ĭ߲
+#define DEF_NTP_SERVER		"pool.ntp.org"
+#define NTP_SERVER_LEN		32
+#define TIME_BATCH_S_MAX	60			//ֻ256ֽڣٳҲϲ˶
+#define DEF_MQTT_BATCH_MS	200			//ͬһַ485ݺϲĬϵȴʱ
+#define DEF_MQTT_TOPIC		"dtu/%i/rtu/%a"
+#define DEF_MQTT_ADC_TOPIC	"dtu/%i/adc/%c"
+#define DEF_MQTT_SUB_TOPIC	"dtu/%i/down"
 #define	DTUCONF_filename	"sys.cfg"
+#define	DTUCONF_SIZE		( 4 * PAGE_SIZE)	//sys.cfgռ4ҳṹ
 
 #define SIGTYPE_0_5_V			10
 #define SIGTYPE_1_5_V			11
@@ -79,6 +92,42 @@ typedef struct {
 	ser_485Cfg	the_485cfg;
 	
 	signRange_t		sign_range[3];
+	
+	//Ӱ汾2ӵֶ
+	uint16_t	spool_size_kb;			//·Ͽʱݴݵ0ʾݴ
+	uint16_t	spool_rate_Bps;			//ݴݵķٶƣ0ʾ
+	uint8_t		spool_drop;				//֮Ķ
+	
+	uint16_t	rcnt_base_s;			//·Ͽһǰȴʱ
+	uint16_t	rcnt_max_s;				//ȴʱ
+	uint8_t		tka_links;				//ʹģTCP·
+	
+	uint32_t	ipr_baud;				//ģЭ̵߲ʣ0ʾʹģӦ
+	uint32_t	ipr_cur;				//ģ鵱ǰ̶Ĳʣ0ʾӦ
+	uint8_t		ipr_nego;				//ҪЭ̲
+	uint8_t		rxget_on;				//AT+CIPRXGETģȡݣ͸ģʽ²
+	uint16_t	ack_win;				//ʹڣģδȷϵֽ0ʾ
+	uint8_t		rudp_centers;			//UDPšȷϺطļ
+	
+	uint8_t		mqtt_on;				//ʹMQTTЭ飬Ч
+	uint8_t		mqtt_qos;				//485ݷQoS01
+	uint16_t	mqtt_batch_ms;			//ͬһַ485ݺϲĵȴʱ
+	uint16_t	mqtt_adc_s;				//ADCݵڣ0ʾ
+	char		mqtt_user[16];			//Ϊյʱ򲻴û
+	char		mqtt_pass[16];
+	char		mqtt_topic[MQTT_TOPIC_NUM][MQTT_TOPIC_LEN];
+	
+	uint16_t	bulk_len;				//485ݳȰں淢ͣ0ʾ
+	uint8_t		upf_on;					//ʹö֡ʹMQTTʱ
+	uint8_t		upf_lz;					//֡ݳѹ
+	uint8_t		route_mode;				//ĵ·ɷʽROUTE_ALLʾ
+	uint8_t		route_primary;			//лʱ
+	uint8_t		time_src;				//У׼ʱԴWCLK_SRC_OFFʾУ׼
+	uint8_t		batch_s;				//У׼ʱ䲢ö֡ʱͨȴϲʱ䣬0ʾ500ms
+	char		ntp_server[NTP_SERVER_LEN];		//ģSNTPʹõķ
+	uint16_t	dns_ttl_s;				//Чʱ䣬0ʾ棬ģӵʱ
+	uint16_t	dns_neg_s;				//ʧ֮òٽ
+	uint8_t		sms_pdu;				//PDUʽշԷͶݺͳ
 }DtuCfg_t;
 
 typedef void (* other_ack)( char *data, void *arg);
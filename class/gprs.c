@@ -25,11 +25,26 @@
 #include "dtuConfig.h"
 #include "bufManager.h"
 #include "CircularBuffer.h"
+#include "ByteFifo.h"
+#include "spool.h"
+#include "mqttClient.h"
+#include "upframe.h"
+#include "route.h"
+#include "wclock.h"
+#include "dnscache.h"
+#include "smsPdu.h"
+#include "modem.h"
+
+#if ROUTE_CENTER_NUM != IPMUX_NUM
+#error "ROUTE_CENTER_NUM must equal IPMUX_NUM"
+#endif
+#include "modbusRTU_cli.h"
 
 #include "times.h"
 #include "system.h"
 
 static int set_sms2TextMode(gprs_t *self);
+static int set_sms2PduMode(gprs_t *self);
 static int serial_cmmn( char *buf, int bufsize, int delay_ms);
 static int SerilTxandRx( char *buf, int bufsize, int count);
 void read_event(void *buf, void *arg ,int len);
@@ -38,6 +53,21 @@ static int get_sms_phNO(char *databuf, char *phbuf);
 static int get_seq( char **data);
 static int check_apn(char *apn);
 static void Get_ip_status(void);
+static int parse_cnnt_urc( char *buf);
+static void parse_urc(void *buf, void *arg, int len);
+static int check_cnnt_result( int cnnt_num, int *result);
+static void chn_lock(void);
+static void chn_unlock(void);
+static void set_keepalive( void);
+static void rxget_init( void);
+static void rxget_run( void);
+static int txwin_room( int link, int len);
+static int rudp_on( int link);
+static int radio_query( void);
+static void clock_init( void);
+static int upf_send( int cnnt_num, int type, uint32_t ts, char *data, int len);
+static int cmd_lock(void);
+static void data_lock(void);
 //void free_event( gprs_t *self, void *event);
 
 //static gprs_event_t *malloc_event();
@@ -65,6 +95,9 @@ static void Get_ip_status(void);
 #define CNNT_DISCONNECT		0
 #define	CNNT_ESTABLISHED	1
 #define CNNT_SENDERROR		2
+#define CNNT_CONNECTING		3		//ѾCIPSTARTȴCONNECT OK/FAIL
+
+#define CNNT_TIMEOUT_S		75		//ģӳʱҲ75s
 
 
 static struct {
@@ -78,20 +111,173 @@ static struct {
 //	int8_t	cnn_num[IPMUX_NUM];
 	
 	int8_t	cnn_state[IPMUX_NUM];
+	uint8_t	send_fail[IPMUX_NUM];		//ʧܵĴ
+	uint8_t	udp[IPMUX_NUM];				//UDP·ʹģıͷʹ
+	uint8_t	hold[IPMUX_NUM];			//ս·ȷעMQTTCONNECT֮ŷͶ
+	uint32_t	cnn_start_s[IPMUX_NUM];		//ӵʱ
 }Ip_cnnState;
 
 
 //RecvdataBuf	TcpRecvData;
 
 static char Gprs_cmd_buf[CMDBUF_LEN];
-static char TCP_data[TCPDATA_LEN];
+static char Gprs_data_cmd[CMDBUF_LEN];		//ͨרõģֻͨʹ
+static char TCP_data[TCPDATA_LEN];		//·Ľնдﻮ
+
+//+RECEIVE,n,len:\r\n ݿֵܱ֡
+//Ҫסǰĸ·ݣʣûյ
+//ȡģʽAT+CIPRXGET=2Ļظ+CIPRXGET: 2,n,len,left\r\n Ҳݣһ
+#define RXHEAD_LEN		32
+#define RXHEAD_TAG_MAX	13
+static const char *Rxhead_tags[] = { "+RECEIVE,", "+CIPRXGET: 2,"};
+#define RXHEAD_TAG_NUM	( sizeof( Rxhead_tags) / sizeof( Rxhead_tags[0]))
+static sByteFifo	TcpRxFifo[IPMUX_NUM];
+static struct {
+	int8_t		link;			//ǰ·-1ʾ·Ŵݶ
+	int8_t		in_head;		//ͷû
+	uint8_t		head_len;
+	uint8_t		pull;			//ǰȡ
+	uint16_t	remain;			//ûյݳ
+	char		head[RXHEAD_LEN];
+	uint32_t	drop[IPMUX_NUM];	//նֽ
+}RxDemux;
+
+//ȡģʽģյֻ+CIPRXGET: 1֪ͨģ
+//նпռʱٶɶеĿռԲᶪ
+//̫ʱģĻˣTCPĴ÷
+#define RXGET_MAX		1460		//һȡֽ
+#define RXGET_MIN		64			//նеĿռҲģʱȲ
+#define RXGET_WAIT_MS	500			//ȴȡ
+static struct {
+	uint8_t		on;
+	uint8_t		notify;				//յ֪ͨûжȡ·
+	volatile uint8_t	reading;	//ȡݻû
+	uint16_t	pending[IPMUX_NUM];	//ģﻹûȡֽ
+}Rxget;
+
+//ռ䣺AT+CMGLһгжţڴڻصַ
+//ÿ¼ǣš볤ȡ롢ݳȡ
+#define SMS_INBOX_LEN		256
+#define SMS_TEXT_MAX		160
+#define SMS_LIST_TIMEOUT_MS	5000
+#define SMS_LIST_IDLE		0
+#define SMS_LISTING			1
+#define SMS_LIST_OK			2
+#define SMS_LIST_ERR		3
+#define SMS_LINE_LEN		64		//бмŵ֪ͨҪн֪ͨĽ
+static struct {
+	volatile uint8_t	listing;
+	uint8_t		state;			//״̬
+	uint8_t		line_len;
+	uint8_t		field;			//+CMGL: еĵڼֶ
+	uint8_t		quote;
+	uint8_t		skip;			//ǰŲ
+	uint8_t		more;			//жŷŲ£п֮Ҫһ
+	uint8_t		keep;			//жű˵ûдɾ
+	uint8_t		pdu;			//гPDUʽģʮ
+	uint8_t		nib;			//PDUʮѾյ˰ֽ
+	uint8_t		hi;
+	uint8_t		idx;
+	uint8_t		cnt;			//ǰֶεĳ
+	uint8_t		nl;				//ıݺ滹ûȷǲݵĻ
+	uint16_t	rd;
+	volatile uint16_t	commit;		//ļ¼Ľβ
+	uint16_t	wr;
+	uint16_t	len_pos;		//ǰֶγȵλãֶνʱ
+	uint32_t	done[ MAX_NUM_SMS / 32];		//ȴɾĶ
+	uint32_t	held[ MAX_NUM_SMS / 32];		//ζȡѾȡSIMĶţг
+	char		line[ SMS_LINE_LEN];
+	char		buf[ SMS_INBOX_LEN];
+}SmsInbox;
+
+//PDUʽĶţշĻ涼ܴ󣬷ռ̵߳ջ
+//ŵĸһζȡƴӵߵĻһֻƴһŵĶSIM´ƴ
+#define SMS_PDU_HEX_CHUNK	SMS_PDU_HEAD_MAX	//һתʮƷ͵ֽ
+#define SMS_ASM_PARTS		8					//ƴӵÿε
+#define SMS_ASM_TIMEOUT_S	300					//ŵĶôûû룬ÿε
+static uint8_t	Sms_pdu[ SMS_PDU_LEN_MAX + 1];
+static char		Sms_pdu_hex[ 2 * SMS_PDU_HEX_CHUNK + 1];
+static sms_pdu_t	Sms_msg;
+static struct {
+	uint8_t		on;				//ƴ
+	uint8_t		total;
+	uint8_t		got;			//յĶΣλ
+	uint8_t		cap;
+	uint16_t	ref;
+	uint8_t		idx[ SMS_ASM_PARTS];
+	uint8_t		len[ SMS_ASM_PARTS];
+	char		phone[ SMS_PDU_PHONE_LEN];
+	uint8_t		wait_on;		//гû
+	uint16_t	wait_ref;
+	uint32_t	wait_s;			//ʼȴʱ
+}SmsAsm;
+
+#define TCPSENDBUF_LEN     256		//2
+#define TCPSEND_THRESHOLD	( TCPSENDBUF_LEN / 2)		//ݳȾϷ
+#define TCPSEND_WAIT_MS		500		//ͨȴϲʱ
+static sByteFifo	TcpTxFifo[IPMUX_NUM];
+static char	TcpTxFrame[TCPSENDBUF_LEN];
+
+//ʹݵĶУͨݻǷTcpTxFifo
+//еĻڴģʱֻ˵ķ䣬TcpTxQueue_init
+#define URGENTBUF_LEN		64		//2ݣŲµĽݰͨݷ
+#if UPLINK_BULK_ENABLE
+#define TCPTXQ_LEN			( URGENTBUF_LEN + 2 * TCPSENDBUF_LEN)		//һ·
+#else
+#define TCPTXQ_LEN			( URGENTBUF_LEN + TCPSENDBUF_LEN)			//ûдݵĶ
+#endif
+static sByteFifo	TcpUrgFifo[IPMUX_NUM];
+static sByteFifo	TcpBulkFifo[IPMUX_NUM];
+
+static struct {
+	uint32_t		since_ms[UPLINK_CLASS_NUM][IPMUX_NUM];		//ݷʱ
+	uplink_lat_t	lat[UPLINK_CLASS_NUM];
+	uint8_t			last_to;		//һ֡Щ·ĶУspoolʱ0
+}Uplink;
+
+//֡Ĺ棺֡ĴMQTTĿƱĶƴֻͨʹ
+//MQTTıĲٴɶ߲֡ͬʱҪ
+#define FRAMEBUF_LEN		( TCPSENDBUF_LEN + UPF_OVERHEAD)
+static char		FrameBuf[ FRAMEBUF_LEN];
+static struct {
+	uint32_t	raw;			//ǰֽ
+	uint32_t	out;			//ֽ
+}UpfStat;
+
+static struct {
+	uint32_t	unacked[IPMUX_NUM];		//ϴβѯδȷֽ֮󷢳
+	uint32_t	query_ms[IPMUX_NUM];
+	uint32_t	stall_start[IPMUX_NUM];	//ʼȴڵʱ䣬0ʾûڵ
+	uint32_t	stall_ms[IPMUX_NUM];	//Ϊȴʱ
+	uint32_t	sent[IPMUX_NUM];		//ӽ󽻸ģֽ
+	uint32_t	acked[IPMUX_NUM];		//ϴβѯĶԶѾȷϵֽ
+}TxWin;
+
+//RTT·ͺѾģֽѯԶȷϵֽﵽʱһ
+//ֻʹл߷ֵʱŲʱûȷϵΪ
+static struct {
+	uint32_t	start_ms[IPMUX_NUM];	//0ʾûڲ
+	uint32_t	target[IPMUX_NUM];
+	uint32_t	poll_ms[IPMUX_NUM];
+}RouteProbe;
+
+//UDP·ϵĿɿ䣬ÿ·ֻһ֡ڵȴȷ
+//շͨڲdtu߳̽طͻظȷrun
+//ȴȷϵ֡Ҫطù棬ֻ˿ɿ·
+#if RUDP_ENABLE
+static rudp_t	Rudp[IPMUX_NUM];
+static char		*Rudp_buf[IPMUX_NUM];
+static uint8_t	Rudp_links;			//ÿɿ·
+#endif
 
 
 
+//šȿƲ
+//ͨϵһATݷֻҪͨ
 osMutexDef (GprsMutex); 
 osMutexId g_GprsMutex_id; 
-
-vectorBufManager_t	g_TcpVbm;
+osMutexDef (GprsChnMutex); 
+osMutexId g_GprsChnMutex_id; 
 
 void GprsTcpCnnectBeagin()
 {
@@ -133,9 +319,98 @@ int Grps_SetCipmux( short mux)
 	
 	
 	dsys.gprs.cip_mux = mux;
+	if( mux)
+		TcpRxQueue_init( ( 1 << IPMUX_NUM) - 1);
+	else
+		TcpRxQueue_init( 1);
 	return ERR_OK;
 }
 
+//ѽջָlink_setе·ûõ·
+//ÿ·ֵĳ2ݣһ֡GPRS_UART_BUF_LEN·ԽԽ׶
+//Ҫûݽյʱ
+void TcpRxQueue_init( uint8_t link_set)
+{
+	int i;
+	int left = 0;
+	int remain = TCPDATA_LEN;
+	int qlen = 0;
+	char *p = TCP_data;
+	
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( CHK_U8_BIT( link_set, i))
+			left ++;
+	}
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( CHK_U8_BIT( link_set, i) == 0)
+		{
+			BFInit( &TcpRxFifo[i], NULL, 0);
+			continue;
+		}
+		for( qlen = TCPDATA_LEN; qlen > remain / left; qlen >>= 1)
+			;
+		BFInit( &TcpRxFifo[i], p, qlen);
+		p += qlen;
+		remain -= qlen;
+		left --;
+	}
+	RxDemux.link = -1;
+	RxDemux.in_head = 0;
+	RxDemux.head_len = 0;
+	RxDemux.remain = 0;
+	RxDemux.pull = 0;
+}
+
+//ѷͶзָlink_setе·ڴģʱõĵ
+//ѾĲͷҲգ߳ʱд
+//ʧܵ·г0ݵʱ򷵻ERR_MEM_UNAVAILABLE
+void TcpTxQueue_init( uint8_t link_set)
+{
+	char	*p;
+	int		i;
+	
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( CHK_U8_BIT( link_set, i) == 0 || TcpTxFifo[i].buf)
+			continue;
+		p = malloc( TCPTXQ_LEN);
+		if( p == NULL)
+		{
+			DPRINTF("link %d malloc tx queue failed !\n", i);
+			continue;
+		}
+		BFInit( &TcpUrgFifo[i], p, URGENTBUF_LEN);
+		BFInit( &TcpTxFifo[i], p + TCPTXQ_LEN - TCPSENDBUF_LEN, TCPSENDBUF_LEN);
+#if UPLINK_BULK_ENABLE
+		BFInit( &TcpBulkFifo[i], p + URGENTBUF_LEN, TCPSENDBUF_LEN);
+#endif
+	}
+}
+
+uint32_t Gprs_get_rxdrop( int cnnt_num)
+{
+	if( cnnt_num >= IPMUX_NUM)
+		return 0;
+	return RxDemux.drop[ cnnt_num];
+}
+
+//ȡģʽģﻹûȡֻֽյ֪֪ͨʱ-1
+int Gprs_get_rxpending( int cnnt_num)
+{
+	if( cnnt_num >= IPMUX_NUM)
+		return 0;
+	if( Rxget.pending[ cnnt_num] == 0 && CHK_U8_BIT( Rxget.notify, cnnt_num))
+		return -1;
+	return Rxget.pending[ cnnt_num];
+}
+
+int Gprs_rxget_on( void)
+{
+	return Rxget.on;
+}
+
 int Gprs_init(gprs_t *self)
 {
 	dsys.gprs.cur_state = GPRSERROR;
@@ -162,7 +437,14 @@ int Gprs_init(gprs_t *self)
 		DPRINTF("gprs create mutex failed !\n");
 		return ERR_MEM_UNAVAILABLE;
 	}
-	VecBuf_Init( &g_TcpVbm, TCP_data, TCPDATA_LEN, DROP_NEWDATA);
+	g_GprsChnMutex_id =  osMutexCreate ( osMutex(GprsChnMutex));
+	if ( g_GprsChnMutex_id == NULL) {
+		DPRINTF("gprs create channel mutex failed !\n");
+		return ERR_MEM_UNAVAILABLE;
+	}
+	Route_init( Dtu_config.route_mode, Dtu_config.route_primary);
+	Dns_init( Dtu_config.dns_ttl_s, Dtu_config.dns_neg_s);
+	TcpRxQueue_init( 1);
 //	TcpRecvData.buf = TCP_data;
 //	TcpRecvData.buf_len = TCPDATA_LEN;
 //	TcpRecvData.read = 0;
@@ -191,34 +473,485 @@ int unlock(  gprs_t *self)
 	return ERR_OK;
 }
 
+static void chn_lock(void)
+{
+	osMutexWait( g_GprsChnMutex_id, osWaitForever );
+}
+static void chn_unlock(void)
+{
+	osMutexRelease( g_GprsChnMutex_id);
+}
+
+//͸ģʽ£ӱֵʱģʽģʽ֮л
+//ָǰ˳ģʽǰ߿һʱATOصģʽ
+static trspMode_t	Trsp;
+static uint32_t		Trsp_tx_ms;			//һд͸ݵʱ
+static uint8_t		Trsp_dtr = 0;		//ģAT&D1DTR˳ģʽ
+
+//˳ģʽDTRʱDTR"+++"
+static int trsp_escape( void)
+{
+	uint32_t	t;
+	
+#if GPRS_DTR_ENABLE
+	if( Trsp_dtr)
+	{
+		GPIO_SetBits( Gprs_dtr.Port, Gprs_dtr.pin);
+		osDelay( 2);
+		GPIO_ResetBits( Gprs_dtr.Port, Gprs_dtr.pin);
+	}
+	else
+#endif
+	{
+		//ֻдݲҪȴʱ
+		t = get_time_ms() - Trsp_tx_ms;
+		if( t < TRSP_GUARD_MS)
+			osDelay( TRSP_GUARD_MS - t);
+		strcpy( Gprs_data_cmd, "+++");
+		UART_SEND( Gprs_data_cmd, 3);
+	}
+	t = get_time_ms();
+	while( get_time_ms() - t < TRSP_REPLY_MS)
+	{
+		if( UART_RECV( Gprs_data_cmd, CMDBUF_LEN) <= 0)
+			continue;
+		if( strstr( Gprs_data_cmd, "OK"))
+			return ERR_OK;
+	}
+	return ERR_DEV_TIMEOUT;
+}
+
+//صģʽѾϿʱģظNO CARRIER
+static int trsp_resume( void)
+{
+	uint32_t	t;
+	
+	strcpy( Gprs_data_cmd, "ATO\x00D\x00A");
+	UART_SEND( Gprs_data_cmd, strlen( Gprs_data_cmd));
+	t = get_time_ms();
+	while( get_time_ms() - t < TRSP_REPLY_MS)
+	{
+		if( UART_RECV( Gprs_data_cmd, CMDBUF_LEN) <= 0)
+			continue;
+		if( strstr( Gprs_data_cmd, "CONNECT"))
+			return ERR_OK;
+		if( strstr( Gprs_data_cmd, "NO CARRIER") || strstr( Gprs_data_cmd, "ERROR"))
+			return ERR_FAIL;
+	}
+	return ERR_DEV_TIMEOUT;
+}
+
+//ͨڵ
+static int trsp_switch( int act)
+{
+	uint32_t	t;
+	int			ret;
+	
+	if( act == TRSP_ACT_NONE)
+		return ERR_OK;
+	t = get_time_ms();
+	if( act == TRSP_ACT_ESCAPE)
+		ret = trsp_escape();
+	else
+		ret = trsp_resume();
+	if( TrspMode_done( &Trsp, ret == ERR_OK, get_time_ms() - t) == TRSP_ST_IDLE)
+	{
+		DPRINTF("[TRSP] link lost when switch mode \n");
+		Ip_cnnState.cnn_state[ 0] = CNNT_DISCONNECT;
+		dsys.gprs.set_tcp_close = SET_U8_BIT(dsys.gprs.set_tcp_close, 0);
+		Modem_post( MODEM_EV_CLOSE, 0);
+	}
+	return ret;
+}
+
+static void trsp_sync( void)
+{
+	TrspMode_link( &Trsp, dsys.gprs.cip_mode == CIPMODE_TRSP && \
+		Ip_cnnState.cnn_state[ 0] == CNNT_ESTABLISHED);
+}
+
+//ȡ֤ͨģ鴦ģʽ˲ģʽʱ򷵻شʱָܷ
+static int cmd_lock(void)
+{
+	chn_lock();
+	trsp_sync();
+	if( trsp_switch( TrspMode_want_cmd( &Trsp, get_time_ms())) == ERR_OK)
+		return ERR_OK;
+	//ѾϿˣģصģʽ
+	if( Trsp.state == TRSP_ST_IDLE)
+		return ERR_OK;
+	chn_unlock();
+	return ERR_DEV_BUSY;
+}
+
+//ȡ֤ͨģ鴦ģʽ
+static void data_lock(void)
+{
+	chn_lock();
+	trsp_sync();
+	trsp_switch( TrspMode_want_data( &Trsp));
+}
+
+//ģʽ¿һʱصģʽ·ݲյ
+static void trsp_idle_resume( void)
+{
+	if( TrspMode_idle( &Trsp, get_time_ms()) == 0)
+		return;
+	data_lock();
+	chn_unlock();
+}
+
+//AT&D1: DTRЧЧʱ˳ģʽӱ
+static void trsp_init( void)
+{
+	TrspMode_init( &Trsp);
+	Trsp_dtr = 0;
+#if GPRS_DTR_ENABLE
+	if( dsys.gprs.cip_mode == CIPMODE_TRSP)
+	{
+		strcpy( Gprs_cmd_buf, "AT&D1\x00D\x00A");
+		SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+		if( strstr( Gprs_cmd_buf, "OK"))
+			Trsp_dtr = 1;
+	}
+#endif
+}
+
+//źǿȺ͵ѹĻʱ䣬ע״̬֪ͨ£Ҫˢ
+static uint32_t	Radio_info_s;
+static uint32_t	Radio_try_s;		//һκ̨ˢµʱ䣬ܳɹû
+static uint8_t	Radio_info_ok = 0;
+
+//ģʱӣAT+CLTS=1֮·ʱģʱӣAT+CCLK?У׼ʱ
+//SNTPʱAT+CNTPģӷȡʱ䣬SNTPAT+SAPBRĳأAT+CIICRĳǷֿ
+#define CNTP_WAIT_MS		10000		//ȴ+CNTPʱ
+#define CNTP_OK				1			//+CNTP: 1 ɹǴ
+static struct {
+	uint8_t		cntp_bad;		//ģ鲻֧AT+CNTP
+	volatile int8_t	cntp;		//+CNTPĽ0ʾûյ
+}Mclk;
+
+//+CREG: <stat> ֪ͨ+CREG: <n>,<stat>[,<lac>,<ci>] ǲѯĻظ
+//ڶֵʱȡڶȡһ
+static void parse_reg_stat( char *pp, uint8_t *stat)
+{
+	char 	*p = strchr( pp, ':');
+	int		val[2] = { -1, -1};
+	int		n = 0;
+	
+	if( p == NULL)
+		return;
+	for( p ++; *p != '\0' && *p != '\r' && *p != '\n' && n < 2; p ++)
+	{
+		if( *p == ',')
+			n ++;
+		else if( *p >= '0' && *p <= '9')
+			val[n] = ( val[n] < 0 ? 0 : val[n] * 10) + *p - '0';
+		else if( *p != ' ')
+		{
+			val[n] = -1;
+			break;
+		}
+	}
+	if( val[1] >= 0)
+		*stat = val[1];
+	else if( val[0] >= 0)
+		*stat = val[0];
+}
+
+static int reg_done( uint8_t stat)
+{
+	return stat == 1 || stat == 5;
+}
+
+//ȴע״̬֪ͨ״̬仯˾Ϸ
+static void reg_wait( uint8_t *stat, int wait_ms)
+{
+	uint8_t old = *stat;
+	
+	while( wait_ms > 0 && *stat == old)
+	{
+		osDelay( 20);
+		wait_ms -= 20;
+	}
+}
+
+//Ĵֵֻ仯ʱд
+static void radio_regs( void)
+{
+	static uint16_t	last[5];
+	static uint8_t	written = 0;
+	uint16_t		val[5];
+	int				i;
+	
+	val[0] = dsys.gprs.signal_strength;
+	val[1] = dsys.gprs.status_gsm;
+	val[2] = dsys.gprs.status_gprs;
+	val[3] = dsys.gprs.voltage_mv;
+	val[4] = GprsRadioAge();
+	for( i = 0; i < 5; i ++)
+	{
+		if( written && val[i] == last[i])
+			continue;
+		regType4_write( RADIO_INPUT_REG + i, REG_LINE, val[i]);
+		last[i] = val[i];
+	}
+	written = 1;
+}
+
+//ںں̨ˢ£ռû͸ģʽʱˢ
+//ѯʧܵʱRADIO_RETRY_SԣظURCϵʱ򲻻ÿڶռסѭ
+static void radio_refresh( gprs_t *self)
+{
+	radio_regs();
+	
+	if( Radio_info_ok && get_time_s() - Radio_info_s < RADIO_TTL_S)
+		return;
+	if( get_time_s() - Radio_try_s < RADIO_RETRY_S)
+		return;
+	if( dsys.gprs.cur_state < GPRS_OPEN_FINISH || Trsp.state == TRSP_ST_DATA)
+		return;
+	if( osMutexWait( g_GprsMutex_id, 0) != osOK)
+		return;
+	Radio_try_s = get_time_s();
+	if( radio_query() != ERR_OK)
+		DPRINTF("radio refresh fail \n");
+	osMutexRelease( g_GprsMutex_id);
+}
+
+//źǿȺ͵ѹ˶ãûлȡʱ򷵻0xffff
+int GprsRadioAge(void)
+{
+	uint32_t age = get_time_s() - Radio_info_s;
+	
+	if( Radio_info_ok == 0 || age > 0xffff)
+		return 0xffff;
+	return age;
+}
+
+trspMode_t *GprsGetTrspMode(void)
+{
+	return &Trsp;
+}
+
+int GprsTrspDtr(void)
+{
+	return Trsp_dtr;
+}
+
+
+
+//ʱļ¼
+static gprs_boot_t	Boot;
+static uint32_t		Boot_t0_ms;
+static uint8_t		Boot_cpin = 0;		//յ+CPIN: READY
+
+gprs_boot_t *GprsGetBoot(void)
+{
+	return &Boot;
+}
+
+//ֻ¼һεʱ
+static void boot_mark( uint16_t *ms)
+{
+	uint32_t	t;
+	
+	if( *ms)
+		return;
+	t = get_time_ms() - Boot_t0_ms;
+	if( t == 0)
+		t = 1;
+	*ms = t > 0xffff ? 0xffff : t;
+}
+
+static void boot_link_up( void)
+{
+	if( Boot.data_ms)
+		return;
+	boot_mark( &Boot.data_ms);
+	regType4_write( BOOT_INPUT_REG, REG_LINE, Boot.data_ms / 100);
+	DPRINTF("[BOOT] at %d, cpin %d, reg %d, ip %d, data %d ms, warm %d \n", Boot.at_ms, Boot.cpin_ms, \
+			Boot.reg_ms, Boot.ip_ms, Boot.data_ms, Boot.warm);
+}
+
+//ÿ100msĻظģ鿪ЩATͬӦ
+//յRDY֪ͨʱǰأϷһAT
+static int at_probe( int times)
+{
+	int ret = ERR_DEV_TIMEOUT;
+	
+	if( cmd_lock() != ERR_OK)
+		return ERR_DEV_BUSY;
+	while( times --)
+	{
+		strcpy( Gprs_cmd_buf, "AT\x00D\x00A");
+		UART_SEND( Gprs_cmd_buf, strlen( Gprs_cmd_buf));
+		memset( Gprs_cmd_buf, 0, CMDBUF_LEN);
+		if( UART_RECV( Gprs_cmd_buf, CMDBUF_LEN) > 0 && strstr( Gprs_cmd_buf, "OK"))
+		{
+			ret = ERR_OK;
+			break;
+		}
+	}
+	chn_unlock();
+	return ret;
+}
+
+//ģЭ̵ĲʣӸߵͳ
+static const uint32_t Ipr_rates[] = { 460800, 230400, GPRS_BAUD_DEF};
+#define IPR_RATE_NUM	( sizeof( Ipr_rates) / sizeof( Ipr_rates[0]))
+
+//ģAT+IPRöӦĴڲ
+static uint32_t ipr_uart_baud( uint32_t ipr)
+{
+	return ipr ? ipr : GPRS_BAUD_DEF;
+}
+
+int GprsIprCheck(int baud)
+{
+	int i;
+	
+	if( baud == 0)
+		return ERR_OK;
+	for( i = 0; i < IPR_RATE_NUM; i ++)
+	{
+		if( Ipr_rates[i] == baud)
+			return ERR_OK;
+	}
+	return ERR_BAD_PARAMETER;
+}
+
+static void ipr_save( void)
+{
+	fs_lock();
+	fs_lseek( DtuCfg_file, WR_SEEK_SET, 0);
+	fs_write( DtuCfg_file, (uint8_t *)&Dtu_config, sizeof( DtuCfg_t));
+	fs_flush();
+	fs_unlock();
+}
+
+//ģ͵ƬһлµĲʣлAT֤
+//֤ʧܵĻ߶ָԭ
+//ERR_DEV_TIMEOUTʾ߶ͨˣҪģ
+static int ipr_switch( uint32_t ipr)
+{
+	uint32_t	old = Dtu_config.ipr_cur;
+	
+	sprintf( Gprs_cmd_buf, "AT+IPR=%d\x00D\x00A", ( int)ipr);
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( strstr( Gprs_cmd_buf, "OK") == NULL)
+		return ERR_FAIL;
+	//ģԭĲʻظOK֮л
+	osDelay( 10);
+	gprs_uart_set_baud( ipr_uart_baud( ipr));
+	if( at_probe( IPR_PROBES) == ERR_OK)
+	{
+		//еĹ̼ԶAT+IPR
+		strcpy( Gprs_cmd_buf, "AT&W\x00D\x00A");
+		SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+		return ERR_OK;
+	}
+	
+	//µĲͨдģ˻ԭãյ
+	DPRINTF("[IPR] %d no reply, back to %d \n", ( int)ipr, ( int)old);
+	sprintf( Gprs_cmd_buf, "AT+IPR=%d\x00D\x00A", ( int)old);
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 3);
+	gprs_uart_set_baud( ipr_uart_baud( old));
+	if( at_probe( IPR_PROBES) == ERR_OK)
+		return ERR_FAIL;
+	return ERR_DEV_TIMEOUT;
+}
+
+//õ޴ӸߵЭ̣ϴЭ̹ûиĹͲЭ
+static int ipr_negotiate( void)
+{
+	int		i;
+	int		ret = ERR_FAIL;
+	
+	if( Dtu_config.ipr_nego == 0)
+		return ERR_OK;
+	for( i = 0; i < IPR_RATE_NUM; i ++)
+	{
+		if( Dtu_config.ipr_baud == 0)
+		{
+			ret = ipr_switch( 0);
+			break;
+		}
+		if( Ipr_rates[i] > Dtu_config.ipr_baud)
+			continue;
+		ret = ipr_switch( Ipr_rates[i]);
+		if( ret != ERR_FAIL)
+			break;
+	}
+	if( ret == ERR_DEV_TIMEOUT)
+		return ret;
+	if( ret == ERR_OK)
+		Dtu_config.ipr_cur = Dtu_config.ipr_baud ? Ipr_rates[i] : 0;
+	Dtu_config.ipr_nego = 0;
+	ipr_save();
+	DPRINTF("[IPR] baud %d \n", ( int)gprs_uart_get_baud());
+	return ERR_OK;
+}
 
+//ﱣĲϵģ飬ģ黻ûбAT+IPRγеĲ
+static int ipr_scan( void)
+{
+	int		i;
+	
+	for( i = 0; i < IPR_RATE_NUM; i ++)
+	{
+		if( Ipr_rates[i] == gprs_uart_get_baud())
+			continue;
+		gprs_uart_set_baud( Ipr_rates[i]);
+		if( at_probe( 3) != ERR_OK)
+			continue;
+		Dtu_config.ipr_cur = Ipr_rates[i];
+		Dtu_config.ipr_nego = 1;
+		ipr_save();
+		return ERR_OK;
+	}
+	gprs_uart_set_baud( ipr_uart_baud( Dtu_config.ipr_cur));
+	return ERR_DEV_TIMEOUT;
+}
 
 void startup(gprs_t *self)
 {
-//	char *pp = NULL;
-//	int		waitms ;
-//	while(1)
+	static uint8_t	first = 1;
+	
 	{
-//		waitms = 5000;
-		GPIO_ResetBits(Gprs_powerkey.Port, Gprs_powerkey.pin);
-		osDelay(100);
-		GPIO_SetBits(Gprs_powerkey.Port, Gprs_powerkey.pin);
-		osDelay(2000);
-		GPIO_ResetBits(Gprs_powerkey.Port, Gprs_powerkey.pin);
-	//	osDelay( 2000);
+		memset( &Boot, 0, sizeof( Boot));
+		regType4_write( BOOT_INPUT_REG, REG_LINE, 0);
+		Boot_cpin = 0;
+		Boot_t0_ms = get_time_ms();
+		gprs_uart_set_baud( ipr_uart_baud( Dtu_config.ipr_cur));
+		//ƬŹλʱģܻţʱٰԴػ
+		//ģͣ͸ģʽʱղOKԭķʽ¿ػ
+		if( first)
+		{
+			first = 0;
+			if( at_probe( 3) == ERR_OK)
+				Boot.warm = 1;
+		}
+		if( Boot.warm == 0)
+		{
+			GPIO_SetBits(Gprs_powerkey.Port, Gprs_powerkey.pin);
+			osDelay( GPRS_PWRKEY_ON_MS);
+			GPIO_ResetBits(Gprs_powerkey.Port, Gprs_powerkey.pin);
+		}
 
 		dsys.gprs.flag_ready = 0;
 		dsys.gprs.status_gsm = 0xff;
 		dsys.gprs.status_gprs = 0xff;
 		dsys.gprs.ip_status = 0xff;
+		Radio_info_ok = 0;
 		dsys.gprs.cur_state = STARTUP;
-//		while(waitms)
-//		{
-//			if( dsys.gprs.cur_state == STARTUP)
-//				return;
-//			osDelay(1);
-//			waitms --;
-//		}
+		if( Boot.warm)
+		{
+			//֪ͨͷˣر֮ǰӺͳģ
+			dsys.gprs.flag_ready = 3;
+			strcpy( Gprs_cmd_buf, "AT+CIPSHUT\x00D\x00A" );
+			SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 30);
+		}
 	}
 	
 	return ;
@@ -249,11 +982,9 @@ void shutdown(gprs_t *self)
 int	Gprs_check_simCard( gprs_t *self)
 {
 	char step = 0;
-	uint8_t	err;
 //	static char successCount = 0;
 	short	retry = RETRY_TIMES;
 	char 	*pp = NULL;
-	int ret;
 	while(1)
 	{
 		if( dsys.gprs.cur_state == SHUTDOWN)
@@ -265,6 +996,14 @@ int	Gprs_check_simCard( gprs_t *self)
 		{
 			
 			case 0:
+				//ģһظATͿʼãٹ̶ȴ
+				if( at_probe( GPRS_BOOT_PROBES) != ERR_OK && ipr_scan() != ERR_OK)
+				{
+					dsys.gprs.cur_state = GPRSERROR;
+					DPRINTF(" AT no reply \t\n");
+					goto errOut;
+				}
+				boot_mark( &Boot.at_ms);
 				strcpy( Gprs_cmd_buf, "ATE0\x00D\x00A" );
 				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,5);
 				pp = strstr((const char*)Gprs_cmd_buf,"OK");
@@ -275,10 +1014,14 @@ int	Gprs_check_simCard( gprs_t *self)
 					step ++;
 					DPRINTF(" ATE0 succeed! \t\n");
 					retry = RETRY_TIMES ;
+					if( ipr_negotiate() != ERR_OK)
+					{
+						dsys.gprs.cur_state = GPRSERROR;
+						goto errOut;
+					}
 					break;
 				}
 				
-				osDelay(1000);
 				retry --;
 				if( retry == 0) {
 					dsys.gprs.cur_state = GPRSERROR;
@@ -289,19 +1032,30 @@ int	Gprs_check_simCard( gprs_t *self)
 				break;
 				
 			case 1:
-				strcpy( Gprs_cmd_buf, "AT+CPIN?\x00D\x00A" );
-				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
-				pp = strstr((const char*)Gprs_cmd_buf,"OK");
-				if(pp)
+				//Ѿյ+CPIN: READY֪ͨͲٲѯ
+				if( Boot_cpin == 0)
 				{
-					
+					strcpy( Gprs_cmd_buf, "AT+CPIN?\x00D\x00A" );
+					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+					if( strstr((const char*)Gprs_cmd_buf,"READY"))
+						Boot_cpin = 1;
+				}
+				if( Boot_cpin)
+				{
+					boot_mark( &Boot.cpin_ms);
 					step ++;
 					retry = RETRY_TIMES * 2;
 					DPRINTF(" AT+CPIN? succeed! \t\n");
-					break;
+					//ע״̬֪֮ͨѯ
+					strcpy( Gprs_cmd_buf, "AT+CREG=1\x00D\x00A" );
+					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+					strcpy( Gprs_cmd_buf, "AT+CGREG=1\x00D\x00A" );
+					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+					break;
 				}
 				retry --;
-				osDelay(1000);
+				//ȴSIM֪ͨû֪ͨĻ1sٲѯ
+				reg_wait( &Boot_cpin, 1000);
 				if( retry == 0) {
 					
 					dsys.gprs.cur_state = GPRSERROR;
@@ -310,39 +1064,30 @@ int	Gprs_check_simCard( gprs_t *self)
 				}
 				break;
 			case 2:		//GSMע״̬
-				strcpy( Gprs_cmd_buf, "AT+CREG?\x00D\x00A" );
-				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
-			
-				pp = strstr((const char*)Gprs_cmd_buf,"+CREG");
-				if(pp)
+				//Ѿյעɹ֪ͨͲٲѯ
+				if( reg_done( dsys.gprs.status_gsm) == 0)
 				{
-					ret = Get_str_data(pp, ",", 1, &err);
-					if(err == 0)
-					{
-						dsys.gprs.status_gsm = ret;	
-							
-						switch(dsys.gprs.status_gsm)
-						{
-							case 0:		//ѰµӪ
-							case 2:		//ע
-							case 4:		//δ֪
-								break;
-							case 1:		//Registered, home network
-							case 5:		//Registered, roaming
-							case 3:		//Registration denied
-								step ++;
-								retry = RETRY_TIMES;
-								break;
-							
-								
-							
-							
-							
-						}
-					}
-					
+					strcpy( Gprs_cmd_buf, "AT+CREG?\x00D\x00A" );
+					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+					pp = strstr((const char*)Gprs_cmd_buf,"+CREG");
+					if(pp)
+						parse_reg_stat( pp, &dsys.gprs.status_gsm);
 				}
-				osDelay(1000);
+				switch(dsys.gprs.status_gsm)
+				{
+					case 1:		//Registered, home network
+					case 5:		//Registered, roaming
+					case 3:		//Registration denied
+						step ++;
+						retry = RETRY_TIMES;
+						break;
+					default:	//0 ѰµӪ 2 ע 4 δ֪
+						break;
+				}
+				if( step != 2)
+					break;
+				//ȴע״̬֪ͨû֪ͨĻ1sٲѯ
+				reg_wait( &dsys.gprs.status_gsm, 1000);
 				retry --;
 				if( retry == 0) {
 					retry = RETRY_TIMES ;
@@ -353,65 +1098,39 @@ int	Gprs_check_simCard( gprs_t *self)
 				}
 				break;
 			case 3:		//GPRSע״̬
-				strcpy( Gprs_cmd_buf, "AT+CGREG?\x00D\x00A" );
-				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
-			
-				pp = strstr((const char*)Gprs_cmd_buf,"+CGREG");
-				if(pp)
+				if( reg_done( dsys.gprs.status_gprs) == 0)
 				{
-					ret = Get_str_data(pp, ",", 1, &err);
-					if(err == 0)
-					{
-						dsys.gprs.status_gprs = ret;	
-							
-						switch(dsys.gprs.status_gprs)
+					strcpy( Gprs_cmd_buf, "AT+CGREG?\x00D\x00A" );
+					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+					pp = strstr((const char*)Gprs_cmd_buf,"+CGREG");
+					if(pp)
+						parse_reg_stat( pp, &dsys.gprs.status_gprs);
+				}
+				switch(dsys.gprs.status_gprs)
+				{
+					case 3:	//Registration denied,The GPRS service is disabled, the UE is not allowed to attach for GPRS if it is requested by the user.
+						//ʹʱ
+					case 0:	//Not registered, GPRS service is disabled,the UE is allowed to attach for GPRS if requested by the user.
+					case 1:		//Registered, home network
+					case 5:		//Registered, roaming
+						if( reg_done( dsys.gprs.status_gsm) || reg_done( dsys.gprs.status_gprs))
+						{
+							//עɹ
+							boot_mark( &Boot.reg_ms);
+							step ++;
+						}
+						else
 						{
 							
-							case 2:		//Not registered, but MT is currently trying to attach or searching an operator to register to.
-							case 4:		//δ֪
-								break;
-							case 3:	//Registration denied,The GPRS service is disabled, the UE is not allowed to attach for GPRS if it is requested by the user.
-								//ʹʱµĴ
-//								strcpy( Gprs_cmd_buf, "AT+CIPCLOSE=1\x00D\x00A" );		
-//								SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
-//								pp = strstr((const char*)Gprs_cmd_buf,"OK");
-//								osDelay(1000);
-////								Get_ip_status();
-//								strcpy( Gprs_cmd_buf, "AT+CIPSHUT\x00D\x00A" );		
-//								SerilTxandRx(Gprs_cmd_buf, CMDBUF_LEN,10);
-//								pp = strstr((const char*)Gprs_cmd_buf,"OK");
-//								osDelay(1000);
-//								self->shutdown(self);
-//								
-//								goto errOut;
-							case 0:	//Not registered, GPRS service is disabled,the UE is allowed to attach for GPRS if requested by the user.
-
-							case 1:		//Registered, home network
-							case 5:		//Registered, roaming
-								if(dsys.gprs.status_gsm == 1 || dsys.gprs.status_gsm == 5 || \
-									dsys.gprs.status_gprs == 1 || dsys.gprs.status_gprs == 5)
-								{
-									//עɹ
-									step ++;
-									retry = 6000;
-								}
-								else
-								{
-									
-									goto errOut;
-								}
-								
-								break;
-							
-								
-							
-							
-							
+							goto errOut;
 						}
-					}
-				
+						break;
+					default:	//2 ע 4 δ֪
+						break;
 				}
-				osDelay(1000);
+				if( step != 3)
+					break;
+				reg_wait( &dsys.gprs.status_gprs, 1000);
 				retry --;
 				if( retry == 0) {
 					dsys.gprs.cur_state = GPRSERROR;
@@ -419,40 +1138,8 @@ int	Gprs_check_simCard( gprs_t *self)
 					goto errOut;
 				}
 				break;
-			case 4:		//wait sms read and call read
-
-				
-				
-				if( dsys.gprs.flag_ready >= 2)
-					return ERR_OK;
-				
-				osDelay(3);
-				if( retry)
-				{
-					strcpy( Gprs_cmd_buf, "AT+CCALR?\x00D\x00A" );
-					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
-					//+CCALR:1
-					pp = strstr((const char*)Gprs_cmd_buf,"+CCALR");
-					if(pp)
-					{
-						ret = Get_str_data(pp, NULL, 0, &err);
-						if(err == 0)
-						{
-						
-							if(ret == 1)
-								dsys.gprs.flag_ready |= 1;
-						}
-						
-						
-						
-					}
-					retry --;
-					
-				}
-				else
-					goto errOut;
-				
-				break;
+			case 4:		//ź͵绰ܲӰٵSMS Readyŵʱټ
+				return ERR_OK;
 			default:
 				step = 0;
 				break;
@@ -465,14 +1152,73 @@ int	Gprs_check_simCard( gprs_t *self)
 	return ERR_FAIL; 
 }
 
+//+CBC: 0,95,4140
+static int parse_cbc( char *buf)
+{
+	char 		*pp = strstr((const char*)buf,"+CBC");
+	uint8_t		err = 0;
+	int			ret;
+	
+	if( pp == NULL)
+		return ERR_FAIL;
+	ret = Get_str_data(pp, ",", 0, &err);
+	if(err == 0)
+		dsys.gprs.bcs = ret;
+	
+	ret = Get_str_data(pp, ",", 1, &err);
+	if(err == 0)
+		dsys.gprs.bcl = ret;
+	
+	ret = Get_str_data(pp, ",", 2, &err);
+	if(err == 0)
+		dsys.gprs.voltage_mv = ret;
+	return ERR_OK;
+}
+
+//+CSQ: 20,0
+static int parse_csq( char *buf)
+{
+	char 		*pp = strstr((const char*)buf,"+CSQ");
+	uint8_t		err = 0;
+	int			ret;
+	
+	if( pp == NULL)
+		return ERR_FAIL;
+	ret = Get_str_data(pp, ",", 0, &err);
+	if(err == 0)
+		dsys.gprs.signal_strength = ret;
+	
+	ret = Get_str_data(pp, ",", 2, &err);
+	if(err == 0)
+		dsys.gprs.ber = ret;
+	return ERR_OK;
+}
+
+//̨ˢֻѯһΣ
+static int radio_query( void)
+{
+	strcpy( Gprs_cmd_buf, "AT+CBC\x00D\x00A" );
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,5);
+	if( parse_cbc( Gprs_cmd_buf) != ERR_OK)
+		return ERR_FAIL;
+	strcpy( Gprs_cmd_buf, "AT+CSQ\x00D\x00A" );
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+	if( parse_csq( Gprs_cmd_buf) != ERR_OK)
+		return ERR_FAIL;
+	Radio_info_s = get_time_s();
+	Radio_info_ok = 1;
+	return ERR_OK;
+}
+
 //ȡSIMĵѹźǿȵϢ
+//ûйڵʱֱӷأģ
 static int	Gprs_get_info( gprs_t *self)
 {
-	char 		*pp = NULL;
 	char 		step = 0;
-	uint8_t		err = 0;
 	short		retry = RETRY_TIMES;
-	int			ret;
+	
+	if( Radio_info_ok && get_time_s() - Radio_info_s < RADIO_TTL_S)
+		return ERR_OK;
 	while(1)
 	{
 		if( dsys.gprs.cur_state == SHUTDOWN)
@@ -486,24 +1232,8 @@ static int	Gprs_get_info( gprs_t *self)
 			case 0:
 				strcpy( Gprs_cmd_buf, "AT+CBC\x00D\x00A" );
 				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,5);
-			
-				//+CBC:0,95,4140
-				pp = strstr((const char*)Gprs_cmd_buf,"+CBC");
-				if(pp)
+				if( parse_cbc( Gprs_cmd_buf) == ERR_OK)
 				{
-					ret = Get_str_data(pp, ",", 0, &err);
-					if(err == 0)
-						dsys.gprs.bcs = ret;
-					
-					ret = Get_str_data(pp, ",", 1, &err);
-					if(err == 0)
-						dsys.gprs.bcl = ret;
-					
-					ret = Get_str_data(pp, ",", 2, &err);
-					if(err == 0)
-						dsys.gprs.voltage_mv = ret;
-					
-					
 					step ++;
 					retry = RETRY_TIMES ;
 					break;
@@ -521,16 +1251,8 @@ static int	Gprs_get_info( gprs_t *self)
 			case 1:
 				strcpy( Gprs_cmd_buf, "AT+CSQ\x00D\x00A" );
 				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
-				pp = strstr((const char*)Gprs_cmd_buf,"+CSQ");
-				if(pp)
+				if( parse_csq( Gprs_cmd_buf) == ERR_OK)
 				{
-					ret = Get_str_data(pp, ",", 0, &err);
-					if(err == 0)
-						dsys.gprs.signal_strength = ret;
-					
-					ret = Get_str_data(pp, ",", 2, &err);
-					if(err == 0)
-						dsys.gprs.ber = ret;
 					step ++;
 					retry = RETRY_TIMES * 2;
 					break;
@@ -544,6 +1266,8 @@ static int	Gprs_get_info( gprs_t *self)
 				}
 				break;
 			case 2:
+				Radio_info_s = get_time_s();
+				Radio_info_ok = 1;
 				return ERR_OK;
 				
 			default:
@@ -557,10 +1281,10 @@ static int	Gprs_get_info( gprs_t *self)
 	return ERR_FAIL; 
 }
 
-int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms){
+//ıʽͣ00x1Aöǰ
+static int sms_submit_text(  gprs_t *self, char *phnNmbr, char *sms, int sms_len){
 //	uint8_t i = 0;
 	
-	short  sms_len = strlen( sms);
 	char	step = 0;
 	char	endchar = 0x1A;
 	short retry = RETRY_TIMES;
@@ -628,6 +1352,9 @@ int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms){
 					return ERR_DEV_TIMEOUT;
 				break;
 			case 2:
+				//ύŵģӦм䲻ܲݷ
+				if( cmd_lock() != ERR_OK)
+					return ERR_DEV_BUSY;
 				sprintf(Gprs_cmd_buf,"AT+CMGS=\"%s\"\x00D\x00A",phnNmbr);
 				UART_SEND( Gprs_cmd_buf, strlen(Gprs_cmd_buf));
 				osDelay(100);
@@ -651,6 +1378,7 @@ int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms){
 				if(pp)
 				{
 //					osDelay(1000);
+					chn_unlock();
 					return ERR_OK;
 				}
 				pp = strstr((const char*)Gprs_cmd_buf,"ERROR");
@@ -662,6 +1390,7 @@ int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms){
 //					UART_SEND( sms, sms_len + 1);
 					Gprs_state.sms_msgFromt = SMS_MSG_ERR;
 					Gprs_state.sms_chrcSet = SMS_CHRC_SET_ERR;
+					chn_unlock();
 					return ERR_FAIL;
 				}
 				
@@ -670,7 +1399,10 @@ int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms){
 				osDelay(100);
 				retry --;
 				if( retry == 0)
+				{
+					chn_unlock();
 					return ERR_DEV_TIMEOUT;
+				}
 				
 		} //switch
 		
@@ -679,215 +1411,742 @@ int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms){
 	
 }
 
-/**
- * @brief SIMжȡָĺTEXTʽϢ
- *
- * @details SIMָδϢĺڴΪջߺ벻Ϸͷصһ
- *					ǷȡĶŵķͷڴ
- * 
- * @param[in]	self.
- * @param[in]	phnNmbr ָĺ룬Ϊ.
- * @param[in]	bufsize ĴС.
- * @param[out]	buf ȡĶŴڴڴ. 
- * @param[out] phnNmbr	ûָһϷĺʱ򣬽ȡĶŵĺ
- * @retval	> 0,ű
- * @retval  = 0 ޶
- * @retval	ERROR	< 0
- */
+//ύһPDUݷֳСתʮƷͣҪPDUʮƻ
+static int sms_cmgs_pdu( char *phnNmbr, uint8_t *data, int len, uint8_t ref, uint8_t total, uint8_t seq)
+{
+	char	endchar = 0x1A;
+	short	retry;
+	int		hl, k, n;
+	
+	hl = SmsPdu_submit_head( Sms_pdu, phnNmbr, len, ref, total, seq);
+	if( hl < 0)
+		return ERR_BAD_PARAMETER;
+	//ύŵģӦм䲻ܲݷ
+	if( cmd_lock() != ERR_OK)
+		return ERR_DEV_BUSY;
+	//Ȳĵַ
+	sprintf( Gprs_cmd_buf, "AT+CMGS=%d\x00D\x00A", hl - 1 + len);
+	UART_SEND( Gprs_cmd_buf, strlen( Gprs_cmd_buf));
+	osDelay(100);
+	SmsPdu_hex( Sms_pdu_hex, Sms_pdu, hl);
+	UART_SEND( Sms_pdu_hex, 2 * hl);
+	for( k = 0; k < len; k += n)
+	{
+		n = len - k > SMS_PDU_HEX_CHUNK ? SMS_PDU_HEX_CHUNK : len - k;
+		SmsPdu_hex( Sms_pdu_hex, data + k, n);
+		if( UART_SEND( Sms_pdu_hex, 2 * n) == ERR_DEV_TIMEOUT)
+			osDelay(1000);
+	}
+	UART_SEND( &endchar, 1);
+	for( retry = 300; retry > 0; retry --)			///Ӧʱ60s
+	{
+		memset( Gprs_cmd_buf, 0, CMDBUF_LEN);
+		UART_RECV( Gprs_cmd_buf, CMDBUF_LEN);
+		if( strstr( ( const char*)Gprs_cmd_buf, "OK"))
+		{
+			chn_unlock();
+			return ERR_OK;
+		}
+		if( strstr( ( const char*)Gprs_cmd_buf, "ERROR"))
+		{
+			Gprs_state.sms_msgFromt = SMS_MSG_ERR;
+			chn_unlock();
+			return ERR_FAIL;
+		}
+		osDelay(100);
+	}
+	chn_unlock();
+	return ERR_DEV_TIMEOUT;
+}
 
-int	read_phnNmbr_TextSMS( gprs_t *self, char *phnNmbr, char *in_buf, char *out_buf, int *len)
+//PDUʽ8λ뷢ԭʼݣһķֳɳŵļΣһʧܾͷʧ
+static int sms_submit_pdu( gprs_t *self, char *phnNmbr, char *sms, int sms_len)
 {
-	char step = 0;
-	char i = 0;
+	static uint8_t	ref = 0;
+	int		total, seq, n;
+	int		off = 0;
+	int		ret;
 	
-	short retry = RETRY_TIMES;
-	short bufLen = *len;
+	if( sms_len == 0)
+		return ERR_OK;
+	if( dsys.gprs.flag_ready < 2)
+		return ERR_DEV_SICK;
+	if( phnNmbr == NULL || sms == NULL)
+		return ERR_BAD_PARAMETER;
+	if( dsys.gprs.cur_state < INIT_FINISH_OK)
+		return ERR_UNINITIALIZED;
+	if( check_phoneNO( phnNmbr) != ERR_OK)
+		return ERR_BAD_PARAMETER;
+	total = SmsPdu_parts( sms_len);
+	if( total > SMS_PDU_PARTS_MAX)
+		return ERR_BAD_PARAMETER;
+	if( set_sms2PduMode( self) != ERR_OK)
+		return ERR_DEV_TIMEOUT;
 	
-	char *pp = NULL;
-	char	*ptarget = out_buf;
+	ref ++;
+	for( seq = 1; seq <= total; seq ++)
+	{
+		if(dsys.gprs.cur_state == SHUTDOWN)
+			return ERR_DEV_SICK;
+		n = SmsPdu_part_len( sms_len, seq);
+		ret = sms_cmgs_pdu( phnNmbr, ( uint8_t *)sms + off, n, ref, total, seq);
+		if( ret != ERR_OK)
+			return ret;
+		off += n;
+	}
+	return ERR_OK;
+}
+
+//ָȵĶݣݲҪ0β
+//PDUʽʱ8λ뷢ͣᱻ00x1Aض
+int	send_sms_data(  gprs_t *self, char *phnNmbr, char *sms, int sms_len)
+{
+	if( Dtu_config.sms_pdu)
+		return sms_submit_pdu( self, phnNmbr, sms, sms_len);
+	return sms_submit_text( self, phnNmbr, sms, sms_len);
+}
+
+//ıĶŸֻıʽ
+int	send_text_sms(  gprs_t *self, char *phnNmbr, char *sms)
+{
+	if( sms == NULL)
+		return ERR_BAD_PARAMETER;
+	return sms_submit_text( self, phnNmbr, sms, strlen( sms));
+}
+
+#define INBOX_ST_LINE		0		//еĿͷ
+#define INBOX_ST_IDX		1		//+CMGL: ı
+#define INBOX_ST_HEAD		2		//״̬ʱ
+#define INBOX_ST_TEXT		3		//
+#define INBOX_ST_MORE		4		//ı֮һУݡһšOK֪ͨ
+
+static void urc_dispatch(void *buf, void *arg, int len);
+
+static int inbox_empty( void)
+{
+	return SmsInbox.rd == SmsInbox.commit;
+}
+
+static int inbox_putc( char c)
+{
+	uint16_t next = ( SmsInbox.wr + 1) % SMS_INBOX_LEN;
 	
-	short number = 0;
-	char  text_begin = 0, text_end = 0;
-			
-	short legal_phno = 0;
-	int	phnoend_offset = 0;
+	if( next == SmsInbox.rd)
+		return ERR_MEM_UNAVAILABLE;
+	SmsInbox.buf[ SmsInbox.wr] = c;
+	SmsInbox.wr = next;
+	return ERR_OK;
+}
+
+static char inbox_getc( void)
+{
+	char c = SmsInbox.buf[ SmsInbox.rd];
+	SmsInbox.rd = ( SmsInbox.rd + 1) % SMS_INBOX_LEN;
+	return c;
+}
+
+//ʼһ䳤ֶΣֶνʱ
+static void inbox_field_begin( void)
+{
+	if( SmsInbox.skip)
+		return;
+	SmsInbox.len_pos = SmsInbox.wr;
+	SmsInbox.cnt = 0;
+	if( inbox_putc( 0) != ERR_OK)
+		SmsInbox.skip = 2;
+}
+
+static void inbox_field_putc( char c, int max)
+{
+	if( SmsInbox.skip || SmsInbox.cnt >= max)
+		return;
+	if( inbox_putc( c) != ERR_OK)
+	{
+		SmsInbox.skip = 2;
+		return;
+	}
+	SmsInbox.cnt ++;
+	SmsInbox.buf[ SmsInbox.len_pos] = SmsInbox.cnt;
+}
+
+//һŽŲµʱ¼´ٶ
+static void inbox_rec_end( void)
+{
+	if( SmsInbox.skip == 0)
+		SmsInbox.commit = SmsInbox.wr;
+	else
+		SmsInbox.wr = SmsInbox.commit;
+	if( SmsInbox.skip == 2)
+		SmsInbox.more = 1;
+}
+
+//жŵĹģҲ֪ᷢͨЩҪ֪ͨĽܵɶ
+//·ʱǰ·ţ0, CLOSED
+static const char *const ListUrc[] = {
+	"+CMTI:", "+CREG:", "+CGREG:", "+CIPRXGET:", "+CDNSGIP:", "+CNTP:", "+CTZV", "*PSUTTZ",
+	"+CPIN:", "NORMAL POWER DOWN", "RING", "Call Ready", "SMS Ready",
+	"CONNECT OK", "CONNECT FAIL", "ALREADY CONNECT", "CLOSED", NULL
+};
+
+static int urc_line( const char *line)
+{
+	int i;
 	
-	if( check_phoneNO( phnNmbr) == ERR_OK)
-		legal_phno = 1;
-	//Ϊ׼ã˵û
-	if( dsys.gprs.flag_ready < 2)
-		return ERR_UNINITIALIZED;  
+	if( line[0] >= '0' && line[0] <= '9' && line[1] == ',' && line[2] == ' ')
+		line += 3;
+	for( i = 0; ListUrc[i]; i ++)
+	{
+		if( strncmp( line, ListUrc[i], strlen( ListUrc[i])) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+//бĽβ
+static int list_end_line( void)
+{
+	if( SmsInbox.line_len == 2 && memcmp( SmsInbox.line, "OK", 2) == 0)
+		SmsInbox.listing = SMS_LIST_OK;
+	else if( SmsInbox.line_len >= 5 && memcmp( SmsInbox.line, "ERROR", 5) == 0)
+		SmsInbox.listing = SMS_LIST_ERR;
+	else if( SmsInbox.line_len >= 6 && memcmp( SmsInbox.line, "+CMS E", 6) == 0)
+		SmsInbox.listing = SMS_LIST_ERR;
+	else
+		return 0;
+	return 1;
+}
+
+//ȷݵһУǰĻкͻĲַŽ
+static void inbox_body_flush( void)
+{
+	int i;
 	
-	while(1)
+	for( ; SmsInbox.nl; SmsInbox.nl --)
+		inbox_field_putc( '\n', SMS_TEXT_MAX);
+	for( i = 0; i < SmsInbox.line_len; i ++)
+		inbox_field_putc( SmsInbox.line[ i], SMS_TEXT_MAX);
+	SmsInbox.line_len = 0;
+}
+
+//ڴڻصAT+CMGL
+//+CMGL: 1,"REC UNREAD","+8613918186089","","18/01/08,10:00:00+32"\r\n
+//ݣж\r\n
+//...
+//OK\r\n
+//ıݵһ+CMGL: OKŽмŵ֪ͨн֪ͨĽ
+//PDUʽʱ+CMGL: 1,1,,25\r\nһʮƵPDUתֽڷУPDU
+static void sms_list_parse( char *data, int len, void *arg)
+{
+	char c;
+	
+	while( len -- > 0)
 	{
-		if(dsys.gprs.cur_state == SHUTDOWN)
-		{
-			//17-12-17 ʹԵʱйػ
-			return ERR_DEV_SICK;  
-		}
-		
-		switch(step)
+		c = *data ++;
+		if( c == '\r' || c == '\0')
+			continue;
+		switch( SmsInbox.state)
 		{
-			case 0:		//set msg mode
-				if( set_sms2TextMode( self) == ERR_OK)
+			case INBOX_ST_LINE:
+				if( c == '\n')
 				{
-					
-					step ++;
-					Gprs_state.sms_msgFromt = SMS_MSG_TEXT;
-					retry = RETRY_TIMES;
+					SmsInbox.line[ SmsInbox.line_len] = '\0';
+					if( list_end_line() == 0 && SmsInbox.line_len)
+						urc_dispatch( SmsInbox.line, arg, SmsInbox.line_len);
+					SmsInbox.line_len = 0;
 					break;
 				}
-				osDelay(100);
-				retry --;
-				if( retry == 0)
-					return ERR_FAIL;
-				break;
-			case 1:		///ȡŵ
-				strcpy( Gprs_cmd_buf, "AT+CPMS?\x00D\x00A" );
-			
-//				+CPMS: <mem1>,<used1>,<total1>,<mem2>,<used2>,<total2>,
-//						<mem3>,<used3>,<total3>
-				
-				if( SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,50) == 0)
+				if( SmsInbox.line_len < SMS_LINE_LEN - 1)
+					SmsInbox.line[ SmsInbox.line_len ++] = c;
+				if( SmsInbox.line_len == 7 && memcmp( SmsInbox.line, "+CMGL: ", 7) == 0)
 				{
-					//£GPRSػ
-					Gprs_state.sms_msgFromt = SMS_MSG_ERR;
-					return ERR_FAIL;
+					SmsInbox.state = INBOX_ST_IDX;
+					SmsInbox.idx = 0;
 				}
-			
-				//ҵ
-				pp = strstr(Gprs_cmd_buf,",");
-				if( pp)
+				break;
+			case INBOX_ST_IDX:
+				if( c >= '0' && c <= '9')
 				{
-					pp ++;
-					
-					//ûжžͷ
-					number = atoi( pp);	
-					if( number == 0)
-						return -1;
+					SmsInbox.idx = SmsInbox.idx * 10 + c - '0';
+					break;
 				}
-				else
+				//ѾĶţȴɾ
+				SmsInbox.skip = 0;
+				if( SmsInbox.idx < MAX_NUM_SMS && ( check_bit( ( uint8_t *)SmsInbox.done, SmsInbox.idx) || \
+					check_bit( ( uint8_t *)SmsInbox.held, SmsInbox.idx)))
+					SmsInbox.skip = 1;
+				else if( inbox_putc( SmsInbox.idx) != ERR_OK)
+					SmsInbox.skip = 2;
+				SmsInbox.field = 1;
+				SmsInbox.quote = 0;
+				SmsInbox.cnt = 0;
+				SmsInbox.state = INBOX_ST_HEAD;
+				break;
+			case INBOX_ST_HEAD:
+				if( c == '\n')
 				{
-					return -1;
+					//ûкǲԵ
+					if( SmsInbox.field < 2 && SmsInbox.skip == 0)
+						SmsInbox.skip = 1;
+					SmsInbox.state = INBOX_ST_TEXT;
+					SmsInbox.nib = 0;
+					inbox_field_begin();
+					break;
 				}
-				pp = strstr(pp,",");
-				if( pp)
+				if( c == '"')
 				{
-					pp ++;
+					SmsInbox.quote = !SmsInbox.quote;
+					break;
 				}
-				else
+				if( c == ',' && SmsInbox.quote == 0)
 				{
-					return -1;
+					SmsInbox.field ++;
+					SmsInbox.cnt = 0;
+					if( SmsInbox.field == 2)
+						inbox_field_begin();
+					break;
 				}
-				retry --;
-				if( retry == 0)
-					return ERR_FAIL;
-				
-//				tmp = strcspn( pp, "0123456789");			
-//				pp = Gprs_cmd_buf + tmp;
-//				tmp = strcspn( pp, ",");	
-				number = atoi( pp);			
-				if( number < 1)
-					return 0;	
-				if( dsys.gprs.rx_sms_seq > number)
-					dsys.gprs.rx_sms_seq = 0;
-				i = dsys.gprs.rx_sms_seq;		///ŴӶCMIT֪ͨʼȡ
-				step ++;
-				retry = RETRY_TIMES;
+				//ֻҪյĶţ"STO SENT"֮ĲҪPDUʽ01
+				if( SmsInbox.field == 1 && SmsInbox.cnt ++ == 0 && SmsInbox.skip == 0 && \
+					( SmsInbox.pdu ? ( c != '0' && c != '1') : c != 'R'))
+					SmsInbox.skip = 1;
+				if( SmsInbox.field == 2)
+					inbox_field_putc( c, PHONENO_LEN - 1);
 				break;
-				
-			case 2:		///һζȡţжȡͷָĶ
-				sprintf( in_buf, "AT+CMGR=%d\x00D\x00A", i);
-				
-				
-				if( SerilTxandRx( in_buf, bufLen, 10) == 0)
+			case INBOX_ST_TEXT:
+				if( c == '\n')
 				{
-					Gprs_state.sms_msgFromt = SMS_MSG_ERR;
-					return ERR_FAIL;
+					SmsInbox.line_len = 0;
+					//PDUֻһ
+					if( SmsInbox.pdu)
+					{
+						inbox_rec_end();
+						SmsInbox.state = INBOX_ST_LINE;
+						break;
+					}
+					SmsInbox.nl = 1;
+					SmsInbox.state = INBOX_ST_MORE;
+					break;
 				}
-			
-				pp = in_buf;			///ٶppֵ
-				if(  legal_phno)			//ĺϷͽƥ
+				if( SmsInbox.pdu == 0)
 				{
-					pp = strstr((const char*)in_buf,phnNmbr);
+					inbox_field_putc( c, SMS_TEXT_MAX);
+					break;
 				}
-				else if( phnNmbr)	//ûָҪնŵķͷʱѷͷ봫ĺȥ
+				c = c >= 'a' ? c - 'a' + 10 : ( c >= 'A' ? c - 'A' + 10 : c - '0');
+				if( c < 0 || c > 15)
 				{
-					
-					
-					phnoend_offset = get_sms_phNO( pp, phnNmbr);
-					if( phnoend_offset > 0)
-						pp += phnoend_offset ;
-					else			//ҲκЧĺ룬Ͳ
-						pp = NULL;
+					if( SmsInbox.skip == 0)
+						SmsInbox.skip = 1;
+					break;
 				}
-				
-				
-				if( pp)
+				if( SmsInbox.nib == 0)
+					SmsInbox.hi = c;
+				else
+					inbox_field_putc( ( SmsInbox.hi << 4) | c, SMS_PDU_LEN_MAX);
+				SmsInbox.nib ^= 1;
+				break;
+			case INBOX_ST_MORE:
+				if( c == '\n')
 				{
-					number = 0;
-					while( *pp != '\0')
+					SmsInbox.line[ SmsInbox.line_len] = '\0';
+					if( SmsInbox.line_len == 0)
 					{
-						if( *pp == '\x00A')			/// ݴӵһ\00A ʼ ڶ\00A
-						{
-							if( text_begin == 0) {
-								text_begin = 1;
-								
-								pp ++;
-								continue;
-							}
-							else {
-								text_end = 1;
-								
-							}
-						}
-						if( text_end || number > ( *len - 1))
-						{
-							
-							*ptarget  = '\0';
-							*len = number;
-							dsys.gprs.rx_sms_seq = i + 1;
-							return i;
-						}
-						
-						
-						if( text_begin) {
-							number ++;
-							*ptarget = *pp;
-							ptarget ++;
-						}
-						
-						pp ++;
-							
-					}		// while( *pp != '\0')
-					
-//todo  ֽյûнβô죿
-					return i;
+						//ȼ滹ݵʱٷŽȥ
+						SmsInbox.nl ++;
+					}
+					else if( list_end_line())
+					{
+						inbox_rec_end();
+						SmsInbox.state = INBOX_ST_LINE;
+					}
+					else if( urc_line( SmsInbox.line))
+						urc_dispatch( SmsInbox.line, arg, SmsInbox.line_len);
+					else
+					{
+						inbox_body_flush();
+						SmsInbox.nl = 1;
+					}
+					SmsInbox.line_len = 0;
+					break;
 				}
-				pp = strstr((const char*)in_buf,"REC");		//յRECʱ򣬿ǴûȫԼ
-				if( pp && retry)
+				if( SmsInbox.line_len < SMS_LINE_LEN - 1)
+					SmsInbox.line[ SmsInbox.line_len ++] = c;
+				if( SmsInbox.line_len == 7 && memcmp( SmsInbox.line, "+CMGL: ", 7) == 0)
 				{
-					retry --;
+					inbox_rec_end();
+					SmsInbox.state = INBOX_ST_IDX;
+					SmsInbox.idx = 0;
+					break;
 				}
-				else
+				//ܳв֪ͨݣֱӷŽ
+				if( SmsInbox.line_len == SMS_LINE_LEN - 1)
 				{
-					retry = RETRY_TIMES;
-					
-					i ++;
-					
+					SmsInbox.line[ SmsInbox.line_len] = '\0';
+					if( urc_line( SmsInbox.line) == 0)
+					{
+						inbox_body_flush();
+						SmsInbox.state = INBOX_ST_TEXT;
+					}
 				}
-				if( i > number)
-					return ERR_FAIL;
 				break;
 			default:
-				step = 0;
+				SmsInbox.state = INBOX_ST_LINE;
 				break;
-		}  //switch(step)
+		}
+	}
+}
+
+//AT+CMGLɴڻصѶŽ
+static int sms_list( gprs_t *self)
+{
+	int wait = 0;
+	int ret;
+	int i;
+	
+	if( Dtu_config.sms_pdu)
+	{
+		if( set_sms2PduMode( self) != ERR_OK)
+			return ERR_FAIL;
+	}
+	else
+	{
+		if( set_sms2TextMode( self) != ERR_OK)
+			return ERR_FAIL;
+		Gprs_state.sms_msgFromt = SMS_MSG_TEXT;
+	}
+	
+	if( cmd_lock() != ERR_OK)
+		return ERR_DEV_BUSY;
+	UART_RECV( Gprs_cmd_buf, CMDBUF_LEN);
+	SmsInbox.state = INBOX_ST_LINE;
+	SmsInbox.line_len = 0;
+	SmsInbox.skip = 0;
+	SmsInbox.more = 0;
+	SmsInbox.keep = 0;
+	//SIMĶѾѶˣҲɾ
+	for( i = 0; i < MAX_NUM_SMS / 32; i ++)
+	{
+		if( SmsInbox.held[i])
+			SmsInbox.keep = 1;
+	}
+	SmsInbox.pdu = Dtu_config.sms_pdu;
+	SmsInbox.wr = SmsInbox.commit;
+	SmsInbox.listing = SMS_LISTING;
+	//"ALL"δĶŸĳѶԴ֮CMGDɾ
+	if( SmsInbox.pdu)
+		strcpy( Gprs_cmd_buf, "AT+CMGL=4\x00D\x00A");
+	else
+		strcpy( Gprs_cmd_buf, "AT+CMGL=\"ALL\"\x00D\x00A");
+	UART_SEND( Gprs_cmd_buf, strlen( Gprs_cmd_buf));
+	while( SmsInbox.listing == SMS_LISTING && wait < SMS_LIST_TIMEOUT_MS)
+	{
+		osDelay( 20);
+		wait += 20;
+	}
+	ret = SmsInbox.listing;
+	SmsInbox.listing = SMS_LIST_IDLE;
+	//ûļ¼Ҫ
+	SmsInbox.wr = SmsInbox.commit;
+	UART_RECV( Gprs_cmd_buf, CMDBUF_LEN);
+	chn_unlock();
+	
+	if( ret == SMS_LIST_OK)
+		return ERR_OK;
+	//ûĶ´ٶ
+	SmsInbox.more = 1;
+	if( ret == SMS_LISTING)
+		return ERR_DEV_TIMEOUT;
+	Gprs_state.sms_msgFromt = SMS_MSG_ERR;
+	return ERR_FAIL;
+}
+
+//Ӷȡһţ*len - 1ֽڣ油0
+static int inbox_pop( char *phone, char *text, int *len)
+{
+	int idx, n, i;
+	char c;
+	
+	if( inbox_empty())
+		return ERR_UNKOWN;
+	idx = ( uint8_t)inbox_getc();
+	n = ( uint8_t)inbox_getc();
+	for( i = 0; i < n; i ++)
+		phone[i] = inbox_getc();
+	phone[i] = '\0';
+	n = ( uint8_t)inbox_getc();
+	for( i = 0; i < n; i ++)
+	{
+		c = inbox_getc();
+		if( i < *len - 1)
+			text[i] = c;
+	}
+	if( n > *len - 1)
+		n = *len - 1;
+	text[n] = '\0';
+	*len = n;
+	return idx;
+}
+
+static int sms_cmgd( int seq, int delflag)
+{
+	short retry = RETRY_TIMES;
+	char *pp = NULL;
+	
+	while(1)
+	{
+		sprintf( Gprs_cmd_buf, "AT+CMGD=%d,%d\x00D\x00A", seq, delflag);
+		serial_cmmn( Gprs_cmd_buf, CMDBUF_LEN,1);
+		pp = strstr((const char*)Gprs_cmd_buf,"OK");		
+		if( pp)
+			return ERR_OK;
 		
-	}	//while(1)
+		pp = strstr((const char*)Gprs_cmd_buf,"ERROR");	
+		if( pp)
+			return ERR_FAIL;
 		
+		retry --;
+		if( retry == 0)
+			return ERR_FAIL;
 		
+		osDelay(100);
+	}
+}
+
+//ɾĶ
+//гĶŶѾѶˣûбĶʱһָɾѶĶ
+static int sms_delete_done( void)
+{
+	int i;
+	int ret = ERR_OK;
+	
+	for( i = 0; i < MAX_NUM_SMS / 32; i ++)
+	{
+		if( SmsInbox.done[i])
+			break;
+	}
+	if( i == MAX_NUM_SMS / 32)
+		return ERR_OK;
+	
+	if( SmsInbox.keep == 0)
+	{
+		ret = sms_cmgd( 1, 1);
+		if( ret == ERR_OK)
+			memset( SmsInbox.done, 0, sizeof( SmsInbox.done));
+		return ret;
+	}
+	
+	for( i = 0; i < MAX_NUM_SMS; i ++)
+	{
+		if( check_bit( ( uint8_t *)SmsInbox.done, i) == 0)
+			continue;
+		if( sms_cmgd( i, 0) != ERR_OK)
+			ret = ERR_FAIL;
+		else
+			clear_bit( ( uint8_t *)SmsInbox.done, i);
+	}
+	return ret;
+}
+
+//ζȡвгҲɾ
+static void sms_hold( int idx)
+{
+	SmsInbox.keep = 1;
+	if( idx < MAX_NUM_SMS)
+		set_bit( ( uint8_t *)SmsInbox.held, idx);
+}
+
+//ζȡˣûƴĳSIMʼȴʱ
+static void sms_asm_stop( void)
+{
+	if( SmsAsm.on == 0)
+		return;
+	SmsAsm.on = 0;
+	if( SmsAsm.wait_on && SmsAsm.wait_ref == SmsAsm.ref)
+		return;
+	SmsAsm.wait_on = 1;
+	SmsAsm.wait_ref = SmsAsm.ref;
+	SmsAsm.wait_s = get_time_s();
+}
+
+/**
+ * @brief ȡSms_pduĶݣŵĶƴ.
+ *
+ * @details ΰŷoutԵλã֮ȥÿмûĲ.
+ *			̫ࡢǰĶξͷŲ»ߵȴʱĳÿε.
+ * @retval	>=0	ŵıţƴõĳյһεıţѾΪ
+ * @retval	-1	ҪĶ
+ */
+static int sms_pdu_take( int idx, int pdu_len, char *out, int *len, int size)
+{
+	sms_pdu_t	*m = &Sms_msg;
+	int			k, pos;
+	
+	size --;			//һֽڲ0
+	if( m->total <= 1 || m->total > SMS_ASM_PARTS || ( m->total - 1) * m->cap >= size || \
+		( SmsAsm.wait_on && SmsAsm.wait_ref == m->ref && get_time_s() - SmsAsm.wait_s > SMS_ASM_TIMEOUT_S))
+	{
+		//ƴӵʱ򻺴治ã´ٶ
+		if( SmsAsm.on)
+		{
+			sms_hold( idx);
+			return -1;
+		}
+		*len = SmsPdu_decode( Sms_pdu, pdu_len, m, out, size);
+		out[ *len] = '\0';
+		return idx;
+	}
+	if( SmsAsm.on && ( SmsAsm.ref != m->ref || SmsAsm.total != m->total || SmsAsm.cap != m->cap || \
+		strcmp( SmsAsm.phone, m->phone)))
+	{
+		sms_hold( idx);
+		return -1;
+	}
+	if( SmsAsm.on == 0)
+	{
+		SmsAsm.on = 1;
+		SmsAsm.got = 0;
+		SmsAsm.ref = m->ref;
+		SmsAsm.total = m->total;
+		SmsAsm.cap = m->cap;
+		strcpy( SmsAsm.phone, m->phone);
+	}
+	k = m->seq - 1;
+	//ظյĶβҪ
+	if( SmsAsm.got & ( 1 << k))
+	{
+		set_bit( ( uint8_t *)SmsInbox.done, idx);
+		return -1;
+	}
+	sms_hold( idx);
+	//һοܷŲȫĲֶ
+	pos = size - k * SmsAsm.cap;
+	SmsAsm.len[ k] = SmsPdu_decode( Sms_pdu, pdu_len, m, out + k * SmsAsm.cap, pos < SmsAsm.cap ? pos : SmsAsm.cap);
+	SmsAsm.idx[ k] = idx;
+	SmsAsm.got |= 1 << k;
+	if( SmsAsm.got != ( 1 << SmsAsm.total) - 1)
+		return -1;
+	
+	for( k = 0, pos = 0; k < SmsAsm.total; k ++)
+	{
+		memmove( out + pos, out + k * SmsAsm.cap, SmsAsm.len[ k]);
+		pos += SmsAsm.len[ k];
+		if( SmsAsm.idx[ k] != idx)
+			set_bit( ( uint8_t *)SmsInbox.done, SmsAsm.idx[ k]);
+	}
+	out[ pos] = '\0';
+	*len = pos;
+	SmsAsm.on = 0;
+	if( SmsAsm.wait_ref == SmsAsm.ref)
+		SmsAsm.wait_on = 0;
+	return idx;
+}
+
+/**
+ * @brief SIMжȡָĺTEXTʽϢ
+ *
+ * @details SIMָϢĺڴΪջߺ벻Ϸͷصһ
+ *					ǷȡĶŵķͷڴ
+ *					ռпյʱһAT+CMGLеĶţԺʱSIMеĶ޹
+ *					PDUʽʱPDUȡŵĸƴӳһ
+ * 
+ * @param[in]	self.
+ * @param[in]	phnNmbr ָĺ룬Ϊ.
+ * @param[in]	in_buf ʹ.
+ * @param[out]	out_buf ȡĶŴڴڴ. 
+ * @param[in/out] len ĴСضŵĳ.
+ * @param[out] phnNmbr	ûָһϷĺʱ򣬽ȡĶŵĺ
+ * @retval	> 0,ű
+ * @retval	ERROR	< 0
+ */
+
+int	read_phnNmbr_TextSMS( gprs_t *self, char *phnNmbr, char *in_buf, char *out_buf, int *len)
+{
+	char	phone[ PHONENO_LEN];
+	short	legal_phno = 0;
+	short	listed = 0;
+	int		bufLen = *len;
+	int		pdu_len;
+	int		idx;
+	int		ret;
+	
+	if( check_phoneNO( phnNmbr) == ERR_OK)
+		legal_phno = 1;
+	//Ϊ׼ã˵û
+	if( dsys.gprs.flag_ready < 2)
+		return ERR_UNINITIALIZED;  
+	
+	memset( SmsInbox.held, 0, sizeof( SmsInbox.held));
+	SmsAsm.on = 0;
+	while(1)
+	{
+		if(dsys.gprs.cur_state == SHUTDOWN)
+		{
+			//17-12-17 ʹԵʱйػ
+			sms_asm_stop();
+			return ERR_DEV_SICK;  
+		}
+		if( inbox_empty())
+		{
+			if( listed && SmsInbox.more == 0)
+			{
+				sms_asm_stop();
+				return ERR_UNKOWN;
+			}
+			ret = sms_list( self);
+			if( ret != ERR_OK && inbox_empty())
+			{
+				sms_asm_stop();
+				return ret;
+			}
+			listed = 1;
+			continue;
+		}
 		
+		*len = bufLen;
+		if( SmsInbox.pdu)
+		{
+			pdu_len = sizeof( Sms_pdu);
+			idx = inbox_pop( phone, ( char *)Sms_pdu, &pdu_len);
+			if( idx < 0)
+				continue;
+			//ʽԵĶŲҪ
+			if( SmsPdu_decode( Sms_pdu, pdu_len, &Sms_msg, NULL, 0) < 0)
+			{
+				set_bit( ( uint8_t *)SmsInbox.done, idx);
+				continue;
+			}
+			strncpy( phone, Sms_msg.phone, PHONENO_LEN - 1);
+			phone[ PHONENO_LEN - 1] = '\0';
+		}
+		else
+		{
+			idx = inbox_pop( phone, out_buf, len);
+			if( idx < 0)
+				continue;
+		}
+		if( legal_phno)			//ĺϷͽƥ
+		{
+			if( strstr( phone, phnNmbr) == NULL)
+			{
+				//ĶSIM
+				sms_hold( idx);
+				continue;
+			}
+		}
+		else if( phnNmbr)	//ûָҪնŵķͷʱѷͷ봫ĺȥ
+		{
+			//ҲκЧĺ룬Ͳ
+			if( strlen( phone) < 4)
+			{
+				set_bit( ( uint8_t *)SmsInbox.done, idx);
+				continue;
+			}
+			strcpy( phnNmbr, phone);
+		}
+		if( SmsInbox.pdu && sms_pdu_take( idx, pdu_len, out_buf, len, bufLen) < 0)
+			continue;
+		return idx;
+	}
 }
 //ȡָкŵĶ
 int	read_seq_TextSMS( gprs_t *self, char *phnNmbr, int seq, char *buf, int *len)
@@ -1018,33 +2277,16 @@ int	read_seq_TextSMS( gprs_t *self, char *phnNmbr, int seq, char *buf, int *len)
 		
 }
 
+//ĶȼռĶŶ֮һɾ
 int delete_sms( gprs_t *self, int seq) 
 {
-	short retry = RETRY_TIMES;
-	
-	char *pp = NULL;
-	
-	while(1)
-	{
-		sprintf( Gprs_cmd_buf, "AT+CMGD=%d\x00D\x00A", seq);
-		serial_cmmn( Gprs_cmd_buf, CMDBUF_LEN,1);
-		pp = strstr((const char*)Gprs_cmd_buf,"OK");		
-		if( pp)
-			return ERR_OK;
-		
-		pp = strstr((const char*)Gprs_cmd_buf,"ERROR");	
-		if( pp)
-			return ERR_FAIL;
-		
-		retry --;
-		if( retry == 0)
-			return ERR_FAIL;
-		
-		osDelay(100);
-		
-		
-	}
+	if( seq < 0 || seq >= MAX_NUM_SMS)
+		return sms_cmgd( seq, 0);
 	
+	set_bit( ( uint8_t *)SmsInbox.done, seq);
+	if( inbox_empty() && SmsInbox.more == 0)
+		return sms_delete_done();
+	return ERR_OK;
 }
 
 
@@ -1070,9 +2312,7 @@ int delete_sms( gprs_t *self, int seq)
  
  int tcpClose( gprs_t *self, int cnntNum)
  {
-	 char *pp;
-	 
-	 short safeCount = 5;
+	 short safeCount = 0;
 //	 short i = 0;
 	 if( dsys.gprs.cip_mux)
 	 {
@@ -1088,229 +2328,365 @@ int delete_sms( gprs_t *self, int seq)
 	 {
 		 if( Ip_cnnState.cnn_state[ 0] != CNNT_ESTABLISHED)
 			 return ERR_OK;
-		 //˳ģʽ
-		 while(1)
+		 //˳ģʽв͸д봮
+		 //˲ʱҪӱǳɶϿ
+		 for( safeCount = 0; safeCount < TRSP_ESC_FAIL_MAX; safeCount ++)
 		 {
-			 osDelay(1200);
-			 sprintf( Gprs_cmd_buf, "+++");		//quick close
-			 serial_cmmn( Gprs_cmd_buf, CMDBUF_LEN,700);
-			 pp = strstr((const char*)Gprs_cmd_buf,"OK");
-			 if( pp)
+			 if( cmd_lock() == ERR_OK)
 				 break;
-			 if( safeCount)
-				 safeCount --;
-			 else
-				 break;
-			 
-			 
-			 
 		 }
+		 if( safeCount == TRSP_ESC_FAIL_MAX)
+			 chn_lock();
 		sprintf( Gprs_cmd_buf, "AT+CIPCLOSE\x00D\x00A");		//quick close
 		SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,100);
 		Ip_cnnState.cnn_state[ 0] = CNNT_DISCONNECT;
+		TrspMode_link( &Trsp, 0);
+		chn_unlock();
 	 }
 	 return ERR_OK;
  }
  
- int tcpip_cnnt( gprs_t *self, int cnnt_num,char *prtl, char *addr, int portnum)
- {
-	short step = 0;
+//ĵAT+CDNSGIP֪ͨ+CDNSGIP: 1,"","IP1"[,"IP2"]  +CDNSGIP: 0,
+#define DNS_WAIT_MS			10000		//ȴ+CDNSGIPʱ
+#define DNS_ERR_MAX			3			//AT+CDNSGIPERRORôΣΪģ鲻֧
+static struct {
+	uint8_t			bad;				//ģ鲻֧AT+CDNSGIPģӵʱԼ
+	uint8_t			errs;				//AT+CDNSGIPERRORĴ
+	uint32_t		err_s;				//һηERRORʱ
+	volatile int8_t	result;				//1ɹ-1ʧܣ0ʾûյ
+	const char		*host;				//ڽĽҪ
+	char			ip[DNS_IP_LEN];
+}Dnsq;
+static char Dns_ip[DNS_IP_LEN];
+static char Dns_cmd_buf[IP_ADDR_LEN + 20];
+static const char *Dns_link[IPMUX_NUM];		//·õûûNULL
+
+static void dns_urc( char *pp)
+{
+	char	*q;
+	int		n;
+	
+	if( Dnsq.host == NULL || Dnsq.result)
+		return;
+	if( *pp != '1')
+	{
+		Dnsq.result = -1;
+		return;
+	}
+	pp = strchr( pp, '"');
+	n = strlen( Dnsq.host);
+	if( pp == NULL || strncmp( pp + 1, Dnsq.host, n) || pp[ n + 1] != '"')
+		return;
+	pp = strchr( pp + n + 2, '"');
+	if( pp == NULL || ( q = strchr( ++ pp, '"')) == NULL || q - pp >= DNS_IP_LEN)
+		return;
+	memcpy( Dnsq.ip, pp, q - pp);
+	Dnsq.ip[ q - pp] = '\0';
+	Dnsq.result = Dns_is_ip( Dnsq.ip) ? 1 : -1;
+}
+
+//AT+CDNSGIPģӵʱԼ
+//ERROR֮dns_neg_sҲã
+static int dns_off( void)
+{
+	if( Dnsq.bad)
+		return 1;
+	return Dnsq.errs && get_time_s() - Dnsq.err_s < Dtu_config.dns_neg_s;
+}
+
+//һǵDNS_WAIT_MS
+//ERRORʱ򷵻ERR_UNINITIALIZEDģԼ
+static int dns_query( const char *host)
+{
+	char	*pp;
+	int		wait;
+	
+	if( strlen( host) >= IP_ADDR_LEN)
+		return ERR_BAD_PARAMETER;
+	Dnsq.result = 0;
+	Dnsq.host = host;
+	sprintf( Dns_cmd_buf, "AT+CDNSGIP=\"%s\"\x00D\x00A", host);
+	SerilTxandRx( Dns_cmd_buf, sizeof( Dns_cmd_buf), 10);
+	if( strstr( Dns_cmd_buf, "ERROR"))
+	{
+		//PDPûʱҲ᷵ERRORȷ˵ֻ֧ζŲʹ
+		Dnsq.host = NULL;
+		Dnsq.err_s = get_time_s();
+		if( Dnsq.errs < DNS_ERR_MAX)
+			Dnsq.errs ++;
+		pp = strstr( Dns_cmd_buf, "+CME ERROR: ");
+		if( ( pp && atoi( pp + 12) == 4) || strstr( Dns_cmd_buf, "not supported") || Dnsq.errs >= DNS_ERR_MAX)
+		{
+			DPRINTF("[DNS] not support CDNSGIP, resolve by CIPSTART \n");
+			Dnsq.bad = 1;
+		}
+		else
+			DPRINTF("[DNS] CDNSGIP error %d, retry after %d s \n", Dnsq.errs, Dtu_config.dns_neg_s);
+		return ERR_UNINITIALIZED;
+	}
+	Dnsq.errs = 0;
+	//ܺOKͬһ֡
+	pp = strstr( Dns_cmd_buf, "+CDNSGIP: ");
+	if( pp)
+		dns_urc( pp + 10);
+	for( wait = 0; Dnsq.result == 0 && wait < DNS_WAIT_MS; wait += 100)
+		osDelay( 100);
+	Dnsq.host = NULL;
+	if( Dnsq.result != 1)
+	{
+		Dns_failed( host, get_time_s());
+		DPRINTF("[DNS] %s fail \n", host);
+		return ERR_FAIL;
+	}
+	Dns_resolved( host, Dnsq.ip, get_time_s());
+	DPRINTF("[DNS] %s -> %s \n", host, Dnsq.ip);
+	return ERR_OK;
+}
+
+//ĵɻIPûеʱȽ
+//NULLʾսʧܹβ
+static char *center_addr( int link, char *host)
+{
+	int		ret;
+	
+	Dns_link[ link] = NULL;
+	if( Dtu_config.dns_ttl_s == 0 || dns_off() || Dns_is_ip( host))
+		return host;
+	ret = Dns_lookup( host, get_time_s(), Dns_ip);
+	if( ret == DNS_MISS)
+	{
+		if( dns_query( host) == ERR_UNINITIALIZED)
+			return host;
+		ret = Dns_lookup( host, get_time_s(), Dns_ip);
+	}
+	if( ret == DNS_NEG)
+		return NULL;
+	//̫ʱûм¼ģԼ
+	if( ret == DNS_MISS)
+		return host;
+	Dns_link[ link] = host;
+	return Dns_ip;
+}
+
+//ûIPʧˣ´֮ǰ½
+static void dns_link_fail( int link)
+{
+	if( Dns_link[ link] == NULL)
+		return;
+	Dns_suspect( Dns_link[ link]);
+	Dns_link[ link] = NULL;
+}
+
+ /**
+ * @brief 첽.
+ *
+ * @details ֻAT+CIPSTARTȴӽ
+ *			ӽread_event"n, CONNECT OK"/"n, CONNECT FAIL"¼
+ *			ͨdeal_tcpcnnt_eventȡ·ģʽ¿ͬʱķӡ
+ * 
+ * @param[in]	self.
+ * @param[in]	cnnt_num.  
+ * @param[in]	addr. 
+ * @param[in]	portnum. 
+ * @retval	ERR_OK Ѿ
+ * @retval	ERR_DEV_SICK ģδƶ޷
+ * @retval	ERR_DEV_BUSY ڽ
+ * @retval	ERR_BAD_PARAMETER ӺųΧ
+ * @retval	ERR_ADDR_ERROR ģ鲻ַ
+ * @retval	ERR_RES_UNAVAILABLE ĵսʧܹ
+ */
+int tcpip_cnnt_start( gprs_t *self, int cnnt_num, char *prtl, char *addr, int portnum)
+{
 	short	retry = RETRY_TIMES;
-	int ret = 0;
 	char *pp = NULL;
 
-	//Ϊ׼ã˵û
-	if( dsys.gprs.flag_ready < 2)	//ȵSMS CALL˲
+	//ֻҪע˾ͿõSMS Ready
+	if( reg_done( dsys.gprs.status_gsm) == 0 && reg_done( dsys.gprs.status_gprs) == 0)
 		return ERR_DEV_SICK; 
-	if( cnnt_num > IPMUX_NUM)
+	if( cnnt_num >= IPMUX_NUM)
 		return ERR_BAD_PARAMETER;
 	if( portnum <= 0)
 		return ERR_BAD_PARAMETER;
+	if( dsys.gprs.cip_mux == 0)
+		cnnt_num = 0;
+	if( Ip_cnnState.cnn_state[ cnnt_num] == CNNT_CONNECTING)
+		return ERR_DEV_BUSY;
 	
-	while(1)
+	while( 1)
 	{
 		if(dsys.gprs.cur_state == SHUTDOWN)
 		{
 			//17-12-17 ʹԵʱйػ
 			return ERR_DEV_SICK;  
 		}
-		switch( step)
+		//ѾĻֱӷ
+		if( prepare_ip( self) == ERR_OK)
+			break;
+		if( retry == 0)
 		{
-			case 0:
-				ret = prepare_ip( self);
-				if( ret != ERR_OK)
-				{
-					if(retry)
-					{
-						retry --;
-					}
-					else
-					{
-						dsys.gprs.cur_state = TCP_IP_ERROR;
-						return ERR_DEV_SICK;
-					}
-				}
-				else
-					step += 3;			//170720 ֱӣ
-				break;
-			case 1:		//ȹر
-				if( dsys.gprs.cip_mux)
-					sprintf( Gprs_cmd_buf, "AT+CIPSTATUS=%d\x00D\x00A", cnnt_num);
-				else
-				{
-					cnnt_num = 0;
-					sprintf( Gprs_cmd_buf, "AT+CIPSTATUS\x00D\x00A");
-				}
-				
-				//170719
-				//͸ģʽҪ˳ģʽ
-//				if( SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10) == 0)
-//				{
-//					if( dsys.gprs.cip_mode == CIPMODE_TRSP)
-//					{
-////						SystemShutdown();
-////						self->tcpClose( self, 0);
-//					}
-//						
-//					break;
-//				}
-				//CONNECTING or CONNECTED
-				//ڵ·ģʽ£ǰõ޷ӾͻʹCONNECTING״̬
-				pp = strstr((const char*)Gprs_cmd_buf,"CONNECT");	
-				if( pp)
-				{
-					step ++;
-					break;
-				}
-				pp = strstr((const char*)Gprs_cmd_buf,"ERROR");	
-				if( pp)
-				{
-					dsys.gprs.cur_state = GPRSERROR;
-					strcpy( Gprs_cmd_buf, "AT+CIPSHUT\x00D\x00A" );		//Deactivate GPRS PDP context
-					serial_cmmn( Gprs_cmd_buf, CMDBUF_LEN,1);
-					ret = ERR_FAIL;
-					goto cntFailed;
-				}
-				step += 2;
-				break;
-			case 2:
-				if( dsys.gprs.cip_mux)
-					sprintf( Gprs_cmd_buf, "AT+CIPCLOSE=%d\x00D\x00A", cnnt_num);
-				else
-					sprintf( Gprs_cmd_buf, "AT+CIPCLOSE\x00D\x00A");					
-				SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,20);
-//				pp = strstr((const char*)Gprs_cmd_buf,"OK");	
-//				if( pp)
-//					step ++;
-//				pp = strstr((const char*)Gprs_cmd_buf,"ERROR");	
-//				if( pp)
-					step ++;
-				break;
-			case 3:
-				if( dsys.gprs.cip_mux)
-					sprintf( Gprs_cmd_buf, "AT+CIPSTART=%d,\"%s\",\"%s\",\"%d\"\x00D\x00A", cnnt_num, prtl, addr, portnum);
-				else
-					sprintf( Gprs_cmd_buf, "AT+CIPSTART=\"%s\",\"%s\",\"%d\"\x00D\x00A", prtl, addr, portnum);
-				DPRINTF("  %s ", Gprs_cmd_buf);
-
-				
-				
-				UART_SEND( Gprs_cmd_buf, strlen( Gprs_cmd_buf));
-				
-				//ĵַȷʱGPRSỨܳʱܷش
-				retry = 90;
-				step++;
-				break;
-			case 4:
-				memset( Gprs_cmd_buf, 0, CMDBUF_LEN);
-				ret = UART_RECV( Gprs_cmd_buf, CMDBUF_LEN);
-				if( ret > 0)
-				{
-					pp = strstr((const char*)Gprs_cmd_buf,"ERROR");	
-					if( pp)
-					{
-						
-						dsys.gprs.cur_state = TCP_IP_ERROR;
-						ret = ERR_ADDR_ERROR;
-						goto cntFailed;
-//						return ERR_ADDR_ERROR;
-					}
-					pp = strstr((const char*)Gprs_cmd_buf,"CONNECT FAIL");
-					if( pp)
-					{	//˵ַȷʱظҵȴʱܳ
-						ret = ERR_ADDR_ERROR;
-						goto cntFailed;
-//						return ERR_BAD_PARAMETER;
-					}
-					
-					if( dsys.gprs.cip_mode)
-					{
-						//͸ģʽµĳɹزOK
-						pp = strstr((const char*)Gprs_cmd_buf,"CONNECT");	
-						if( pp)
-						{
-							Ip_cnnState.cnn_state[ cnnt_num] = CNNT_ESTABLISHED;
-							ret = ERR_OK;
-							osDelay(1000);
-							goto exit;
-//							osDelay(1000);
-//							return ERR_OK;
-						}
-						
-					}
-					else
-					{
-						pp = strstr((const char*)Gprs_cmd_buf,"CONNECT OK");	
-						if( pp)
-						{
-							Ip_cnnState.cnn_state[ cnnt_num] = CNNT_ESTABLISHED;
-							ret = ERR_OK;
-							osDelay(1000);
-							goto exit;
-						}
-						
-						
-					}
-					
-					//ر
-					//ػʱҲ
-					pp = strstr((const char*)Gprs_cmd_buf,"CLOSED");
-					if( pp)
-					{	
-						
-						ret = ERR_BAD_PARAMETER;
-						goto cntFailed;
-//						return ERR_BAD_PARAMETER;
-					}
-					
-				
-				}
-				retry --;
-				if( retry == 0)
-				{
-					if( dsys.gprs.cip_mux)
-						sprintf( Gprs_cmd_buf, "AT+CIPCLOSE=%d\x00D\x00A", cnnt_num);
-					else
-						sprintf( Gprs_cmd_buf, "AT+CIPCLOSE\x00D\x00A");
-					
-//					sprintf( Gprs_cmd_buf, "AT+CIPCLOSE\x00D\x00A");		//quick close
-					SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,20);
-//					self->tcpClose( self, cnnt_num);
-					ret = ERR_DEV_TIMEOUT;
-					goto cntFailed;
-//					return ERR_DEV_TIMEOUT;
-				}
-				
-				break;
-			default:
-				break;
+			dsys.gprs.cur_state = TCP_IP_ERROR;
+			return ERR_DEV_SICK;
 		}
-		osDelay(1000);		//sundh 170720
+		retry --;
+		osDelay(1000);
+	}
+	addr = center_addr( cnnt_num, addr);
+	if( addr == NULL)
+		return ERR_RES_UNAVAILABLE;
 	
-		
-	}	//while
-	//sundh 170720
-cntFailed:
+	//ϴβĽٱΪУ֮жϲŻ¼ӵĽ
+	dsys.gprs.set_tcp_cnnt = CLR_U8_BIT(dsys.gprs.set_tcp_cnnt, cnnt_num);
+	dsys.gprs.set_tcp_cnntfail = CLR_U8_BIT(dsys.gprs.set_tcp_cnntfail, cnnt_num);
+	Ip_cnnState.cnn_start_s[ cnnt_num] = get_time_s();
+	Ip_cnnState.udp[ cnnt_num] = strcmp( prtl, "UDP") == 0;
+	Ip_cnnState.cnn_state[ cnnt_num] = CNNT_CONNECTING;
+	
+	if( dsys.gprs.cip_mux)
+		sprintf( Gprs_cmd_buf, "AT+CIPSTART=%d,\"%s\",\"%s\",\"%d\"\x00D\x00A", cnnt_num, prtl, addr, portnum);
+	else
+		sprintf( Gprs_cmd_buf, "AT+CIPSTART=\"%s\",\"%s\",\"%d\"\x00D\x00A", prtl, addr, portnum);
+	DPRINTF("  %s ", Gprs_cmd_buf);
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	
+	//ѾϵģжѾ¼ӳɹ
+	pp = strstr((const char*)Gprs_cmd_buf,"ALREADY CONNECT");
+	if( pp)
+		return ERR_OK;
+	pp = strstr((const char*)Gprs_cmd_buf,"ERROR");	
+	if( pp)
+	{
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
+		dsys.gprs.cur_state = TCP_IP_ERROR;
+		dns_link_fail( cnnt_num);
+		return ERR_ADDR_ERROR;
+	}
+	
+	return ERR_OK;
+}
+
+//һڽǷн
+//1ʾнresult
+static int check_cnnt_result( int cnnt_num, int *result)
+{
+	if( Ip_cnnState.cnn_state[ cnnt_num] != CNNT_CONNECTING)
+		return 0;
+	
+	if( CHK_U8_BIT(dsys.gprs.set_tcp_cnnt, cnnt_num))
+	{
+		dsys.gprs.set_tcp_cnnt = CLR_U8_BIT(dsys.gprs.set_tcp_cnnt, cnnt_num);
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_ESTABLISHED;
+		Ip_cnnState.send_fail[ cnnt_num] = 0;
+		Rxget.pending[ cnnt_num] = 0;
+		Rxget.notify = CLR_U8_BIT( Rxget.notify, cnnt_num);
+		TxWin.unacked[ cnnt_num] = 0;
+		TxWin.stall_start[ cnnt_num] = 0;
+		TxWin.sent[ cnnt_num] = 0;
+		TxWin.acked[ cnnt_num] = 0;
+		RouteProbe.start_ms[ cnnt_num] = 0;
+		Route_link_up( cnnt_num, get_time_s());
+#if RUDP_ENABLE
+		Rudp_init( &Rudp[ cnnt_num], Rudp_buf[ cnnt_num]);
+#endif
+		Ip_cnnState.hold[ cnnt_num] = 1;
+		boot_link_up();
+		*result = ERR_OK;
+		return 1;
+	}
+	if( CHK_U8_BIT(dsys.gprs.set_tcp_cnntfail, cnnt_num))
+	{	//˵ַȷʱظ
+		dsys.gprs.set_tcp_cnntfail = CLR_U8_BIT(dsys.gprs.set_tcp_cnntfail, cnnt_num);
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
+		//õǻIPĻ˵ַ½֮жϵַǲǴ
+		*result = Dns_link[ cnnt_num] ? ERR_FAIL : ERR_ADDR_ERROR;
+		dns_link_fail( cnnt_num);
+		return 1;
+	}
+	//ӹзر
+	//ػʱҲ
+	if( CHK_U8_BIT(dsys.gprs.set_tcp_close, cnnt_num))
+	{
+		dsys.gprs.set_tcp_close = CLR_U8_BIT(dsys.gprs.set_tcp_close, cnnt_num);
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
+		*result = ERR_BAD_PARAMETER;
+		return 1;
+	}
+	if(dsys.gprs.cur_state == SHUTDOWN)
+	{
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
+		*result = ERR_DEV_SICK;
+		return 1;
+	}
+	//ĵַȷʱGPRSỨܳʱܷش
+	if( get_time_s() - Ip_cnnState.cnn_start_s[ cnnt_num] > CNNT_TIMEOUT_S)
+	{
+		if( dsys.gprs.cip_mux)
+			sprintf( Gprs_cmd_buf, "AT+CIPCLOSE=%d\x00D\x00A", cnnt_num);
+		else
+			sprintf( Gprs_cmd_buf, "AT+CIPCLOSE\x00D\x00A");
+		SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,20);
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
+		dns_link_fail( cnnt_num);
+		*result = ERR_DEV_TIMEOUT;
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+ * @brief ȡһѾн.
+ *
+ * @details tcpip_cnnt_startӣյӽӳʱģػ
+ *			ͨӿȡʱӻᱻرա
+ * 
+ * @param[in]	self.
+ * @param[out]	result. ERR_OK ӳɹERR_ADDR_ERROR ַ޷ӣ
+ *				ERR_DEV_TIMEOUT ӳʱERR_DEV_SICK ģػERR_BAD_PARAMETER رӣ
+ *				ERR_FAIL IP޷ӣ´ǰ½
+ * @retval	>=0 Ӻ
+ * @retval	ERR_FAIL ûӽ
+ */
+int Gprs_Event_tcpCnnt( gprs_t *self, int *result)
+{
+	int i;
+	for(i = 0; i < IPMUX_NUM; i++)
+	{
+		if( check_cnnt_result( i, result))
+			return i;
+	}
+	return ERR_FAIL;
+}
+
+/**
+ * @brief ָĵַӣȴӽ
+ *
+ * @details ʹӽ֪ͨжϣÿѯһδ.
+ * 
+ * @param[in]	self.
+ * @param[in]	cnnt_num.  
+ * @param[in]	addr. 
+ * @param[in]	portnum. 
+ * @retval	ERR_OK ӳɹ
+ * @retval	ERR_DEV_SICK ģ鲻ܹ
+ * @retval	ERR_BAD_PARAMETER ӺųΧ
+ * @retval	ERR_ADDR_ERROR ĵַ޷
+ * @retval	ERR_DEV_TIMEOUT ӳʱ
+ */
+ int tcpip_cnnt( gprs_t *self, int cnnt_num,char *prtl, char *addr, int portnum)
+ {
+	int ret = 0;
+	
+	if( dsys.gprs.cip_mux == 0)
+		cnnt_num = 0;
+	ret = tcpip_cnnt_start( self, cnnt_num, prtl, addr, portnum);
+	if( ret != ERR_OK)
+		return ret;
+	
+	while( check_cnnt_result( cnnt_num, &ret) == 0)
+		osDelay( CNNT_POLL_MS);
+	//ûעϿԷͶ
+	if( ret == ERR_OK)
+		Gprs_link_release( cnnt_num);
 	
 	if( ret == ERR_DEV_TIMEOUT)
 	{
@@ -1321,50 +2697,447 @@ cntFailed:
 			
 		}
 	}
-exit:
-		return ret;
+	return ret;
 		
  }
 
 
-#define TCPSENDBUF_LEN     256
-#define SENDBUF_NUM		2
-static short sendDataIdx[SENDBUF_NUM];
-//static char sending_cnnt_num = -1;
-static short sendBuf = -1;
-char  sendTcpdata[SENDBUF_NUM][TCPSENDBUF_LEN];
+//ݷͱ˸·ķͶУgprsrun
+//ǵߵߵģsendto_tcp_bufĵߣ485̣߳run
+//ÿ·ȼнͨУÿη͵ʱѡȼĿԷĶ
+//͹ֻռͨԲᱻŵȳʱĿƲ
+//·Ͽʱݴspool·ָȷԭеݣٰ˳spool
+
+
+static uint8_t EstablishedSet(void)
+{
+	uint8_t set = 0;
+	char j = 0;
+	
+	for( j = 0; j < IPMUX_NUM; j ++)
+	{
+		if( Ip_cnnState.cnn_state[ j] == CNNT_ESTABLISHED)
+			set = SET_U8_BIT( set, j);
+	}
+	return set;
+}
+
+uint8_t Gprs_established( void)
+{
+	return EstablishedSet();
+}
+
+//ӽĵһѾȥˣݿԷ
+void Gprs_link_release( int cnnt_num)
+{
+	if( cnnt_num >= IPMUX_NUM)
+		return;
+	Ip_cnnState.hold[ cnnt_num] = 0;
+	//ȴڼ۵ݾ췢ȥ
+	set_alarmclock_ms( ALARM_SENDTCPBUF, 10);
+}
+
+//spoolļ¼ϳһ֡Ѿӵ·
+static void SendSpoolData( uint8_t up)
+{
+	uint32_t	ts;
+	char j = 0;
+	int len = 0;
+	int num = 0;
+	int sent = 0;
+	
+	len = Spool_read( TcpTxFrame, TCPSENDBUF_LEN, &num, &ts);
+	if( len == 0 || Spool_rate_allow( len) == 0)
+		return;
+	//·յļ¼Ҫһ£һ·Ĵ˾Ͷһ
+	for( j = 0; j < IPMUX_NUM; j ++)
+	{
+		if( CHK_U8_BIT( up, j) && txwin_room( j, len) == 0)
+			return;
+	}
+	for( j = 0; j < IPMUX_NUM; j ++)
+	{
+		if( CHK_U8_BIT( up, j) == 0)
+			continue;
+		//ôʱʱڵʱ
+		if( upf_send( j, UPF_DATA, ts, TcpTxFrame, len) == ERR_OK)
+			sent = 1;
+		//͸ģʽֻһ
+		if( dsys.gprs.cip_mode == CIPMODE_TRSP)
+			break;
+	}
+	//ʧܵʱspool´ٷ
+	if( sent)
+		Spool_pop( num);
+}
+
+//+CIPACK: <txlen>,<acklen>,<nacklen>
+static int txwin_query( int link)
+{
+	char		*pp;
+	uint8_t		err = 0;
+	int			ret = ERR_FAIL;
+	
+	chn_lock();
+	if( dsys.gprs.cip_mux)
+		sprintf( Gprs_data_cmd, "AT+CIPACK=%d\x00D\x00A", link);
+	else
+		strcpy( Gprs_data_cmd, "AT+CIPACK\x00D\x00A");
+	SerilTxandRx( Gprs_data_cmd, CMDBUF_LEN, 10);
+	pp = strstr((const char*)Gprs_data_cmd,"+CIPACK");
+	if( pp)
+	{
+		TxWin.acked[ link] = Get_str_data( pp, ",", 1, &err);
+		if( err == 0)
+			TxWin.unacked[ link] = Get_str_data( pp, ",", 2, &err);
+		if( err == 0)
+			ret = ERR_OK;
+	}
+	chn_unlock();
+	return ret;
+}
+
+//ŵlenֽڵʱ򷵻1
+//ѯʧܵʱƣΪѯһֱ
+static int txwin_room( int link, int len)
+{
+	uint32_t	now;
+	
+#if RUDP_ENABLE
+	//ɿUDPһ֡ûȷ
+	if( rudp_on( link) && Rudp[ link].wait)
+		return 0;
+#endif
+	if( Dtu_config.ack_win == 0 || dsys.gprs.cip_mode == CIPMODE_TRSP || Ip_cnnState.udp[ link])
+		return 1;
+	now = get_time_ms();
+	if( TxWin.unacked[ link] && TxWin.unacked[ link] + len > Dtu_config.ack_win && \
+		now - TxWin.query_ms[ link] >= TXWIN_QUERY_MS)
+	{
+		TxWin.query_ms[ link] = now;
+		if( txwin_query( link) != ERR_OK)
+			TxWin.unacked[ link] = 0;
+	}
+	//һ֡ȴڻʱ򣬵ǰĶȷٷ
+	if( TxWin.unacked[ link] == 0 || TxWin.unacked[ link] + len <= Dtu_config.ack_win)
+	{
+		if( TxWin.stall_start[ link])
+		{
+			TxWin.stall_ms[ link] += now - TxWin.stall_start[ link];
+			TxWin.stall_start[ link] = 0;
+		}
+		return 1;
+	}
+	if( TxWin.stall_start[ link] == 0)
+		TxWin.stall_start[ link] = now ? now : 1;
+	return 0;
+}
+
+int Gprs_get_txwin( int cnnt_num, uint32_t *unacked, uint32_t *stall_ms)
+{
+	if( cnnt_num >= IPMUX_NUM)
+		return ERR_BAD_PARAMETER;
+	*unacked = TxWin.unacked[ cnnt_num];
+	*stall_ms = TxWin.stall_ms[ cnnt_num];
+	if( TxWin.stall_start[ cnnt_num])
+		*stall_ms += get_time_ms() - TxWin.stall_start[ cnnt_num];
+	return ERR_OK;
+}
+
+static int rudp_on( int link)
+{
+#if RUDP_ENABLE
+	return CHK_U8_BIT( Rudp_links, link) && Ip_cnnState.udp[ link] && dsys.gprs.cip_mode != CIPMODE_TRSP;
+#else
+	return 0;
+#endif
+}
+
+//ڽ֮ǰãֻUDP·
+void Gprs_rudp_set( int cnnt_num, int on)
+{
+#if RUDP_ENABLE
+	if( cnnt_num >= IPMUX_NUM)
+		return;
+	if( on && Rudp_buf[ cnnt_num] == NULL)
+		Rudp_buf[ cnnt_num] = malloc( RUDP_HEAD_LEN + RUDP_DATA_MAX);
+	//䲻ʱͨUDP
+	if( on && Rudp_buf[ cnnt_num])
+		Rudp_links = SET_U8_BIT( Rudp_links, cnnt_num);
+	else
+		Rudp_links = CLR_U8_BIT( Rudp_links, cnnt_num);
+#endif
+}
+
+int Gprs_link_udp( int cnnt_num)
+{
+	if( cnnt_num >= IPMUX_NUM)
+		return 0;
+	return Ip_cnnState.udp[ cnnt_num];
+}
+
+//ûÿɿ·NULL
+rudp_t *Gprs_get_rudp( int cnnt_num)
+{
+#if RUDP_ENABLE
+	if( cnnt_num >= IPMUX_NUM || rudp_on( cnnt_num) == 0)
+		return NULL;
+	return &Rudp[ cnnt_num];
+#else
+	return NULL;
+#endif
+}
+
+static int cipsend( gprs_t *self, int cnnt_num, char *data, int len);
+static void route_probe_start( int link);
+
+//ظȷϣʱ֡ط
+static void rudp_run( void)
+{
+#if RUDP_ENABLE
+	gprs_t	*this_gprs = GprsGetInstance();
+	char	ack[ RUDP_HEAD_LEN];
+	int		j, n;
+	
+	for( j = 0; j < IPMUX_NUM; j ++)
+	{
+		if( rudp_on( j) == 0 || Ip_cnnState.cnn_state[ j] != CNNT_ESTABLISHED)
+			continue;
+		chn_lock();
+		n = Rudp_ack( &Rudp[ j], ack);
+		if( n > 0)
+			cipsend( this_gprs, j, ack, n);
+		n = Rudp_poll( &Rudp[ j], get_time_ms());
+		if( n > 0)
+			cipsend( this_gprs, j, Rudp[ j].tx_buf, n);
+		else if( n < 0)
+		{
+			DPRINTF("[RUDP] link %d give up seq %d \n", j, ( uint8_t)( Rudp[ j].tx_seq - 1));
+			Route_stall( j);
+		}
+		chn_unlock();
+	}
+#endif
+}
+
+//UDP·rudpжûбȷϣ͸ģʽ²ܲѯ
+static void route_probe_start( int link)
+{
+	if( Route_mode() == ROUTE_ALL || RouteProbe.start_ms[ link] || Ip_cnnState.udp[ link] || \
+		dsys.gprs.cip_mode == CIPMODE_TRSP)
+		return;
+	RouteProbe.target[ link] = TxWin.sent[ link];
+	RouteProbe.start_ms[ link] = get_time_ms();
+	RouteProbe.poll_ms[ link] = RouteProbe.start_ms[ link];
+}
+
+//ѯڲ·ȷ˾ͼ¼RTTʱΪĲ
+static void route_run( void)
+{
+	uint32_t	now = get_time_ms();
+	int			j;
+	
+	for( j = 0; j < IPMUX_NUM; j ++)
+	{
+		if( RouteProbe.start_ms[ j] == 0)
+			continue;
+		if( Ip_cnnState.cnn_state[ j] != CNNT_ESTABLISHED)
+		{
+			RouteProbe.start_ms[ j] = 0;
+			continue;
+		}
+		if( now - RouteProbe.poll_ms[ j] < ROUTE_RTT_POLL_MS)
+			continue;
+		RouteProbe.poll_ms[ j] = now;
+		if( txwin_query( j) == ERR_OK && TxWin.acked[ j] >= RouteProbe.target[ j])
+		{
+			Route_rtt( j, now - RouteProbe.start_ms[ j], get_time_s());
+			RouteProbe.start_ms[ j] = 0;
+		}
+		else if( now - RouteProbe.start_ms[ j] >= ROUTE_STALL_MS)
+		{
+			DPRINTF("[ROUTE] link %d not acked in %d ms \n", j, ROUTE_STALL_MS);
+			Route_stall( j);
+			RouteProbe.start_ms[ j] = 0;
+		}
+	}
+}
+
+static sByteFifo *uplink_fifo( int prio, int link)
+{
+	if( prio == UPLINK_URGENT)
+		return &TcpUrgFifo[ link];
+	if( prio == UPLINK_BULK)
+		return &TcpBulkFifo[ link];
+	return &TcpTxFifo[ link];
+}
+
+//¼ݵȴʱ
+static void uplink_lat_add( int prio, int link)
+{
+	uplink_lat_t	*lat = &Uplink.lat[ prio];
+	uint32_t		ms = get_time_ms() - Uplink.since_ms[ prio][ link];
+	int				b = 0;
+	
+	lat->sends ++;
+	if( ms > lat->max_ms)
+		lat->max_ms = ms;
+	while( b < UPLINK_LAT_BUCKETS - 1 && ( ms >> ( b + 5)))
+		b ++;
+	lat->hist[ b] ++;
+}
+
+//ʱİٷλڸӵޣֵ
+uint32_t Uplink_lat_pct( uplink_lat_t *lat, int pct)
+{
+	uint32_t	total = 0;
+	uint32_t	n = 0;
+	int			b;
+	
+	for( b = 0; b < UPLINK_LAT_BUCKETS; b ++)
+		total += lat->hist[ b];
+	if( total == 0)
+		return 0;
+	for( b = 0; b < UPLINK_LAT_BUCKETS - 1; b ++)
+	{
+		n += lat->hist[ b];
+		if( n * 100 >= total * pct)
+			break;
+	}
+	if( b < UPLINK_LAT_BUCKETS - 1 && ( 32u << b) < lat->max_ms)
+		return 32u << b;
+	return lat->max_ms;
+}
+
+//һGprs_send_prioЩ·ֻɵGprs_send_prio߳ʹ
+uint8_t Gprs_last_route( void)
+{
+	return Uplink.last_to;
+}
+
+uplink_lat_t *Gprs_get_uplink_lat( int prio)
+{
+	if( prio >= UPLINK_CLASS_NUM)
+		return NULL;
+	return &Uplink.lat[ prio];
+}
+
+//У׼ʱ䲢ö֡ʱÿ֡ݵʱ䣬ͨݿԶһٺϲ
+static uint32_t uplink_wait_ms( void)
+{
+	if( Dtu_config.batch_s && Dtu_config.upf_on && MqttClient_on() == 0 && Wclock_synced())
+		return Dtu_config.batch_s * 1000;
+	return TCPSEND_WAIT_MS;
+}
+
+//ϲݷʱΪʱ
+static uint32_t uplink_ts( int prio, int link)
+{
+	return Wclock_stamp_s( get_tick_ms64() - ( get_time_ms() - Uplink.since_ms[ prio][ link]));
+}
 
+//ǲǿԷ
+//͸ģʽģԼõ
+//spoolݵʱ򣬶ǸݣϷȥ
+static int uplink_due( int prio, int link, int len, char timeout)
+{
+	if( len == 0)
+		return 0;
+	if( prio == UPLINK_URGENT || len >= TCPSEND_THRESHOLD || dsys.gprs.cip_mode == CIPMODE_TRSP || Spool_count())
+		return 1;
+	//ֻһΣȼĶռõʱ򰴷ʱж
+	if( prio == UPLINK_NORMAL)
+		return timeout || get_time_ms() - Uplink.since_ms[ prio][ link] >= uplink_wait_ms();
+	return get_time_ms() - Uplink.since_ms[ prio][ link] >= UPLINK_BULK_MS;
+}
 
 static void SendBufData(void)
 {
-	gprs_t	*this_gprs = GprsGetInstance();
-	char i = 0, j = 0;
+	sByteFifo	*q;
+	uint32_t	ts;
+	char j = 0;
+	char prio = 0;
 	char timeout = 0;
-	char needclean = 0;		//̫ʱ
-
-	
+	uint8_t saved = 0;
+	int len = 0;
+	uint8_t up = EstablishedSet();
+	uint8_t ready = up;
+	uint8_t usable = Route_usable( up);
 
-	this_gprs->lock( this_gprs);
+	for( j = 0; j < IPMUX_NUM; j ++)
+	{
+		if( Ip_cnnState.hold[ j])
+			ready = CLR_U8_BIT( ready, j);
+	}
 	if( Ringing( ALARM_SENDTCPBUF) == ERR_OK)
 		timeout = 1;
 
-	for( i = 0; i < SENDBUF_NUM; i++)
+	for( j = 0; j < IPMUX_NUM; j ++)
 	{
-		if( TCPSENDBUF_LEN - sendDataIdx[ i] < 50)
-			needclean = 1;
-		if( ( timeout + needclean) == 0)
+		if( up == 0)
+		{
+			//·Ͽˣݴspool
+			//ĵʱ·Ķͬʱдͬݣÿȼֻһ
+			for( prio = 0; prio < UPLINK_CLASS_NUM; prio ++)
+			{
+				q = uplink_fifo( prio, j);
+				if( BFLengthData( q) == 0)
+					continue;
+				ts = uplink_ts( prio, j);
+				len = BFRead( q, TcpTxFrame, TCPSENDBUF_LEN);
+				if( CHK_U8_BIT( saved, prio) == 0 && Spool_put( TcpTxFrame, len, ts) == ERR_OK && \
+					Route_mode() == ROUTE_ALL)
+					saved = SET_U8_BIT( saved, prio);
+			}
+			continue;
+		}
+		//л֮ڲõĵĶݾspoolµ
+		//ûspoolʱԭĶĻָ
+		if( Route_mode() != ROUTE_ALL && CHK_U8_BIT( usable, j) == 0 && Spool_on())
+		{
+			for( prio = 0; prio < UPLINK_CLASS_NUM; prio ++)
+			{
+				q = uplink_fifo( prio, j);
+				if( BFLengthData( q))
+				{
+					ts = uplink_ts( prio, j);
+					len = BFRead( q, TcpTxFrame, TCPSENDBUF_LEN);
+					Spool_put( TcpTxFrame, len, ts);
+				}
+			}
+			continue;
+		}
+		if( CHK_U8_BIT( ready, j) == 0)
 			continue;
-		sendBuf = i;
-		for( j = 0; j < IPMUX_NUM; j ++)
-			this_gprs->sendto_tcp( this_gprs, j, sendTcpdata[ i], sendDataIdx[ i]);
-		memset( sendTcpdata[ i], 0 , TCPSENDBUF_LEN);
-		needclean = 0;
-		sendDataIdx[ i]= 0;
+		//ͨݻڵȺϲʱ򣬴ݿȷ
+		for( prio = 0; prio < UPLINK_CLASS_NUM; prio ++)
+		{
+			q = uplink_fifo( prio, j);
+			len = BFLengthData( q);
+			if( uplink_due( prio, j, len, timeout))
+				break;
+		}
+		if( prio == UPLINK_CLASS_NUM)
+			continue;
+		//ڶ֮sendto_tcp_buf᷵ʧܣݵԴ
+		if( txwin_room( j, len > TCPSENDBUF_LEN ? TCPSENDBUF_LEN : len) == 0)
+			continue;
+		ts = uplink_ts( prio, j);
+		len = BFRead( q, TcpTxFrame, TCPSENDBUF_LEN);
+		if( upf_send( j, UPF_DATA, ts, TcpTxFrame, len) == ERR_OK)
+			uplink_lat_add( prio, j);
+		//ʣµݴڿʼʱ
+		if( BFLengthData( q))
+			Uplink.since_ms[ prio][ j] = get_time_ms();
 	}
-	sendBuf = -1;
-	this_gprs->unlock( this_gprs);
-
 	
+	if( ready && Spool_count())
+	{
+		//ѡеĻڵעȥʱȲ
+		ready &= Route_pick( up, get_time_s());
+		if( ready)
+			SendSpoolData( ready);
+	}
 }
  
 
@@ -1375,81 +3148,214 @@ void GprsRun( gprs_t *self)
 	
 	{
 		SendBufData();
+		rxget_run();
+		rudp_run();
+		route_run();
+		MqttClient_run();
+		Spool_run();
+		trsp_idle_resume();
+		radio_refresh( self);
 	}	
 	
 }	
-int sendto_tcp_buf( gprs_t *self, char *data, int len)
+//ֻһ߳е
+//ݷŲеʱͨݷ
+int Gprs_send_prio( char *data, int len, int prio)
 {
-	int wrbuf = 0;
+	sByteFifo	*q;
+	int ret = ERR_MEM_UNAVAILABLE;
+	char j = 0;
+	uint8_t	to;
 	
 	if( len == 0)
 		return ERR_OK;
+	if( len >= TCPSENDBUF_LEN || prio >= UPLINK_CLASS_NUM)
+		return ERR_BAD_PARAMETER;
+	if( prio == UPLINK_URGENT && len >= URGENTBUF_LEN)
+		prio = UPLINK_NORMAL;
+#if UPLINK_BULK_ENABLE == 0
+	if( prio == UPLINK_BULK)
+		prio = UPLINK_NORMAL;
+#endif
+
+	//·Ͽˣspoolﻹû꣬spoolԱ֤˳
+	//ݲspool
+	//ûspoolʱԭĴʽ
+	Uplink.last_to = 0;
+	if( EstablishedSet() == 0 || ( Spool_count() && prio != UPLINK_URGENT))
+	{
+		ret = Spool_put( data, len, Wclock_stamp_s( get_tick_ms64()));
+		if( ret != ERR_UNINITIALIZED)
+			return ret;
+		ret = ERR_MEM_UNAVAILABLE;
+	}
 
-	
-	if( dsys.gprs.cip_mode == CIPMODE_TRSP)
+	//·ɷʽѡģԭķʽŵ
+	to = Route_pick( EstablishedSet(), get_time_s());
+	for( j = 0; j < IPMUX_NUM; j ++)
 	{
-		if( UART_SEND( data, len) == ERR_DEV_TIMEOUT)
-			osDelay(1000);
-		else
-			osDelay(5);
-		return ERR_OK;
-		
+		if( CHK_U8_BIT( to, j) == 0)
+			continue;
+		q = uplink_fifo( prio, j);
+		if( BFLengthData( q) == 0)
+		{
+			Uplink.since_ms[ prio][ j] = get_time_ms();
+			//ͨдӿտʼʱ֤ȴ500msͷͣʱϲʱbatch_s
+			if( prio == UPLINK_NORMAL)
+				set_alarmclock_ms( ALARM_SENDTCPBUF, uplink_wait_ms());
+		}
+		if( BFWrite( q, data, len) == ERR_OK)
+		{
+			ret = ERR_OK;
+			Uplink.last_to = SET_U8_BIT( Uplink.last_to, j);
+		}
+		//͸ģʽֻһ
+		if( dsys.gprs.cip_mode == CIPMODE_TRSP)
+			break;
 	}
-//	for( i = 0; i < SENDBUF_NUM; i ++)
-//	{
-//		if( ( len + sendDataIdx[ 0] ) <  TCPSENDBUF_LEN)
-//			continue;
-//		memcpy( sendTcpdata[ i] + sendDataIdx[ i], data, len);
-//		sendDataIdx[ i] += len;
-//		set_alarmclock_ms( ALARM_SENDTCPBUF, 100);
-//		return ERR_OK;	
-//	}
+	if( ret != ERR_OK)
+		Uplink.lat[ prio].drop ++;
 	
-	if( sendBuf == 0)
-		wrbuf = 1;
+	return ret;	
+}
 
-	if( ( len + sendDataIdx[ wrbuf]) >  TCPSENDBUF_LEN)
-		return ERR_MEM_UNAVAILABLE;
-		
-	memcpy( sendTcpdata[ wrbuf]+ sendDataIdx[ wrbuf], data, len);
-	sendDataIdx[ wrbuf] += len;
-	set_alarmclock_ms( ALARM_SENDTCPBUF, 500);
-	return ERR_OK;	
+int sendto_tcp_buf( gprs_t *self, char *data, int len)
+{
+	return Gprs_send_prio( data, len, UPLINK_NORMAL);
+}
+
+/**
+ * @brief ö֡ʱٷֱͣӷ.
+ *
+ * @details MQTTııиʽٴ. յݲԭһsendto_tcp.
+ *			ʱУ׼UTCǿ.
+ */
+static int upf_send( int cnnt_num, int type, uint32_t ts, char *data, int len)
+{
+	gprs_t	*this_gprs = GprsGetInstance();
+	int		n;
+	int		ret;
+	
+	if( Dtu_config.upf_on == 0 || MqttClient_on() || len == 0)
+		return this_gprs->sendto_tcp( this_gprs, cnnt_num, data, len);
+	chn_lock();
+	n = Upf_pack( FrameBuf, FRAMEBUF_LEN, type, ts, data, len, Dtu_config.upf_lz);
+	if( n > 0)
+	{
+		UpfStat.raw += len;
+		UpfStat.out += n;
+		ret = this_gprs->sendto_tcp( this_gprs, cnnt_num, FrameBuf, n);
+	}
+	else
+	{
+		ret = n;
+	}
+	chn_unlock();
+	return ret;
+}
+
+int Gprs_send_typed( int cnnt_num, int type, char *data, int len)
+{
+	return upf_send( cnnt_num, type, Wclock_stamp_s( get_tick_ms64()), data, len);
+}
+
+//ȡ֡Ĺ棬ͬʱռͨGprs_frame_unlock
+char *Gprs_frame_lock( int *size)
+{
+	chn_lock();
+	*size = FRAMEBUF_LEN;
+	return FrameBuf;
+}
+
+void Gprs_frame_unlock( void)
+{
+	chn_unlock();
+}
+
+void Gprs_get_upf( uint32_t *raw, uint32_t *out)
+{
+	*raw = UpfStat.raw;
+	*out = UpfStat.out;
 }
 
  
 int sendto_tcp( gprs_t *self, int cnnt_num, char *data, int len)
 {
-	char *pp;
 	int 	ret = 0;
-	int retry = 10;
+	int wait;
 	
 	if( dsys.gprs.cip_mode == CIPMODE_TRSP)
 		cnnt_num = 0;
 	if( len == 0)
 		return ERR_OK;
-	if( cnnt_num > IPMUX_NUM)
+	if( cnnt_num >= IPMUX_NUM)
 		return ERR_BAD_PARAMETER;
 	if( Ip_cnnState.cnn_state[ cnnt_num] != CNNT_ESTABLISHED)
 		return ERR_UNINITIALIZED;
+	if( rudp_on( cnnt_num) && len > RUDP_DATA_MAX)
+		return ERR_BAD_PARAMETER;
+	//ȶԶȷ֮ǰٷ
+	for( wait = 0; ; wait += TXWIN_QUERY_MS)
+	{
+		if( txwin_room( cnnt_num, len))
+		{
+			chn_lock();
+			if( rudp_on( cnnt_num) == 0)
+				break;
+#if RUDP_ENABLE
+			//֮߳̿Ѿһ֡
+			ret = Rudp_pack( &Rudp[ cnnt_num], data, len, get_time_ms());
+			if( ret > 0)
+			{
+				data = Rudp[ cnnt_num].tx_buf;
+				len = ret;
+				break;
+			}
+#endif
+			chn_unlock();
+		}
+		if( wait >= TXWIN_WAIT_MS)
+			return ERR_DEV_BUSY;
+		osDelay( TXWIN_QUERY_MS);
+	}
+	ret = cipsend( self, cnnt_num, data, len);
+	chn_unlock();
+	return ret;
+}
+
+//ɿUDPѾˣطȷҲֱӴ﷢
+static int cipsend( gprs_t *self, int cnnt_num, char *data, int len)
+{
+	char *pp;
+	int 	ret = 0;
+	int retry = 10;
 	
+	data_lock();
 	if( dsys.gprs.cip_mode == CIPMODE_TRSP)
 	{
+		//ATOʧܣѾϿ
+		if( Ip_cnnState.cnn_state[ 0] != CNNT_ESTABLISHED)
+		{
+			ret = ERR_UNINITIALIZED;
+			goto sendExit;
+		}
 		if( UART_SEND( data, len) == ERR_DEV_TIMEOUT)
 			osDelay(1000);
+		Trsp_tx_ms = get_time_ms();
 //		else
 //			osDelay(1);
-		return ERR_OK;
+		ret = ERR_OK;
+		goto sendExit;
 		
 	}
 
 
 
 	if( dsys.gprs.cip_mux)
-		sprintf( Gprs_cmd_buf, "AT+CIPSEND=%d,%d\x00D\x00A", cnnt_num, len);
+		sprintf( Gprs_data_cmd, "AT+CIPSEND=%d,%d\x00D\x00A", cnnt_num, len);
 	else
-		sprintf( Gprs_cmd_buf, "AT+CIPSEND=%d\x00D\x00A", len);
-	ret = UART_SEND( Gprs_cmd_buf, strlen( Gprs_cmd_buf));
+		sprintf( Gprs_data_cmd, "AT+CIPSEND=%d\x00D\x00A", len);
+	ret = UART_SEND( Gprs_data_cmd, strlen( Gprs_data_cmd));
 	if( ret == ERR_DEV_TIMEOUT)
 		osDelay(100);
 	else
@@ -1460,26 +3366,34 @@ int sendto_tcp( gprs_t *self, int cnnt_num, char *data, int len)
 	while(1)
 	{
 		
-		UART_RECV( Gprs_cmd_buf, CMDBUF_LEN);
+		UART_RECV( Gprs_data_cmd, CMDBUF_LEN);
 		
-		pp = strstr((const char*)Gprs_cmd_buf,"OK");		
+		pp = strstr((const char*)Gprs_data_cmd,"OK");		
 		if( pp)
-			return ERR_OK;
-		pp = strstr((const char*)Gprs_cmd_buf,"FAIL");		
+		{
+			ret = ERR_OK;
+			break;
+		}
+		pp = strstr((const char*)Gprs_data_cmd,"FAIL");		
 		if( pp)
-			return ERR_FAIL;
-		pp = strstr((const char*)Gprs_cmd_buf,"ERROR");		
+		{
+			ret = ERR_FAIL;
+			break;
+		}
+		pp = strstr((const char*)Gprs_data_cmd,"ERROR");		
 		if( pp)
 		{
 			Ip_cnnState.cnn_state[ cnnt_num] = CNNT_SENDERROR;
-			return ERR_FAIL;
+			ret = ERR_FAIL;
+			break;
 		}
 		//ǵʱδʱӺ϶Ͽ
-		pp = strstr((const char*)Gprs_cmd_buf,"CLOS");		
+		pp = strstr((const char*)Gprs_data_cmd,"CLOS");		
 		if( pp)
 		{
 			Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
-			return ERR_UNINITIALIZED;
+			ret = ERR_UNINITIALIZED;
+			break;
 		}
 		retry --;
 		
@@ -1488,11 +3402,39 @@ int sendto_tcp( gprs_t *self, int cnnt_num, char *data, int len)
 		{
 //			Ip_cnnState.cnn_state[ cnnt_num] = CNNT_DISCONNECT;
 //			return ERR_UNINITIALIZED;
-			return ERR_OK;
+			ret = ERR_OK;
+			break;
 
 		}
 	}
 	
+	sendExit:
+	chn_unlock();
+	
+	Route_sent( cnnt_num, ret == ERR_OK);
+	if( ret == ERR_OK)
+	{
+		TxWin.unacked[ cnnt_num] += len;
+		TxWin.sent[ cnnt_num] += len;
+		route_probe_start( cnnt_num);
+		//ݷȥˣڲҪٷ
+		Ip_cnnState.send_fail[ cnnt_num] = 0;
+		set_alarmclock_s( ALARM_GPRSLINK( cnnt_num), Dtu_config.hartbeat_timespan_s);
+	}
+	else if( ret == ERR_FAIL && ( ++ Ip_cnnState.send_fail[ cnnt_num] >= SEND_FAIL_MAX || \
+			Ip_cnnState.cnn_state[ cnnt_num] == CNNT_SENDERROR))
+	{
+		//ԶѾˣģȴûз֣رղϱϿ¼ӹȥ
+		//tcpCloseֻرѾ
+		DPRINTF("[TCP] link %d send fail %d times, close \n", cnnt_num, Ip_cnnState.send_fail[ cnnt_num]);
+		Ip_cnnState.send_fail[ cnnt_num] = 0;
+		Ip_cnnState.cnn_state[ cnnt_num] = CNNT_ESTABLISHED;
+		self->tcpClose( self, cnnt_num);
+		dsys.gprs.set_tcp_close = SET_U8_BIT(dsys.gprs.set_tcp_close, cnnt_num);
+		Modem_post( MODEM_EV_CLOSE, cnnt_num);
+	}
+	return ret;
+	
 }
  /**
  * @brief gprs.
@@ -1572,107 +3514,392 @@ int	delete_contact( gprs_t *self, char *name)
 }
 	
 //ֵǶȡĶŵı
+//յ¶֪ͨռﻹûĶʱռȡһ
 int Gprs_Event_smsRecv( gprs_t *self, char *buf, int *lsize, char *phno)
 {
-	
 	int i;
 	int ret = 0;
-	for(i = 0; i < MAX_NUM_SMS; i++)
+	int notify = 0;
+	
+	for(i = 0; i < MAX_NUM_SMS / 32; i++)
+	{
+		if( dsys.gprs.set_sms_recv[i])
+			notify = 1;
+		dsys.gprs.set_sms_recv[i] = 0;
+	}
+	if( notify == 0 && inbox_empty() && SmsInbox.more == 0)
+		return ERR_FAIL;
+	
+	ret = self->read_phnNmbr_TextSMS( self, phno, buf, buf, lsize);
+	if( ret < 0)
+		return ERR_FAIL;
+	return ret;
+}
+
+	//+RECEIVE,0,6:\0D\0A
+	//123456
+//ԽնΪ׼set_tcp_recvֻ֪ͨ
+//һȡ*len - 1ֽڣݺ油0
+int Gprs_Event_tcpRecv( gprs_t *self, char *buf, int *len)
+{
+	static int next = 0;
+	int i, k;
+	int size = *len - 1;
+	
+	if( *len < 2)
+		return ERR_BAD_PARAMETER;
+	for(k = 0; k < IPMUX_NUM; k++)
 	{
-		if(check_bit((uint8_t *)dsys.gprs.set_sms_recv, i))
+		//ȡ·һ·Ĵռס
+		i = ( next + k) % IPMUX_NUM;
+		if( BFLengthData( &TcpRxFifo[i]) == 0)
+			continue;
+		//ɿUDPȥ֡ͷȷ֡ظ֡ûݽϲ
+		do
 		{
-			ret = self->read_seq_TextSMS( self, phno, i, buf, lsize);
-			if( ret == ERR_OK)
-				return i;
-			clear_bit((uint8_t *)dsys.gprs.set_sms_recv, i);
-			
+			*len = BFRead( &TcpRxFifo[i], buf, size);
+#if RUDP_ENABLE
+			if( rudp_on( i))
+			{
+				chn_lock();
+				*len = Rudp_input( &Rudp[i], buf, *len, buf);
+				chn_unlock();
+			}
+#endif
+		}while( *len == 0 && BFLengthData( &TcpRxFifo[i]));
+		if( BFLengthData( &TcpRxFifo[i]) == 0)
+			dsys.gprs.set_tcp_recv = CLR_U8_BIT(dsys.gprs.set_tcp_recv, i);
+		if( *len == 0)
+			continue;
+		buf[ *len] = '\0';
+		next = i + 1;
+		return i;
+		
+	}
+	dsys.gprs.set_tcp_recv = 0;
+
+//	gprs_event_t *this_event = (gprs_event_t *)event;
+//	*len = VecBuf_read( &g_TcpVbm, buf, *len);
+//	if( CKECK_EVENT( this_event, tcp_receive) )
+//	{
+//		return this_event->arg;	
+//	}
+	
+	return ERR_FAIL;
+}
+int Gprs_Event_tcpclose( gprs_t *self)
+{
+	int i;
+	for(i = 0; i < IPMUX_NUM; i++)
+	{
+		//ӹеĹرӹԼ
+		if( Ip_cnnState.cnn_state[i] == CNNT_CONNECTING)
+			continue;
+		if(CHK_U8_BIT(dsys.gprs.set_tcp_close, i))
+		{
+			dsys.gprs.set_tcp_close = CLR_U8_BIT(dsys.gprs.set_tcp_close, i);
+			Ip_cnnState.cnn_state[i] = CNNT_DISCONNECT;
+			return i;
 		}
 		
 	}
 	
 //	gprs_event_t *this_event = ( gprs_event_t *)event;
-//	int ret = 0;
-//	if( CKECK_EVENT( this_event, sms_urc) )
+//	if( CKECK_EVENT( this_event, tcp_close) )
 //	{
-//		ret = self->read_seq_TextSMS( self, phno, this_event->arg, buf, lsize);
-//		if( ret == ERR_OK)
-//			return this_event->arg;
+////		self->tcpClose( self, this_event->arg);
+//		Ip_cnnState.cnn_state[ this_event->arg] = CNNT_DISCONNECT;
 //		
+//		return this_event->arg;
 //	}
+	
 	return ERR_FAIL;
 }
 
-	//+RECEIVE,0,6:\0D\0A
-	//123456
-int Gprs_Event_tcpRecv( gprs_t *self, char *buf, int *len)
+
+
+//ӽ֪ͨ:
+//·ģʽ:	"0, CONNECT OK"  "0, CONNECT FAIL"  "0, ALREADY CONNECT"
+//·ģʽ:	"CONNECT OK"  "CONNECT FAIL"͸ģʽӳɹֻ"CONNECT"
+//ֻ¼е·Ƿ¼˽
+static int parse_cnnt_urc( char *buf)
+{
+	char *pp = buf;
+	char *head;
+	int n = 0;
+	int found = 0;
+	
+	//AT+CIPSTATUSĻظҲCONNECT OK
+	if( strstr((const char*)buf,"STATE:"))
+		return 0;
+	while( ( pp = strstr((const char*)pp,"CONNECT")) != NULL)
+	{
+		head = pp;
+		if( ( head - buf >= 8) && ( strncmp( head - 8, "ALREADY ", 8) == 0))
+			head -= 8;
+		n = 0;
+		if( dsys.gprs.cip_mux)
+		{
+			if( ( head - buf < 3) || ( head[-2] != ',') || ( head[-3] < '0') || ( head[-3] >= '0' + IPMUX_NUM))
+			{
+				pp += 7;
+				continue;
+			}
+			n = head[-3] - '0';
+		}
+		if( Ip_cnnState.cnn_state[ n] == CNNT_CONNECTING)
+		{
+			if( strncmp( pp, "CONNECT FAIL", 12) == 0)
+			{
+				dsys.gprs.set_tcp_cnntfail = SET_U8_BIT(dsys.gprs.set_tcp_cnntfail, n);
+				found = 1;
+			}
+			else if( ( head != pp) || ( strncmp( pp, "CONNECT OK", 10) == 0) || \
+				( ( dsys.gprs.cip_mode == CIPMODE_TRSP) && ( pp[7] == '\r')))
+			{
+				dsys.gprs.set_tcp_cnnt = SET_U8_BIT(dsys.gprs.set_tcp_cnnt, n);
+				found = 1;
+			}
+		}
+		pp += 7;
+	}
+	return found;
+}
+
+static int get_seq( char **data)
+{
+	//+CMTI:"SM",1
+	int tmp;
+	char *buf = *data;
+	tmp = strcspn( buf, "0123456789");	
+	*data += tmp;
+	return  atoi( buf + tmp);
+}
+
+//ڲ0βвַ
+static char *find_str( char *buf, int len, const char *s)
 {
+	int slen = strlen( s);
 	int i;
-	for(i = 0; i < IPMUX_NUM; i++)
+	
+	for( i = 0; i + slen <= len; i ++)
+	{
+		if( buf[i] == s[0] && memcmp( buf + i, s, slen) == 0)
+			return buf + i;
+	}
+	return NULL;
+}
+
+//headǰnַٽcһͷ
+static int rxhead_prefix( const char *head, int n, char c)
+{
+	int i, tlen;
+	
+	for( i = 0; i < RXHEAD_TAG_NUM; i ++)
+	{
+		tlen = strlen( Rxhead_tags[i]);
+		if( strncmp( head, Rxhead_tags[i], n < tlen ? n : tlen))
+			continue;
+		if( n >= tlen || Rxhead_tags[i][n] == c)
+			return 1;
+	}
+	return 0;
+}
+
+//ֵıͷûеĻ֡ĩβضϵıͷ
+static char *find_rxhead( char *p, int len)
+{
+	char *pp;
+	char *first = NULL;
+	int i, n;
+	
+	for( i = 0; i < RXHEAD_TAG_NUM; i ++)
 	{
-		if(CHK_U8_BIT(dsys.gprs.set_tcp_recv, i))
+		pp = find_str( p, len, Rxhead_tags[i]);
+		if( pp && ( first == NULL || pp < first))
+			first = pp;
+	}
+	if( first)
+		return first;
+	for( n = RXHEAD_TAG_MAX - 1; n > 0; n --)
+	{
+		if( n > len)
+			continue;
+		for( i = 0; i < RXHEAD_TAG_NUM; i ++)
 		{
-			*len = VecBuf_read( &g_TcpVbm, buf, *len);
-			dsys.gprs.set_tcp_recv = CLR_U8_BIT(dsys.gprs.set_tcp_recv, i);
-			return i;
+			if( n < strlen( Rxhead_tags[i]) && memcmp( p + len - n, Rxhead_tags[i], n) == 0)
+				return p + len - n;
+		}
+	}
+	return NULL;
+}
+
+//ݷ·ĽնУŲµĲֶ
+static void rx_deliver( int link, char *data, int len)
+{
+	int free_size;
+	
+	if( len <= 0)
+		return;
+	if( link < 0 || link >= IPMUX_NUM || TcpRxFifo[link].size == 0)
+		return;
+	free_size = BFFreeSize( &TcpRxFifo[link]);
+	if( len > free_size)
+	{
+		RxDemux.drop[ link] += len - free_size;
+		len = free_size;
+	}
+	if( len == 0)
+		return;
+	BFWrite( &TcpRxFifo[link], data, len);
+	dsys.gprs.set_tcp_recv = SET_U8_BIT(dsys.gprs.set_tcp_recv, link);
+	Modem_post( MODEM_EV_RECV, link);
+}
+
+//յ+RECEIVEĲ֣δıͷԼͷ
+//ش˵ֽ
+static int rx_demux( char *data, int len, void *arg)
+{
+	int used = 0;
+	int n;
+	char *pp;
+	
+	if( RxDemux.in_head)
+	{
+		while( used < len && RxDemux.head_len < RXHEAD_LEN - 1)
+		{
+			//һ֡ĩβ"+RECEI"ȿܲǱͷǵĻ֪ͨͨ
+			if( rxhead_prefix( RxDemux.head, RxDemux.head_len, data[ used]) == 0)
+			{
+				RxDemux.in_head = 0;
+				RxDemux.head[ RxDemux.head_len] = '\0';
+				parse_urc( RxDemux.head, arg, RxDemux.head_len);
+				return used;
+			}
+			RxDemux.head[ RxDemux.head_len ++] = data[ used ++];
+			if( RxDemux.head[ RxDemux.head_len - 1] == '\n')
+				break;
+		}
+		if( RxDemux.head_len == 0 || RxDemux.head[ RxDemux.head_len - 1] != '\n')
+		{
+			//ͷ̫϶Ǵģ
+			if( RxDemux.head_len >= RXHEAD_LEN - 1)
+				RxDemux.in_head = 0;
+			return used;
+		}
+		RxDemux.head[ RxDemux.head_len] = '\0';
+		RxDemux.in_head = 0;
+		pp = RxDemux.head;
+		RxDemux.pull = RxDemux.head[1] == 'C';
+		if( RxDemux.pull)
+		{
+			//+CIPRXGET: 2,0,6,0\r\n  ·ʱû·ţ+CIPRXGET: 2,6,0\r\n
+			pp += RXHEAD_TAG_MAX;
+			RxDemux.link = 0;
+			if( dsys.gprs.cip_mux)
+			{
+				RxDemux.link = get_seq( &pp);
+				pp = strstr( pp, ",");
+			}
+		}
+		else
+		{
+			//+RECEIVE,0,6:\r\n
+			RxDemux.link = get_seq( &pp);
+			pp = strstr( pp, ",");
+		}
+		if( RxDemux.link >= IPMUX_NUM)
+			RxDemux.link = -1;
+		if( pp == NULL)
+		{
+			Rxget.reading = 0;
+			return used;
+		}
+		RxDemux.remain = get_seq( &pp);
+		if( RxDemux.pull)
+		{
+			pp = strstr( pp, ",");
+			if( pp && RxDemux.link >= 0)
+				Rxget.pending[ RxDemux.link] = get_seq( &pp);
+			if( RxDemux.remain == 0)
+				Rxget.reading = 0;
 		}
-		
 	}
-
-//	gprs_event_t *this_event = (gprs_event_t *)event;
-//	*len = VecBuf_read( &g_TcpVbm, buf, *len);
-//	if( CKECK_EVENT( this_event, tcp_receive) )
-//	{
-//		return this_event->arg;	
-//	}
 	
-	return ERR_FAIL;
+	if( RxDemux.remain)
+	{
+		n = len - used;
+		if( n > RxDemux.remain)
+			n = RxDemux.remain;
+		rx_deliver( RxDemux.link, data + used, n);
+		RxDemux.remain -= n;
+		used += n;
+		if( RxDemux.remain == 0 && RxDemux.pull)
+			Rxget.reading = 0;
+	}
+	return used;
 }
-int Gprs_Event_tcpclose( gprs_t *self)
+
+//͸ģʽ£Ӵ֡а+RECEIVEıͷݷ
+//Ĳְ֪ͨͨ
+void read_event(void *buf, void *arg, int len)
 {
-	int i;
-	for(i = 0; i < IPMUX_NUM; i++)
+	char *p = buf;
+	char *end = p + len;
+	char *pp;
+	char c;
+	
+	if( arg == NULL)
+		return ;
+	if( dsys.gprs.cip_mode == CIPMODE_TRSP)
 	{
-		if(CHK_U8_BIT(dsys.gprs.set_tcp_close, i))
+		parse_urc( buf, arg, len);
+		return;
+	}
+	
+	//Ȱһ֡ûĲ
+	p += rx_demux( p, len, arg);
+	while( p < end)
+	{
+		pp = find_rxhead( p, end - p);
+		if( pp == NULL)
 		{
-			dsys.gprs.set_tcp_close = CLR_U8_BIT(dsys.gprs.set_tcp_close, i);
-			Ip_cnnState.cnn_state[i] = CNNT_DISCONNECT;
-			return i;
+			parse_urc( p, arg, end - p);
+			break;
 		}
-		
+		if( pp > p)
+		{
+			c = *pp;
+			*pp = '\0';
+			parse_urc( p, arg, pp - p);
+			*pp = c;
+		}
+		RxDemux.in_head = 1;
+		RxDemux.head_len = 0;
+		p = pp + rx_demux( pp, end - pp, arg);
 	}
-	
-//	gprs_event_t *this_event = ( gprs_event_t *)event;
-//	if( CKECK_EVENT( this_event, tcp_close) )
-//	{
-////		self->tcpClose( self, this_event->arg);
-//		Ip_cnnState.cnn_state[ this_event->arg] = CNNT_DISCONNECT;
-//		
-//		return this_event->arg;
-//	}
-	
-	return ERR_FAIL;
 }
 
-
-
-static int get_seq( char **data)
+static void parse_urc(void *buf, void *arg, int len)
 {
-	//+CMTI:"SM",1
-	int tmp;
-	char *buf = *data;
-	tmp = strcspn( buf, "0123456789");	
-	*data += tmp;
-	return  atoi( buf + tmp);
+//	gprs_event_t	*event;
+	if( arg == NULL)
+		return ;
+	//κַжŵʱбĽ֪ͨ
+	if( SmsInbox.listing == SMS_LISTING)
+	{
+		sms_list_parse( buf, len, arg);
+		return;
+	}
+	urc_dispatch( buf, arg, len);
 }
 
-void read_event(void *buf, void *arg, int len)
+//ģ֪ͨbufҪ0β
+static void urc_dispatch(void *buf, void *arg, int len)
 {
 	char *pp;
 	gprs_t *cthis;
 	int tmp = 0;		
-//	gprs_event_t	*event;
-	if( arg == NULL)
-		return ;
 //	if(dsys.gprs.flag_cnt)
 //		return;
 	
@@ -1681,6 +3908,31 @@ void read_event(void *buf, void *arg, int len)
 	
 	
 	
+	//֪ͨSIMϿʼ
+	if( strstr((const char*)buf,"+CPIN: READY"))
+		Boot_cpin = 1;
+	
+	//ȡģʽģյݣ+CIPRXGET: 1,0  ·ʱû·
+	pp = strstr((const char*)buf,"+CIPRXGET: 1");
+	if( pp && Rxget.on)
+	{
+		tmp = 0;
+		if( dsys.gprs.cip_mux && pp[12] == ',')
+			tmp = atoi( pp + 13);
+		if( tmp < IPMUX_NUM)
+			Rxget.notify = SET_U8_BIT( Rxget.notify, tmp);
+	}
+	
+	//·ʱ䣬ģʱѾ£У׼
+	if( strstr((const char*)buf,"*PSUTTZ") || strstr((const char*)buf,"+CTZV"))
+		Wclock_kick();
+	pp = strstr((const char*)buf,"+CNTP: ");
+	if( pp)
+		Mclk.cntp = atoi( pp + 7);
+	pp = strstr((const char*)buf,"+CDNSGIP: ");
+	if( pp)
+		dns_urc( pp + 10);
+	
 	pp = strstr((const char*)buf,"SMS Ready");
 	if( pp)
 	{
@@ -1703,11 +3955,21 @@ void read_event(void *buf, void *arg, int len)
 	{
 		dsys.gprs.cur_state = SHUTDOWN;
 		dsys.gprs.flag_ready = 0;
+		RxDemux.in_head = 0;
+		RxDemux.remain = 0;
+		Modem_post( MODEM_EV_DOWN, 0);
 		return;
 		
 	}
 	
 	
+	if( parse_cnnt_urc( buf))
+	{
+		//͸ģʽ£ӳɹ֮ݶ͸ݣ½
+		if( dsys.gprs.cip_mode == CIPMODE_TRSP)
+			return;
+	}
+	
 	//tcp closeָĹرղΪ¼
 	pp = strstr((const char*)buf,"STATE: TCP CLOSED");
 	if( pp)
@@ -1750,20 +4012,30 @@ void read_event(void *buf, void *arg, int len)
 //	}
 		
 	}
-	else
+	else if( dsys.gprs.cip_mux)
 	{
-		pp = strstr((const char*)buf,",CLOSED");
+		//0, CLOSED
+		pp = strstr((const char*)buf,", CLOSED");
+		if( pp && pp > ( char *)buf)
+			pp --;
+		else
+			pp = NULL;
 		
 	}
+	else
+	{
+		pp = strstr((const char*)buf,"CLOSED");
+	}
 	
 	
 	
 	if( pp)
 	{
 		tmp = get_seq(&pp);
-		if(tmp > IPMUX_NUM)
+		if(tmp >= IPMUX_NUM)
 			return;
 		dsys.gprs.set_tcp_close = SET_U8_BIT(dsys.gprs.set_tcp_close, tmp);
+		Modem_post( MODEM_EV_CLOSE, tmp);
 //		event = malloc_event();
 //		if( event)
 //		{
@@ -1784,46 +4056,17 @@ void read_event(void *buf, void *arg, int len)
 		return;
 	}
 	
-	//+RECEIVE,0,6:\0D\0A
-	//123456
-	pp = strstr((const char*)buf,"RECEIVE");
-	if( pp)
+	//ע״̬֪ͨһʱҪ
+	if( dsys.gprs.cip_mode != CIPMODE_TRSP || Trsp.state != TRSP_ST_DATA)
 	{
-		
-		tmp = get_seq(&pp);
-		if(tmp > IPMUX_NUM)
-			return;
-		dsys.gprs.set_tcp_recv = SET_U8_BIT(dsys.gprs.set_tcp_recv, tmp);
-		pp = strstr(pp,",");
-		tmp = get_seq(&pp); 
-		while((*pp != '\0') && (*pp != '\x00A'))
-			pp++;
-		if(pp[1] == '\0')
-			return;
-		VecBuf_write(&g_TcpVbm,  pp + 1, tmp);
-		
-//		event = malloc_event();
-//		if( event)
-//		{
-//			
-//			event->type = tcp_receive;
-//			event->arg = get_seq(&pp);
-//			pp = strstr(pp,",");
-//			tmp = get_seq(&pp); 
-//			while( *pp != '\x00A')
-//				pp++;
-//			VecBuf_write( &g_TcpVbm,  pp + 1, tmp);
-//			if( CBWrite( cthis->event_cbuf, event) != ERR_OK)
-//			{
-//				
-//				goto CB_WRFAIL;
-//				
-//			}
-//		}
-//		
-		return;
-
+		pp = strstr((const char*)buf,"+CREG:");
+		if( pp)
+			parse_reg_stat( pp, &dsys.gprs.status_gsm);
+		pp = strstr((const char*)buf,"+CGREG:");
+		if( pp)
+			parse_reg_stat( pp, &dsys.gprs.status_gprs);
 	}
+	
 	pp = strstr((const char*)buf,"CMTI");
 	if( pp)
 	{
@@ -1831,6 +4074,7 @@ void read_event(void *buf, void *arg, int len)
 		if(tmp > MAX_NUM_SMS)
 			return;
 		set_bit((uint8_t *)dsys.gprs.set_sms_recv, tmp);
+		Modem_post( MODEM_EV_SMS, tmp);
 //		event = malloc_event();
 //		if( event)
 //		{
@@ -1855,10 +4099,14 @@ void read_event(void *buf, void *arg, int len)
 	{
 		if( cthis->get_firstCnt_seq( cthis) < 0)
 			return;
+		//ģʽյĶָĻظлģĻظҲĵ
+		if( Trsp.state == TRSP_ST_CMD)
+			return;
+		if( Trsp.state == TRSP_ST_SWITCH && ( strstr( buf, "OK") || strstr( buf, "CONNECT") || \
+			strstr( buf, "NO CARRIER")))
+			return;
 		
-		tmp = len; 
-		VecBuf_write( &g_TcpVbm,  buf, tmp);
-		dsys.gprs.set_tcp_recv = SET_U8_BIT(dsys.gprs.set_tcp_recv, 0);
+		rx_deliver( 0, buf, len);
 		
 //		event = malloc_event();
 //		if(event)
@@ -1890,9 +4138,11 @@ void read_event(void *buf, void *arg, int len)
 int report_event( gprs_t *self, char *buf, int *lsize)
 {
 	short	i,j;
+	chn_lock();
 	gprs_Uart_ioctl( GPRS_UART_CMD_CLR_RXBLOCK);
 	UART_RECV( buf, *lsize);
 	gprs_Uart_ioctl( GPRS_UART_CMD_SET_RXBLOCK);
+	chn_unlock();
 	
 	//ӸּѯǷ¼δ
 	if(dsys.gprs.set_tcp_close)
@@ -1905,6 +4155,8 @@ int report_event( gprs_t *self, char *buf, int *lsize)
 		if(dsys.gprs.set_sms_recv[i])
 			return 0;
 	}
+	if( inbox_empty() == 0 || SmsInbox.more)
+		return 0;
 //	return CBRead( self->event_cbuf, event);
 	return -1;
 
@@ -2318,91 +4570,77 @@ int check_ip(char *ip)
 	
 }
 
+//һ1460ֽڵ+RECEIVEݰ֡пιread_eventֻ·2ջ
+//նǷԼݺ֪ܷͨʶ
+//lenҪ64 + GPRS_UART_BUF_LEN
 int buf_test( gprs_t *self, char *buf, int len)
 {
-	int  i  = 0 ;
-//	int	 tcp_buf_len = TCPDATA_LEN;
-	int ret = 0;
-
-
-	//ȫ·д
-	
-	//1 дݳΪ0ʱĲ
-	VecBuf_write( &g_TcpVbm, buf, 0);
-	
-	//2 ʱĶȡ
-	ret = VecBuf_read( &g_TcpVbm, buf, len);
-	
-	//3 дݴڻ޶ʱΪ
-	memset( buf, 1, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN);
-	
-	//4 дݳǻʱΪ
-	memset( buf, 2, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN - VBM_FRAMEHEAD_LEN);
-	
-	//5 ԻʱȡΪ
-	memset( buf, 0, len );
-	ret = VecBuf_read( &g_TcpVbm, buf, len);
-	
-	//6 ͨд빦
-	memset( buf, 3, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN/2 );
-	
-	//7 ԶȡݵĻ治ʱȡ
-	memset( buf, 0, len );
-	ret = VecBuf_read( &g_TcpVbm, buf, TCPDATA_LEN/3);
-	
-	//8 ͨд ĶȡΪ
-	memset( buf, 4, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN/2 );
-	memset( buf, 0, len );
-	ret = VecBuf_read( &g_TcpVbm, buf, TCPDATA_LEN);
-	
-	//9 д֡ݣһζȡʱȡ治㣬Եڶλʱܷȡ
-	memset( buf, 5, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN/3 );
-	memset( buf, 6, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN/3 );
-	memset( buf, 0, len );
-	ret = VecBuf_read( &g_TcpVbm, buf, TCPDATA_LEN/4);
-	memset( buf, 0, len );
-	ret = VecBuf_read( &g_TcpVbm, buf, TCPDATA_LEN);
-	
-	
-	//10 Եڶдʱ治Ϊ
-	for( i = 1; i < 3; i ++)
-	{
-		memset( buf, i, TCPDATA_LEN / 2);
-		VecBuf_write( &g_TcpVbm, buf, TCPDATA_LEN / 2);
-	}
-	for( i = 0; i < 2; i ++)
-	{
-		memset( buf, 0, len);
-		ret = VecBuf_read( &g_TcpVbm, buf, len);
-	}
-	
-	//11 дֽʱд
-	
-	for( i = 1; i < 15; i += 2)
-	{
-		memset( buf, i, TCPDATA_LEN );
-		VecBuf_write( &g_TcpVbm, buf, i );
-	}
+	const char *head = "+RECEIVE,2,1460:\r\n";
+	const char *tail = "3, CLOSED\r\n";
+	char *frame = buf + 64;
+	int  hlen = strlen( head);
+	int  flen = hlen + 1460 + strlen( tail);
+	int  cut[] = { 7, 1, 200, 512, 512, 100, 500};		//һ֡ڱͷмض
+	int  sent = 0;
+	int  rcvd = 0;
+	int  i = 0;
+	int  k = 0;
+	int  n = 0;
+	int  ret = 0;
+	
+	if( len <= 64 + GPRS_UART_BUF_LEN)
+		return ERR_BAD_PARAMETER;
 	
-	//12 д벻볤ݺд볤
-	memset( buf, 12, TCPDATA_LEN );
-	VecBuf_write( &g_TcpVbm, buf, 8 );
+	Grps_SetCipmux( 1);
+	TcpRxQueue_init( 1 << 2);
+	dsys.gprs.cip_mode = CIPMODE_OPAQUE;
+	dsys.gprs.set_tcp_close = 0;
 	
-	//13 ݶȡǷȷ
-	ret = 1;
-	while( ret)
+	while( sent < flen)
 	{
+		n = cut[ i % ( sizeof( cut) / sizeof( cut[0]))];
+		i ++;
+		if( n > flen - sent)
+			n = flen - sent;
+		//ͷ + 1460ֽ + ر֪ͨ
+		for( k = 0; k < n; k ++)
+		{
+			if( sent + k < hlen)
+				frame[k] = head[ sent + k];
+			else if( sent + k < hlen + 1460)
+				frame[k] = ( sent + k - hlen) & 0xff;
+			else
+				frame[k] = tail[ sent + k - hlen - 1460];
+		}
+		frame[n] = '\0';
+		read_event( frame, self, n);
+		sent += n;
 		
-		ret = VecBuf_read( &g_TcpVbm, buf, len);
+		//ģDTU֮߳֡ȡ
+		while( 1)
+		{
+			n = 64;
+			ret = Gprs_Event_tcpRecv( self, buf, &n);
+			if( ret < 0)
+				break;
+			if( ret != 2)
+				return ERR_FAIL;
+			for( k = 0; k < n; k ++)
+			{
+				if( (uint8_t)buf[ k] != ( ( rcvd + k) & 0xff))
+					return ERR_FAIL;
+			}
+			rcvd += n;
+		}
 	}
 	
-	return 0;
+	if( rcvd != 1460 || RxDemux.drop[2])
+		return ERR_FAIL;
+	if( CHK_U8_BIT( dsys.gprs.set_tcp_close, 3) == 0)
+		return ERR_FAIL;
+	dsys.gprs.set_tcp_close = 0;
+	
+	return ERR_OK;
 	
 	
 }
@@ -2559,6 +4797,11 @@ static int SerilTxandRx( char *buf, int bufsize, int count)
 {
 	int ret = 0;
 	
+	if( cmd_lock() != ERR_OK)
+	{
+		memset( buf, 0, bufsize);
+		return 0;
+	}
 	//Ȱ֮ǰδȡ
 	
 //	gprs_Uart_ioctl( GPRSUART_SET_RXWAITTIME_MS, 10);
@@ -2572,21 +4815,56 @@ static int SerilTxandRx( char *buf, int bufsize, int count)
 		memset( buf, 0, bufsize);
 		ret = UART_RECV( buf, bufsize);
 		if( ret > 0)
+		{
+			chn_unlock();
 			return ret;
+		}
 		count --;
 			
 	}
 	
+	chn_unlock();
 	return 0;
 
 }
 
 static int serial_cmmn( char *buf, int bufsize, int delay_ms)
 {
+	int ret = 0;
+	
+	if( cmd_lock() != ERR_OK)
+	{
+		memset( buf, 0, bufsize);
+		return 0;
+	}
 	UART_SEND( buf, strlen(buf));
 	if( delay_ms)
 		osDelay( delay_ms);
-	return UART_RECV( buf, bufsize);
+	ret = UART_RECV( buf, bufsize);
+	chn_unlock();
+	return ret;
+}
+
+//PDUʽͺͽնƵ
+static int set_sms2PduMode(gprs_t *self)
+{
+	int retry = RETRY_TIMES;
+	
+	if( Gprs_state.sms_msgFromt == SMS_MSG_PDU)
+		return ERR_OK;
+	self->set_smscAddr( self, Dtu_config.smscAddr);
+	while( retry --)
+	{
+		strcpy( Gprs_cmd_buf, "AT+CMGF=0\x00D\x00A" );
+		SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN,10);
+		if( strstr( ( const char*)Gprs_cmd_buf, "OK"))
+		{
+			Gprs_state.sms_msgFromt = SMS_MSG_PDU;
+			return ERR_OK;
+		}
+		osDelay(100);
+	}
+	return ERR_FAIL;
 }
 
 static int set_sms2TextMode(gprs_t *self)
@@ -3072,6 +5350,11 @@ static int prepare_ip(gprs_t *self)
 				if(pp)
 				{
 					dsys.gprs.cur_state = TCP_IP_OK;
+					boot_mark( &Boot.ip_ms);
+					set_keepalive();
+					rxget_init();
+					trsp_init();
+					clock_init();
 					return ERR_OK;
 				}
 				
@@ -3110,6 +5393,237 @@ static int prepare_ip(gprs_t *self)
 		return ERR_FAIL;
 }
 
+//ģTCPҪڽ֮ǰ
+//·ñʱŴ򿪣ģ鲻֧Ļʹ
+static void set_keepalive( void)
+{
+	uint32_t idle_s = Dtu_config.hartbeat_timespan_s;
+	
+	if( idle_s < TKA_IDLE_MIN_S)
+		idle_s = TKA_IDLE_MIN_S;
+	if( idle_s > TKA_IDLE_MAX_S)
+		idle_s = TKA_IDLE_MAX_S;
+	if( Dtu_config.tka_links)
+		sprintf( Gprs_cmd_buf, "AT+CIPTKA=1,%d,%d,%d\x00D\x00A", idle_s, TKA_INTVL_S, TKA_PROBES);
+	else
+		strcpy( Gprs_cmd_buf, "AT+CIPTKA=0\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( strstr( Gprs_cmd_buf, "OK") == NULL)
+	{
+		DPRINTF("[TKA] not support, use heatbeat package \n");
+		dsys.gprs.tka_on = 0;
+		return;
+	}
+	dsys.gprs.tka_on = Dtu_config.tka_links ? 1 : 0;
+}
+
+//ģ鱣AT+CLTS=1ĻдAT&Wдflashֻڵһδ򿪵ʱ
+static void clock_init( void)
+{
+	Mclk.cntp_bad = 0;
+	if( Dtu_config.time_src == WCLK_SRC_OFF)
+		return;
+	strcpy( Gprs_cmd_buf, "AT+CLTS?\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( strstr( Gprs_cmd_buf, "+CLTS: 1"))
+		return;
+	strcpy( Gprs_cmd_buf, "AT+CLTS=1\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( strstr( Gprs_cmd_buf, "OK") == NULL)
+	{
+		DPRINTF("[CLK] not support network time \n");
+		return;
+	}
+	strcpy( Gprs_cmd_buf, "AT&W\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+}
+
+//򿪳أģSNTPȡʱ䲢ԼʱӣCNTP_WAIT_MS
+static int cntp_run( gprs_t *self)
+{
+	char	apn[24];
+	int		n;
+	int		wait;
+	
+	if( Mclk.cntp_bad || Dtu_config.ntp_server[0] == '\0')
+		return ERR_UNINITIALIZED;
+	strcpy( Gprs_cmd_buf, "AT+SAPBR=3,1,\"Contype\",\"GPRS\"\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	//õĽ ,û,
+	if( !check_apn( Dtu_config.apn))
+		strcpy( apn, self->operator == COPS_CHINA_UNICOM ? "UNINET" : "CMNET");
+	else
+	{
+		n = strcspn( Dtu_config.apn, ",");
+		if( n >= sizeof( apn))
+			n = sizeof( apn) - 1;
+		memcpy( apn, Dtu_config.apn, n);
+		apn[ n] = '\0';
+	}
+	sprintf( Gprs_cmd_buf, "AT+SAPBR=3,1,\"APN\",\"%s\"\x00D\x00A", apn);
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	//Ѿ򿪵ʱظERRORӰĲ
+	strcpy( Gprs_cmd_buf, "AT+SAPBR=1,1\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 100);
+	strcpy( Gprs_cmd_buf, "AT+CNTPCID=1\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( strlen( Dtu_config.ntp_server) > CMDBUF_LEN - 20)
+		return ERR_BAD_PARAMETER;
+	sprintf( Gprs_cmd_buf, "AT+CNTP=\"%s\",0\x00D\x00A", Dtu_config.ntp_server);
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	Mclk.cntp = 0;
+	strcpy( Gprs_cmd_buf, "AT+CNTP\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( strstr( Gprs_cmd_buf, "ERROR"))
+	{
+		DPRINTF("[CLK] not support SNTP, use network time \n");
+		Mclk.cntp_bad = 1;
+	}
+	//ܺOKͬһ֡
+	else if( strstr( Gprs_cmd_buf, "+CNTP: ") && Mclk.cntp == 0)
+		Mclk.cntp = atoi( strstr( Gprs_cmd_buf, "+CNTP: ") + 7);
+	for( wait = 0; Mclk.cntp_bad == 0 && Mclk.cntp == 0 && wait < CNTP_WAIT_MS; wait += 100)
+		osDelay( 100);
+	strcpy( Gprs_cmd_buf, "AT+SAPBR=0,1\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( Mclk.cntp != CNTP_OK)
+	{
+		DPRINTF("[CLK] SNTP fail %d \n", Mclk.cntp);
+		return ERR_FAIL;
+	}
+	return ERR_OK;
+}
+
+/**
+ * @brief ģʱУ׼ʱ.
+ *
+ * @details У׼ʱ·ʱŷģ.
+ *			SNTPʱģӷȡʱ䣬ʧܵʱ·ʱ.
+ *			͸ģʽʱУ׼. Ҫgprs.
+ * @retval	ERR_OK	У׼У׼ɹ
+ * @retval	ERR_DEV_BUSY	ģڲִ
+ * @retval	ERR_UNINITIALIZED	ģʱӻûбù
+ * @retval	ERR_BAD_PARAMETER	ظĸʽ
+ */
+int Gprs_time_sync( gprs_t *self)
+{
+	uint64_t	epoch_ms;
+	uint64_t	tick;
+	uint8_t		src = WCLK_SRC_NITZ;
+	int			ret;
+	
+	if( Dtu_config.time_src == WCLK_SRC_OFF || Wclock_due( get_time_s()) == 0)
+		return ERR_OK;
+	if( dsys.gprs.cur_state < GPRS_OPEN_FINISH || Trsp.state == TRSP_ST_DATA)
+		return ERR_DEV_BUSY;
+	Wclock_tried( get_time_s());
+	if( Dtu_config.time_src == WCLK_SRC_NTP && cntp_run( self) == ERR_OK)
+		src = WCLK_SRC_NTP;
+	strcpy( Gprs_cmd_buf, "AT+CCLK?\x00D\x00A");
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	tick = get_tick_ms64();
+	ret = Wclock_parse_cclk( Gprs_cmd_buf, &epoch_ms);
+	if( ret != ERR_OK)
+	{
+		DPRINTF("[CLK] modem clock not ready %d \n", ret);
+		return ret;
+	}
+	Wclock_sync( epoch_ms, WCLK_CCLK_PREC_MS, tick, src);
+	DPRINTF("[CLK] sync from %d, err %d ms, %d ppm \n", src, Wclock_stat()->last_err_ms, Wclock_stat()->ppm);
+	return ERR_OK;
+}
+
+/**
+ * @brief ڿеʱ½ڵ.
+ *
+ * @details ڵIP½֮ǰãʱõȽ.
+ *			һֻһҪgprs.
+ * @retval	ERR_OK	ý߽ɹ
+ * @retval	ERR_DEV_BUSY	ģڲִ
+ * @retval	ERR_FAIL	ʧ
+ */
+int Gprs_dns_refresh( gprs_t *self)
+{
+	const char	*host;
+	
+	if( Dtu_config.dns_ttl_s == 0 || dns_off())
+		return ERR_OK;
+	host = Dns_refresh_due( get_time_s());
+	if( host == NULL)
+		return ERR_OK;
+	if( dsys.gprs.cur_state != TCP_IP_OK || Trsp.state == TRSP_ST_DATA)
+		return ERR_DEV_BUSY;
+	return dns_query( host);
+}
+
+//ȡģʽҪڽ֮ǰ򿪣͸ģʽ²
+static void rxget_init( void)
+{
+	memset( &Rxget, 0, sizeof( Rxget));
+	if( dsys.gprs.cip_mode == CIPMODE_TRSP)
+		return;
+	sprintf( Gprs_cmd_buf, "AT+CIPRXGET=%d\x00D\x00A", Dtu_config.rxget_on ? 1 : 0);
+	SerilTxandRx( Gprs_cmd_buf, CMDBUF_LEN, 10);
+	if( Dtu_config.rxget_on == 0)
+		return;
+	if( strstr( Gprs_cmd_buf, "OK") == NULL)
+	{
+		DPRINTF("[RXGET] not support, use +RECEIVE \n");
+		return;
+	}
+	Rxget.on = 1;
+}
+
+//ȡһ·ݣڴжֱӷնУֻ
+static void rxget_read( int link, int len)
+{
+	int wait;
+	
+	chn_lock();
+	Rxget.notify = CLR_U8_BIT( Rxget.notify, link);
+	if( dsys.gprs.cip_mux)
+		sprintf( Gprs_data_cmd, "AT+CIPRXGET=2,%d,%d\x00D\x00A", link, len);
+	else
+		sprintf( Gprs_data_cmd, "AT+CIPRXGET=2,%d\x00D\x00A", len);
+	Rxget.reading = 1;
+	SerilTxandRx( Gprs_data_cmd, CMDBUF_LEN, 10);
+	if( strstr( Gprs_data_cmd, "ERROR"))
+	{
+		//·ѾϿ
+		Rxget.reading = 0;
+		Rxget.pending[ link] = 0;
+	}
+	for( wait = 0; Rxget.reading && wait < RXGET_WAIT_MS; wait += 10)
+		osDelay( 10);
+	Rxget.reading = 0;
+	chn_unlock();
+}
+
+//նпռʱŴģȡ
+static void rxget_run( void)
+{
+	int i, room, need;
+	
+	if( Rxget.on == 0)
+		return;
+	for( i = 0; i < IPMUX_NUM; i ++)
+	{
+		if( Rxget.pending[i] == 0 && CHK_U8_BIT( Rxget.notify, i) == 0)
+			continue;
+		if( Ip_cnnState.cnn_state[i] != CNNT_ESTABLISHED || TcpRxFifo[i].size == 0)
+		{
+			Rxget.pending[i] = 0;
+			Rxget.notify = CLR_U8_BIT( Rxget.notify, i);
+			continue;
+		}
+		room = BFFreeSize( &TcpRxFifo[i]);
+		need = Rxget.pending[i] && Rxget.pending[i] < RXGET_MIN ? Rxget.pending[i] : RXGET_MIN;
+		if( room < need)
+			continue;
+		rxget_read( i, room > RXGET_MAX ? RXGET_MAX : room);
+	}
+}
+
 //յĶŵĸʽǣ
 //+CMGR: "REC UNREAD","+8613918186089", "","02/01/30,20:40:31+00",This is a test
 //
@@ -3153,6 +5667,7 @@ FUNCTION_SETTING(shutdown, shutdown);
 FUNCTION_SETTING(get_sim_info, Gprs_get_info);
 FUNCTION_SETTING(check_simCard, Gprs_check_simCard);
 FUNCTION_SETTING(send_text_sms, send_text_sms);
+FUNCTION_SETTING(send_sms_data, send_sms_data);
 FUNCTION_SETTING(read_phnNmbr_TextSMS, read_phnNmbr_TextSMS);
 FUNCTION_SETTING(read_seq_TextSMS, read_seq_TextSMS);
 
@@ -3178,6 +5693,8 @@ FUNCTION_SETTING(set_smscAddr, set_smscAddr);
 FUNCTION_SETTING(set_dns_ip, set_dns_ip);
 FUNCTION_SETTING(tcpClose, tcpClose);
 FUNCTION_SETTING(tcpip_cnnt, tcpip_cnnt);
+FUNCTION_SETTING(tcpip_cnnt_start, tcpip_cnnt_start);
+FUNCTION_SETTING(deal_tcpcnnt_event, Gprs_Event_tcpCnnt);
 FUNCTION_SETTING(sendto_tcp, sendto_tcp);
 FUNCTION_SETTING(sendto_tcp_buf, sendto_tcp_buf);
 
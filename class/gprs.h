@@ -3,11 +3,78 @@
 #include "lw_oopc.h"
 #include "stdint.h"
 #include "CircularBuffer.h"
+#include "trspMode.h"
+#include "rudp.h"
 
 #define RETRY_TIMES	5
 
 #define IPMUX_NUM	4		//֧4·,ó7Ϊõu8ļ¼tcp close¼
 #define EVENT_MAX	16		//󻺴¼
+#define CNNT_POLL_MS	50		//ȴӽʱĲѯ
+
+//ģTCP(AT+CIPTKA)ģеӶЧ
+//ģ鱣·ٷ
+#define TKA_IDLE_MIN_S		30		//ӿж֮ʼͱ̽⣬ȡڲڷΧ
+#define TKA_IDLE_MAX_S		7200
+#define TKA_INTVL_S			75		//̽ļ
+#define TKA_PROBES			3		//̽ٴûлӦͶϿ
+#define SEND_FAIL_MAX		3		//ʧܶٴΪԶѾˣر·
+
+//ʹڣģﻹûбԶȷϵݳʱȲڷͶ
+//δȷϵֽAT+CIPACKѯûڵʱ򰴷ĳȹƣÿζ
+#define TXWIN_QUERY_MS		200		//ʱѯļ
+#define TXWIN_WAIT_MS		3000	//Ͷֱӷ͵ȴʱ
+//UDP·ʹģ鱣ͷʹڣrudpšȷϺط
+
+//ݰȼ벻ͬķͶУÿηȷȼĶ
+//ݲȺϲһη;ͷȥspoolݵʱҲں
+//ݵȽͨĶж˲ŷϲȴʱҲ
+#define UPLINK_URGENT		0		//쳣Ӧ
+#define UPLINK_NORMAL		1
+#define UPLINK_BULK			2
+#define UPLINK_CLASS_NUM	3
+#define UPLINK_BULK_MS		2000	//ȴϲʱ
+//R8RAMĬϲݵĶУͨݷ
+#ifndef UPLINK_BULK_ENABLE
+#define UPLINK_BULK_ENABLE	0
+#endif
+#define UPLINK_LAT_BUCKETS	10		//ʱֱͼn[2^(n+4), 2^(n+5))ms032ms£һ
+
+typedef struct {
+	uint32_t	sends;					//͵Ĵÿ·ֱ
+	uint32_t	drop;					//˷Ųȥ֡
+	uint32_t	max_ms;
+	uint32_t	hist[ UPLINK_LAT_BUCKETS];
+}uplink_lat_t;
+
+//źǿȡѹĻ棬ʱں̨ˢ
+//ע״̬ģ+CREG/+CGREG֪ͨ
+#define RADIO_TTL_S			30
+#define RADIO_RETRY_S		10		//̨ˢʧ֮ȶٲѯ
+#define RADIO_INPUT_REG		18		//õmodbusĴźǿ0-31
+									//19 GSMע״̬20 GPRSע״̬
+									//21 ѹmv
+									//22 ʱs
+
+//ʱ򣺵ԴµʱȡֲҪСֵ֮ÿ100msһATֱģظ
+#define GPRS_PWRKEY_ON_MS	1100	//ֲҪ󿪻1s
+#define GPRS_BOOT_PROBES	100		//̽10s
+#define BOOT_INPUT_REG		23		//õmodbusĴһ·ʱ䣬λ100ms
+
+//AT+IPRģЭ̸ߵĲʣ´οֱʹ
+//ģӦGPRS_BAUD_DEFͨ
+#define GPRS_BAUD_DEF		115200
+#define IPR_PROBES			5		//лʺAT֤Ĵ
+
+//׶ڿʼʱms0ʾûеһ
+typedef struct {
+	uint16_t	at_ms;			//ģظAT
+	uint16_t	cpin_ms;		//SIM
+	uint16_t	reg_ms;			//עɹ
+	uint16_t	ip_ms;			//ȡIP
+	uint16_t	data_ms;		//һ·
+	uint8_t		warm;			//Ƭλʱģ黹ţû¿
+}gprs_boot_t;
 
 #define COPS_CHINA_MOBILE		0x33
 #define COPS_CHINA_UNICOM		0x55
@@ -35,6 +102,7 @@ CLASS(gprs_t)
 	// public
 	int ( *init)( gprs_t *self);
 	
+	//ŵȿƲʱУݲҪ
 	int ( *lock)(  gprs_t *self);
 	int ( *unlock)(  gprs_t *self);
 	
@@ -45,6 +113,7 @@ CLASS(gprs_t)
 	int	(*get_sim_info)(gprs_t *self);
 	
 	int	(*send_text_sms)(  gprs_t *self, char *phnNmbr, char *sms);
+	int	(*send_sms_data)(  gprs_t *self, char *phnNmbr, char *sms, int sms_len);
 	int	(*read_phnNmbr_TextSMS)(  gprs_t *self, char *phnNmbr, char *in_buf, char *out_buf, int *len);
 	int	(*read_seq_TextSMS)( gprs_t *self, char *phnNmbr, int seq, char *buf, int *len);
 	int (*delete_sms)( gprs_t *self, int seq);
@@ -54,6 +123,7 @@ CLASS(gprs_t)
 	int (*get_apn)( gprs_t *self, char *buf);
 	int (*set_dns_ip)( gprs_t *self, char *dns_ip);
 	int (*tcpip_cnnt)( gprs_t *self, int cnnt_num, char *prtl, char *addr, int portnum);
+	int (*tcpip_cnnt_start)( gprs_t *self, int cnnt_num, char *prtl, char *addr, int portnum);
 	int ( *tcpClose)( gprs_t *self, int cnntNum); 
 	int (*sendto_tcp)( gprs_t *self, int cnnt_num, char *data, int len);
 	int (*sendto_tcp_buf)( gprs_t *self, char *data, int len);
@@ -69,6 +139,7 @@ CLASS(gprs_t)
 	int (*report_event)( gprs_t *self, char *buf, int *lsize);
 //	void (*free_event)( gprs_t *self, void *event);
 	int (*deal_tcpclose_event)(gprs_t *self);
+	int (*deal_tcpcnnt_event)(gprs_t *self, int *result);
 	int (*deal_tcprecv_event)(gprs_t *self,  char *buf, int *len);
 	int (*deal_smsrecv_event)(gprs_t *self, char *buf, int *lsize, char *phno);
 	
@@ -125,6 +196,11 @@ typedef struct {
 
 
 gprs_t *GprsGetInstance(void);
+trspMode_t *GprsGetTrspMode(void);
+int GprsTrspDtr(void);
+int GprsRadioAge(void);
+gprs_boot_t *GprsGetBoot(void);
+int GprsIprCheck(int baud);
 
 int compare_phoneNO(char *NO1, char *NO2);
 int check_phoneNO(char *NO);
@@ -133,6 +209,27 @@ int check_ip(char *ip);
 int get_apn( gprs_t *self, char *buf);
 int Grps_SetCipmode( short mode);
 int Grps_SetCipmux( short mux);
+void TcpRxQueue_init( uint8_t link_set);
+void TcpTxQueue_init( uint8_t link_set);
+uint32_t Gprs_get_rxdrop( int cnnt_num);
+int Gprs_get_rxpending( int cnnt_num);
+int Gprs_rxget_on( void);
+int Gprs_get_txwin( int cnnt_num, uint32_t *unacked, uint32_t *stall_ms);
+void Gprs_rudp_set( int cnnt_num, int on);
+int Gprs_link_udp( int cnnt_num);
+rudp_t *Gprs_get_rudp( int cnnt_num);
+uint8_t Gprs_established( void);
+void Gprs_link_release( int cnnt_num);
+int Gprs_send_prio( char *data, int len, int prio);
+uint8_t Gprs_last_route( void);
+uplink_lat_t *Gprs_get_uplink_lat( int prio);
+uint32_t Uplink_lat_pct( uplink_lat_t *lat, int pct);
+int Gprs_send_typed( int cnnt_num, int type, char *data, int len);
+char *Gprs_frame_lock( int *size);
+void Gprs_frame_unlock( void);
+void Gprs_get_upf( uint32_t *raw, uint32_t *out);
+int Gprs_time_sync( gprs_t *self);
+int Gprs_dns_refresh( gprs_t *self);
 void GprsTcpCnnectBeagin();
 void GprsTcpCnnectFinish();
 
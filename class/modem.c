@@ -0,0 +1,84 @@
+/**
+* @file 		modem.c
+* @brief		ģĹ.
+* @details		1. MODEM_TYPEαʹõģ
+*				2. ¼Ķĺͷַģ鹲ãֻҪModem_post
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "modem.h"
+#include "sdhError.h"
+
+static struct {
+	uint8_t		mask;
+	modem_cb	cb;
+	void		*ctx;
+}Modem_sub[ MODEM_SUB_MAX];
+
+static uint32_t	Modem_evs[ MODEM_EV_NUM];
+
+Modem *ModemGetInstance( void)
+{
+#if MODEM_TYPE == MODEM_SIM800
+	return Sim800ModemGetInstance();
+#else
+#error "unknown MODEM_TYPE"
+#endif
+}
+
+/**
+ * @brief ģ¼.
+ *
+ * @details ͬһصٴζĵʱֻ¼ϣev_maskΪ0ʾȡ.
+ * @retval	ERR_OK	ɹ
+ * @retval	ERR_MEM_UNAVAILABLE	
+ */
+int Modem_subscribe( Modem *self, uint8_t ev_mask, modem_cb cb, void *ctx)
+{
+	int		i;
+	int		empty = -1;
+	
+	for( i = 0; i < MODEM_SUB_MAX; i ++)
+	{
+		if( Modem_sub[i].cb == cb)
+		{
+			Modem_sub[i].ctx = ctx;
+			Modem_sub[i].mask = ev_mask;
+			return ERR_OK;
+		}
+		if( Modem_sub[i].cb == NULL && empty < 0)
+			empty = i;
+	}
+	if( ev_mask == 0)
+		return ERR_OK;
+	if( empty < 0)
+		return ERR_MEM_UNAVAILABLE;
+	//صдڻصﲻῴûļ¼
+	Modem_sub[ empty].ctx = ctx;
+	Modem_sub[ empty].mask = ev_mask;
+	Modem_sub[ empty].cb = cb;
+	return ERR_OK;
+}
+
+//¼ڴڻصDTU߳
+void Modem_post( int ev, int arg)
+{
+	int		i;
+	
+	if( ev < 0 || ev >= MODEM_EV_NUM)
+		return;
+	Modem_evs[ ev] ++;
+	for( i = 0; i < MODEM_SUB_MAX; i ++)
+	{
+		if( Modem_sub[i].cb && ( Modem_sub[i].mask & MODEM_EV_BIT( ev)))
+			Modem_sub[i].cb( ev, arg, Modem_sub[i].ctx);
+	}
+}
+
+uint32_t Modem_ev_count( int ev)
+{
+	if( ev < 0 || ev >= MODEM_EV_NUM)
+		return 0;
+	return Modem_evs[ ev];
+}
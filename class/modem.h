@@ -0,0 +1,61 @@
+#ifndef __MODEM_H__
+#define __MODEM_H__
+#include "lw_oopc.h"
+#include "stdint.h"
+
+//ģĹӿڣDTU̵߳Ŀġݡݡź¼ֻͨӿʹģ
+//ÿģʵһݣMODEM_TYPEѡPCøԵģԣSIM800tools/sim800_emu
+//SIM顢ʱУ׼ЩģָйصĲ軹ڸԵ
+#define MODEM_SIM800		0
+#ifndef MODEM_TYPE
+#define MODEM_TYPE			MODEM_SIM800
+#endif
+
+//ģ¼ڴڻص﷢
+//ĵĻصҲڴڻصִУֻܼ¼¼߷źţܵȴ
+#define MODEM_EV_RECV		0		//·յݣ·
+#define MODEM_EV_CLOSE		1		//·Ͽˣ·
+#define MODEM_EV_SMS		2		//յ˶ţǶű
+#define MODEM_EV_DOWN		3		//ģػ
+#define MODEM_EV_NUM		4
+#define MODEM_EV_BIT( ev)	( 1 << ( ev))
+#define MODEM_SUB_MAX		4		//Ķ
+
+typedef void ( *modem_cb)( int ev, int arg, void *ctx);
+
+INTERFACE( Modem)
+{
+	const char	*name;
+	
+	int ( *open)( Modem *self);						//ӷʽȴ
+	void ( *power)( Modem *self, int on);			//0ػ1¿
+	//ƲʱУзͲҪ
+	int ( *lock)( Modem *self);
+	int ( *unlock)( Modem *self);
+	int ( *send)( Modem *self, char *data, int len, int prio);	//ݣ·ɷģ뷢Ͷоͷ
+	//µĲҪ
+	int ( *send_link)( Modem *self, int link, int type, char *data, int len);	//һ·עӦtypeupframe.h֡
+	int ( *recv)( Modem *self, char *buf, int *len);	//ȡһ·յݣ·ţûݵʱ<0
+	int ( *connect)( Modem *self, int link, char *prtl, char *addr, int port);	//ӣȴ
+	int ( *connected)( Modem *self, int *result);	//ȡһӵĽ·ţûнʱ<0
+	int ( *closed)( Modem *self);					//ȡһϿ·ûеʱ<0
+	int ( *close)( Modem *self, int link);
+	int ( *sms_recv)( Modem *self, char *buf, int *len, char *phone);	//ȡ֪ͨյĶţضűţûеʱ<=0
+	int ( *sms_read)( Modem *self, char *buf, int *len, char *phone);	//ģ洢Ķһûеʱ<0
+	int ( *sms_send)( Modem *self, char *phone, char *text);
+	int ( *sms_delete)( Modem *self, int seq);
+	int ( *subscribe)( Modem *self, uint8_t ev_mask, modem_cb cb, void *ctx);
+};
+
+CLASS( Sim800Modem)
+{
+	IMPLEMENTS( Modem);
+};
+
+Modem *ModemGetInstance( void);
+Modem *Sim800ModemGetInstance( void);
+int Modem_subscribe( Modem *self, uint8_t ev_mask, modem_cb cb, void *ctx);
+void Modem_post( int ev, int arg);
+uint32_t Modem_ev_count( int ev);
+
+#endif
@@ -0,0 +1,176 @@
+/**
+* @file 		modem_sim800.c
+* @brief		SIM800ģӿ.
+* @details		1. ػӷʽáġշݺͶŰװModemӿڣĲgprs.c
+*				2. ¼gprs.cĴڻصͨModem_post
+*				3. PCtools/sim800_emuģ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "modem.h"
+#include "gprs.h"
+#include "dtuConfig.h"
+#include "sdhError.h"
+#include "system.h"
+
+//͸ö·ӣĿͬʱ
+static int Sim800_open( Modem *self)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	uint8_t	link_set = 0;
+	int		i;
+	
+	if(Dtu_config.multiCent_mode == 0)
+	{
+		Grps_SetCipmode(CIPMODE_TRSP);
+		Grps_SetCipmux(0);
+		link_set = 1;
+	}
+	else
+	{
+		Grps_SetCipmux(1);
+		//ջָֻ˵
+		for( i = 0; i < IPMUX_NUM; i ++)
+		{
+			if( Dtu_config.DateCenter_port[i] > 0)
+				link_set = SET_U8_BIT( link_set, i);
+		}
+		if( link_set)
+			TcpRxQueue_init( link_set);
+	}
+	//ͶҲָֻ˵
+	TcpTxQueue_init( link_set);
+	gprs->startup( gprs);
+	return ERR_OK;
+}
+
+static void Sim800_power( Modem *self, int on)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	if( on)
+		gprs->startup( gprs);
+	else
+		gprs->shutdown( gprs);
+}
+
+static int Sim800_lock( Modem *self)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->lock( gprs);
+}
+
+static int Sim800_unlock( Modem *self)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->unlock( gprs);
+}
+
+static int Sim800_send( Modem *self, char *data, int len, int prio)
+{
+	return Gprs_send_prio( data, len, prio);
+}
+
+//µĲҪ
+static int Sim800_send_link( Modem *self, int link, int type, char *data, int len)
+{
+	return Gprs_send_typed( link, type, data, len);
+}
+
+static int Sim800_recv( Modem *self, char *buf, int *len)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->deal_tcprecv_event( gprs, buf, len);
+}
+
+static int Sim800_connect( Modem *self, int link, char *prtl, char *addr, int port)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->tcpip_cnnt_start( gprs, link, prtl, addr, port);
+}
+
+static int Sim800_connected( Modem *self, int *result)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->deal_tcpcnnt_event( gprs, result);
+}
+
+static int Sim800_closed( Modem *self)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->deal_tcpclose_event( gprs);
+}
+
+static int Sim800_close( Modem *self, int link)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->tcpClose( gprs, link);
+}
+
+static int Sim800_sms_recv( Modem *self, char *buf, int *len, char *phone)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->deal_smsrecv_event( gprs, buf, len, phone);
+}
+
+static int Sim800_sms_read( Modem *self, char *buf, int *len, char *phone)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->read_phnNmbr_TextSMS( gprs, phone, buf, buf, len);
+}
+
+static int Sim800_sms_send( Modem *self, char *phone, char *text)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->send_text_sms( gprs, phone, text);
+}
+
+static int Sim800_sms_delete( Modem *self, int seq)
+{
+	gprs_t	*gprs = GprsGetInstance();
+	
+	return gprs->delete_sms( gprs, seq);
+}
+
+Modem *Sim800ModemGetInstance( void)
+{
+	static Sim800Modem *singleton = NULL;
+	if( singleton == NULL)
+	{
+		singleton = Sim800Modem_new();
+		
+	}
+	return ( Modem *)singleton;
+	
+}
+
+CTOR( Sim800Modem)
+cthis->Modem.name = "SIM800";
+FUNCTION_SETTING( Modem.open, Sim800_open);
+FUNCTION_SETTING( Modem.power, Sim800_power);
+FUNCTION_SETTING( Modem.lock, Sim800_lock);
+FUNCTION_SETTING( Modem.unlock, Sim800_unlock);
+FUNCTION_SETTING( Modem.send, Sim800_send);
+FUNCTION_SETTING( Modem.send_link, Sim800_send_link);
+FUNCTION_SETTING( Modem.recv, Sim800_recv);
+FUNCTION_SETTING( Modem.connect, Sim800_connect);
+FUNCTION_SETTING( Modem.connected, Sim800_connected);
+FUNCTION_SETTING( Modem.closed, Sim800_closed);
+FUNCTION_SETTING( Modem.close, Sim800_close);
+FUNCTION_SETTING( Modem.sms_recv, Sim800_sms_recv);
+FUNCTION_SETTING( Modem.sms_read, Sim800_sms_read);
+FUNCTION_SETTING( Modem.sms_send, Sim800_sms_send);
+FUNCTION_SETTING( Modem.sms_delete, Sim800_sms_delete);
+FUNCTION_SETTING( Modem.subscribe, Modem_subscribe);
+END_CTOR
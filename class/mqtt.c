@@ -0,0 +1,285 @@
+/**
+* @file 		mqtt.c
+* @brief		MQTT 3.1.1ĵıͽ.
+* @details		1. CONNECTPUBLISH(QoS0/1)SUBSCRIBEPUBACKPINGREQDISCONNECT
+*				2. յݰֽPUBLISHд棬ֻ¼
+*				3. ӲԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "mqtt.h"
+#include "sdhError.h"
+#include <string.h>
+#if MQTT_ENABLE
+
+#define RX_HEAD			0
+#define RX_LEN			1
+#define RX_TLEN			2		//PUBLISHⳤ
+#define RX_TOPIC		3
+#define RX_ID			4		//PUBLISHııʶ
+#define RX_DATA			5
+#define RX_BODY			6		//ĵ
+
+//ʣ೤ȵı룬ռõֽ
+static int put_len( char *buf, uint32_t len)
+{
+	int n = 0;
+
+	do
+	{
+		buf[n] = len & 0x7f;
+		len >>= 7;
+		if( len)
+			buf[n] |= 0x80;
+		n ++;
+	}while( len);
+	return n;
+}
+
+static char *put_u16( char *p, uint16_t val)
+{
+	*p ++ = val >> 8;
+	*p ++ = val & 0xff;
+	return p;
+}
+
+static char *put_str( char *p, char *s, int len)
+{
+	p = put_u16( p, len);
+	memcpy( p, s, len);
+	return p + len;
+}
+
+//д̶ͷŲµʱ򷵻NULL
+static char *put_head( char *buf, int size, uint8_t head, uint32_t remain)
+{
+	char	tmp[4];
+	int		n = put_len( tmp, remain);
+
+	if( 1 + n + remain > size)
+		return NULL;
+	buf[0] = head;
+	memcpy( buf + 1, tmp, n);
+	return buf + 1 + n;
+}
+
+//CONNECTʹỰuserΪյʱ򲻴û
+int Mqtt_connect( char *buf, int size, char *client, char *user, char *pass, uint16_t keepalive_s)
+{
+	char		*p;
+	uint8_t		flags = 0x02;
+	int			clen = strlen( client);
+	int			ulen = user ? strlen( user) : 0;
+	int			plen = pass ? strlen( pass) : 0;
+	uint32_t	remain = 10 + 2 + clen;
+
+	if( ulen)
+	{
+		flags |= 0x80;
+		remain += 2 + ulen;
+		if( plen)
+		{
+			flags |= 0x40;
+			remain += 2 + plen;
+		}
+	}
+	p = put_head( buf, size, MQTT_CONNECT << 4, remain);
+	if( p == NULL)
+		return ERR_MEM_UNAVAILABLE;
+	p = put_str( p, "MQTT", 4);
+	*p ++ = 4;				//Э鼶3.1.1
+	*p ++ = flags;
+	p = put_u16( p, keepalive_s);
+	p = put_str( p, client, clen);
+	if( flags & 0x80)
+		p = put_str( p, user, ulen);
+	if( flags & 0x40)
+		p = put_str( p, pass, plen);
+	return p - buf;
+}
+
+//QoS0ʱûбıʶidʹ
+int Mqtt_publish( char *buf, int size, char *topic, char *data, int len, int qos, uint16_t id)
+{
+	char		*p;
+	int			tlen = strlen( topic);
+	uint32_t	remain = 2 + tlen + len + ( qos ? 2 : 0);
+
+	if( qos > 1)
+		return ERR_BAD_PARAMETER;
+	p = put_head( buf, size, ( MQTT_PUBLISH << 4) | ( qos << 1), remain);
+	if( p == NULL)
+		return ERR_MEM_UNAVAILABLE;
+	p = put_str( p, topic, tlen);
+	if( qos)
+		p = put_u16( p, id);
+	memcpy( p, data, len);
+	return p + len - buf;
+}
+
+//һ⣬QoS0
+int Mqtt_subscribe( char *buf, int size, char *topic, uint16_t id)
+{
+	char		*p;
+	int			tlen = strlen( topic);
+
+	p = put_head( buf, size, ( MQTT_SUBSCRIBE << 4) | 0x02, 2 + 2 + tlen + 1);
+	if( p == NULL)
+		return ERR_MEM_UNAVAILABLE;
+	p = put_u16( p, id);
+	p = put_str( p, topic, tlen);
+	*p ++ = 0;
+	return p - buf;
+}
+
+int Mqtt_puback( char *buf, uint16_t id)
+{
+	buf[0] = MQTT_PUBACK << 4;
+	buf[1] = 2;
+	put_u16( buf + 2, id);
+	return 4;
+}
+
+//ֻй̶ͷıģPINGREQDISCONNECT
+int Mqtt_simple( char *buf, uint8_t type)
+{
+	buf[0] = type << 4;
+	buf[1] = 0;
+	return 2;
+}
+
+void Mqtt_rx_init( mqtt_rx_t *rx)
+{
+	memset( rx, 0, sizeof( mqtt_rx_t));
+}
+
+static uint8_t rx_qos( mqtt_rx_t *rx)
+{
+	return ( rx->head >> 1) & 0x3;
+}
+
+//һ
+static void rx_done( mqtt_rx_t *rx)
+{
+	uint8_t type = rx->head >> 4;
+
+	rx->st = RX_HEAD;
+	switch( type)
+	{
+		case MQTT_CONNACK:
+			if( rx->n < 2)
+			{
+				rx->bad ++;
+				return;
+			}
+			rx->connack_rc = rx->var[1];
+			break;
+		case MQTT_PUBACK:
+			if( rx->n < 2)
+			{
+				rx->bad ++;
+				return;
+			}
+			rx->puback_id = ( rx->var[0] << 8) | rx->var[1];
+			break;
+		case MQTT_PUBLISH:
+			if( rx_qos( rx) == 1 && rx->n == 2)
+			{
+				rx->pub_id = ( rx->var[0] << 8) | rx->var[1];
+				rx->pub_ack = 1;
+			}
+			break;
+	}
+	rx->got |= 1 << type;
+}
+
+//ʣ೤Ƚ
+static void rx_begin( mqtt_rx_t *rx)
+{
+	rx->n = 0;
+	if( rx->remain == 0)
+		rx_done( rx);
+	else if( ( rx->head >> 4) == MQTT_PUBLISH)
+		rx->st = RX_TLEN;
+	else
+		rx->st = RX_BODY;
+}
+
+//PUBLISH֮ǱıʶQoS>0
+static void rx_after_topic( mqtt_rx_t *rx)
+{
+	rx->n = 0;
+	rx->st = rx_qos( rx) ? RX_ID : RX_DATA;
+}
+
+//յݣPUBLISHдoutдĳ
+//дĳȲᳬѾĳȣoutԺinͬһ
+int Mqtt_input( mqtt_rx_t *rx, char *in, int len, char *out)
+{
+	int			i;
+	int			n = 0;
+	uint8_t		c;
+
+	for( i = 0; i < len; i ++)
+	{
+		c = in[i];
+		if( rx->st == RX_HEAD)
+		{
+			rx->head = c;
+			rx->remain = 0;
+			rx->len_shift = 0;
+			rx->st = RX_LEN;
+			continue;
+		}
+		if( rx->st == RX_LEN)
+		{
+			rx->remain |= ( uint32_t)( c & 0x7f) << rx->len_shift;
+			rx->len_shift += 7;
+			if( ( c & 0x80) == 0)
+				rx_begin( rx);
+			else if( rx->len_shift >= 28)
+			{
+				//ʣ೤4ֽڣѾûˣֻܴһֽ¿ʼ
+				rx->bad ++;
+				rx->st = RX_HEAD;
+			}
+			continue;
+		}
+
+		rx->remain --;
+		switch( rx->st)
+		{
+			case RX_TLEN:
+				rx->var[ rx->n ++] = c;
+				if( rx->n < 2)
+					break;
+				rx->topic_left = ( rx->var[0] << 8) | rx->var[1];
+				if( rx->topic_left)
+					rx->st = RX_TOPIC;
+				else
+					rx_after_topic( rx);
+				break;
+			case RX_TOPIC:
+				if( -- rx->topic_left == 0)
+					rx_after_topic( rx);
+				break;
+			case RX_ID:
+				rx->var[ rx->n ++] = c;
+				if( rx->n == 2)
+					rx->st = RX_DATA;
+				break;
+			case RX_DATA:
+				out[ n ++] = c;
+				break;
+			default:
+				if( rx->n < sizeof( rx->var))
+					rx->var[ rx->n ++] = c;
+				break;
+		}
+		if( rx->remain == 0)
+			rx_done( rx);
+	}
+	return n;
+}
+#endif
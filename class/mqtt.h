@@ -0,0 +1,51 @@
+#ifndef __MQTT_H__
+#define __MQTT_H__
+#include <stdint.h>
+
+//MQTT 3.1.1ĵıͽֻʵֿͻõĲ
+//ӲӣյݰֽĿԷڶ
+//R8FlashRAMĬϲMQTT
+#ifndef MQTT_ENABLE
+#define MQTT_ENABLE			0
+#endif
+
+#define MQTT_CONNECT		1
+#define MQTT_CONNACK		2
+#define MQTT_PUBLISH		3
+#define MQTT_PUBACK			4
+#define MQTT_SUBSCRIBE		8
+#define MQTT_SUBACK			9
+#define MQTT_PINGREQ		12
+#define MQTT_PINGRESP		13
+#define MQTT_DISCONNECT		14
+
+#define MQTT_DUP_FLAG		0x08		//طPUBLISHڵһֽ
+
+typedef struct {
+	uint8_t		st;				//״̬
+	uint8_t		head;			//ǰĵĵһֽ
+	uint8_t		len_shift;		//ʣ೤Ѿλ
+	uint8_t		n;				//varѾյֽ
+	uint32_t	remain;			//ǰĻûյĳ
+	uint16_t	topic_left;		//PUBLISH⻹ûյĳ
+	uint8_t		var[4];			//СĵݣPUBLISHⳤȺͱıʶ
+
+	//Ľʹ
+	uint16_t	got;			//յıͼϣnλӦn
+	uint8_t		connack_rc;		//CONNACKķ룬0ʾ
+	uint16_t	puback_id;		//յPUBACKııʶ
+	uint8_t		pub_ack;		//յQoS1PUBLISHҪظPUBACK
+	uint16_t	pub_id;
+	uint32_t	bad;			//ʽ󶪵ı
+}mqtt_rx_t;
+
+int Mqtt_connect( char *buf, int size, char *client, char *user, char *pass, uint16_t keepalive_s);
+int Mqtt_publish( char *buf, int size, char *topic, char *data, int len, int qos, uint16_t id);
+int Mqtt_subscribe( char *buf, int size, char *topic, uint16_t id);
+int Mqtt_puback( char *buf, uint16_t id);
+int Mqtt_simple( char *buf, uint8_t type);
+
+void Mqtt_rx_init( mqtt_rx_t *rx);
+int Mqtt_input( mqtt_rx_t *rx, char *in, int len, char *out);
+
+#endif
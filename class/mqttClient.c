@@ -0,0 +1,534 @@
+/**
+* @file 		mqttClient.c
+* @brief		ʹMQTTЭʱĿͻ.
+* @details		1. ӽCONNECTSUBSCRIBEյݽԭд
+*				2. 485ݰRTUַϲַˡ˻ߵȴʱ䵽˾ͷһ
+*				3. ıķ·ķͶУСһϲͣ·Ͽʱһspool
+*				4. QoS1ͬʱֻһڵȴȷϣʱDUP־ֱطûȷϵ·
+*				5. PINGREQյκαĶлӦ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "mqttClient.h"
+#include "cmsis_os.h"
+#include "gprs.h"
+#include "modem.h"
+#include "dtuConfig.h"
+#include "modbusRTU_cli.h"
+#include "sdhError.h"
+#include "times.h"
+#include "debug.h"
+#include <stdio.h>
+#include <string.h>
+#if MQTT_ENABLE
+
+#define ADC_CHN_NUM		3
+#define TOPIC_BUF_LEN	( MQTT_TOPIC_LEN + 16)
+
+static struct {
+	//ȴϲ485
+	uint8_t		addr;
+	uint8_t		prio;				//Ͷеȼ
+	uint16_t	len;
+	uint32_t	start_ms;			//һ֡ʱ
+	char		batch[ MQTT_BATCH_LEN];
+
+	//ȴPUBACKQoS1·ͬһ
+	uint16_t	id;					//һʹõııʶ
+	uint16_t	wait_id;
+	uint8_t		wait_links;			//ûȷϵ·
+	uint8_t		retry;
+	uint8_t		sending;			//طĲܱ
+	uint16_t	pkt_len;
+	uint32_t	sent_ms;
+	char		pkt[ MQTT_PKT_LEN];
+
+	uint32_t	adc_s;				//һηADCݵʱ
+	uint16_t	alarm[ ADC_CHN_NUM];	//һηı״̬
+	//̵߳ջСƴʱʹ
+	//CONNECTSUBSCRIBEЩƱĺͲϲķgprsĹ֡ƴ
+	char		topic[ TOPIC_BUF_LEN];
+	uint8_t		ping_miss[IPMUX_NUM];
+	mqtt_rx_t	rx[IPMUX_NUM];
+	mqtt_stat_t	stat;
+}MqttCli;
+
+osMutexDef( MqttMutex);
+static osMutexId MqttMutex_id = NULL;
+
+static void mqtt_lock( void)
+{
+	osMutexWait( MqttMutex_id, osWaitForever);
+}
+
+static void mqtt_unlock( void)
+{
+	osMutexRelease( MqttMutex_id);
+}
+
+//%idtu_id%a%cnumMqttCli.topic
+static char *topic_fmt( char *fmt, int num)
+{
+	char	*out = MqttCli.topic;
+	char	*end = out + TOPIC_BUF_LEN - 12;
+
+	while( *fmt && out < end)
+	{
+		if( fmt[0] == '%' && fmt[1] == 'i')
+			out += sprintf( out, "%u", ( unsigned int)Dtu_config.dtu_id);
+		else if( fmt[0] == '%' && ( fmt[1] == 'a' || fmt[1] == 'c'))
+			out += sprintf( out, "%d", num);
+		else
+		{
+			*out ++ = *fmt ++;
+			continue;
+		}
+		fmt += 2;
+	}
+	*out = '\0';
+	return MqttCli.topic;
+}
+
+//ıĺ485һģӿڵͨ·ɷ
+static int uplink_send( char *data, int len, int prio)
+{
+	Modem	*modem = ModemGetInstance();
+	
+	return modem->send( modem, data, len, prio);
+}
+
+static uint16_t next_id( void)
+{
+	MqttCli.id ++;
+	if( MqttCli.id == 0)
+		MqttCli.id = 1;
+	return MqttCli.id;
+}
+
+//ѺϲݷȥQoS1ķڵȴȷϵʱ򷵻ERR_DEV_BUSY
+static int batch_flush( void)
+{
+	char	*topic;
+	uint8_t	qos = Dtu_config.mqtt_qos;
+	int		len, ret;
+
+	if( MqttCli.len == 0)
+		return ERR_OK;
+	if( MqttCli.wait_links || MqttCli.sending)
+		return ERR_DEV_BUSY;
+	topic = topic_fmt( Dtu_config.mqtt_topic[ MQTT_TOPIC_RTU], MqttCli.addr);
+	len = Mqtt_publish( MqttCli.pkt, MQTT_PKT_LEN, topic, MqttCli.batch, MqttCli.len, qos, qos ? next_id() : 0);
+	MqttCli.len = 0;
+	if( len < 0)
+	{
+		MqttCli.stat.drop ++;
+		return len;
+	}
+	//·ϿʱĴspoolָٷȷ
+	ret = uplink_send( MqttCli.pkt, len, MqttCli.prio);
+	if( ret != ERR_OK)
+	{
+		MqttCli.stat.drop ++;
+		return ret;
+	}
+	MqttCli.stat.pub ++;
+	if( qos == 0)
+		return ERR_OK;
+	MqttCli.wait_id = MqttCli.id;
+	MqttCli.wait_links = Gprs_last_route();
+	MqttCli.pkt_len = len;
+	MqttCli.retry = 0;
+	MqttCli.sent_ms = get_time_ms();
+	return ERR_OK;
+}
+
+//ݲϲQoS0ϷռQoS1ĵȴ
+static int urgent_publish( char *data, int len)
+{
+	char	*ctl;
+	int		n, size;
+	int		ret;
+
+	ctl = Gprs_frame_lock( &size);
+	n = Mqtt_publish( ctl, size, topic_fmt( Dtu_config.mqtt_topic[ MQTT_TOPIC_RTU], ( uint8_t)data[0]), \
+			data, len, 0, 0);
+	if( n < 0)
+		ret = ERR_BAD_PARAMETER;
+	else
+		ret = uplink_send( ctl, n, UPLINK_URGENT);
+	Gprs_frame_unlock();
+	//̫ıķERR_BAD_PARAMETERɵ߰ͨݺϲ
+	if( ret == ERR_BAD_PARAMETER)
+		return ret;
+	if( ret != ERR_OK)
+	{
+		MqttCli.stat.drop ++;
+		return ERR_MEM_UNAVAILABLE;
+	}
+	MqttCli.stat.pub ++;
+	MqttCli.stat.frames ++;
+	return ERR_OK;
+}
+
+/**
+ * @brief һ֡485ݣǰͬһַݺϲٷ.
+ *
+ * @details ַȼˡŲµʱȰǰݷȥ.
+ *			ݲϲֱӷķͶ.
+ *			QoS1ķûȷϡǰݷȥʱ򶪵ǰ.
+ * @retval	ERR_OK	ɹ
+ * @retval	ERR_UNINITIALIZED	ûMQTT
+ * @retval	ERR_MEM_UNAVAILABLE	ݱ
+ */
+int MqttClient_put( char *data, int len, int prio)
+{
+	int		n;
+	int		ret = ERR_OK;
+
+	if( MqttMutex_id == NULL)
+		return ERR_UNINITIALIZED;
+	mqtt_lock();
+	if( prio == UPLINK_URGENT)
+	{
+		//֮ǰϲȷУݻǻȷȥ
+		if( MqttCli.len)
+			batch_flush();
+		ret = urgent_publish( data, len);
+		if( ret != ERR_BAD_PARAMETER)
+		{
+			mqtt_unlock();
+			return ret;
+		}
+		//̫ʱͨݺϲ
+		ret = ERR_OK;
+		prio = UPLINK_NORMAL;
+	}
+	while( len > 0)
+	{
+		n = len > MQTT_BATCH_LEN ? MQTT_BATCH_LEN : len;
+		if( MqttCli.len && ( MqttCli.addr != ( uint8_t)data[0] || MqttCli.prio != prio || MqttCli.len + n > MQTT_BATCH_LEN))
+		{
+			if( batch_flush() == ERR_DEV_BUSY)
+			{
+				MqttCli.len = 0;
+				MqttCli.stat.drop ++;
+				ret = ERR_MEM_UNAVAILABLE;
+			}
+		}
+		if( MqttCli.len == 0)
+		{
+			MqttCli.addr = data[0];
+			MqttCli.prio = prio;
+			MqttCli.start_ms = get_time_ms();
+		}
+		memcpy( MqttCli.batch + MqttCli.len, data, n);
+		MqttCli.len += n;
+		MqttCli.stat.frames ++;
+		data += n;
+		len -= n;
+	}
+	mqtt_unlock();
+	return ret;
+}
+
+//ADCQoS0һڵݻȡ
+//ֵ3λСøĸʽջϷŲ
+static void adc_publish( void)
+{
+	gprs_t		*this_gprs = GprsGetInstance();
+	char		val[16];
+	char		*ctl;
+	uint32_t	u32;
+	int32_t		milli;
+	float		f;
+	int			chn, len, size;
+
+	for( chn = 0; chn < ADC_CHN_NUM; chn ++)
+	{
+		//modbusĴһÿͨĹֵռĴ
+		u32 = regType4_read( chn * 2, REG_LINE) | ( ( uint32_t)regType4_read( chn * 2 + 1, REG_LINE) << 16);
+		memcpy( &f, &u32, sizeof( f));
+		milli = ( int32_t)( f * 1000);
+		sprintf( val, "%s%d.%03d", milli < 0 ? "-" : "", ( int)( milli < 0 ? -milli : milli) / 1000, \
+				( int)( milli < 0 ? -milli : milli) % 1000);
+		ctl = Gprs_frame_lock( &size);
+		len = Mqtt_publish( ctl, size, topic_fmt( Dtu_config.mqtt_topic[ MQTT_TOPIC_ADC], chn), \
+				val, strlen( val), 0, 0);
+		if( len > 0 && this_gprs->sendto_tcp_buf( this_gprs, ctl, len) == ERR_OK)
+			MqttCli.stat.pub ++;
+		else
+			MqttCli.stat.drop ++;
+		Gprs_frame_unlock();
+	}
+}
+
+//ADCı״̬˾ϷADCݵ/alarm
+static void alarm_publish( void)
+{
+	char		val[8];
+	char		*topic;
+	char		*ctl;
+	uint16_t	alarm;
+	int			chn, len, size;
+
+	for( chn = 0; chn < ADC_CHN_NUM; chn ++)
+	{
+		alarm = regType4_read( chn + 9, REG_LINE);
+		if( alarm == MqttCli.alarm[ chn])
+			continue;
+		topic = topic_fmt( Dtu_config.mqtt_topic[ MQTT_TOPIC_ADC], chn);
+		strcat( topic, "/alarm");
+		sprintf( val, "%d", alarm);
+		ctl = Gprs_frame_lock( &size);
+		len = Mqtt_publish( ctl, size, topic, val, strlen( val), 0, 0);
+		//Ųеʱ´ٷ
+		if( len > 0 && uplink_send( ctl, len, UPLINK_URGENT) == ERR_OK)
+		{
+			MqttCli.alarm[ chn] = alarm;
+			MqttCli.stat.pub ++;
+		}
+		Gprs_frame_unlock();
+	}
+}
+
+/**
+ * @brief gprsrunԵãȴʱ䵽˵ݣطûȷϵQoS1.
+ *
+ */
+void MqttClient_run( void)
+{
+	gprs_t		*this_gprs = GprsGetInstance();
+	uint32_t	now = get_time_ms();
+	uint8_t		resend = 0;
+	int			j;
+
+	if( MqttMutex_id == NULL)
+		return;
+	mqtt_lock();
+	if( MqttCli.len && now - MqttCli.start_ms >= Dtu_config.mqtt_batch_ms)
+		batch_flush();
+	if( Dtu_config.mqtt_adc_s && NEED_ADC( Dtu_config.work_mode) && \
+		get_time_s() - MqttCli.adc_s >= Dtu_config.mqtt_adc_s)
+	{
+		MqttCli.adc_s = get_time_s();
+		adc_publish();
+	}
+	if( NEED_ADC( Dtu_config.work_mode))
+		alarm_publish();
+	//Ͽ·ٵȴspoolµķ
+	MqttCli.wait_links &= Gprs_established();
+	if( MqttCli.wait_links && now - MqttCli.sent_ms >= MQTT_ACK_MS)
+	{
+		if( MqttCli.retry >= MQTT_RETRY_MAX)
+		{
+			DPRINTF("[MQTT] give up publish %d \n", MqttCli.wait_id);
+			MqttCli.stat.lost ++;
+			MqttCli.wait_links = 0;
+		}
+		else
+		{
+			MqttCli.retry ++;
+			MqttCli.stat.retrans ++;
+			MqttCli.sent_ms = now;
+			MqttCli.pkt[0] |= MQTT_DUP_FLAG;
+			MqttCli.sending = 1;
+			resend = MqttCli.wait_links;
+		}
+	}
+	mqtt_unlock();
+
+	//طʱ򲻳485߳̿Լ
+	for( j = 0; j < IPMUX_NUM && resend; j ++)
+	{
+		if( CHK_U8_BIT( resend, j))
+			this_gprs->sendto_tcp( this_gprs, j, MqttCli.pkt, MqttCli.pkt_len);
+	}
+	MqttCli.sending = 0;
+}
+
+/**
+ * @brief ӽCONNECT˶ʱٶ.
+ *
+ * @details Ҫgprs. ȴCONNACKЭCONNECT֮Ϸ.
+ */
+int MqttClient_link_up( int link)
+{
+	gprs_t	*this_gprs = GprsGetInstance();
+	char	client[16];
+	char	*topic;
+	char	*ctl;
+	int		len, size;
+	int		ret = ERR_OK;
+	uint32_t	keepalive_s = Dtu_config.hartbeat_timespan_s;
+
+	if( link >= IPMUX_NUM || MqttMutex_id == NULL)
+		return ERR_BAD_PARAMETER;
+	//ûʱPINGREQȴ1.5ıʱ
+	if( keepalive_s > 0xffff)
+		keepalive_s = 0xffff;
+	sprintf( client, "dtu%u", ( unsigned int)Dtu_config.dtu_id);
+
+	mqtt_lock();
+	Mqtt_rx_init( &MqttCli.rx[ link]);
+	MqttCli.ping_miss[ link] = 0;
+	MqttCli.wait_links = CLR_U8_BIT( MqttCli.wait_links, link);
+	ctl = Gprs_frame_lock( &size);
+	len = Mqtt_connect( ctl, size, client, Dtu_config.mqtt_user, Dtu_config.mqtt_pass, keepalive_s);
+	if( len > 0)
+		ret = this_gprs->sendto_tcp( this_gprs, link, ctl, len);
+	else
+		ret = len;
+	topic = topic_fmt( Dtu_config.mqtt_topic[ MQTT_TOPIC_SUB], 0);
+	if( ret == ERR_OK && topic[0])
+	{
+		len = Mqtt_subscribe( ctl, size, topic, next_id());
+		if( len > 0)
+			ret = this_gprs->sendto_tcp( this_gprs, link, ctl, len);
+		else
+			ret = len;
+	}
+	Gprs_frame_unlock();
+	mqtt_unlock();
+	return ret;
+}
+
+/**
+ * @brief ·յݣϵbuf.
+ *
+ * @details Ҫgprs.
+ * @retval	>=0	bufݳ
+ * @retval	ERR_FAIL	ܾ
+ */
+int MqttClient_input( int link, char *buf, int len)
+{
+	gprs_t		*this_gprs = GprsGetInstance();
+	mqtt_rx_t	*rx;
+	char		*ctl;
+	int			n, size;
+	int			refused = 0;
+
+	if( link >= IPMUX_NUM || MqttMutex_id == NULL)
+		return len;
+	rx = &MqttCli.rx[ link];
+	mqtt_lock();
+	n = Mqtt_input( rx, buf, len, buf);
+	if( rx->got)
+		MqttCli.ping_miss[ link] = 0;
+	if( ( rx->got & ( 1 << MQTT_PUBACK)) && rx->puback_id == MqttCli.wait_id)
+		MqttCli.wait_links = CLR_U8_BIT( MqttCli.wait_links, link);
+	if( ( rx->got & ( 1 << MQTT_CONNACK)) && rx->connack_rc)
+		refused = 1;
+	if( rx->pub_ack)
+	{
+		ctl = Gprs_frame_lock( &size);
+		this_gprs->sendto_tcp( this_gprs, link, ctl, Mqtt_puback( ctl, rx->pub_id));
+		Gprs_frame_unlock();
+	}
+	rx->pub_ack = 0;
+	rx->got = 0;
+	mqtt_unlock();
+
+	if( refused)
+	{
+		DPRINTF("[MQTT] link %d refused %d \n", link, rx->connack_rc);
+		return ERR_FAIL;
+	}
+	return n;
+}
+
+/**
+ * @brief ʱãPINGREQ.
+ *
+ * @details Ҫgprs.
+ * @retval	ERR_DEV_TIMEOUT	ǰPINGREQûлӦѾ
+ */
+int MqttClient_ping( int link)
+{
+	gprs_t	*this_gprs = GprsGetInstance();
+	char	*ctl;
+	int		ret, size;
+
+	if( link >= IPMUX_NUM || MqttMutex_id == NULL)
+		return ERR_BAD_PARAMETER;
+	mqtt_lock();
+	if( MqttCli.ping_miss[ link] >= MQTT_PING_MISS_MAX)
+	{
+		MqttCli.ping_miss[ link] = 0;
+		ret = ERR_DEV_TIMEOUT;
+	}
+	else
+	{
+		MqttCli.ping_miss[ link] ++;
+		ctl = Gprs_frame_lock( &size);
+		ret = this_gprs->sendto_tcp( this_gprs, link, ctl, Mqtt_simple( ctl, MQTT_PINGREQ));
+		Gprs_frame_unlock();
+	}
+	mqtt_unlock();
+	return ret;
+}
+
+int MqttClient_on( void)
+{
+	return MqttMutex_id != NULL;
+}
+
+mqtt_stat_t *MqttClient_stat( void)
+{
+	return &MqttCli.stat;
+}
+
+//MQTTųʼûгʼʱӿڶ
+int MqttClient_init( void)
+{
+	if( Dtu_config.mqtt_on == 0)
+		return ERR_OK;
+	memset( &MqttCli, 0, sizeof( MqttCli));
+	if( MqttMutex_id == NULL)
+		MqttMutex_id = osMutexCreate( osMutex( MqttMutex));
+	if( MqttMutex_id == NULL)
+		return ERR_RES_UNAVAILABLE;
+	return ERR_OK;
+}
+#else
+static mqtt_stat_t	MqttStat;
+
+int MqttClient_init( void)
+{
+	return ERR_OK;
+}
+
+int MqttClient_on( void)
+{
+	return 0;
+}
+
+int MqttClient_put( char *data, int len, int prio)
+{
+	return ERR_UNINITIALIZED;
+}
+
+int MqttClient_link_up( int link)
+{
+	return ERR_OK;
+}
+
+int MqttClient_input( int link, char *buf, int len)
+{
+	return len;
+}
+
+int MqttClient_ping( int link)
+{
+	return ERR_OK;
+}
+
+void MqttClient_run( void)
+{
+}
+
+mqtt_stat_t *MqttClient_stat( void)
+{
+	return &MqttStat;
+}
+#endif
@@ -0,0 +1,41 @@
+#ifndef __MQTTCLIENT_H__
+#define __MQTTCLIENT_H__
+#include <stdint.h>
+#include "mqtt.h"
+
+//ʹMQTTЭʱ485ݰRTUַͬ⣬ADCݰͨ
+//ͬһַĶ֡ϲһηıĺԭһ·ķͶ
+//PINGREQûлӦͶϿ
+//%idtu_id%aRTUַ%cADCͨ
+//ADCı״̬仯ʱýȼADC/alarm
+//ûбMQTTʱӿڶǿյģMqttClient_on0mqtt.h
+#define MQTT_TOPIC_LEN		32
+#define MQTT_TOPIC_RTU		0			//485ݵķ
+#define MQTT_TOPIC_ADC		1			//ADCݵķ
+#define MQTT_TOPIC_SUB		2			//ݵĶ⣬յݺԭһ
+#define MQTT_TOPIC_NUM		3
+
+#define MQTT_BATCH_LEN		160			//һηϲ
+#define MQTT_PKT_LEN		( MQTT_BATCH_LEN + MQTT_TOPIC_LEN + 16)		//ҪСڷͶһܷĳ
+#define MQTT_ACK_MS			5000		//QoS1ȴPUBACKʱ䣬ʱط
+#define MQTT_RETRY_MAX		3
+#define MQTT_PING_MISS_MAX	2			//ٴPINGREQûлӦΪѾ
+
+typedef struct {
+	uint32_t	pub;			//Ĵ
+	uint32_t	frames;			//ϲ485֡
+	uint32_t	retrans;		//QoS1طĴ
+	uint32_t	lost;			//طķ
+	uint32_t	drop;			//ûзȥͶķ
+}mqtt_stat_t;
+
+int MqttClient_init( void);
+int MqttClient_on( void);
+int MqttClient_put( char *data, int len, int prio);
+int MqttClient_link_up( int link);
+int MqttClient_input( int link, char *buf, int len);
+int MqttClient_ping( int link);
+void MqttClient_run( void);
+mqtt_stat_t *MqttClient_stat( void);
+
+#endif
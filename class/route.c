@@ -0,0 +1,208 @@
+/**
+* @file 		route.c
+* @brief		ĵ·ɺĵĽ״̬.
+* @details		1. ¼ÿĵķʹʧܴRTTͳʱûȷϵĴ
+*				2. õķʽѡݷЩģȫлֵ
+*				3. ֻѡ񣬲ģ飬ԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "route.h"
+#include <string.h>
+
+#define NO_LINK		0xff
+
+static struct {
+	uint8_t			mode;
+	uint8_t			primary;
+	uint8_t			active;			//лʱʹõ
+	uint8_t			rr;				//ֵʱһѡ
+	uint32_t		failovers;		//лĴ
+	route_center_t	c[ROUTE_CENTER_NUM];
+}Route;
+
+void Route_init( uint8_t mode, uint8_t primary)
+{
+	int j;
+
+	memset( &Route, 0, sizeof( Route));
+	Route.mode = mode;
+	Route.primary = primary < ROUTE_CENTER_NUM ? primary : 0;
+	Route.active = NO_LINK;
+	for( j = 0; j < ROUTE_CENTER_NUM; j ++)
+		Route.c[ j].healthy = 1;
+}
+
+uint8_t Route_mode( void)
+{
+	return Route.mode;
+}
+
+//½֮Ϊãǰʧܲټ
+void Route_link_up( int link, uint32_t now_s)
+{
+	if( link >= ROUTE_CENTER_NUM)
+		return;
+	Route.c[ link].healthy = 1;
+	Route.c[ link].fail_run = 0;
+	Route.c[ link].healthy_s = now_s;
+}
+
+//ͳɹֻ˵ݽģ飬òõĻָ
+void Route_sent( int link, int ok)
+{
+	route_center_t	*c;
+
+	if( link >= ROUTE_CENTER_NUM)
+		return;
+	c = &Route.c[ link];
+	c->sends ++;
+	if( ok)
+	{
+		c->fail_run = 0;
+		return;
+	}
+	c->fails ++;
+	if( ++ c->fail_run >= ROUTE_FAIL_MAX)
+		c->healthy = 0;
+}
+
+//ݱԶȷˣǿõ
+void Route_rtt( int link, uint32_t ms, uint32_t now_s)
+{
+	route_center_t	*c;
+
+	if( link >= ROUTE_CENTER_NUM)
+		return;
+	c = &Route.c[ link];
+	if( ms > 0xffff)
+		ms = 0xffff;
+	if( c->srtt_ms == 0)
+		c->srtt_ms = ms ? ms : 1;
+	else
+		c->srtt_ms = ( c->srtt_ms * 7 + ms) / 8;
+	if( c->healthy == 0)
+	{
+		c->healthy = 1;
+		c->healthy_s = now_s;
+	}
+}
+
+void Route_stall( int link)
+{
+	if( link >= ROUTE_CENTER_NUM)
+		return;
+	Route.c[ link].stalls ++;
+	Route.c[ link].healthy = 0;
+}
+
+//Ųҿõģõʱŵģܱȶݺ
+uint8_t Route_usable( uint8_t up)
+{
+	uint8_t	set = 0;
+	int		j;
+
+	if( Route.mode == ROUTE_ALL)
+		return up;
+	for( j = 0; j < ROUTE_CENTER_NUM; j ++)
+	{
+		if( ( up & ( 1 << j)) && Route.c[ j].healthy)
+			set |= 1 << j;
+	}
+	return set ? set : up;
+}
+
+static uint8_t pick_failover( uint8_t usable, uint32_t now_s)
+{
+	uint8_t	p = Route.primary;
+	uint8_t	a = Route.active;
+	int		k, j;
+
+	//Ļָȶһʱлȥл
+	if( a != NO_LINK && ( usable & ( 1 << a)))
+	{
+		if( a != p && ( usable & ( 1 << p)) && Route.c[ p].healthy && now_s - Route.c[ p].healthy_s >= ROUTE_HOLDDOWN_S)
+			a = p;
+	}
+	else
+	{
+		for( k = 0; k < ROUTE_CENTER_NUM; k ++)
+		{
+			j = ( p + k) % ROUTE_CENTER_NUM;
+			if( usable & ( 1 << j))
+				break;
+		}
+		a = j;
+	}
+	if( Route.active != NO_LINK && a != Route.active)
+		Route.failovers ++;
+	Route.active = a;
+	return 1 << a;
+}
+
+static uint8_t pick_balance( uint8_t usable)
+{
+	uint16_t	min = 0;
+	uint16_t	rtt;
+	int			k, j;
+
+	for( j = 0; j < ROUTE_CENTER_NUM; j ++)
+	{
+		rtt = Route.c[ j].srtt_ms;
+		if( ( usable & ( 1 << j)) && rtt && ( min == 0 || rtt < min))
+			min = rtt;
+	}
+	for( k = 1; k <= ROUTE_CENTER_NUM; k ++)
+	{
+		j = ( Route.rr + k) % ROUTE_CENTER_NUM;
+		if( ( usable & ( 1 << j)) == 0)
+			continue;
+		rtt = Route.c[ j].srtt_ms;
+		if( min == 0 || rtt == 0 || rtt <= min * 2)
+			break;
+	}
+	//usableǿյģǸܻᱻѡ
+	if( k > ROUTE_CENTER_NUM)
+		return usable;
+	Route.rr = j;
+	return 1 << j;
+}
+
+/**
+ * @brief ѡһ֡Ҫ.
+ *
+ * @param[in]	up	Ѿӵĵļ
+ * @retval	ĵļϣûӵʱ0
+ */
+uint8_t Route_pick( uint8_t up, uint32_t now_s)
+{
+	uint8_t	usable;
+
+	if( Route.mode == ROUTE_ALL || up == 0)
+		return up;
+	usable = Route_usable( up);
+	if( Route.mode == ROUTE_FAILOVER)
+		return pick_failover( usable, now_s);
+	return pick_balance( usable);
+}
+
+//лʱʹõģûѡʱ򷵻-1
+int Route_active( void)
+{
+	if( Route.mode != ROUTE_FAILOVER || Route.active == NO_LINK)
+		return -1;
+	return Route.active;
+}
+
+uint32_t Route_failovers( void)
+{
+	return Route.failovers;
+}
+
+route_center_t *Route_get( int link)
+{
+	if( link >= ROUTE_CENTER_NUM)
+		return NULL;
+	return &Route.c[ link];
+}
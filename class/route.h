@@ -0,0 +1,42 @@
+#ifndef __ROUTE_H__
+#define __ROUTE_H__
+#include <stdint.h>
+
+//ĵ·ɣԭÿһ֡еģڿֻģ
+//Ĳõʱеģڿõֵ֮
+//ĶӺлʱ
+//Ƿ״̬ʧܺݶûбԶȷж
+#define ROUTE_CENTER_NUM	4		//gprs.hIPMUX_NUMһ£ﲻgprs.hPCϲ
+
+#define ROUTE_ALL			0		//
+#define ROUTE_FAILOVER		1		//ģõʱŷһ
+#define ROUTE_BALANCE		2		//ڿõ֮ͣRTTһϵĲμ
+
+#define ROUTE_FAIL_MAX		2		//ʧܶٴΪĲ
+#define ROUTE_STALL_MS		3000	//ݷȥûûбȷΪĲãлʱ䲻ᳬټһβѯ
+#define ROUTE_RTT_POLL_MS	200		//RTTʱAT+CIPACKѯļ
+#define ROUTE_HOLDDOWN_S	30		//Ļָ֮ȶòлȥ
+
+typedef struct {
+	uint8_t		healthy;
+	uint8_t		fail_run;		//ʧܵĴ
+	uint16_t	srtt_ms;		//ƽRTT0ʾûв
+	uint32_t	sends;
+	uint32_t	fails;
+	uint32_t	stalls;			//ȥݳʱûбȷϵĴ
+	uint32_t	healthy_s;		//һλָõʱ
+}route_center_t;
+
+void Route_init( uint8_t mode, uint8_t primary);
+uint8_t Route_mode( void);
+void Route_link_up( int link, uint32_t now_s);
+void Route_sent( int link, int ok);
+void Route_rtt( int link, uint32_t ms, uint32_t now_s);
+void Route_stall( int link);
+uint8_t Route_usable( uint8_t up);
+uint8_t Route_pick( uint8_t up, uint32_t now_s);
+int Route_active( void);
+uint32_t Route_failovers( void);
+route_center_t *Route_get( int link);
+
+#endif
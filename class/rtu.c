@@ -28,7 +28,7 @@ int RtuInit( RtuInstance *self, int workmode)
 		case MODE_PASSTHROUGH:
 			self->modbusProcess = GetEmptyProcess();
 			self->forwardSMS = GetEmptyProcess();
-			self->forwardNet = GetForwardNet();
+			self->forwardNet = ( MQTT_ENABLE && Dtu_config.mqtt_on) ? GetForwardMqtt() : GetForwardNet();
 			break;
 		case MODE_SMS:
 			self->modbusProcess = GetEmptyProcess();
@@ -135,9 +135,11 @@ static void ModbusRTURegTpye3_wrCB(void)
 		
 	}
 	
+	fs_lock();
 	fs_lseek( DtuCfg_file, WR_SEEK_SET, 0);
 	fs_write( DtuCfg_file, (uint8_t *)&Dtu_config, sizeof( DtuCfg_t));
 	fs_flush();
+	fs_unlock();
 	osDelay(10);
 	
 	
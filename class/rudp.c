@@ -0,0 +1,148 @@
+/**
+* @file 		rudp.c
+* @brief		UDP·ϵšȷϺط.
+* @details		1. ֡ڷͻյȷ֮ǰµ֡
+*				2. ʱûȷϾطȴʱÿμӱͷһ֡
+*				3. յ֡ظȷϣźһ֡ͬǶԶ˵طֻȷϲϲ
+*				4. ӲԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "rudp.h"
+#include "sdhError.h"
+#include <string.h>
+#if RUDP_ENABLE
+
+void Rudp_init( rudp_t *r, char *tx_buf)
+{
+	memset( r, 0, sizeof( rudp_t));
+	r->tx_buf = tx_buf;
+}
+
+static void rudp_head( char *buf, uint8_t type, uint8_t seq, int len)
+{
+	buf[0] = ( char)RUDP_MAGIC;
+	buf[1] = type;
+	buf[2] = seq;
+	buf[3] = ( len >> 8) & 0xff;
+	buf[4] = len & 0xff;
+}
+
+//ݴ֡ŵͻ֡ĳ
+//һ֡ûȷϵʱ򷵻0
+int Rudp_pack( rudp_t *r, char *data, int len, uint32_t now_ms)
+{
+	if( r->wait)
+		return 0;
+	if( len > RUDP_DATA_MAX)
+		return ERR_BAD_PARAMETER;
+	rudp_head( r->tx_buf, RUDP_DATA, r->tx_seq, len);
+	memcpy( r->tx_buf + RUDP_HEAD_LEN, data, len);
+	r->tx_len = RUDP_HEAD_LEN + len;
+	r->tx_seq ++;
+	r->wait = 1;
+	r->retry = 0;
+	r->tx_ms = now_ms;
+	return r->tx_len;
+}
+
+//ԵãҪط֡ĳȣ֡tx_buf
+//Ҫط0һ֡ʱ򷵻ERR_FAIL
+int Rudp_poll( rudp_t *r, uint32_t now_ms)
+{
+	if( r->wait == 0)
+		return 0;
+	if( now_ms - r->tx_ms < ( ( uint32_t)RUDP_RTO_MS << r->retry))
+		return 0;
+	if( r->retry >= RUDP_RETRY_MAX)
+	{
+		r->wait = 0;
+		r->lost ++;
+		return ERR_FAIL;
+	}
+	r->retry ++;
+	r->retrans ++;
+	r->tx_ms = now_ms;
+	return r->tx_len;
+}
+
+//֡ͷ
+static void rudp_frame( rudp_t *r)
+{
+	uint8_t		seq = r->head[2];
+	uint16_t	len = ( ( uint8_t)r->head[3] << 8) | ( uint8_t)r->head[4];
+
+	if( len > RUDP_DATA_MAX)
+	{
+		r->bad += RUDP_HEAD_LEN;
+		return;
+	}
+	r->remain = len;
+	r->skip = 1;
+	if( r->head[1] == RUDP_ACK)
+	{
+		//ֻܶڵȴһ֡ȷ
+		if( r->wait && seq == ( uint8_t)( r->tx_seq - 1))
+			r->wait = 0;
+		return;
+	}
+	if( r->head[1] != RUDP_DATA)
+	{
+		r->bad += RUDP_HEAD_LEN + len;
+		return;
+	}
+	//ȷ϶˶Զ˻طظ֡ҲҪȷһ
+	r->ack_seq = seq;
+	r->ack_pend = 1;
+	if( r->rx_any && seq == r->rx_seq)
+	{
+		r->dup ++;
+		return;
+	}
+	r->rx_seq = seq;
+	r->rx_any = 1;
+	r->skip = 0;
+}
+
+//յݣ֡дoutдĳ
+//дĳȲᳬѾĳȣoutԺinͬһ
+int Rudp_input( rudp_t *r, char *in, int len, char *out)
+{
+	int i;
+	int n = 0;
+
+	for( i = 0; i < len; i ++)
+	{
+		if( r->remain)
+		{
+			r->remain --;
+			if( r->skip == 0)
+				out[ n ++] = in[i];
+			continue;
+		}
+		//֮֡ݶֱһ֡ͷ
+		if( r->st == 0 && ( uint8_t)in[i] != RUDP_MAGIC)
+		{
+			r->bad ++;
+			continue;
+		}
+		r->head[ r->st ++] = in[i];
+		if( r->st < RUDP_HEAD_LEN)
+			continue;
+		r->st = 0;
+		rudp_frame( r);
+	}
+	return n;
+}
+
+//ȷҪظʱȷ֡֡ĳ
+int Rudp_ack( rudp_t *r, char *buf)
+{
+	if( r->ack_pend == 0)
+		return 0;
+	r->ack_pend = 0;
+	rudp_head( buf, RUDP_ACK, r->ack_seq, 0);
+	return RUDP_HEAD_LEN;
+}
+#endif
@@ -0,0 +1,55 @@
+#ifndef __RUDP_H__
+#define __RUDP_H__
+#include <stdint.h>
+
+//UDP·ϵļ򵥿ɿ䣬Ҫͬĸʽշ
+//֡ʽ0xA5   ȸֽ ȵֽ ...
+//	'D'֡յҪظȷϣ'A'ȷ֡Ǳȷϵ֡ţû
+//ÿͬʱֻһ֡ûȷϣͣȣͶѾСݺϲ֡
+//յݰֽ֡ͷݿԷڶ
+//ÿõ·Ҫһ֡ط棬R8Ŀռ䲻Ĭϲȥ
+#ifndef RUDP_ENABLE
+#define RUDP_ENABLE			0
+#endif
+
+#define RUDP_MAGIC			0xA5
+#define RUDP_DATA			'D'
+#define RUDP_ACK			'A'
+#define RUDP_HEAD_LEN		5
+#define RUDP_DATA_MAX		256			//һ֡
+#define RUDP_RTO_MS			2000		//һطǰȴʱ䣬֮ÿμӱ
+#define RUDP_RETRY_MAX		3			//طٴûȷϾͷһ֡
+
+typedef struct {
+	//
+	uint8_t		tx_seq;			//һ֡
+	uint8_t		wait;			//֡ڵȴȷ
+	uint8_t		retry;
+	uint16_t	tx_len;			//ȴȷϵ֡ĳȣ֡ͷ
+	uint32_t	tx_ms;			//һη͵ʱ
+	char		*tx_buf;		//ȴȷϵ֡ȲСRUDP_HEAD_LEN + RUDP_DATA_MAX
+
+	//
+	uint8_t		rx_seq;			//յ֡
+	uint8_t		rx_any;			//յ֡
+	uint8_t		ack_seq;		//Ҫظȷ
+	uint8_t		ack_pend;
+	uint8_t		st;				//֡ͷѾյֽ
+	uint8_t		skip;			//ظ֡ݶ
+	uint16_t	remain;			//ǰ֡ûյݳ
+	char		head[ RUDP_HEAD_LEN];
+
+	//ͳ
+	uint32_t	retrans;		//طĴ
+	uint32_t	lost;			//֡
+	uint32_t	dup;			//յظ֡
+	uint32_t	bad;			//֡ⶪֽ
+}rudp_t;
+
+void Rudp_init( rudp_t *r, char *tx_buf);
+int Rudp_pack( rudp_t *r, char *data, int len, uint32_t now_ms);
+int Rudp_poll( rudp_t *r, uint32_t now_ms);
+int Rudp_input( rudp_t *r, char *in, int len, char *out);
+int Rudp_ack( rudp_t *r, char *buf);
+
+#endif
@@ -0,0 +1,308 @@
+/**
+* @file 		smsPdu.c
+* @brief		PDUʽıͽ.
+* @details		1. ͣSMS-SUBMIT8λ룬һķֶβϳŵͷ
+*				2. գSMS-DELIVERͷͳŵͷ7λ/8λ/UCS2
+*				3. ĵַģõģAT+CSCAPDU00
+*				4. ģ飬ԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "smsPdu.h"
+#include "sdhError.h"
+#include <string.h>
+
+#define PDU_MTI_SUBMIT		0x01
+#define PDU_UDHI			0x40		//ûͷ
+#define PDU_TYPE_INTL		0x91		//ʺ
+#define PDU_TYPE_UNKNOWN	0x81
+#define PDU_TON_MASK		0x70
+#define PDU_TON_INTL		0x10
+#define PDU_TON_ALNUM		0x50		//ĸֵĵַ
+#define PDU_DCS_8BIT		0x04
+#define PDU_IEI_CONCAT8		0x00		//ţ8λο
+#define PDU_IEI_CONCAT16	0x08		//ţ16λο
+#define GSM_ESC				0x1B
+
+static const char Hex[] = "0123456789ABCDEF";
+
+//7λĬĸASCIIһַASCIIûе'?'
+static char gsm7_char( uint8_t c)
+{
+	switch( c)
+	{
+		case 0x00:	return '@';
+		case 0x02:	return '$';
+		case 0x0A:	return '\n';
+		case 0x0D:	return '\r';
+		case 0x11:	return '_';
+		case 0x24:	return '?';
+		case 0x40:	return '?';
+	}
+	if( c < 0x20 || ( c > 0x5A && c < 0x61) || c > 0x7A)
+		return '?';
+	return c;
+}
+
+//ת֮չַ
+static char gsm7_ext( uint8_t c)
+{
+	switch( c)
+	{
+		case 0x14:	return '^';
+		case 0x28:	return '{';
+		case 0x29:	return '}';
+		case 0x2F:	return '\\';
+		case 0x3C:	return '[';
+		case 0x3D:	return '~';
+		case 0x3E:	return ']';
+		case 0x40:	return '|';
+	}
+	return '?';
+}
+
+//i7λַλǰ
+static uint8_t septet( const uint8_t *ud, int ud_bytes, int i)
+{
+	int		bit = i * 7;
+	int		k = bit / 8;
+	int		s = bit % 8;
+	uint16_t	v = ud[ k];
+
+	if( k + 1 < ud_bytes)
+		v |= ( uint16_t)ud[ k + 1] << 8;
+	return ( v >> s) & 0x7f;
+}
+
+//8λҪֳɼ
+int SmsPdu_parts( int len)
+{
+	if( len <= SMS_PDU_8BIT_MAX)
+		return 1;
+	return ( len + SMS_PDU_CONCAT_8BIT - 1) / SMS_PDU_CONCAT_8BIT;
+}
+
+//seqεֽseq1ʼ
+int SmsPdu_part_len( int len, int seq)
+{
+	int		n;
+
+	if( SmsPdu_parts( len) == 1)
+		return len;
+	n = len - ( seq - 1) * SMS_PDU_CONCAT_8BIT;
+	return n > SMS_PDU_CONCAT_8BIT ? SMS_PDU_CONCAT_8BIT : n;
+}
+
+/**
+ * @brief һ8λSMS-SUBMITû֮ǰĲ.
+ *
+ * @details ֱӽlenֽڵݾPDU.
+ *			AT+CMGSĳǷֵ - 1 + lenĵַǸֽ.
+ * @param[out]	head	SMS_PDU_HEAD_MAXֽ
+ * @param[in]	total	ܶ1ʱ򲻼ӳŵͷ
+ * @retval	>0	headֽ
+ * @retval	ERR_BAD_PARAMETER	벻Ի̫
+ */
+int SmsPdu_submit_head( uint8_t *head, const char *phone, int len, uint8_t ref, uint8_t total, uint8_t seq)
+{
+	uint8_t	type = PDU_TYPE_UNKNOWN;
+	int		digits, i;
+	int		n = 0;
+
+	if( len < 0 || len > ( total > 1 ? SMS_PDU_CONCAT_8BIT : SMS_PDU_8BIT_MAX) || seq < 1 || seq > total)
+		return ERR_BAD_PARAMETER;
+	if( *phone == '+')
+	{
+		type = PDU_TYPE_INTL;
+		phone ++;
+	}
+	for( digits = 0; phone[ digits] >= '0' && phone[ digits] <= '9'; digits ++)
+		;
+	if( digits == 0 || digits >= SMS_PDU_PHONE_LEN - 1 || phone[ digits] != '\0')
+		return ERR_BAD_PARAMETER;
+
+	head[ n ++] = 0;
+	head[ n ++] = PDU_MTI_SUBMIT | ( total > 1 ? PDU_UDHI : 0);
+	head[ n ++] = 0;
+	head[ n ++] = digits;
+	head[ n ++] = type;
+	//ÿλλʱF
+	for( i = 0; i < digits; i += 2)
+		head[ n ++] = ( phone[ i] - '0') | ( i + 1 < digits ? ( phone[ i + 1] - '0') << 4 : 0xF0);
+	head[ n ++] = 0;
+	head[ n ++] = PDU_DCS_8BIT;
+	if( total <= 1)
+	{
+		head[ n ++] = len;
+		return n;
+	}
+	head[ n ++] = len + SMS_PDU_UDH_LEN;
+	head[ n ++] = SMS_PDU_UDH_LEN - 1;
+	head[ n ++] = PDU_IEI_CONCAT8;
+	head[ n ++] = 3;
+	head[ n ++] = ref;
+	head[ n ++] = total;
+	head[ n ++] = seq;
+	return n;
+}
+
+//תʮƵַhex2 * len + 1ֽ
+void SmsPdu_hex( char *hex, const uint8_t *data, int len)
+{
+	while( len -- > 0)
+	{
+		*hex ++ = Hex[ *data >> 4];
+		*hex ++ = Hex[ *data ++ & 0x0f];
+	}
+	*hex = '\0';
+}
+
+//ûͷֻĳŵϢ
+static void parse_udh( const uint8_t *udh, int udhl, sms_pdu_t *msg)
+{
+	int		i = 0;
+	int		iei, iel;
+
+	while( i + 2 <= udhl)
+	{
+		iei = udh[ i];
+		iel = udh[ i + 1];
+		i += 2;
+		if( i + iel > udhl)
+			return;
+		if( iei == PDU_IEI_CONCAT8 && iel == 3 && udh[ i + 1] > 1 && udh[ i + 2] >= 1 && udh[ i + 2] <= udh[ i + 1])
+		{
+			msg->ref = udh[ i];
+			msg->total = udh[ i + 1];
+			msg->seq = udh[ i + 2];
+		}
+		else if( iei == PDU_IEI_CONCAT16 && iel == 4 && udh[ i + 2] > 1 && udh[ i + 3] >= 1 && udh[ i + 3] <= udh[ i + 2])
+		{
+			msg->ref = ( udh[ i] << 8) | udh[ i + 1];
+			msg->total = udh[ i + 2];
+			msg->seq = udh[ i + 3];
+		}
+		i += iel;
+	}
+}
+
+static uint8_t dcs_coding( uint8_t dcs)
+{
+	uint8_t	alpha;
+
+	//ݱ
+	if( ( dcs & 0xF0) == 0xF0)
+		return ( dcs & 0x04) ? SMS_PDU_8BIT : SMS_PDU_7BIT;
+	if( ( dcs & 0x80) == 0)
+	{
+		alpha = ( dcs >> 2) & 3;
+		if( alpha == 1)
+			return SMS_PDU_8BIT;
+		if( alpha == 2)
+			return SMS_PDU_UCS2;
+	}
+	return SMS_PDU_7BIT;
+}
+
+/**
+ * @brief յSMS-DELIVER.
+ *
+ * @param[in]	pdu		AT+CMGLгPDUתɵֽڣĵַ
+ * @param[out]	msg		롢ͳŵϢ
+ * @param[out]	data	ݣΪNULLʱֻͷݳsizeĲֶ治0
+ * @retval	>=0	ݵֽ
+ * @retval	ERR_BAD_PARAMETER	ʽԻ߲յĶ
+ */
+int SmsPdu_decode( const uint8_t *pdu, int len, sms_pdu_t *msg, char *data, int size)
+{
+	const uint8_t	*ud;
+	int		p, fo, n, type, i, k;
+	int		udl, ud_bytes, start = 0;
+	int		out = 0;
+	uint8_t	c;
+
+	memset( msg, 0, sizeof( sms_pdu_t));
+	msg->total = 1;
+	msg->seq = 1;
+	if( data == NULL)
+		size = 0;
+	if( len < 1 || ( p = pdu[0] + 1) + 3 > len)
+		return ERR_BAD_PARAMETER;
+	fo = pdu[ p ++];
+	if( ( fo & 0x03) != 0)
+		return ERR_BAD_PARAMETER;
+	n = pdu[ p ++];
+	type = pdu[ p ++];
+	if( p + ( n + 1) / 2 + 10 > len)
+		return ERR_BAD_PARAMETER;
+	if( ( type & PDU_TON_MASK) != PDU_TON_ALNUM)
+	{
+		k = 0;
+		if( ( type & PDU_TON_MASK) == PDU_TON_INTL)
+			msg->phone[ k ++] = '+';
+		for( i = 0; i < n && k < SMS_PDU_PHONE_LEN - 1; i ++)
+		{
+			c = ( pdu[ p + i / 2] >> ( ( i & 1) * 4)) & 0x0f;
+			if( c > 9)
+				break;
+			msg->phone[ k ++] = '0' + c;
+		}
+		msg->phone[ k] = '\0';
+	}
+	p += ( n + 1) / 2;
+	p ++;							//PID
+	msg->coding = dcs_coding( pdu[ p ++]);
+	p += 7;							//ʱ
+	udl = pdu[ p ++];
+	ud = pdu + p;
+	ud_bytes = msg->coding == SMS_PDU_7BIT ? ( udl * 7 + 7) / 8 : udl;
+	if( ud_bytes > len - p || ud_bytes > SMS_PDU_UD_MAX)
+		return ERR_BAD_PARAMETER;
+	if( fo & PDU_UDHI)
+	{
+		if( ud_bytes < 1 || ud[0] + 1 > ud_bytes)
+			return ERR_BAD_PARAMETER;
+		parse_udh( ud + 1, ud[0], msg);
+		start = ud[0] + 1;
+	}
+
+	if( msg->coding == SMS_PDU_7BIT)
+	{
+		//ͷ油뵽7λı߽
+		start = ( start * 8 + 6) / 7;
+		msg->cap = SMS_PDU_UD_MAX * 8 / 7 - start;
+		for( i = start; i < udl; i ++)
+		{
+			c = septet( ud, ud_bytes, i);
+			if( c == GSM_ESC)
+			{
+				if( ++ i >= udl)
+					break;
+				c = gsm7_ext( septet( ud, ud_bytes, i));
+			}
+			else
+				c = gsm7_char( c);
+			if( out < size)
+				data[ out ++] = c;
+		}
+		return out;
+	}
+	if( msg->coding == SMS_PDU_UCS2)
+	{
+		msg->cap = ( SMS_PDU_UD_MAX - start) / 2;
+		for( i = start; i + 1 < udl; i += 2)
+		{
+			if( out < size)
+				data[ out ++] = ( ud[ i] == 0 && ud[ i + 1] < 0x80) ? ud[ i + 1] : '?';
+		}
+		return out;
+	}
+	msg->cap = SMS_PDU_UD_MAX - start;
+	n = udl - start;
+	if( n > size)
+		n = size;
+	if( n > 0)
+		memcpy( data, ud + start, n);
+	return n > 0 ? n : 0;
+}
@@ -0,0 +1,37 @@
+#ifndef __SMSPDU_H__
+#define __SMSPDU_H__
+#include <stdint.h>
+
+//ŵPDUʽıʽֻܷASCII485Ķ0Ͷˣ0x1AǰAT+CMGS
+//PDUʽ8λ뷢ԭʼݣһóŵͷUDHֶΣշƴһ
+//յĶŰת7λUCS2תASCII8λԭ
+#define SMS_PDU_LEN_MAX			176		//һŵPDUֽĵַ
+#define SMS_PDU_UD_MAX			140		//ûֽ
+#define SMS_PDU_UDH_LEN			6		//ŵͷ05 00 03 ο ܶ 
+#define SMS_PDU_8BIT_MAX		SMS_PDU_UD_MAX
+#define SMS_PDU_CONCAT_8BIT		( SMS_PDU_UD_MAX - SMS_PDU_UDH_LEN)		//ÿֽ
+#define SMS_PDU_PARTS_MAX		8		//һηֳɵĶ
+#define SMS_PDU_HEAD_MAX		32		//͵PDUû֮ǰĲֽ
+#define SMS_PDU_PHONE_LEN		21
+
+//
+#define SMS_PDU_7BIT			0
+#define SMS_PDU_8BIT			1
+#define SMS_PDU_UCS2			2
+
+typedef struct {
+	char		phone[ SMS_PDU_PHONE_LEN];		//ͷ룬ĸֵĵַǿյ
+	uint8_t		coding;
+	uint8_t		total;			//ŵܶǳŵʱ1
+	uint8_t		seq;			//1ʼ
+	uint16_t	ref;			//ŵĲο
+	uint8_t		cap;			//һܷŵַһζģƴӵλ
+}sms_pdu_t;
+
+int SmsPdu_parts( int len);
+int SmsPdu_part_len( int len, int seq);
+int SmsPdu_submit_head( uint8_t *head, const char *phone, int len, uint8_t ref, uint8_t total, uint8_t seq);
+void SmsPdu_hex( char *hex, const uint8_t *data, int len);
+int SmsPdu_decode( const uint8_t *pdu, int len, sms_pdu_t *msg, char *data, int size);
+
+#endif
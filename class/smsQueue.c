@@ -0,0 +1,323 @@
+/**
+* @file 		smsQueue.c
+* @brief		ģʽ485ݵķͶ.
+* @details		1. йԱ뷢͵ͬݣֻһݣÿ¼Լ
+*				2. ʱĶ֡ϲһУһ֡ݲᱻһųȵ֡⣩
+*				3. ʧܺȴһʱԣȴʱÿμӱͷ
+*				4. ֮󣬷ĺ붪һ֡
+*				5. ߳ʹûеʱƶݣԷʱҪже
+*				6. PDUʽʱԭͣһSMSQ_PDU_MAXֽڣʱֳɳ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "smsQueue.h"
+#include "cmsis_os.h"
+#include "gprs.h"
+#include "dtuConfig.h"
+#include "modbusRTU_cli.h"
+#include "sdhError.h"
+#include "times.h"
+#include "debug.h"
+#include <string.h>
+
+typedef struct {
+	uint16_t	off;			//һҪ͵ݵλ
+	uint8_t		retry;
+	int8_t		last;			//һη͵Ľ
+	uint32_t	next_s;			//Եʱ
+	uint16_t	sent;
+	uint16_t	fail;
+}smsq_rcpt_t;
+
+static struct {
+	uint16_t	wr;
+	uint8_t		frames;
+	uint8_t		sending;		//߳ʹûе
+	uint16_t	ends[ SMSQ_FRAME_NUM];		//ÿһ֡λ
+	uint32_t	put_s;			//һηݵʱ
+	uint32_t	drop;
+	smsq_rcpt_t	rcpt[ ADMIN_PHNOE_NUM];
+	char		buf[ SMSQ_BUF_LEN];
+}SmsQ;
+
+osMutexDef( SmsQMutex);
+static osMutexId SmsQMutex_id = NULL;
+
+static void smsq_lock( void)
+{
+	osMutexWait( SmsQMutex_id, osWaitForever);
+}
+
+static void smsq_unlock( void)
+{
+	osMutexRelease( SmsQMutex_id);
+}
+
+//Чĺ벻ֱͣĩβ
+static int rcpt_valid( int i)
+{
+	return check_phoneNO( Dtu_config.admin_Phone[i]) == ERR_OK;
+}
+
+//кû͵һ֡Щֱ
+static int drop_first_frame( void)
+{
+	int i, k;
+	int found = 0;
+
+	for( k = 0; k < SmsQ.frames && found == 0; k ++)
+	{
+		for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+		{
+			if( rcpt_valid( i) == 0 || SmsQ.rcpt[i].off >= SmsQ.ends[k])
+				continue;
+			SmsQ.rcpt[i].off = SmsQ.ends[k];
+			SmsQ.rcpt[i].retry = 0;
+			found = 1;
+		}
+	}
+	if( found == 0)
+		return ERR_FAIL;
+	SmsQ.drop ++;
+	return ERR_OK;
+}
+
+//к붼ݴӻߣڷ͵ʱƶ
+static void smsq_compact( void)
+{
+	uint16_t	min = SmsQ.wr;
+	int			i, n;
+
+	for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+	{
+		if( rcpt_valid( i) == 0)
+			SmsQ.rcpt[i].off = SmsQ.wr;
+		if( SmsQ.rcpt[i].off < min)
+			min = SmsQ.rcpt[i].off;
+	}
+	if( min == 0)
+		return;
+	memmove( SmsQ.buf, SmsQ.buf + min, SmsQ.wr - min);
+	SmsQ.wr -= min;
+	for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+		SmsQ.rcpt[i].off -= min;
+	for( i = 0, n = 0; i < SmsQ.frames; i ++)
+	{
+		if( SmsQ.ends[i] <= min)
+			continue;
+		SmsQ.ends[ n ++] = SmsQ.ends[i] - min;
+	}
+	SmsQ.frames = n;
+}
+
+//һŶ
+static int smsq_msg_max( void)
+{
+	return Dtu_config.sms_pdu ? SMSQ_PDU_MAX : SMSQ_TEXT_MAX;
+}
+
+/**
+ * @brief һ֡ݷ뷢ͶУȴ.
+ *
+ * @details һųȵݱֳɶ֡.
+ *			˵ʱ֡֡ûбƳʱµ.
+ * @retval	ERR_OK	ɹ
+ * @retval	ERR_UNINITIALIZED	û
+ * @retval	ERR_MEM_UNAVAILABLE	ݱ
+ */
+int SmsQ_put( char *data, int len)
+{
+	int		n;
+	int		ret = ERR_OK;
+	int		max = smsq_msg_max();
+
+	if( SmsQMutex_id == NULL)
+		return ERR_UNINITIALIZED;
+	//Űıͣ0ͽ
+	if( Dtu_config.sms_pdu == 0)
+	{
+		for( n = 0; n < len && data[n] != '\0'; n ++)
+			;
+		len = n;
+	}
+
+	smsq_lock();
+	while( len > 0)
+	{
+		n = len > max ? max : len;
+
+		//֡ļ¼ˣܷµĻһ֡ϲ
+		if( SmsQ.frames == SMSQ_FRAME_NUM && \
+			SmsQ.ends[ SmsQ.frames - 1] - SmsQ.ends[ SmsQ.frames - 2] + n <= max)
+			SmsQ.frames --;
+		while( SmsQ.sending == 0)
+		{
+			smsq_compact();
+			if( SmsQ.wr + n <= SMSQ_BUF_LEN && SmsQ.frames < SMSQ_FRAME_NUM)
+				break;
+			if( drop_first_frame() != ERR_OK)
+				break;
+			ret = ERR_MEM_UNAVAILABLE;
+		}
+		if( SmsQ.wr + n > SMSQ_BUF_LEN || SmsQ.frames == SMSQ_FRAME_NUM)
+		{
+			//ڷ͵ʱڳռ䣬µ
+			SmsQ.drop ++;
+			ret = ERR_MEM_UNAVAILABLE;
+			break;
+		}
+		memcpy( SmsQ.buf + SmsQ.wr, data, n);
+		SmsQ.wr += n;
+		SmsQ.ends[ SmsQ.frames ++] = SmsQ.wr;
+		data += n;
+		len -= n;
+	}
+	SmsQ.put_s = get_time_s();
+	smsq_unlock();
+	return ret;
+}
+
+//ػжֽûз
+int SmsQ_depth( void)
+{
+	int i;
+	int depth = 0;
+
+	for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+	{
+		if( rcpt_valid( i) && SmsQ.wr - SmsQ.rcpt[i].off > depth)
+			depth = SmsQ.wr - SmsQ.rcpt[i].off;
+	}
+	return depth;
+}
+
+uint32_t SmsQ_drop_count( void)
+{
+	return SmsQ.drop;
+}
+
+//ĳ뷢ͳɹͷĶԼһη͵Ľ
+int SmsQ_status( int rcpt, uint16_t *sent, uint16_t *fail, int *last)
+{
+	if( rcpt < 0 || rcpt >= ADMIN_PHNOE_NUM)
+		return ERR_BAD_PARAMETER;
+	*sent = SmsQ.rcpt[ rcpt].sent;
+	*fail = SmsQ.rcpt[ rcpt].fail;
+	*last = SmsQ.rcpt[ rcpt].last;
+	return ERR_OK;
+}
+
+//offʼĺϲ֡
+//ûиݲһûϲʱʱ0
+static int smsq_msg_len( uint16_t off, uint32_t now)
+{
+	int i;
+	int len = 0;
+	int max = smsq_msg_max();
+
+	for( i = 0; i < SmsQ.frames; i ++)
+	{
+		if( SmsQ.ends[i] <= off)
+			continue;
+		//滹ݣٵ
+		//PDUʽĳıʽ֮ǰ֡ܳһţֿ
+		if( SmsQ.ends[i] - off > max)
+			return len ? len : max;
+		len = SmsQ.ends[i] - off;
+	}
+	if( now - SmsQ.put_s < SMSQ_MERGE_S)
+		return 0;
+	return len;
+}
+
+/**
+ * @brief ߳Եãÿθһ뷢һ.
+ *
+ */
+void SmsQ_run( void)
+{
+	static uint8_t	turn = 0;
+	gprs_t		*this_gprs = GprsGetInstance();
+	smsq_rcpt_t	*r;
+	uint16_t	off;
+	uint32_t	now;
+	int			len, i, ret;
+
+	if( SmsQMutex_id == NULL)
+		return;
+
+	regType4_write( SMSQ_INPUT_REG, REG_LINE, SmsQ_depth());
+	regType4_write( SMSQ_INPUT_REG + 1, REG_LINE, SmsQ.drop);
+	ret = 0;
+	for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+		ret += SmsQ.rcpt[i].fail;
+	regType4_write( SMSQ_INPUT_REG + 2, REG_LINE, ret);
+
+	smsq_lock();
+	smsq_compact();
+	now = get_time_s();
+	for( i = 0; i < ADMIN_PHNOE_NUM; i ++)
+	{
+		turn = ( turn + 1) % ADMIN_PHNOE_NUM;
+		r = &SmsQ.rcpt[ turn];
+		if( r->off == SmsQ.wr || ( r->retry && ( int32_t)( now - r->next_s) < 0))
+			continue;
+		len = smsq_msg_len( r->off, now);
+		if( len)
+			break;
+	}
+	if( i == ADMIN_PHNOE_NUM)
+	{
+		smsq_unlock();
+		return;
+	}
+	off = r->off;
+	SmsQ.sending = 1;
+	smsq_unlock();
+
+	//͵ʱ򲻳жеRTU߳̿Լ
+	this_gprs->lock( this_gprs);
+	ret = this_gprs->send_sms_data( this_gprs, Dtu_config.admin_Phone[ turn], SmsQ.buf + off, len);
+	this_gprs->unlock( this_gprs);
+
+	smsq_lock();
+	SmsQ.sending = 0;
+	r->last = ret;
+	//ģ黹û׼ãԴ
+	if( ret == ERR_DEV_SICK || ret == ERR_UNINITIALIZED)
+		goto runExit;
+	//ڼЩݱ
+	if( r->off != off)
+		goto runExit;
+	if( ret == ERR_OK)
+	{
+		r->off = off + len;
+		r->retry = 0;
+		r->sent ++;
+		goto runExit;
+	}
+	r->retry ++;
+	if( r->retry > SMSQ_RETRY_MAX)
+	{
+		DPRINTF("sms to %s give up \n", Dtu_config.admin_Phone[ turn]);
+		r->off = off + len;
+		r->retry = 0;
+		r->fail ++;
+		goto runExit;
+	}
+	r->next_s = get_time_s() + ( SMSQ_RETRY_BASE_S << ( r->retry - 1));
+
+	runExit:
+	smsq_unlock();
+}
+
+int SmsQ_init( void)
+{
+	memset( &SmsQ, 0, sizeof( SmsQ));
+	if( SmsQMutex_id == NULL)
+		SmsQMutex_id = osMutexCreate( osMutex( SmsQMutex));
+	if( SmsQMutex_id == NULL)
+		return ERR_RES_UNAVAILABLE;
+	return ERR_OK;
+}
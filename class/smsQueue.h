@@ -0,0 +1,27 @@
+#ifndef __SMSQUEUE_H__
+#define __SMSQUEUE_H__
+#include <stdint.h>
+
+//ģʽ485ݵķͶУɵ̷߳Ա
+//RTUֻ߳ݷУȴŷ
+#define SMSQ_BUF_LEN		256
+#define SMSQ_FRAME_NUM		16
+#define SMSQ_TEXT_MAX		160			//һַ
+#define SMSQ_PDU_MAX		255			//PDUʽһ෢͵ֽʱֳγţշĻ
+#define SMSQ_MERGE_S		2			//ڶеȴϲʱ
+#define SMSQ_RETRY_MAX		5
+#define SMSQ_RETRY_BASE_S	5			//nǰȴ SMSQ_RETRY_BASE_S << (n - 1) 
+
+//õmodbusĴ
+#define SMSQ_INPUT_REG		15			//еȴ͵ֽ
+										//16 ֡
+										//17 ͵Ķ
+
+int SmsQ_init( void);
+int SmsQ_put( char *data, int len);
+int SmsQ_depth( void);
+uint32_t SmsQ_drop_count( void);
+int SmsQ_status( int rcpt, uint16_t *sent, uint16_t *fail, int *last);
+void SmsQ_run( void);
+
+#endif
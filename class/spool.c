@@ -0,0 +1,496 @@
+/**
+* @file 		spool.c
+* @brief		·Ͽڼݵݴ.
+* @details		1. ݰ¼׷ӵflashspool.datļУļΪʹ
+*				2. ÿ¼м¼ͷ־ȡšļšʱݵcrc
+*				3. ļͷһδͼ¼λúţϵʱҵдλ
+*				4. λòÿһ¼ͱ棬Եܻط¼
+*				5. ļϵͳֻһ棬вfs_lockн
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "spool.h"
+#include "sw_filesys.h"
+#include "dtuConfig.h"
+#include "modbusRTU_cli.h"
+#include "sdhError.h"
+#include "times.h"
+#include "wclock.h"
+#include "debug.h"
+#include <string.h>
+
+#define SPOOL_HEAD_MAGIC	0x4c4f5053		//"SPOL"
+#define SPOOL_REC_MAGIC		0xa55b			//¼ͷʱǰļ¼ʹ
+#define SPOOL_WRAP			0xffff			//ȵļ¼ʾļ¼ļͷʼ
+#define SPOOL_REC_MAX		255
+#define SPOOL_DATA_OFS		sizeof( spool_head_t)
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	head;			//һδͼ¼λ
+	uint32_t	head_seq;
+	uint16_t	gen;			//ļţÿؽı䣬ǰµļ¼
+	uint16_t	crc;
+}spool_head_t;
+
+typedef struct {
+	uint16_t	magic;
+	uint16_t	len;
+	uint32_t	seq;
+	uint16_t	gen;
+	uint16_t	crc;			//ݵcrc
+	uint32_t	ts;				//ݵʱ֡һ
+}spool_rec_t;
+
+static struct {
+	sdhFile		*fd;
+	uint32_t	size;
+	uint32_t	head;			//λ
+	uint32_t	saved;			//ļͷﱣĶλ
+	uint32_t	tail;			//дλ
+	uint32_t	head_seq;
+	uint32_t	tail_seq;		//һ¼ţhead_seqʱΪ
+	uint32_t	drop;
+	uint32_t	flush_s;
+	uint32_t	rate_s;
+	uint32_t	rate_bytes;
+	uint16_t	gen;
+	uint8_t		dirty;			//ݻļϵͳĻ
+	uint8_t		head_chg;		//λñˣû
+}Spool;
+
+static void save_head( void)
+{
+	spool_head_t	h;
+
+	h.magic = SPOOL_HEAD_MAGIC;
+	h.head = Spool.head;
+	h.head_seq = Spool.head_seq;
+	h.gen = Spool.gen;
+	h.crc = CRC16( (uint8_t *)&h, sizeof( h) - 2);
+	fs_lseek( Spool.fd, 0, WR_SEEK_SET);
+	fs_write( Spool.fd, (uint8_t *)&h, sizeof( h));
+	Spool.saved = Spool.head;
+	Spool.head_chg = 0;
+	Spool.dirty = 1;
+}
+
+static int rec_check( spool_rec_t *rec, uint32_t seq)
+{
+	if( rec->magic != SPOOL_REC_MAGIC || rec->gen != Spool.gen || rec->seq != seq)
+		return ERR_FAIL;
+	if( rec->len == SPOOL_WRAP)
+		return ERR_OK;
+	if( rec->len == 0 || rec->len > SPOOL_REC_MAX)
+		return ERR_FAIL;
+	return ERR_OK;
+}
+
+//ҪļͷﱣĶλ֮ǰȰµĶλñҲ¼
+static void spool_overwrite( uint32_t pos, uint32_t len)
+{
+	if( Spool.head_chg && Spool.saved >= pos && Spool.saved < pos + len)
+		save_head();
+	fs_lseek( Spool.fd, pos, WR_SEEK_SET);
+}
+
+//ȡposΪseqļ¼ͷصļͷ
+//ؼ¼ʵʵλã¼Եʱ򷵻-1
+static int32_t rec_locate( uint32_t pos, uint32_t seq, spool_rec_t *rec)
+{
+	if( pos + sizeof( spool_rec_t) > Spool.size)
+		pos = SPOOL_DATA_OFS;
+	fs_lseek( Spool.fd, pos, RD_SEEK_SET);
+	if( fs_read( Spool.fd, (uint8_t *)rec, sizeof( spool_rec_t)) != ERR_OK)
+		return -1;
+	if( rec_check( rec, seq) != ERR_OK)
+		return -1;
+	if( rec->len != SPOOL_WRAP)
+		return pos;
+
+	pos = SPOOL_DATA_OFS;
+	fs_lseek( Spool.fd, pos, RD_SEEK_SET);
+	if( fs_read( Spool.fd, (uint8_t *)rec, sizeof( spool_rec_t)) != ERR_OK)
+		return -1;
+	if( rec_check( rec, seq) != ERR_OK || rec->len == SPOOL_WRAP)
+		return -1;
+	return pos;
+}
+
+//¼ˣʣµļ¼Ҫ
+static void spool_reset( void)
+{
+	Spool.drop += Spool.tail_seq - Spool.head_seq;
+	Spool.head = Spool.tail;
+	Spool.head_seq = Spool.tail_seq;
+	Spool.head_chg = 1;
+}
+
+//һ¼
+static int skip_oldest( void)
+{
+	spool_rec_t	rec;
+	int32_t		pos;
+
+	pos = rec_locate( Spool.head, Spool.head_seq, &rec);
+	if( pos < 0)
+	{
+		spool_reset();
+		return ERR_FAIL;
+	}
+	Spool.head = pos + sizeof( rec) + rec.len;
+	Spool.head_seq ++;
+	Spool.head_chg = 1;
+	//λָһ¼ʵλãĶλòжǷᱻ
+	if( Spool.head_seq != Spool.tail_seq)
+	{
+		pos = rec_locate( Spool.head, Spool.head_seq, &rec);
+		if( pos >= 0)
+			Spool.head = pos;
+	}
+	return ERR_OK;
+}
+
+//дλܷneedֽڣҪʱдƼ¼صļͷ
+static int spool_fit( uint32_t need)
+{
+	spool_rec_t	rec;
+	int empty = ( Spool.head_seq == Spool.tail_seq);
+
+	if( Spool.tail > Spool.head || empty)
+	{
+		if( Spool.tail + need <= Spool.size)
+			return ERR_OK;
+		if( !empty && SPOOL_DATA_OFS + need > Spool.head)
+			return ERR_MEM_UNAVAILABLE;
+		if( Spool.tail + sizeof( rec) <= Spool.size)
+		{
+			rec.magic = SPOOL_REC_MAGIC;
+			rec.len = SPOOL_WRAP;
+			rec.seq = Spool.tail_seq;
+			rec.gen = Spool.gen;
+			rec.crc = 0;
+			rec.ts = 0;
+			spool_overwrite( Spool.tail, sizeof( rec));
+			fs_write( Spool.fd, (uint8_t *)&rec, sizeof( rec));
+		}
+		Spool.tail = SPOOL_DATA_OFS;
+		if( empty)
+		{
+			Spool.head = SPOOL_DATA_OFS;
+			Spool.head_chg = 1;
+		}
+		return ERR_OK;
+	}
+
+	//дλѾص˶λõǰ
+	if( Spool.tail + need <= Spool.head)
+		return ERR_OK;
+	return ERR_MEM_UNAVAILABLE;
+}
+
+/**
+ * @brief 򿪻߽ݴļָдλ.
+ *
+ * @details õΪ0ʱݴ.
+ *			ļСòһʱؽļݶ.
+ * @retval	ERR_OK	ɹ
+ * @retval	ERR_DRI_OPTFAIL	ļ޷
+ */
+int Spool_init( void)
+{
+	spool_head_t	h;
+	spool_rec_t		rec;
+	int32_t			pos;
+	uint32_t		size = Dtu_config.spool_size_kb * 1024;
+
+	memset( &Spool, 0, sizeof( Spool));
+	if( size == 0)
+		return ERR_OK;
+
+	fs_lock();
+	memset( &h, 0, sizeof( h));
+	Spool.fd = fs_open( SPOOL_filename);
+	if( Spool.fd)
+	{
+		fs_lseek( Spool.fd, 0, RD_SEEK_SET);
+		fs_read( Spool.fd, (uint8_t *)&h, sizeof( h));
+		if( fs_du( Spool.fd) != size)
+		{
+			//ˣؽļʹµļ
+			h.crc = ~CRC16( (uint8_t *)&h, sizeof( h) - 2);
+			fs_delete( Spool.fd);
+			Spool.fd = NULL;
+		}
+	}
+	if( Spool.fd == NULL)
+		Spool.fd = fs_creator( SPOOL_filename, size);
+	if( Spool.fd == NULL)
+	{
+		fs_unlock();
+		DPRINTF("spool create file failed !\n");
+		return ERR_DRI_OPTFAIL;
+	}
+	Spool.size = size;
+
+	if( h.magic == SPOOL_HEAD_MAGIC && h.crc == CRC16( (uint8_t *)&h, sizeof( h) - 2) && \
+		h.head >= SPOOL_DATA_OFS && h.head < size)
+	{
+		//Ӷλÿʼҵһ¼
+		Spool.gen = h.gen;
+		Spool.head = h.head;
+		Spool.head_seq = h.head_seq;
+		Spool.tail = h.head;
+		Spool.tail_seq = h.head_seq;
+		Spool.saved = h.head;
+		while( Spool.tail_seq - Spool.head_seq < size / sizeof( rec))
+		{
+			pos = rec_locate( Spool.tail, Spool.tail_seq, &rec);
+			if( pos < 0)
+				break;
+			Spool.tail = pos + sizeof( rec) + rec.len;
+			Spool.tail_seq ++;
+		}
+		if( Spool.head_seq == Spool.tail_seq)
+			Spool.head = Spool.tail;
+	}
+	else
+	{
+		//һţļǰµļ¼ͲᱻЧ
+		if( h.magic == SPOOL_HEAD_MAGIC)
+			Spool.gen = h.gen + 1;
+		else
+			Spool.gen = h.crc ^ ( uint16_t)get_time_ms();
+		Spool.head = SPOOL_DATA_OFS;
+		Spool.tail = SPOOL_DATA_OFS;
+		save_head();
+	}
+	fs_flush();
+	Spool.dirty = 0;
+	fs_unlock();
+	DPRINTF("spool %d records \n", Spool.tail_seq - Spool.head_seq);
+	return ERR_OK;
+}
+
+/**
+ * @brief ׷һ¼.
+ *
+ * @details ֮öµݻļ¼.
+ * @retval	ERR_OK	ɹ
+ * @retval	ERR_UNINITIALIZED	ûݴ
+ * @retval	ERR_BAD_PARAMETER	Ȳ
+ * @retval	ERR_MEM_UNAVAILABLE	ռ䲻ݱ
+ * @retval	ERR_DRI_OPTFAIL	ļдʧ
+ */
+int Spool_put( char *data, int len, uint32_t ts)
+{
+	spool_rec_t	rec;
+	uint32_t	need = sizeof( rec) + len;
+	int			ret = ERR_OK;
+
+	if( Spool.fd == NULL)
+		return ERR_UNINITIALIZED;
+	if( len <= 0 || len > SPOOL_REC_MAX)
+		return ERR_BAD_PARAMETER;
+
+	fs_lock();
+	while( spool_fit( need) != ERR_OK)
+	{
+		if( Dtu_config.spool_drop == SPOOL_DROP_NEW || Spool.head_seq == Spool.tail_seq)
+		{
+			Spool.drop ++;
+			ret = ERR_MEM_UNAVAILABLE;
+			goto putExit;
+		}
+		if( skip_oldest() == ERR_OK)
+			Spool.drop ++;
+	}
+
+	rec.magic = SPOOL_REC_MAGIC;
+	rec.len = len;
+	rec.seq = Spool.tail_seq;
+	rec.gen = Spool.gen;
+	rec.crc = CRC16( (uint8_t *)data, len);
+	rec.ts = ts;
+	spool_overwrite( Spool.tail, need);
+	if( fs_write( Spool.fd, (uint8_t *)&rec, sizeof( rec)) != ERR_OK || \
+		fs_write( Spool.fd, (uint8_t *)data, len) != ERR_OK)
+	{
+		ret = ERR_DRI_OPTFAIL;
+		goto putExit;
+	}
+	if( Spool.dirty == 0)
+		Spool.flush_s = get_time_s();
+	Spool.dirty = 1;
+	Spool.tail += need;
+	Spool.tail_seq ++;
+
+	putExit:
+	fs_unlock();
+	return ret;
+}
+
+/**
+ * @brief ļ¼ʼܷŽbuf¼¼ᱻɾ.
+ *
+ * @details crcļ¼ֱӶ.
+ *			У׼ʱʱֻϲʱļ¼Ȼϲ֮ʱͲ׼.
+ * @param[out]	buf
+ * @param[in]	len bufĳ.
+ * @param[out]	num ļ¼ͳɹSpool_popɾ.
+ * @param[out]	ts һ¼ʱ.
+ * @retval	ݳ
+ */
+int Spool_read( char *buf, int len, int *num, uint32_t *ts)
+{
+	spool_rec_t	rec;
+	int32_t		pos;
+	uint32_t	rd = Spool.head;
+	uint32_t	seq = Spool.head_seq;
+	uint32_t	merge_s = 0xffffffff;
+	int			total = 0;
+
+	*num = 0;
+	*ts = 0;
+	if( Dtu_config.time_src != WCLK_SRC_OFF)
+		merge_s = Dtu_config.batch_s > SPOOL_MERGE_S ? Dtu_config.batch_s : SPOOL_MERGE_S;
+	if( Spool.fd == NULL)
+		return 0;
+	fs_lock();
+	while( seq != Spool.tail_seq)
+	{
+		pos = rec_locate( rd, seq, &rec);
+		if( pos < 0)
+		{
+			spool_reset();
+			break;
+		}
+		if( total + rec.len > len || ( *num && rec.ts - *ts > merge_s))
+			break;
+		fs_lseek( Spool.fd, pos + sizeof( rec), RD_SEEK_SET);
+		fs_read( Spool.fd, (uint8_t *)buf + total, rec.len);
+		rd = pos + sizeof( rec) + rec.len;
+		seq ++;
+		if( CRC16( (uint8_t *)buf + total, rec.len) != rec.crc)
+		{
+			//ֻǰĻ¼´ٶ
+			if( *num)
+				break;
+			Spool.head = rd;
+			Spool.head_seq = seq;
+			Spool.head_chg = 1;
+			Spool.drop ++;
+			continue;
+		}
+		if( *num == 0)
+			*ts = rec.ts;
+		total += rec.len;
+		( *num) ++;
+	}
+	fs_unlock();
+	return total;
+}
+
+//ɾnum¼
+int Spool_pop( int num)
+{
+	if( Spool.fd == NULL)
+		return ERR_UNINITIALIZED;
+	fs_lock();
+	while( num -- > 0 && Spool.head_seq != Spool.tail_seq)
+	{
+		if( skip_oldest() != ERR_OK)
+			break;
+	}
+	fs_unlock();
+	return ERR_OK;
+}
+
+uint32_t Spool_count( void)
+{
+	return Spool.tail_seq - Spool.head_seq;
+}
+
+//flashϵļѾ򿪣ݴ
+int Spool_on( void)
+{
+	return Spool.fd != NULL;
+}
+
+//ռõİٷֱ
+int Spool_usage( void)
+{
+	uint32_t	used;
+
+	if( Spool.fd == NULL || Spool.head_seq == Spool.tail_seq)
+		return 0;
+	if( Spool.tail > Spool.head)
+		used = Spool.tail - Spool.head;
+	else
+		used = Spool.size - Spool.head + Spool.tail - SPOOL_DATA_OFS;
+	return used * 100 / ( Spool.size - SPOOL_DATA_OFS);
+}
+
+uint32_t Spool_drop_count( void)
+{
+	return Spool.drop;
+}
+
+//ݴݵٶƣÿ෢õֽ0ʾ
+int Spool_rate_allow( int len)
+{
+	uint32_t	now;
+
+	if( Dtu_config.spool_rate_Bps == 0)
+		return 1;
+	now = get_time_s();
+	if( now != Spool.rate_s)
+	{
+		Spool.rate_s = now;
+		Spool.rate_bytes = 0;
+	}
+	if( Spool.rate_bytes >= Dtu_config.spool_rate_Bps)
+		return 0;
+	Spool.rate_bytes += len;
+	return 1;
+}
+
+/**
+ * @brief ѻеݺͶλдflash.
+ *
+ * @details ߹ػ֮ǰ.
+ */
+void Spool_sync( void)
+{
+	if( Spool.fd == NULL)
+		return;
+	fs_lock();
+	if( Spool.head_chg)
+		save_head();
+	fs_flush();
+	Spool.dirty = 0;
+	Spool.flush_s = get_time_s();
+	fs_unlock();
+}
+
+/**
+ * @brief ԵãѻеݺͶλдflashϼĴ.
+ *
+ * @details ݴݷʱϱλãʱSPOOL_FLUSH_S뱣һ.
+ */
+void Spool_run( void)
+{
+	if( Spool.fd == NULL)
+		return;
+	regType4_write( SPOOL_INPUT_REG, REG_LINE, Spool_usage());
+	regType4_write( SPOOL_INPUT_REG + 1, REG_LINE, Spool_count());
+	regType4_write( SPOOL_INPUT_REG + 2, REG_LINE, Spool.drop);
+
+	if( Spool.dirty == 0 && Spool.head_chg == 0)
+		return;
+	if( ( Spool.head_chg == 0 || Spool.head_seq != Spool.tail_seq) && \
+		( get_time_s() - Spool.flush_s < SPOOL_FLUSH_S))
+		return;
+	Spool_sync();
+}
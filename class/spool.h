@@ -0,0 +1,35 @@
+#ifndef __SPOOL_H__
+#define __SPOOL_H__
+#include <stdint.h>
+
+//·Ͽʱݴflashļ·ָ֮˳򷢳ȥ
+#define	SPOOL_filename		"spool.dat"
+
+#define SPOOL_DROP_NEW		0		//֮
+#define SPOOL_DROP_OLD		1		//֮
+
+#define SPOOL_SIZE_KB_MIN	8
+#define SPOOL_SIZE_KB_MAX	1024
+#define SPOOL_DEF_SIZE_KB	64
+
+#define SPOOL_FLUSH_S		5		//дڻͣʱ
+#define SPOOL_MERGE_S		1		//У׼ʱʱʱļ¼ϲһ֡batch_sʱbatch_s
+
+//õmodbusĴ
+#define SPOOL_INPUT_REG		12		//ռʣٷֱ
+									//13 ¼
+									//14 ļ¼
+
+int Spool_init( void);
+int Spool_put( char *data, int len, uint32_t ts);
+int Spool_read( char *buf, int len, int *num, uint32_t *ts);
+int Spool_pop( int num);
+uint32_t Spool_count( void);
+int Spool_on( void);
+int Spool_usage( void);
+uint32_t Spool_drop_count( void);
+int Spool_rate_allow( int len);
+void Spool_sync( void);
+void Spool_run( void);
+
+#endif
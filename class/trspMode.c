@@ -0,0 +1,106 @@
+/**
+* @file 		trspMode.c
+* @brief		͸ģʽģʽģʽл״̬.
+* @details		1. Ҫָʱ˳ģʽ˳ָ֮
+*				2. ҪͣһʱûָˣATOصģʽ
+*				3. ATOʧܻ˲ģʽΪѾϿ
+*				4. ¼ÿлѵʱ
+*				5. ӲԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "trspMode.h"
+#include <string.h>
+
+void TrspMode_init( trspMode_t *t)
+{
+	memset( t, 0, sizeof( trspMode_t));
+}
+
+//·״̬ͬӸսʱģ鴦ģʽ
+void TrspMode_link( trspMode_t *t, int up)
+{
+	if( up == 0)
+	{
+		t->state = TRSP_ST_IDLE;
+		t->esc_fail = 0;
+	}
+	else if( t->state == TRSP_ST_IDLE)
+	{
+		t->state = TRSP_ST_DATA;
+	}
+}
+
+//ҪָҪĶ
+int TrspMode_want_cmd( trspMode_t *t, uint32_t now_ms)
+{
+	t->cmd_ms = now_ms;
+	if( t->state != TRSP_ST_DATA)
+		return TRSP_ACT_NONE;
+	t->state = TRSP_ST_SWITCH;
+	t->act = TRSP_ACT_ESCAPE;
+	return TRSP_ACT_ESCAPE;
+}
+
+//ҪݣҪĶ
+int TrspMode_want_data( trspMode_t *t)
+{
+	if( t->state != TRSP_ST_CMD)
+		return TRSP_ACT_NONE;
+	t->state = TRSP_ST_SWITCH;
+	t->act = TRSP_ACT_RESUME;
+	return TRSP_ACT_RESUME;
+}
+
+//ģʽ¿һʱ䣬Ӧûصģʽĵ
+int TrspMode_idle( trspMode_t *t, uint32_t now_ms)
+{
+	return t->state == TRSP_ST_CMD && now_ms - t->cmd_ms >= TRSP_IDLE_MS;
+}
+
+/**
+ * @brief л¼.
+ *
+ * @param[in]	ok	ģǷظлɹ
+ * @param[in]	spend_ms	лѵʱ
+ * @retval	л״̬TRSP_ST_IDLEʾѾ
+ */
+int TrspMode_done( trspMode_t *t, int ok, uint32_t spend_ms)
+{
+	if( t->state != TRSP_ST_SWITCH)
+		return t->state;
+	if( spend_ms > 0xffff)
+		spend_ms = 0xffff;
+	t->last_ms = spend_ms;
+	if( spend_ms > t->max_ms)
+		t->max_ms = spend_ms;
+	
+	if( t->act == TRSP_ACT_ESCAPE)
+	{
+		if( ok)
+		{
+			t->esc_count ++;
+			t->esc_fail = 0;
+			t->state = TRSP_ST_CMD;
+		}
+		else if( ++ t->esc_fail >= TRSP_ESC_FAIL_MAX)
+		{
+			t->esc_fail = 0;
+			t->state = TRSP_ST_IDLE;
+		}
+		else
+		{
+			t->state = TRSP_ST_DATA;
+		}
+	}
+	else
+	{
+		//ATOʧ˵ѾϿˣģģʽ
+		if( ok)
+			t->res_count ++;
+		t->state = ok ? TRSP_ST_DATA : TRSP_ST_IDLE;
+	}
+	t->act = TRSP_ACT_NONE;
+	return t->state;
+}
@@ -0,0 +1,39 @@
+#ifndef __TRSPMODE_H__
+#define __TRSPMODE_H__
+#include <stdint.h>
+
+//͸ģʽ£ģʽģʽ֮л
+//ֻ¼״̬ı仯ģ飬лĶgprs
+#define TRSP_ST_IDLE		0		//û͸ӣģģʽ
+#define TRSP_ST_DATA		1		//ģʽд봮ڵݶᷢ
+#define TRSP_ST_CMD			2		//ӻڣʱеģʽ
+#define TRSP_ST_SWITCH		3		//лȴģĻظ
+
+#define TRSP_ACT_NONE		0
+#define TRSP_ACT_ESCAPE		1		//ģʽ˵ģʽ
+#define TRSP_ACT_RESUME		2		//ATOصģʽ
+
+#define TRSP_GUARD_MS		1000	//"+++"ǰûݵʱ䣬ģҪ1s
+#define TRSP_REPLY_MS		1500	//ȴģظʱ
+#define TRSP_IDLE_MS		200		//ģʽôûָͻصģʽ
+#define TRSP_ESC_FAIL_MAX	3		//˳ʧܵĴ֮ΪѾ
+
+typedef struct {
+	uint8_t		state;
+	uint8_t		act;			//ڽел
+	uint8_t		esc_fail;
+	uint16_t	last_ms;		//һлѵʱ
+	uint16_t	max_ms;
+	uint16_t	esc_count;
+	uint16_t	res_count;
+	uint32_t	cmd_ms;			//һʹģʽʱ
+}trspMode_t;
+
+void TrspMode_init( trspMode_t *t);
+void TrspMode_link( trspMode_t *t, int up);
+int TrspMode_want_cmd( trspMode_t *t, uint32_t now_ms);
+int TrspMode_want_data( trspMode_t *t);
+int TrspMode_idle( trspMode_t *t, uint32_t now_ms);
+int TrspMode_done( trspMode_t *t, int ok, uint32_t spend_ms);
+
+#endif
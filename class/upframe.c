@@ -0,0 +1,206 @@
+/**
+* @file 		upframe.c
+* @brief		ݵĶ֡LZSSѹ.
+* @details		1. ֡͡ʱCRC16Ŀݡע
+*				2. ϲݿѹѹ󲻱ԭСʱѹ
+*				3. ӲԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "upframe.h"
+#include "modbusRTU_cli.h"
+#include "sdhError.h"
+#include <string.h>
+
+#if UPF_LZ_ENABLE
+/**
+ * @brief ѹһ.
+ *
+ * @retval	>0	ѹĳ
+ * @retval	ERR_MEM_UNAVAILABLE	Ų£Ӧֱӷԭ
+ */
+int Lz_compress( uint8_t *in, int len, uint8_t *out, int size)
+{
+	uint8_t	*flag = NULL;
+	int		pos = 0;
+	int		n = 0;
+	int		item = 0;
+	int		i, k, best, best_off, max;
+
+	while( pos < len)
+	{
+		if( ( item & 7) == 0)
+		{
+			if( n >= size)
+				return ERR_MEM_UNAVAILABLE;
+			flag = out + n ++;
+			*flag = 0;
+		}
+		//ǰظ
+		best = 0;
+		best_off = 0;
+		max = len - pos > LZ_MAX_MATCH ? LZ_MAX_MATCH : len - pos;
+		for( i = pos > LZ_WINDOW ? pos - LZ_WINDOW : 0; i < pos && best < max; i ++)
+		{
+			if( in[i] != in[pos])
+				continue;
+			for( k = 1; k < max && in[ i + k] == in[ pos + k]; k ++)
+				;
+			if( k > best)
+			{
+				best = k;
+				best_off = pos - i;
+			}
+		}
+		if( best >= LZ_MIN_MATCH)
+		{
+			if( n + 2 > size)
+				return ERR_MEM_UNAVAILABLE;
+			*flag |= 1 << ( item & 7);
+			out[ n ++] = ( ( best - LZ_MIN_MATCH) << 4) | ( ( best_off - 1) >> 8);
+			out[ n ++] = ( best_off - 1) & 0xff;
+			pos += best;
+		}
+		else
+		{
+			if( n >= size)
+				return ERR_MEM_UNAVAILABLE;
+			out[ n ++] = in[ pos ++];
+		}
+		item ++;
+	}
+	return n;
+}
+
+/**
+ * @brief ѹĺPCϵĲʹ.
+ *
+ * @retval	>=0	ѹĳ
+ * @retval	ERR_BAD_PARAMETER	ݸʽ
+ * @retval	ERR_MEM_UNAVAILABLE	Ų
+ */
+int Lz_decompress( uint8_t *in, int len, uint8_t *out, int size)
+{
+	uint8_t	flag = 0;
+	int		pos = 0;
+	int		n = 0;
+	int		item = 0;
+	int		mlen, off;
+
+	while( pos < len)
+	{
+		if( ( item & 7) == 0)
+			flag = in[ pos ++];
+		if( pos >= len)
+			break;
+		if( flag & ( 1 << ( item & 7)))
+		{
+			if( pos + 2 > len)
+				return ERR_BAD_PARAMETER;
+			mlen = ( in[ pos] >> 4) + LZ_MIN_MATCH;
+			off = ( ( ( in[ pos] & 0x0f) << 8) | in[ pos + 1]) + 1;
+			pos += 2;
+			if( off > n)
+				return ERR_BAD_PARAMETER;
+			if( n + mlen > size)
+				return ERR_MEM_UNAVAILABLE;
+			//ظĲֿԺдصֻֽڸ
+			while( mlen --)
+			{
+				out[ n] = out[ n - off];
+				n ++;
+			}
+		}
+		else
+		{
+			if( n >= size)
+				return ERR_MEM_UNAVAILABLE;
+			out[ n ++] = in[ pos ++];
+		}
+		item ++;
+	}
+	return n;
+}
+#endif
+
+static char *put_u32( char *p, uint32_t val)
+{
+	*p ++ = val >> 24;
+	*p ++ = val >> 16;
+	*p ++ = val >> 8;
+	*p ++ = val;
+	return p;
+}
+
+/**
+ * @brief һ֡lzΪ0ұѹʱѹ.
+ *
+ * @retval	>0	֡ĳ
+ * @retval	ERR_MEM_UNAVAILABLE	Ų
+ */
+int Upf_pack( char *out, int size, uint8_t type, uint32_t ts, char *data, int len, int lz)
+{
+	char		*p = out + UPF_HEAD_LEN;
+	int			n = ERR_FAIL;
+	uint16_t	crc;
+
+	if( len + UPF_OVERHEAD > size)
+		return ERR_MEM_UNAVAILABLE;
+#if UPF_LZ_ENABLE
+	//ѹҪʡ±־λĿ
+	if( lz && len > LZ_MIN_MATCH)
+		n = Lz_compress( ( uint8_t *)data, len, ( uint8_t *)p, len - 1);
+#endif
+	if( n > 0)
+		type |= UPF_LZ;
+	else
+	{
+		n = len;
+		memcpy( p, data, len);
+	}
+	out[0] = UPF_MAGIC;
+	out[1] = type;
+	out[2] = n >> 8;
+	out[3] = n & 0xff;
+	put_u32( out + 4, ts);
+	p += n;
+	crc = CRC16( ( uint8_t *)out, UPF_HEAD_LEN + n);
+	*p ++ = crc >> 8;
+	*p ++ = crc & 0xff;
+	return p - out;
+}
+
+/**
+ * @brief ⿪һ֡ѹݽѹout.
+ *
+ * @retval	>=0	ݵĳ
+ * @retval	ERR_BAD_PARAMETER	֡ͷȻCRC
+ */
+int Upf_unpack( char *frame, int len, uint8_t *type, uint32_t *ts, char *out, int size)
+{
+	uint8_t		*p = ( uint8_t *)frame;
+	uint16_t	crc;
+	int			n;
+
+	if( len < UPF_OVERHEAD || p[0] != UPF_MAGIC)
+		return ERR_BAD_PARAMETER;
+	n = ( p[2] << 8) | p[3];
+	if( n + UPF_OVERHEAD != len)
+		return ERR_BAD_PARAMETER;
+	crc = CRC16( p, UPF_HEAD_LEN + n);
+	if( p[ len - 2] != ( crc >> 8) || p[ len - 1] != ( crc & 0xff))
+		return ERR_BAD_PARAMETER;
+	*type = p[1];
+	*ts = ( ( uint32_t)p[4] << 24) | ( ( uint32_t)p[5] << 16) | ( p[6] << 8) | p[7];
+	if( p[1] & UPF_LZ)
+#if UPF_LZ_ENABLE
+		return Lz_decompress( p + UPF_HEAD_LEN, n, ( uint8_t *)out, size);
+#else
+		return ERR_BAD_PARAMETER;
+#endif
+	if( n > size)
+		return ERR_MEM_UNAVAILABLE;
+	memcpy( out, p + UPF_HEAD_LEN, n);
+	return n;
+}
@@ -0,0 +1,41 @@
+#ifndef __UPFRAME_H__
+#define __UPFRAME_H__
+#include <stdint.h>
+
+//ݵĶ֡ԭʼݺıע
+//	0		1	֡ͷUPF_MAGIC
+//	1		1	ͣUPF_LZλʾݾѹ
+//	2		2	ݵĳȣֽǰ
+//	4		4	ʱsֽǰУ׼ʱUTCǿ
+//	8		n	
+//	8+n		2	CRC16֡ͷݣmodbusRTU_cliһֽǰ
+#define UPF_MAGIC			0xA7
+#define UPF_HEAD_LEN		8
+#define UPF_OVERHEAD		( UPF_HEAD_LEN + 2)
+
+#define UPF_DATA			1			//485ݣǺϲĶ֡
+#define UPF_HEARTBEAT		2
+#define UPF_REGISTER		3
+#define UPF_LZ				0x80
+
+//R8FlashĬϲѹUpf_packlzյѹ֡
+#ifndef UPF_LZ_ENABLE
+#define UPF_LZ_ENABLE		0
+#endif
+
+//LZSSѹöڴ棬ظֻʺѹһϲ
+//ÿ8ǰһ־ֽڣӵλʼ1ʾظ0ʾԭʼֽ
+//ظ2ֽڣ4λǳ-3ʣµ12λǾ-1
+#define LZ_MIN_MATCH		3
+#define LZ_MAX_MATCH		18
+#define LZ_WINDOW			256			//ǰҵķΧѹʱ
+
+#if UPF_LZ_ENABLE
+int Lz_compress( uint8_t *in, int len, uint8_t *out, int size);
+int Lz_decompress( uint8_t *in, int len, uint8_t *out, int size);
+#endif
+
+int Upf_pack( char *out, int size, uint8_t type, uint32_t ts, char *data, int len, int lz);
+int Upf_unpack( char *frame, int len, uint8_t *type, uint32_t *ts, char *out, int size);
+
+#endif
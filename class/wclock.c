@@ -0,0 +1,242 @@
+/**
+* @file 		wclock.c
+* @brief		ǽʱУ׼64λUTCʱ.
+* @details		1. ģʱУ׼ļõ1970꿪ʼUTC
+*				2. У׼֮ƫppmСʱ
+*				3. AT+CCLK?ĻظUTC
+*				4. ֻWclock_now_msȡؼĶԵPCϲ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include "wclock.h"
+#include "times.h"
+#include "sdhError.h"
+#include <stdlib.h>
+#include <string.h>
+
+//ʱõĲУ׼dtu߳ʱ߳
+//дʱдһлȥʱ򲻻һһɵĲ
+typedef struct {
+	uint64_t		base_tick;		//ʼ
+	uint64_t		base_epoch;
+	int32_t			slew_ms;		//base_tickʼҪ
+	int32_t			ppm;
+}wclk_base_t;
+
+static wclk_base_t		Wclk_base[2];
+static volatile uint8_t	Wclk_cur;
+
+static struct {
+	uint64_t		anchor_tick;	//ƫ
+	uint64_t		anchor_epoch;
+	uint32_t		anchor_prec;
+	uint8_t			ppm_ok;			//ƫѾ
+	uint8_t			kick;			//յ·ʱ֪ͨУ׼
+	uint32_t		try_s;			//һγУ׼Ŀʱ
+	wclock_stat_t	stat;
+}Wclk;
+
+static uint64_t base_at( wclk_base_t *b, uint64_t tick_ms)
+{
+	int64_t		d;
+	int64_t		e;
+	int64_t		adj;
+
+	d = ( int64_t)( tick_ms - b->base_tick);
+	e = ( int64_t)b->base_epoch + d + d * b->ppm / 1000000;
+	//ʱȼö࣬ԵʱʱҲ
+	adj = d > 0 ? d / WCLK_SLEW_DIV : 0;
+	if( adj > abs( b->slew_ms))
+		adj = abs( b->slew_ms);
+	e += b->slew_ms < 0 ? -adj : adj;
+	return e;
+}
+
+static void base_set( uint64_t tick_ms, uint64_t epoch_ms, int32_t slew_ms, int32_t ppm)
+{
+	wclk_base_t	*b = &Wclk_base[ Wclk_cur ^ 1];
+
+	b->base_tick = tick_ms;
+	b->base_epoch = epoch_ms;
+	b->slew_ms = slew_ms;
+	b->ppm = ppm;
+	Wclk_cur ^= 1;
+}
+
+//ֻӦʱ䣬ı״̬ǰļҲԻ
+uint64_t Wclock_at( uint64_t tick_ms)
+{
+	if( Wclk.stat.synced == 0)
+		return 0;
+	return base_at( &Wclk_base[ Wclk_cur], tick_ms);
+}
+
+/**
+ * @brief һ׼ȷʱУ׼.
+ *
+ * @param[in]	epoch_ms	UTC
+ * @param[in]	prec_ms		ʱľȣòܲƫ
+ * @param[in]	tick_ms		õʱʱıؼ
+ * @param[in]	src			Դ
+ */
+void Wclock_sync( uint64_t epoch_ms, uint32_t prec_ms, uint64_t tick_ms, uint8_t src)
+{
+	wclock_stat_t	*st = &Wclk.stat;
+	int64_t			err;
+	int64_t			span;
+	int64_t			ppm = st->ppm;
+	uint64_t		now;
+
+	st->src = src;
+	st->syncs ++;
+	st->last_sync_s = tick_ms / 1000;
+	Wclk.kick = 0;
+	if( st->synced == 0)
+	{
+		st->steps ++;
+		st->last_err_ms = 0;
+		base_set( tick_ms, epoch_ms, 0, st->ppm);
+		Wclk.anchor_tick = tick_ms;
+		Wclk.anchor_epoch = epoch_ms;
+		Wclk.anchor_prec = prec_ms;
+		st->synced = 1;
+		return;
+	}
+
+	err = ( int64_t)( epoch_ms - Wclock_at( tick_ms));
+	st->last_err_ms = err > 0x7fffffff ? 0x7fffffff : ( err < -0x7fffffff ? -0x7fffffff : err);
+	if( err >= WCLK_STEP_MS || err <= -WCLK_STEP_MS)
+	{
+		//˵֮ǰʱ䲻ԣƫ²
+		st->steps ++;
+		base_set( tick_ms, epoch_ms, 0, st->ppm);
+		Wclk.anchor_tick = tick_ms;
+		Wclk.anchor_epoch = epoch_ms;
+		Wclk.anchor_prec = prec_ms;
+		return;
+	}
+
+	//㹻У׼ƫӰ첻WCLK_PPM_RESŲ
+	span = ( int64_t)( tick_ms - Wclk.anchor_tick);
+	if( span > 0 && span * WCLK_PPM_RES >= ( int64_t)( prec_ms + Wclk.anchor_prec) * 1000000)
+	{
+		ppm = ( ( int64_t)( epoch_ms - Wclk.anchor_epoch) - span) * 1000000 / span;
+		if( Wclk.ppm_ok)
+			ppm = ( st->ppm + ppm) / 2;
+		if( ppm > WCLK_PPM_MAX)
+			ppm = WCLK_PPM_MAX;
+		if( ppm < -WCLK_PPM_MAX)
+			ppm = -WCLK_PPM_MAX;
+		Wclk.ppm_ok = 1;
+		Wclk.anchor_tick = tick_ms;
+		Wclk.anchor_epoch = epoch_ms;
+		Wclk.anchor_prec = prec_ms;
+	}
+	//ʱߣ
+	now = Wclock_at( tick_ms);
+	base_set( tick_ms, now, ( int64_t)( epoch_ms - now), ppm);
+	st->ppm = ppm;
+}
+
+//ǰUTCûУ׼ʱ򷵻0
+uint64_t Wclock_now_ms( void)
+{
+	return Wclock_at( get_tick_ms64());
+}
+
+//ݵʱУ׼UTCǿ
+uint32_t Wclock_stamp_s( uint64_t tick_ms)
+{
+	if( Wclk.stat.synced == 0)
+		return tick_ms / 1000;
+	return Wclock_at( tick_ms) / 1000;
+}
+
+int Wclock_synced( void)
+{
+	return Wclk.stat.synced;
+}
+
+//ǲǸУ׼
+int Wclock_due( uint32_t now_s)
+{
+	if( Wclk.kick)
+		return 1;
+	if( Wclk.stat.synced && now_s - Wclk.stat.last_sync_s < WCLK_SYNC_S)
+		return 0;
+	return Wclk.try_s == 0 || now_s - Wclk.try_s >= WCLK_RETRY_S;
+}
+
+void Wclock_tried( uint32_t now_s)
+{
+	Wclk.try_s = now_s ? now_s : 1;
+	Wclk.kick = 0;
+}
+
+//ģյ·ʱ
+void Wclock_kick( void)
+{
+	Wclk.kick = 1;
+}
+
+wclock_stat_t *Wclock_stat( void)
+{
+	return &Wclk.stat;
+}
+
+//1970-01-01ʼĺ
+uint64_t Wclock_mktime( int year, int mon, int day, int hour, int min, int sec)
+{
+	int32_t		era, yoe, doy, doe, days;
+
+	year -= mon <= 2;
+	era = ( year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = ( 153 * ( mon + ( mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	days = era * 146097 + doe - 719468;
+	return ( ( uint64_t)days * 86400 + hour * 3600 + min * 60 + sec) * 1000;
+}
+
+/**
+ * @brief AT+CCLK?Ļظ.
+ *
+ * @details +CCLK: "18/01/30,12:34:56+32" ʱǱʱUTCٸ15.
+ *			ֻ룬һм.
+ * @retval	ERR_OK	ɹ
+ * @retval	ERR_BAD_PARAMETER	ʽ
+ * @retval	ERR_UNINITIALIZED	ģʱӻûù
+ */
+int Wclock_parse_cclk( char *buf, uint64_t *epoch_ms)
+{
+	char	*pp = strstr( buf, "+CCLK:");
+	int		v[7];
+	int		i;
+	int		sign;
+	const char	*sep = "//,::";
+
+	if( pp == NULL || ( pp = strchr( pp, '"')) == NULL)
+		return ERR_BAD_PARAMETER;
+	pp ++;
+	for( i = 0; i < 6; i ++)
+	{
+		if( pp[0] < '0' || pp[0] > '9' || pp[1] < '0' || pp[1] > '9')
+			return ERR_BAD_PARAMETER;
+		v[i] = ( pp[0] - '0') * 10 + pp[1] - '0';
+		pp += 2;
+		if( i < 5 && *pp ++ != sep[i])
+			return ERR_BAD_PARAMETER;
+	}
+	if( *pp != '+' && *pp != '-')
+		return ERR_BAD_PARAMETER;
+	sign = *pp ++ == '-' ? -1 : 1;
+	v[6] = strtol( pp, NULL, 10) * sign;
+	if( v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31 || v[3] > 23 || v[4] > 59 || v[5] > 60 || \
+		v[6] > 56 || v[6] < -48)
+		return ERR_BAD_PARAMETER;
+	if( 2000 + v[0] < WCLK_MIN_YEAR)
+		return ERR_UNINITIALIZED;
+	*epoch_ms = Wclock_mktime( 2000 + v[0], v[1], v[2], v[3], v[4], v[5]) - ( int64_t)v[6] * 15 * 60000 + 500;
+	return ERR_OK;
+}
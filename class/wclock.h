@@ -0,0 +1,44 @@
+#ifndef __WCLOCK_H__
+#define __WCLOCK_H__
+#include <stdint.h>
+
+//ǽʱ䣺ֻпļģʱУ׼
+//ģʱ·ʱ䣨AT+CLTS=1ģԼSNTPAT+CNTPãAT+CCLK?
+//У׼֮䰴ļƫСʱ䲻
+#define WCLK_SRC_OFF		0		//У׼ʱÿ
+#define WCLK_SRC_NITZ		1		//·ʱ
+#define WCLK_SRC_NTP		2		//ģSNTPʧܵʱ·ʱ
+
+#define WCLK_SYNC_S			3600	//У׼
+#define WCLK_RETRY_S		60		//ûУ׼ϵʱԵ
+#define WCLK_MIN_YEAR		2018	//һ˵ģʱӻûбù
+#define WCLK_STEP_MS		2000	//ֱµʱ䣬
+#define WCLK_SLEW_DIV		100		//ٶȣÿ100ms1ms
+#define WCLK_PPM_MAX		500		//ƫޣ˵У׼ʱ䲻
+#define WCLK_PPM_RES		50		//У׼ļҪֱܷôƫƫ
+#define WCLK_CCLK_PREC_MS	1000	//AT+CCLK?ֻ
+
+typedef struct {
+	uint8_t		src;			//һУ׼Դ
+	uint8_t		synced;
+	int16_t		ppm;			//ؼʵʿΪ
+	int32_t		last_err_ms;	//һУ׼ʱ
+	uint32_t	syncs;
+	uint32_t	steps;			//ֱĴ
+	uint32_t	last_sync_s;	//һУ׼Ŀʱ
+}wclock_stat_t;
+
+void Wclock_sync( uint64_t epoch_ms, uint32_t prec_ms, uint64_t tick_ms, uint8_t src);
+uint64_t Wclock_at( uint64_t tick_ms);
+uint64_t Wclock_now_ms( void);
+uint32_t Wclock_stamp_s( uint64_t tick_ms);
+int Wclock_synced( void);
+int Wclock_due( uint32_t now_s);
+void Wclock_tried( uint32_t now_s);
+void Wclock_kick( void);
+wclock_stat_t *Wclock_stat( void);
+
+uint64_t Wclock_mktime( int year, int mon, int day, int hour, int min, int sec);
+int Wclock_parse_cclk( char *buf, uint64_t *epoch_ms);
+
+#endif
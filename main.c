@@ -25,6 +25,7 @@
 #include "dtuConfig.h"
 #include "TTextConfProt.h"
 #include "system.h"
+#include "spool.h"
 
 #define APPTYPE_NORMAL			0x25		//
 #define APPTYPE_CONFIG			0x37		//	
@@ -34,6 +35,7 @@
 static void Led_job();
 static int Select_apptype();		//ѡ
 int Init_Thread_rtu (void);
+int Init_Thread_sms (void);
 
 ShutDownJob g_shutdow = NULL;
 #ifdef __GNUC__
@@ -197,6 +199,7 @@ int main (void) {
 		
 		Init_ThrdDtu();
 		Init_Thread_rtu();
+		Init_Thread_sms();
 		osKernelStart (); 
 		sim800 =  GprsGetInstance();
 		u32_val = 0;
@@ -206,6 +209,8 @@ int main (void) {
 			if( ShutdownFlag)
 			{
 				LED_run->destory(LED_run);
+				fs_lock();			//ͷţ֮ǰ߳дļ
+				Spool_sync();
 				fs_flush();
 				if( g_shutdow)
 					g_shutdow();
@@ -0,0 +1,92 @@
+/**
+* @file 		ByteFifo.c
+* @brief		ߵߵֽڻλ.
+* @details		1. 泤ȱ2ݣʵʿósize - 1
+*				2. һ߳дһ̶߳ʱҪ
+* @version	A001
+* @par Copyright (c): 
+* 		XXX˾
+*/
+#include "ByteFifo.h"
+#include "sdhError.h"
+#include <string.h>
+
+void	BFInit( sByteFifo *bf, char *buf, uint16_t size)
+{
+	bf->buf = buf;
+	bf->size = size;
+	bf->read = 0;
+	bf->write = 0;
+}
+
+/**
+ * @brief ػд洢ݵĳ
+ */
+uint16_t	BFLengthData( sByteFifo *bf)
+{
+	return ( ( bf->write - bf->read) & ( bf->size - 1));
+}
+
+/**
+ * @brief ػеĿг
+ */
+uint16_t	BFFreeSize( sByteFifo *bf)
+{
+	//ûз仺Ķ
+	if( bf->size == 0)
+		return 0;
+	return bf->size - 1 - BFLengthData( bf);
+}
+
+/**
+ * @brief 򻺴дݣֻߵ.
+ *
+ * @details ռ䲻ʱһֽҲд룬һ֡ݲ.
+ * 
+ * @param[in]	bf.
+ * @param[in]	data Ҫд.
+ * @param[in]	len ݳ.
+ * @retval	ERR_OK	дɹ
+ * @retval	ERR_MEM_UNAVAILABLE	ռ䲻 
+ */
+int	BFWrite( sByteFifo *bf, char *data, uint16_t len)
+{
+	uint16_t	wr = bf->write;
+	uint16_t	tail = 0;
+	
+	if( len > BFFreeSize( bf))	return ERR_MEM_UNAVAILABLE;
+	tail = bf->size - wr;
+	if( tail > len)
+		tail = len;
+	memcpy( bf->buf + wr, data, tail);
+	memcpy( bf->buf, data + tail, len - tail);
+	BF_MEMORY_BARRIER;
+	bf->write = ( wr + len) & ( bf->size - 1);
+	return ERR_OK;
+}
+
+/**
+ * @brief ӻȡݣֻߵ.
+ *
+ * @param[in]	bf.
+ * @param[out]	data ȡݴŵĵط.
+ * @param[in]	len dataĳ.
+ * @retval	ȡĳ
+ */
+int	BFRead( sByteFifo *bf, char *data, uint16_t len)
+{
+	uint16_t	rd = bf->read;
+	uint16_t	tail = 0;
+	uint16_t	dlen = BFLengthData( bf);
+	
+	if( len > dlen)
+		len = dlen;
+	tail = bf->size - rd;
+	if( tail > len)
+		tail = len;
+	memcpy( data, bf->buf + rd, tail);
+	memcpy( data + tail, bf->buf, len - tail);
+	BF_MEMORY_BARRIER;
+	bf->read = ( rd + len) & ( bf->size - 1);
+	return len;
+}
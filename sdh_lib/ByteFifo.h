@@ -0,0 +1,27 @@
+#ifndef _BYTEFIFO_H__
+#define _BYTEFIFO_H__
+#include "stdint.h"
+
+//ߵߵֽڻλ棬Ҫ
+//дλֻ޸ģλֻ޸
+typedef struct {
+	char				*buf;
+	uint16_t			size;		//2
+	volatile uint16_t	read;		//ǰĶλ
+	volatile uint16_t	write;		//ǰдλ
+	
+}sByteFifo;
+
+//֤д뻺棬ٸ¶дλ
+#ifdef __CC_ARM
+#define BF_MEMORY_BARRIER	__dmb(0xf)
+#else
+#define BF_MEMORY_BARRIER	__sync_synchronize()
+#endif
+
+void	BFInit( sByteFifo *bf, char *buf, uint16_t size);
+uint16_t	BFLengthData( sByteFifo *bf);
+uint16_t	BFFreeSize( sByteFifo *bf);
+int	BFWrite( sByteFifo *bf, char *data, uint16_t len);
+int	BFRead( sByteFifo *bf, char *data, uint16_t len);
+#endif
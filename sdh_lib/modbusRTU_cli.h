@@ -15,7 +15,7 @@
 
 
 #define STATE_SIZE 		16//128										//״̬Ĵ
-#define INPUT_SIZE 		12//160										//Ĵ
+#define INPUT_SIZE 		24//160										//Ĵ
 #define COIL_SIZE 		32//256										//ȦĴ
 #define HOLD_SIZE 		23//160										//ּĴ
 
@@ -42,6 +42,10 @@ static char Flash_err_flag = 0;
 
 static	int FsErr = 0;
 
+//ֻһ棬߳ʹļϵͳʱд̶Ҫ
+osMutexDef( FsMutex);
+static osMutexId FsMutex_id = NULL;
+
 
 static void get_area( int pg_offset, int size, area_t *out_area);
 static int page_malloc( area_t *area, int len);
@@ -84,6 +88,8 @@ int filesys_init(void)
 	StrgInfo.block_size = StrgInfo.block_pagenum * StrgInfo.page_size;
 	StrgInfo.block_number = StrgInfo.total_pagenum / StrgInfo.block_pagenum;
 	Flash_buf = malloc( StrgInfo.sector_size);
+	if( FsMutex_id == NULL)
+		FsMutex_id = osMutexCreate( osMutex( FsMutex));
 	if( Flash_buf == NULL)
 		return ERR_FLASH_UNAVAILABLE;
 		
@@ -860,6 +866,19 @@ int fs_delete( sdhFile *fd)
 	
 }
 
+//ں֮ǰֻһ̣߳Ҫ
+void fs_lock( void)
+{
+	if( FsMutex_id && osKernelRunning())
+		osMutexWait( FsMutex_id, osWaitForever);
+}
+
+void fs_unlock( void)
+{
+	if( FsMutex_id && osKernelRunning())
+		osMutexRelease( FsMutex_id);
+}
+
 int fs_flush( void)
 {
 	int ret;
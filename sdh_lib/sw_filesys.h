@@ -177,6 +177,8 @@ int fs_close( sdhFile *fd);
 
 
 int fs_flush( void);
+void fs_lock( void);
+void fs_unlock( void);
 int fs_format(void);
 int fs_test(void);
 #endif
@@ -67,6 +67,9 @@ typedef struct  {
 		uint8_t	rx_sms_seq;
 		uint8_t	set_tcp_close;		
 		uint8_t	set_tcp_recv;
+		uint8_t	set_tcp_cnnt;			//ӳɹļ
+		uint8_t	set_tcp_cnntfail;		//ʧܵļ
+		uint8_t	tka_on;					//ģTCPѾ
 		
 		uint8_t		signal_strength;			//0 - 31
 		uint8_t		ber;						// 0 - 7
@@ -0,0 +1,118 @@
+/**
+* @file 		bytefifo_test.c
+* @brief		PCϲByteFifo.
+* @details		1. дλƻػ濪ͷ֮ݺͳȷ
+*				2. ֻܷsize-1ֽڣŲµʱдκ
+*				3. ûз仺ĶУsize0ռ0д뷵ERR_MEM_UNAVAILABLE
+*				4. gprs.cTcpTxQueue_initķʽһڴָУд֮󻥲
+*
+*				루Linux
+*					cc -Wall -Isdh_lib -I. -o bytefifo_test tools/host_test/bytefifo_test.c sdh_lib/ByteFifo.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include <string.h>
+#include "ByteFifo.h"
+#include "sdhError.h"
+#include "host_test.h"
+
+//gprs.cһ
+#define URGENTBUF_LEN		64
+#define TCPSENDBUF_LEN		256
+#define TCPTXQ_LEN			( URGENTBUF_LEN + 2 * TCPSENDBUF_LEN)
+
+static void test_wrap( void)
+{
+	sByteFifo	bf;
+	char		buf[16], in[8], out[8];
+	int			i, j;
+
+	BFInit( &bf, buf, sizeof( buf));
+	CHECK( BFLengthData( &bf) == 0);
+	CHECK( BFFreeSize( &bf) == 15);
+	//ÿд77дλûƻ
+	for( i = 0; i < 20; i ++)
+	{
+		for( j = 0; j < 7; j ++)
+			in[j] = ( char)( i * 7 + j);
+		CHECK( BFWrite( &bf, in, 7) == ERR_OK);
+		CHECK( BFLengthData( &bf) == 7);
+		CHECK( BFRead( &bf, out, 3) == 3);
+		CHECK( BFRead( &bf, out + 3, 8) == 4);
+		CHECK( memcmp( in, out, 7) == 0);
+		CHECK( BFLengthData( &bf) == 0);
+	}
+}
+
+static void test_full( void)
+{
+	sByteFifo	bf;
+	char		buf[16], data[16], out[16];
+
+	memset( data, 0xA5, sizeof( data));
+	BFInit( &bf, buf, sizeof( buf));
+	CHECK( BFWrite( &bf, data, 16) == ERR_MEM_UNAVAILABLE);
+	CHECK( BFLengthData( &bf) == 0);
+	CHECK( BFWrite( &bf, data, 10) == ERR_OK);
+	CHECK( BFWrite( &bf, data, 6) == ERR_MEM_UNAVAILABLE);
+	CHECK( BFLengthData( &bf) == 10);
+	CHECK( BFWrite( &bf, data, 5) == ERR_OK);
+	CHECK( BFFreeSize( &bf) == 0);
+	CHECK( BFRead( &bf, out, sizeof( out)) == 15);
+	CHECK( BFRead( &bf, out, sizeof( out)) == 0);
+}
+
+static void test_unallocated( void)
+{
+	sByteFifo	bf;
+	char		data[4] = { 1, 2, 3, 4};
+
+	//ûõĲ仺棬бֳʼȫ0
+	memset( &bf, 0, sizeof( bf));
+	CHECK( BFFreeSize( &bf) == 0);
+	CHECK( BFLengthData( &bf) == 0);
+	CHECK( BFWrite( &bf, data, sizeof( data)) == ERR_MEM_UNAVAILABLE);
+	CHECK( BFRead( &bf, data, sizeof( data)) == 0);
+}
+
+static void test_carve( void)
+{
+	static char	block[ TCPTXQ_LEN + 1];
+	sByteFifo	urg, bulk, tx;
+	char		data[ TCPSENDBUF_LEN];
+	char		out[ TCPSENDBUF_LEN];
+
+	block[ TCPTXQ_LEN] = 0x5A;			//鲻дڴ
+	BFInit( &urg, block, URGENTBUF_LEN);
+	BFInit( &tx, block + TCPTXQ_LEN - TCPSENDBUF_LEN, TCPSENDBUF_LEN);
+	BFInit( &bulk, block + URGENTBUF_LEN, TCPSENDBUF_LEN);
+
+	memset( data, 'u', sizeof( data));
+	CHECK( BFWrite( &urg, data, URGENTBUF_LEN - 1) == ERR_OK);
+	memset( data, 'b', sizeof( data));
+	CHECK( BFWrite( &bulk, data, TCPSENDBUF_LEN - 1) == ERR_OK);
+	memset( data, 't', sizeof( data));
+	CHECK( BFWrite( &tx, data, TCPSENDBUF_LEN - 1) == ERR_OK);
+	CHECK( block[ TCPTXQ_LEN] == 0x5A);
+
+	memset( data, 'u', sizeof( data));
+	CHECK( BFRead( &urg, out, sizeof( out)) == URGENTBUF_LEN - 1);
+	CHECK( memcmp( out, data, URGENTBUF_LEN - 1) == 0);
+	memset( data, 'b', sizeof( data));
+	CHECK( BFRead( &bulk, out, sizeof( out)) == TCPSENDBUF_LEN - 1);
+	CHECK( memcmp( out, data, TCPSENDBUF_LEN - 1) == 0);
+	memset( data, 't', sizeof( data));
+	CHECK( BFRead( &tx, out, sizeof( out)) == TCPSENDBUF_LEN - 1);
+	CHECK( memcmp( out, data, TCPSENDBUF_LEN - 1) == 0);
+}
+
+int main( void)
+{
+	test_wrap();
+	test_full();
+	test_unallocated();
+	test_carve();
+	return TEST_END();
+}
@@ -0,0 +1,134 @@
+/**
+* @file 		dnscache_test.c
+* @brief		PCϲĽ.
+* @details		1. жõĵַǲIP
+*				2. ЧֱIP֮þɵIPҪ½DNS_STALE_S
+*				3. ʧ֮DEF_DNS_NEG_SڲٽоɵIPþɵ
+*				4. ûIPʧ֮½
+*				5. õ޸֮ɵļ¼ϣ¼滻ûõ
+*
+*				루Linux
+*					cc -Wall -Iclass -o dnscache_test tools/host_test/dnscache_test.c class/dnscache.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include <string.h>
+#include "dnscache.h"
+#include "host_test.h"
+
+#define TTL_S		100
+#define NEG_S		30
+
+static void test_is_ip( void)
+{
+	CHECK( Dns_is_ip( "192.168.1.10") == 1);
+	CHECK( Dns_is_ip( "0.0.0.0") == 1);
+	CHECK( Dns_is_ip( "192.168.1") == 0);
+	CHECK( Dns_is_ip( "192.168.1.") == 0);
+	CHECK( Dns_is_ip( "192..1.10") == 0);
+	CHECK( Dns_is_ip( "1921.168.1.10") == 0);
+	CHECK( Dns_is_ip( "dtu.example.com") == 0);
+	CHECK( Dns_is_ip( "") == 0);
+}
+
+static void test_ttl( void)
+{
+	char	host[] = "dtu.example.com";
+	char	ip[ DNS_IP_LEN];
+
+	Dns_init( TTL_S, NEG_S);
+	CHECK( Dns_lookup( host, 0, ip) == DNS_MISS);
+	CHECK( Dns_refresh_due( 0) == NULL);
+
+	Dns_resolved( host, "10.0.0.1", 10);
+	memset( ip, 0, sizeof( ip));
+	CHECK( Dns_lookup( host, 10 + TTL_S - 1, ip) == DNS_HIT);
+	CHECK( strcmp( ip, "10.0.0.1") == 0);
+	CHECK( Dns_refresh_due( 10 + TTL_S - 1) == NULL);
+
+	//ˣɵIP
+	CHECK( Dns_lookup( host, 10 + TTL_S, ip) == DNS_STALE);
+	CHECK( Dns_refresh_due( 10 + TTL_S) == host);
+	CHECK( Dns_lookup( host, 10 + TTL_S + DNS_STALE_S - 1, ip) == DNS_STALE);
+	CHECK( Dns_lookup( host, 10 + TTL_S + DNS_STALE_S, ip) == DNS_MISS);
+
+	Dns_resolved( host, "10.0.0.2", 200);
+	CHECK( Dns_lookup( host, 200, ip) == DNS_HIT);
+	CHECK( strcmp( ip, "10.0.0.2") == 0);
+	CHECK( Dns_get( 0)->resolves == 2);
+}
+
+static void test_fail( void)
+{
+	char	host[] = "dtu.example.com";
+	char	other[] = "backup.example.com";
+	char	ip[ DNS_IP_LEN];
+
+	//ûоɵIPʧ֮ʱ䲻
+	Dns_init( TTL_S, NEG_S);
+	Dns_failed( other, 0);
+	CHECK( Dns_lookup( other, NEG_S - 1, ip) == DNS_NEG);
+	CHECK( Dns_lookup( other, NEG_S, ip) == DNS_MISS);
+	CHECK( Dns_refresh_due( NEG_S) == NULL);
+
+	//оɵIPʧ˻þɵ
+	Dns_resolved( host, "10.0.0.1", 0);
+	Dns_failed( host, TTL_S);
+	CHECK( Dns_lookup( host, TTL_S + 1, ip) == DNS_STALE);
+	CHECK( Dns_refresh_due( TTL_S + 1) == NULL);
+	CHECK( Dns_refresh_due( TTL_S + NEG_S) == host);
+
+	//ûIPʧˣ½
+	Dns_resolved( host, "10.0.0.1", 1000);
+	Dns_suspect( host);
+	CHECK( Dns_lookup( host, 1001, ip) == DNS_MISS);
+	CHECK( Dns_refresh_due( 1001) == host);
+	//½ҲʧܵʱĿֻʱӣIP
+	Dns_failed( host, 1002);
+	CHECK( Dns_lookup( host, 1003, ip) == DNS_STALE);
+	Dns_resolved( host, "10.0.0.3", 1004);
+	CHECK( Dns_lookup( host, 1005, ip) == DNS_HIT);
+	CHECK( strcmp( ip, "10.0.0.3") == 0);
+
+	//ĵַض
+	Dns_resolved( host, "123.123.123.123456", 1006);
+	CHECK( strlen( Dns_get( 1)->ip) == DNS_IP_LEN - 1);
+}
+
+static void test_replace( void)
+{
+	char	hosts[ DNS_CACHE_NUM + 1][16];
+	char	ip[ DNS_IP_LEN];
+	int		j;
+
+	Dns_init( TTL_S, NEG_S);
+	for( j = 0; j <= DNS_CACHE_NUM; j ++)
+		sprintf( hosts[ j], "c%d.example.com", j);
+	for( j = 0; j < DNS_CACHE_NUM; j ++)
+		Dns_resolved( hosts[ j], "10.0.0.1", j);
+	CHECK( Dns_lookup( hosts[0], 10, ip) == DNS_HIT);
+	//c1ûã滻
+	Dns_resolved( hosts[ DNS_CACHE_NUM], "10.0.0.2", 11);
+	CHECK( Dns_lookup( hosts[1], 12, ip) == DNS_MISS);
+	CHECK( Dns_lookup( hosts[0], 12, ip) == DNS_HIT);
+	CHECK( Dns_lookup( hosts[ DNS_CACHE_NUM], 12, ip) == DNS_HIT);
+
+	//ˣ¼ϣλÿʹ
+	strcpy( hosts[2], "new.example.com");
+	CHECK( Dns_lookup( hosts[2], 13, ip) == DNS_MISS);
+	Dns_resolved( hosts[1], "10.0.0.4", 14);
+	CHECK( Dns_lookup( hosts[3], 15, ip) == DNS_HIT);
+	CHECK( Dns_lookup( hosts[1], 15, ip) == DNS_HIT);
+	CHECK( strcmp( ip, "10.0.0.4") == 0);
+}
+
+int main( void)
+{
+	test_is_ip();
+	test_ttl();
+	test_fail();
+	test_replace();
+	return TEST_END();
+}
@@ -0,0 +1,26 @@
+/**
+* @file 		host_test.h
+* @brief		PCϵģõļ.
+* @details		ÿԳļCHECKʧܵʱӡļкţ
+*				main󷵻Test_fails0ʾмûͨ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+#include <stdio.h>
+
+static int Test_fails;
+
+#define CHECK( cond)	do { \
+	if( !( cond)) { \
+		printf( "%s:%d: CHECK( %s) failed\n", __FILE__, __LINE__, #cond); \
+		Test_fails ++; \
+	} \
+} while( 0)
+
+//ÿԳmainãӡ
+#define TEST_END()		( printf( "%s: %s\n", __FILE__, Test_fails ? "FAIL" : "ok"), Test_fails ? 1 : 0)
+
+#endif
@@ -0,0 +1,117 @@
+/**
+* @file 		route_test.c
+* @brief		PCϲԶĵ·.
+* @details		1. ROUTE_ALLŵ
+*				2. лʧܻ߳ʱûȷϾеһģ
+*				   Ļָ֮ȶROUTE_HOLDDOWN_Sлȥ
+*				3. ֵڿõ֮RTTһϵĲμ
+*				4. õʱǷŵ
+*
+*				루Linux
+*					cc -Wall -Iclass -o route_test tools/host_test/route_test.c class/route.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include "route.h"
+#include "host_test.h"
+
+static void test_all( void)
+{
+	Route_init( ROUTE_ALL, 0);
+	CHECK( Route_pick( 0x0b, 0) == 0x0b);
+	Route_stall( 0);
+	CHECK( Route_pick( 0x0b, 0) == 0x0b);
+	CHECK( Route_active() == -1);
+}
+
+static void test_failover( void)
+{
+	int i;
+
+	Route_init( ROUTE_FAILOVER, 1);
+	CHECK( Route_pick( 0, 0) == 0);
+	CHECK( Route_pick( 0x07, 0) == 0x02);
+	CHECK( Route_active() == 1);
+	CHECK( Route_failovers() == 0);
+
+	//ûӵʱһ
+	Route_init( ROUTE_FAILOVER, 1);
+	CHECK( Route_pick( 0x05, 0) == 0x04);
+
+	//ʧ
+	Route_init( ROUTE_FAILOVER, 0);
+	CHECK( Route_pick( 0x03, 0) == 0x01);
+	for( i = 0; i < ROUTE_FAIL_MAX - 1; i ++)
+		Route_sent( 0, 0);
+	CHECK( Route_pick( 0x03, 1) == 0x01);
+	Route_sent( 0, 1);				//ɹһ¼
+	for( i = 0; i < ROUTE_FAIL_MAX - 1; i ++)
+		Route_sent( 0, 0);
+	CHECK( Route_pick( 0x03, 1) == 0x01);
+	Route_sent( 0, 0);
+	CHECK( Route_get( 0)->healthy == 0);
+	CHECK( Route_get( 0)->fails == ROUTE_FAIL_MAX * 2 - 1);
+	CHECK( Route_pick( 0x03, 2) == 0x02);
+	CHECK( Route_failovers() == 1);
+
+	//ͳɹĻָȷݲ
+	Route_sent( 0, 1);
+	CHECK( Route_pick( 0x03, 3) == 0x02);
+	Route_rtt( 0, 300, 10);
+	CHECK( Route_pick( 0x03, 10 + ROUTE_HOLDDOWN_S - 1) == 0x02);
+	CHECK( Route_pick( 0x03, 10 + ROUTE_HOLDDOWN_S) == 0x01);
+	CHECK( Route_failovers() == 2);
+
+	//ʱûȷ
+	Route_stall( 0);
+	CHECK( Route_get( 0)->stalls == 1);
+	CHECK( Route_pick( 0x03, 50) == 0x02);
+	//õıĶϿ
+	CHECK( Route_pick( 0x01, 51) == 0x01);
+	CHECK( Route_failovers() == 4);
+}
+
+static void test_balance( void)
+{
+	uint8_t	seen = 0;
+	int		i;
+
+	Route_init( ROUTE_BALANCE, 0);
+	//ûвRTTʱ򶼲μ
+	for( i = 0; i < 6; i ++)
+		seen |= Route_pick( 0x07, 0);
+	CHECK( seen == 0x07);
+	CHECK( Route_pick( 0x07, 0) != Route_pick( 0x07, 0));
+
+	Route_rtt( 0, 100, 0);
+	Route_rtt( 1, 150, 0);
+	Route_rtt( 2, 500, 0);
+	seen = 0;
+	for( i = 0; i < 6; i ++)
+		seen |= Route_pick( 0x07, 0);
+	CHECK( seen == 0x03);
+
+	//RTTƽ
+	Route_rtt( 0, 900, 0);
+	CHECK( Route_get( 0)->srtt_ms == ( 100 * 7 + 900) / 8);
+
+	//õʱǷŵ
+	Route_stall( 0);
+	Route_stall( 1);
+	Route_stall( 2);
+	CHECK( Route_usable( 0x07) == 0x07);
+	Route_link_up( 2, 0);
+	CHECK( Route_usable( 0x07) == 0x04);
+	CHECK( Route_pick( 0x07, 0) == 0x04);
+	CHECK( Route_get( ROUTE_CENTER_NUM) == NULL);
+}
+
+int main( void)
+{
+	test_all();
+	test_failover();
+	test_balance();
+	return TEST_END();
+}
@@ -0,0 +1,387 @@
+/**
+* @file 		spool_test.c
+* @brief		PCϲ·Ͽڼݵݴ.
+* @details		spool.cֱӰflashϵļļʵִ档
+*				1. ûʱ
+*				2. ˳ϲһ֡ɾ֮дļصͷ֮ݲ
+*				3. ֮öµݻļ¼
+*				4. ϵ֮ļͷָдλ
+*				5. crcļ¼֮ؽļ
+*				6. У׼ʱʱֻϲʱļ¼ٶȵ
+*
+*				루Linux
+*					cc -Wall -Iclass -IBSP -Isdh_lib -I. -o spool_test tools/host_test/spool_test.c \
+*						sdh_lib/modbusRTU_cli.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+
+//sw_filesys.hֻһļдλ÷ֿдֱӱ棬Ҫflush
+#define __FILE_SYS_H__
+#define	PAGE_SIZE			256
+#define ERR_FILE_EMPTY		-2
+#define ERR_FILE_FULL		-3
+enum {
+	WR_SEEK_SET = 0,
+	RD_SEEK_SET = 3,
+};
+typedef struct {
+	uint8_t		*data;
+	int			size;
+	int			rd;
+	int			wr;
+}sdhFile;
+
+static sdhFile		Flash;
+static int			Lock_depth;
+
+sdhFile *fs_open( char *name)
+{
+	return Flash.data ? &Flash : NULL;
+}
+
+sdhFile *fs_creator( char *name, int len)
+{
+	Flash.size = ( len + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+	Flash.data = malloc( Flash.size);
+	memset( Flash.data, 0xff, Flash.size);
+	Flash.rd = Flash.wr = 0;
+	return &Flash;
+}
+
+int fs_delete( sdhFile *fd)
+{
+	free( fd->data);
+	fd->data = NULL;
+	return 0;
+}
+
+int fs_du( sdhFile *fd)
+{
+	return fd->size;
+}
+
+int fs_lseek( sdhFile *fd, int offset, int whence)
+{
+	if( whence == RD_SEEK_SET)
+		fd->rd = offset;
+	else
+		fd->wr = offset;
+	return 0;
+}
+
+int fs_read( sdhFile *fd, uint8_t *data, int len)
+{
+	if( fd->rd + len > fd->size)
+		return ERR_FILE_EMPTY;
+	memcpy( data, fd->data + fd->rd, len);
+	fd->rd += len;
+	return 0;
+}
+
+int fs_write( sdhFile *fd, uint8_t *data, int len)
+{
+	if( fd->wr + len > fd->size)
+		return ERR_FILE_FULL;
+	memcpy( fd->data + fd->wr, data, len);
+	fd->wr += len;
+	return 0;
+}
+
+int fs_flush( void)
+{
+	return 0;
+}
+
+void fs_lock( void)
+{
+	Lock_depth ++;
+}
+
+void fs_unlock( void)
+{
+	Lock_depth --;
+}
+
+//dtuConfig.hֻݴõ
+#define __DTUCONFIG_H__
+typedef struct {
+	uint16_t	spool_size_kb;
+	uint16_t	spool_rate_Bps;
+	uint8_t		spool_drop;
+	uint8_t		time_src;
+	uint8_t		batch_s;
+}DtuCfg_t;
+DtuCfg_t	Dtu_config;
+
+static uint32_t	Now_s;
+
+uint32_t get_time_s( void)
+{
+	return Now_s;
+}
+
+uint32_t get_time_ms( void)
+{
+	return Now_s * 1000;
+}
+
+#include "spool.c"
+
+#define REC_BUF_LEN		512
+
+//i¼ǰ4ֽţ8255֮仯
+static int make_rec( uint32_t i, char *buf)
+{
+	int len = 8 + ( i * 37) % 248;
+	int j;
+
+	memcpy( buf, &i, 4);
+	for( j = 4; j < len; j ++)
+		buf[j] = ( char)( i + j);
+	return len;
+}
+
+//ɾmax¼Ǵfirstʼļ¼ɾļ¼
+static int drain( uint32_t first, int max)
+{
+	char		buf[ REC_BUF_LEN], rec[ 256];
+	uint32_t	ts;
+	int			num, len, got = 0;
+	int			n, k, off;
+
+	while( got < max && Spool_count())
+	{
+		n = Spool_read( buf, sizeof( buf), &num, &ts);
+		if( num == 0)
+			break;
+		for( k = 0, off = 0; k < num; k ++, off += len)
+		{
+			len = make_rec( first + got + k, rec);
+			CHECK( off + len <= n && memcmp( buf + off, rec, len) == 0);
+		}
+		CHECK( off == n);
+		CHECK( ts == first + got);
+		//ֻɾҪ´ٶ
+		if( num > max - got)
+			num = max - got;
+		Spool_pop( num);
+		got += num;
+	}
+	return got;
+}
+
+//ģϵ磬flashϵļ
+static void spool_restart( uint16_t kb, uint8_t drop)
+{
+	memset( &Dtu_config, 0, sizeof( Dtu_config));
+	Dtu_config.spool_size_kb = kb;
+	Dtu_config.spool_drop = drop;
+	CHECK( Spool_init() == ERR_OK);
+	CHECK( Lock_depth == 0);
+}
+
+//ӿյflashʼ
+static void spool_setup( uint16_t kb, uint8_t drop)
+{
+	if( Flash.data)
+		fs_delete( &Flash);
+	spool_restart( kb, drop);
+}
+
+static void test_off( void)
+{
+	char	buf[8];
+	int		num;
+	uint32_t	ts;
+
+	spool_setup( 0, SPOOL_DROP_NEW);
+	CHECK( Spool_on() == 0);
+	CHECK( Spool_put( buf, sizeof( buf), 0) == ERR_UNINITIALIZED);
+	CHECK( Spool_read( buf, sizeof( buf), &num, &ts) == 0 && num == 0);
+	CHECK( Spool_pop( 1) == ERR_UNINITIALIZED);
+}
+
+static void test_wrap( void)
+{
+	char		rec[256];
+	uint32_t	w = 0, r = 0;
+	int			i, len;
+
+	spool_setup( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	CHECK( Spool_on() == 1);
+	CHECK( Spool_count() == 0);
+	CHECK( Spool_put( rec, 0, 0) == ERR_BAD_PARAMETER);
+	CHECK( Spool_put( rec, SPOOL_REC_MAX + 1, 0) == ERR_BAD_PARAMETER);
+
+	//ÿдıȶĶ࣬ļصͷܶ
+	for( i = 0; i < 200; i ++)
+	{
+		while( w - r < 20)
+		{
+			len = make_rec( w, rec);
+			CHECK( Spool_put( rec, len, w) == ERR_OK);
+			w ++;
+		}
+		r += drain( r, 15);
+		CHECK( Spool_count() == w - r);
+		CHECK( Spool_usage() > 0 && Spool_usage() <= 100);
+	}
+	r += drain( r, w);
+	CHECK( r == w);
+	CHECK( Spool_count() == 0 && Spool_usage() == 0);
+	CHECK( Spool_drop_count() == 0);
+	CHECK( Lock_depth == 0);
+}
+
+static void test_full( void)
+{
+	char		rec[256];
+	uint32_t	w = 0;
+	int			len, ret, kept;
+
+	//µ
+	spool_setup( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	for( ;;)
+	{
+		len = make_rec( w, rec);
+		if( ( ret = Spool_put( rec, len, w)) != ERR_OK)
+			break;
+		w ++;
+	}
+	CHECK( ret == ERR_MEM_UNAVAILABLE);
+	CHECK( Spool_drop_count() == 1);
+	CHECK( Spool_count() == w);
+	CHECK( Spool_usage() > 90);
+	CHECK( drain( 0, w) == w);
+
+	//ݣµд¼
+	spool_setup( SPOOL_SIZE_KB_MIN, SPOOL_DROP_OLD);
+	for( w = 0; w < 500; w ++)
+	{
+		len = make_rec( w, rec);
+		CHECK( Spool_put( rec, len, w) == ERR_OK);
+	}
+	kept = Spool_count();
+	CHECK( kept > 0 && kept < 500);
+	CHECK( Spool_drop_count() == 500 - kept);
+	CHECK( drain( 500 - kept, kept) == kept);
+}
+
+static void test_restart( void)
+{
+	char		rec[256];
+	uint32_t	w;
+	int			len;
+
+	spool_setup( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	for( w = 0; w < 40; w ++)
+	{
+		len = make_rec( w, rec);
+		CHECK( Spool_put( rec, len, w) == ERR_OK);
+	}
+	CHECK( drain( 0, 15) == 15);
+	Spool_sync();
+
+	//ϵ磬д
+	spool_restart( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	CHECK( Spool_count() == 25);
+	for( ; w < 50; w ++)
+	{
+		len = make_rec( w, rec);
+		CHECK( Spool_put( rec, len, w) == ERR_OK);
+	}
+	Spool_sync();
+	spool_restart( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	CHECK( Spool_count() == 35);
+	CHECK( drain( 15, 30) == 30);
+
+	//λûбʱطᶪʧ
+	for( ; w < 60; w ++)
+	{
+		len = make_rec( w, rec);
+		CHECK( Spool_put( rec, len, w) == ERR_OK);
+	}
+	Spool_sync();
+	CHECK( drain( 45, 10) == 10);
+	spool_restart( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	CHECK( Spool_count() == 15);
+	CHECK( drain( 45, 15) == 15);
+
+	//ˣؽļ
+	Spool_put( rec, len, 0);
+	spool_restart( SPOOL_SIZE_KB_MIN * 2, SPOOL_DROP_NEW);
+	CHECK( Spool_count() == 0);
+	CHECK( fs_du( &Flash) == SPOOL_SIZE_KB_MIN * 2 * 1024);
+}
+
+static void test_crc( void)
+{
+	char		rec[256], buf[ REC_BUF_LEN];
+	uint32_t	ts;
+	int			num, len;
+
+	spool_setup( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	for( ts = 0; ts < 3; ts ++)
+	{
+		len = make_rec( ts, rec);
+		Spool_put( rec, len, ts);
+	}
+	//һ¼ݻ
+	Flash.data[ SPOOL_DATA_OFS + sizeof( spool_rec_t) + 5] ^= 0x40;
+	len = Spool_read( buf, sizeof( buf), &num, &ts);
+	CHECK( num == 2 && ts == 1);
+	CHECK( Spool_drop_count() == 1);
+	CHECK( Spool_count() == 2);
+	CHECK( drain( 1, 2) == 2);
+}
+
+static void test_merge_rate( void)
+{
+	char		rec[256], buf[ REC_BUF_LEN];
+	uint32_t	ts;
+	int			num;
+
+	spool_setup( SPOOL_SIZE_KB_MIN, SPOOL_DROP_NEW);
+	Dtu_config.time_src = WCLK_SRC_NITZ;
+	memset( rec, 0x33, 16);
+	Spool_put( rec, 16, 1000);
+	Spool_put( rec, 16, 1000 + SPOOL_MERGE_S);
+	Spool_put( rec, 16, 1000 + SPOOL_MERGE_S * 3);
+	CHECK( Spool_read( buf, sizeof( buf), &num, &ts) == 32);
+	CHECK( num == 2 && ts == 1000);
+	Spool_pop( num);
+	CHECK( Spool_read( buf, sizeof( buf), &num, &ts) == 16);
+	CHECK( ts == 1000 + SPOOL_MERGE_S * 3);
+	Spool_pop( num);
+	//bufŲµļ¼´
+	Spool_put( rec, 16, 0);
+	CHECK( Spool_read( buf, 15, &num, &ts) == 0 && num == 0);
+
+	Dtu_config.spool_rate_Bps = 100;
+	Now_s = 10;
+	CHECK( Spool_rate_allow( 60) == 1);
+	CHECK( Spool_rate_allow( 60) == 1);
+	CHECK( Spool_rate_allow( 1) == 0);
+	Now_s = 11;
+	CHECK( Spool_rate_allow( 60) == 1);
+	Dtu_config.spool_rate_Bps = 0;
+	CHECK( Spool_rate_allow( 10000) == 1);
+}
+
+int main( void)
+{
+	test_off();
+	test_wrap();
+	test_full();
+	test_restart();
+	test_crc();
+	test_merge_rate();
+	CHECK( Lock_depth == 0);
+	return TEST_END();
+}
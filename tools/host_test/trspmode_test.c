@@ -0,0 +1,90 @@
+/**
+* @file 		trspmode_test.c
+* @brief		PCϲ͸ģʽģʽģʽл.
+* @details		1. ӽģʽҪָʱ˳ģʽָл
+*				2. Ҫ߿TRSP_IDLE_MS֮ATOصģʽ
+*				3. TRSP_ESC_FAIL_MAX˲ģʽATOʧܣΪӶϿ
+*				4. лʱļ¼0xffff0xffff
+*
+*				루Linux
+*					cc -Wall -Iclass -o trspmode_test tools/host_test/trspmode_test.c class/trspMode.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include "trspMode.h"
+#include "host_test.h"
+
+static void test_switch( void)
+{
+	trspMode_t	t;
+
+	TrspMode_init( &t);
+	CHECK( t.state == TRSP_ST_IDLE);
+	//ûӵʱҪл
+	CHECK( TrspMode_want_cmd( &t, 0) == TRSP_ACT_NONE);
+	CHECK( TrspMode_want_data( &t) == TRSP_ACT_NONE);
+
+	TrspMode_link( &t, 1);
+	CHECK( t.state == TRSP_ST_DATA);
+	CHECK( TrspMode_want_data( &t) == TRSP_ACT_NONE);
+	CHECK( TrspMode_want_cmd( &t, 1000) == TRSP_ACT_ESCAPE);
+	CHECK( t.state == TRSP_ST_SWITCH);
+	CHECK( TrspMode_done( &t, 1, 1200) == TRSP_ST_CMD);
+	CHECK( t.esc_count == 1 && t.last_ms == 1200 && t.max_ms == 1200);
+
+	//ģʽָ
+	CHECK( TrspMode_want_cmd( &t, 1100) == TRSP_ACT_NONE);
+	CHECK( TrspMode_idle( &t, 1100 + TRSP_IDLE_MS - 1) == 0);
+	CHECK( TrspMode_idle( &t, 1100 + TRSP_IDLE_MS) == 1);
+
+	CHECK( TrspMode_want_data( &t) == TRSP_ACT_RESUME);
+	CHECK( TrspMode_idle( &t, 5000) == 0);
+	CHECK( TrspMode_done( &t, 1, 100) == TRSP_ST_DATA);
+	CHECK( t.res_count == 1 && t.last_ms == 100 && t.max_ms == 1200);
+
+	//ظ·״̬ıģʽ
+	TrspMode_link( &t, 1);
+	CHECK( t.state == TRSP_ST_DATA);
+	TrspMode_link( &t, 0);
+	CHECK( t.state == TRSP_ST_IDLE);
+}
+
+static void test_fail( void)
+{
+	trspMode_t	t;
+	int			i;
+
+	TrspMode_init( &t);
+	TrspMode_link( &t, 1);
+	for( i = 1; i < TRSP_ESC_FAIL_MAX; i ++)
+	{
+		CHECK( TrspMode_want_cmd( &t, 0) == TRSP_ACT_ESCAPE);
+		CHECK( TrspMode_done( &t, 0, 0x12345) == TRSP_ST_DATA);
+		CHECK( t.esc_fail == i);
+	}
+	CHECK( t.last_ms == 0xffff);
+	CHECK( TrspMode_want_cmd( &t, 0) == TRSP_ACT_ESCAPE);
+	CHECK( TrspMode_done( &t, 0, 10) == TRSP_ST_IDLE);
+	CHECK( t.esc_fail == 0 && t.esc_count == 0);
+
+	//ATOʧ
+	TrspMode_link( &t, 1);
+	TrspMode_want_cmd( &t, 0);
+	TrspMode_done( &t, 1, 10);
+	CHECK( TrspMode_want_data( &t) == TRSP_ACT_RESUME);
+	CHECK( TrspMode_done( &t, 0, 10) == TRSP_ST_IDLE);
+	CHECK( t.res_count == 0);
+
+	//ûлʱdoneı״̬
+	TrspMode_link( &t, 1);
+	CHECK( TrspMode_done( &t, 0, 10) == TRSP_ST_DATA);
+}
+
+int main( void)
+{
+	test_switch();
+	test_fail();
+	return TEST_END();
+}
@@ -0,0 +1,111 @@
+/**
+* @file 		upframe_test.c
+* @brief		PCϲupframeĴͽ.
+* @details		1. ٽ͡ʱݲ
+*				2. ûдUPF_LZ_ENABLEʱlzԣյѹ֡ERR_BAD_PARAMETER
+*				3. UPF_LZ_ENABLEʱظݱѹѹԭһ
+*				4. CRCͳȲԵ֡ERR_BAD_PARAMETER治ERR_MEM_UNAVAILABLE
+*
+*				루Linuxѹ͹ظһΣ
+*					cc -Wall -Iclass -Isdh_lib -I. -o upframe_test tools/host_test/upframe_test.c \
+*						class/upframe.c sdh_lib/modbusRTU_cli.c
+*					cc -Wall -DUPF_LZ_ENABLE=1 -Iclass -Isdh_lib -I. -o upframe_lz_test tools/host_test/upframe_test.c \
+*						class/upframe.c sdh_lib/modbusRTU_cli.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include <string.h>
+#include "upframe.h"
+#include "sdhError.h"
+#include "modbusRTU_cli.h"
+#include "host_test.h"
+
+static char		Data[ 600];
+static char		Frame[ 700];
+static char		Out[ 700];
+
+static void test_round_trip( void)
+{
+	uint8_t		type;
+	uint32_t	ts;
+	int			i, n, len;
+
+	for( i = 0; i < ( int)sizeof( Data); i ++)
+		Data[i] = ( char)( i * 37 + 11);
+	for( len = 0; len <= ( int)sizeof( Data); len += 75)
+	{
+		n = Upf_pack( Frame, sizeof( Frame), UPF_DATA, 0x12345678, Data, len, 0);
+		CHECK( n == len + UPF_OVERHEAD);
+		CHECK( ( uint8_t)Frame[0] == UPF_MAGIC);
+		n = Upf_unpack( Frame, n, &type, &ts, Out, sizeof( Out));
+		CHECK( n == len);
+		CHECK( type == UPF_DATA);
+		CHECK( ts == 0x12345678);
+		CHECK( memcmp( Out, Data, len) == 0);
+	}
+}
+
+static void test_lz( void)
+{
+	uint8_t		type;
+	uint32_t	ts;
+	int			i, n;
+
+	//ͬļĴӦظΣѹ
+	for( i = 0; i < ( int)sizeof( Data); i ++)
+		Data[i] = "\x01\x03\x04\x00\x10\x00\x20"[ i % 7];
+	n = Upf_pack( Frame, sizeof( Frame), UPF_DATA, 1, Data, sizeof( Data), 1);
+#if UPF_LZ_ENABLE
+	CHECK( n > 0 && n < ( int)sizeof( Data) + UPF_OVERHEAD);
+	CHECK( Frame[1] == ( char)( UPF_DATA | UPF_LZ));
+	n = Upf_unpack( Frame, n, &type, &ts, Out, sizeof( Out));
+	CHECK( n == ( int)sizeof( Data));
+	CHECK( type == ( UPF_DATA | UPF_LZ));
+	CHECK( memcmp( Out, Data, sizeof( Data)) == 0);
+#else
+	//lzԣԭ
+	CHECK( n == ( int)sizeof( Data) + UPF_OVERHEAD);
+	CHECK( Frame[1] == UPF_DATA);
+	CHECK( Upf_unpack( Frame, n, &type, &ts, Out, sizeof( Out)) == ( int)sizeof( Data));
+	//Էѹ֡ܽ
+	{
+		uint16_t crc;
+
+		Frame[1] = UPF_DATA | UPF_LZ;
+		crc = CRC16( ( uint8_t *)Frame, n - 2);
+		Frame[ n - 2] = crc >> 8;
+		Frame[ n - 1] = crc & 0xff;
+		CHECK( Upf_unpack( Frame, n, &type, &ts, Out, sizeof( Out)) == ERR_BAD_PARAMETER);
+	}
+#endif
+}
+
+static void test_errors( void)
+{
+	uint8_t		type;
+	uint32_t	ts;
+	int			n;
+
+	memset( Data, 0x55, 64);
+	CHECK( Upf_pack( Frame, 64 + UPF_OVERHEAD - 1, UPF_DATA, 0, Data, 64, 0) == ERR_MEM_UNAVAILABLE);
+	n = Upf_pack( Frame, sizeof( Frame), UPF_HEARTBEAT, 0, Data, 64, 0);
+	CHECK( n == 64 + UPF_OVERHEAD);
+	CHECK( Upf_unpack( Frame, n, &type, &ts, Out, 63) == ERR_MEM_UNAVAILABLE);
+	CHECK( Upf_unpack( Frame, n - 1, &type, &ts, Out, sizeof( Out)) == ERR_BAD_PARAMETER);
+	CHECK( Upf_unpack( Frame, UPF_OVERHEAD - 1, &type, &ts, Out, sizeof( Out)) == ERR_BAD_PARAMETER);
+	Frame[ UPF_HEAD_LEN + 3] ^= 1;
+	CHECK( Upf_unpack( Frame, n, &type, &ts, Out, sizeof( Out)) == ERR_BAD_PARAMETER);
+	Frame[ UPF_HEAD_LEN + 3] ^= 1;
+	Frame[0] = 0;
+	CHECK( Upf_unpack( Frame, n, &type, &ts, Out, sizeof( Out)) == ERR_BAD_PARAMETER);
+}
+
+int main( void)
+{
+	test_round_trip();
+	test_lz();
+	test_errors();
+	return TEST_END();
+}
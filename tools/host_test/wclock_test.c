@@ -0,0 +1,151 @@
+/**
+* @file 		wclock_test.c
+* @brief		PCϲǽʱУ׼.
+* @details		1. AT+CCLK?ĻظʱUTCģʱûù͸ʽ
+*				2. һУ׼WCLK_STEP_MSʱֱ
+*				3. Сʱ䲻
+*				4. ؼƫʱppm֮С
+*				5. У׼ڡԺ·ʱ֪ͨ
+*
+*				루Linux
+*					cc -Wall -Iclass -IBSP -I. -o wclock_test tools/host_test/wclock_test.c class/wclock.c
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include "wclock.h"
+#include "sdhError.h"
+#include "host_test.h"
+
+//2018-01-30 12:34:56 UTC
+#define T0_MS		1517315696000ULL
+
+static uint64_t		Tick_ms;
+
+//times.cıؼ
+uint64_t get_tick_ms64( void)
+{
+	return Tick_ms;
+}
+
+static void test_cclk( void)
+{
+	uint64_t	ms = 0;
+
+	CHECK( Wclock_mktime( 1970, 1, 1, 0, 0, 0) == 0);
+	CHECK( Wclock_mktime( 2018, 1, 30, 12, 34, 56) == T0_MS);
+	CHECK( Wclock_mktime( 2020, 3, 1, 0, 0, 0) - Wclock_mktime( 2020, 2, 28, 0, 0, 0) == 2 * 86400000ULL);
+
+	CHECK( Wclock_parse_cclk( "\r\n+CCLK: \"18/01/30,12:34:56+00\"\r\n\r\nOK\r\n", &ms) == ERR_OK);
+	CHECK( ms == T0_MS + 500);
+	//+32
+	CHECK( Wclock_parse_cclk( "+CCLK: \"18/01/30,20:34:56+32\"", &ms) == ERR_OK);
+	CHECK( ms == T0_MS + 500);
+	CHECK( Wclock_parse_cclk( "+CCLK: \"18/01/30,08:34:56-16\"", &ms) == ERR_OK);
+	CHECK( ms == T0_MS + 500);
+
+	ms = 1;
+	CHECK( Wclock_parse_cclk( "+CCLK: \"04/01/01,00:00:12+00\"", &ms) == ERR_UNINITIALIZED);
+	CHECK( Wclock_parse_cclk( "+CCLK: \"18/13/30,12:34:56+00\"", &ms) == ERR_BAD_PARAMETER);
+	CHECK( Wclock_parse_cclk( "+CCLK: \"18/01/30 12:34:56+00\"", &ms) == ERR_BAD_PARAMETER);
+	CHECK( Wclock_parse_cclk( "+CCLK: \"18/01/30,12:34:56\"", &ms) == ERR_BAD_PARAMETER);
+	CHECK( Wclock_parse_cclk( "ERROR", &ms) == ERR_BAD_PARAMETER);
+	CHECK( ms == 1);
+}
+
+static void test_sync( void)
+{
+	wclock_stat_t	*st = Wclock_stat();
+	uint64_t		prev, t;
+	int				i;
+
+	Tick_ms = 5000;
+	CHECK( Wclock_synced() == 0);
+	CHECK( Wclock_now_ms() == 0);
+	CHECK( Wclock_stamp_s( Tick_ms) == 5);
+
+	Wclock_sync( T0_MS, WCLK_CCLK_PREC_MS, Tick_ms, WCLK_SRC_NITZ);
+	CHECK( Wclock_synced() == 1);
+	CHECK( st->steps == 1);
+	CHECK( Wclock_now_ms() == T0_MS);
+	Tick_ms += 1500;
+	CHECK( Wclock_now_ms() == T0_MS + 1500);
+	CHECK( Wclock_stamp_s( Tick_ms) == ( T0_MS + 1500) / 1000);
+
+	//ʱ500msм䲻
+	Wclock_sync( T0_MS + 1000, WCLK_CCLK_PREC_MS, Tick_ms, WCLK_SRC_NITZ);
+	CHECK( st->steps == 1);
+	CHECK( st->last_err_ms == -500);
+	prev = Wclock_now_ms();
+	CHECK( prev == T0_MS + 1500);
+	for( i = 0; i < 1000; i ++)
+	{
+		Tick_ms += 100;
+		t = Wclock_now_ms();
+		CHECK( t >= prev);
+		prev = t;
+	}
+	CHECK( Wclock_now_ms() == T0_MS + 1000 + 100000);
+
+	//ֱ̫
+	Wclock_sync( T0_MS + 1000000, WCLK_CCLK_PREC_MS, Tick_ms, WCLK_SRC_NTP);
+	CHECK( st->steps == 2);
+	CHECK( st->src == WCLK_SRC_NTP);
+	CHECK( Wclock_now_ms() == T0_MS + 1000000);
+}
+
+//ؼʵ200ppmÿWCLK_SYNC_SУ׼һ
+static void test_ppm( void)
+{
+	wclock_stat_t	*st = Wclock_stat();
+	uint64_t		real = T0_MS + 1000000;
+	uint64_t		step = WCLK_SYNC_S * 1000ULL;
+	int64_t			err;
+	int				i;
+
+	//AT+CCLK?ľ1sҪ40000sֱܷ50ppm֮ǰУ׼ֻ
+	for( i = 0; i < 11; i ++)
+	{
+		Tick_ms += step - step * 200 / 1000000;
+		real += step;
+		Wclock_sync( real, WCLK_CCLK_PREC_MS, Tick_ms, WCLK_SRC_NITZ);
+		CHECK( st->ppm == 0);
+	}
+	CHECK( st->steps == 2);
+	Tick_ms += step - step * 200 / 1000000;
+	real += step;
+	Wclock_sync( real, WCLK_CCLK_PREC_MS, Tick_ms, WCLK_SRC_NITZ);
+	CHECK( st->ppm > 150 && st->ppm < 250);
+	//֮㰴ƫһֻ֮ʣûɵĲ
+	Tick_ms += step - step * 200 / 1000000;
+	real += step;
+	err = ( int64_t)( real - Wclock_now_ms());
+	CHECK( llabs( err) < 200);
+	CHECK( st->steps == 2);
+}
+
+static void test_due( void)
+{
+	uint32_t	s = Wclock_stat()->last_sync_s;
+
+	CHECK( Wclock_due( s + 10) == 0);
+	CHECK( Wclock_due( s + WCLK_SYNC_S) == 1);
+	Wclock_tried( s + WCLK_SYNC_S);
+	CHECK( Wclock_due( s + WCLK_SYNC_S + 1) == 0);
+	CHECK( Wclock_due( s + WCLK_SYNC_S + WCLK_RETRY_S) == 1);
+	Wclock_kick();
+	CHECK( Wclock_due( s + 10) == 1);
+	Wclock_tried( s + 10);
+	CHECK( Wclock_due( s + 11) == 0);
+}
+
+int main( void)
+{
+	test_cclk();
+	test_sync();
+	test_ppm();
+	test_due();
+	return TEST_END();
+}
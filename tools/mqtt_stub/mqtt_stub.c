@@ -0,0 +1,453 @@
+/**
+* @file 		mqtt_stub.c
+* @brief		PCϴMQTTsim800_emudtuMQTTͻ.
+* @details		1. CONNECTSUBSCRIBEPUBLISH(QoS0/1)PINGREQDISCONNECTӡյķ
+*				2. ֻ֧ȫͬ"#"βǰ׺
+*				3. ԰ظPUBACKܾӣط
+*
+*				루Linux
+*					cc -O2 -Wall -o mqtt_stub tools/mqtt_stub/mqtt_stub.c
+*				У
+*					./mqtt_stub -p 18897 -d 30
+*				sim800_emu·ŽӵĵĶ˿óĶ˿ڡ
+*
+*				׼ǿ̨
+*					pub <> <>		Ŀͻ˷
+*					kick					Ͽпͻ
+*					stats					ӡͳ
+*					quit					˳
+*
+*				
+*					-p <port>		Ķ˿ڣĬ1883
+*					-d <pct>		ظPUBACKı
+*					-r <rc>			CONNACKķ룬0ʾܾ
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define CLIENT_NUM		8
+#define RXBUF_LEN		4096
+#define TOPIC_LEN		64
+#define SUB_NUM			4
+
+typedef struct {
+	int			fd;
+	int			connected;
+	char		id[32];
+	char		subs[SUB_NUM][TOPIC_LEN];
+	int			sub_num;
+	int			len;
+	uint8_t		buf[RXBUF_LEN];
+}client_t;
+
+static client_t		Clients[CLIENT_NUM];
+
+static struct {
+	int			port;
+	int			drop_pct;
+	int			connack_rc;
+}Cfg = { 1883, 0, 0};
+
+static struct {
+	long		connects;
+	long		pub0;
+	long		pub1;
+	long		dup;
+	long		puback_drop;
+	long		pings;
+	long		bytes;
+}Stat;
+
+static void log_ts( const char *fmt, ...) __attribute__(( format( printf, 1, 2)));
+static void log_ts( const char *fmt, ...)
+{
+	struct timespec	ts;
+	va_list			ap;
+
+	clock_gettime( CLOCK_REALTIME, &ts);
+	printf( "[%ld.%03ld] ", ( long)ts.tv_sec % 1000, ts.tv_nsec / 1000000);
+	va_start( ap, fmt);
+	vprintf( fmt, ap);
+	va_end( ap);
+	fflush( stdout);
+}
+
+static void client_close( client_t *c, const char *why)
+{
+	if( c->fd < 0)
+		return;
+	log_ts( "client %s closed: %s\n", c->id[0] ? c->id : "?", why);
+	close( c->fd);
+	memset( c, 0, sizeof( *c));
+	c->fd = -1;
+}
+
+static void send_all( client_t *c, const void *data, int len)
+{
+	if( write( c->fd, data, len) != len)
+		client_close( c, "write");
+}
+
+static int put_len( uint8_t *buf, int len)
+{
+	int n = 0;
+
+	do
+	{
+		buf[n] = len & 0x7f;
+		len >>= 7;
+		if( len)
+			buf[n] |= 0x80;
+		n ++;
+	}while( len);
+	return n;
+}
+
+static void publish_to( client_t *c, const char *topic, const char *text)
+{
+	uint8_t	pkt[1024];
+	int		tlen = strlen( topic);
+	int		dlen = strlen( text);
+	int		n;
+
+	if( 2 + tlen + dlen > ( int)sizeof( pkt) - 5)
+		return;
+	pkt[0] = 0x30;
+	n = 1 + put_len( pkt + 1, 2 + tlen + dlen);
+	pkt[n ++] = tlen >> 8;
+	pkt[n ++] = tlen & 0xff;
+	memcpy( pkt + n, topic, tlen);
+	n += tlen;
+	memcpy( pkt + n, text, dlen);
+	n += dlen;
+	send_all( c, pkt, n);
+}
+
+static int topic_match( const char *sub, const char *topic)
+{
+	int n = strlen( sub);
+
+	if( n && sub[n - 1] == '#')
+		return strncmp( sub, topic, n - 1) == 0;
+	return strcmp( sub, topic) == 0;
+}
+
+//ȡ2ֽڳȵַ
+static int get_str( const uint8_t *p, int left, char *out, int size)
+{
+	int n;
+
+	if( left < 2)
+		return -1;
+	n = ( p[0] << 8) | p[1];
+	if( n + 2 > left)
+		return -1;
+	if( out)
+	{
+		snprintf( out, size, "%.*s", n, p + 2);
+	}
+	return n + 2;
+}
+
+static void print_payload( const uint8_t *p, int n)
+{
+	int i;
+	int text = 1;
+
+	for( i = 0; i < n; i ++)
+	{
+		if( p[i] < 0x20 || p[i] > 0x7e)
+			text = 0;
+	}
+	if( text)
+	{
+		printf( "\"%.*s\"\n", n, p);
+		return;
+	}
+	for( i = 0; i < n; i ++)
+		printf( "%02x ", p[i]);
+	printf( "\n");
+}
+
+static void on_packet( client_t *c, uint8_t head, const uint8_t *p, int len)
+{
+	uint8_t		type = head >> 4;
+	uint8_t		rsp[8];
+	char		topic[TOPIC_LEN];
+	int			n, qos;
+	uint16_t	id = 0;
+
+	if( c->connected == 0 && type != 1)
+	{
+		client_close( c, "first packet is not CONNECT");
+		return;
+	}
+	switch( type)
+	{
+		case 1:		//CONNECT
+			n = get_str( p, len, NULL, 0);
+			if( n != 6 || memcmp( p + 2, "MQTT", 4) || len < 10)
+			{
+				client_close( c, "bad CONNECT");
+				return;
+			}
+			get_str( p + 10, len - 10, c->id, sizeof( c->id));
+			log_ts( "CONNECT %s flags %02x keepalive %d\n", c->id, p[7], ( p[8] << 8) | p[9]);
+			c->connected = 1;
+			Stat.connects ++;
+			rsp[0] = 0x20;
+			rsp[1] = 2;
+			rsp[2] = 0;
+			rsp[3] = Cfg.connack_rc;
+			send_all( c, rsp, 4);
+			break;
+		case 3:		//PUBLISH
+			qos = ( head >> 1) & 3;
+			n = get_str( p, len, topic, sizeof( topic));
+			if( n < 0 || ( qos && n + 2 > len))
+			{
+				client_close( c, "bad PUBLISH");
+				return;
+			}
+			if( qos)
+			{
+				id = ( p[n] << 8) | p[n + 1];
+				n += 2;
+			}
+			log_ts( "PUBLISH %s q%d%s id %d [%d] ", topic, qos, ( head & 0x08) ? " DUP" : "", id, len - n);
+			print_payload( p + n, len - n);
+			if( head & 0x08)
+				Stat.dup ++;
+			if( qos == 0)
+			{
+				Stat.pub0 ++;
+				break;
+			}
+			Stat.pub1 ++;
+			if( rand() % 100 < Cfg.drop_pct)
+			{
+				Stat.puback_drop ++;
+				break;
+			}
+			rsp[0] = 0x40;
+			rsp[1] = 2;
+			rsp[2] = id >> 8;
+			rsp[3] = id & 0xff;
+			send_all( c, rsp, 4);
+			break;
+		case 8:		//SUBSCRIBE
+			if( len < 5)
+			{
+				client_close( c, "bad SUBSCRIBE");
+				return;
+			}
+			get_str( p + 2, len - 2, topic, sizeof( topic));
+			log_ts( "SUBSCRIBE %s\n", topic);
+			if( c->sub_num < SUB_NUM)
+				strcpy( c->subs[ c->sub_num ++], topic);
+			rsp[0] = 0x90;
+			rsp[1] = 3;
+			rsp[2] = p[0];
+			rsp[3] = p[1];
+			rsp[4] = 0;
+			send_all( c, rsp, 5);
+			break;
+		case 12:	//PINGREQ
+			Stat.pings ++;
+			log_ts( "PINGREQ %s\n", c->id);
+			rsp[0] = 0xd0;
+			rsp[1] = 0;
+			send_all( c, rsp, 2);
+			break;
+		case 14:	//DISCONNECT
+			client_close( c, "DISCONNECT");
+			break;
+		default:
+			log_ts( "packet type %d ignored\n", type);
+			break;
+	}
+}
+
+//ȡı
+static void client_parse( client_t *c)
+{
+	int		off = 0;
+	int		n, shift, len;
+
+	while( c->fd >= 0 && c->len - off >= 2)
+	{
+		len = 0;
+		shift = 0;
+		for( n = 1; n < 5 && off + n < c->len; n ++)
+		{
+			len |= ( c->buf[ off + n] & 0x7f) << shift;
+			shift += 7;
+			if( ( c->buf[ off + n] & 0x80) == 0)
+				break;
+		}
+		if( n == 5)
+		{
+			client_close( c, "bad remaining length");
+			return;
+		}
+		if( off + n >= c->len || off + n + 1 + len > c->len)
+			break;
+		on_packet( c, c->buf[ off], c->buf + off + n + 1, len);
+		off += n + 1 + len;
+	}
+	if( c->fd < 0)
+		return;
+	memmove( c->buf, c->buf + off, c->len - off);
+	c->len -= off;
+	if( c->len == RXBUF_LEN)
+		client_close( c, "packet too long");
+}
+
+static void console( char *line)
+{
+	char	*cmd = strtok( line, " \r\n");
+	char	*topic, *text;
+	int		i, j;
+
+	if( cmd == NULL)
+		return;
+	if( strcmp( cmd, "pub") == 0)
+	{
+		topic = strtok( NULL, " \r\n");
+		text = strtok( NULL, "\r\n");
+		if( topic == NULL || text == NULL)
+			return;
+		for( i = 0; i < CLIENT_NUM; i ++)
+		{
+			for( j = 0; j < Clients[i].sub_num && Clients[i].fd >= 0; j ++)
+			{
+				if( topic_match( Clients[i].subs[j], topic))
+				{
+					publish_to( &Clients[i], topic, text);
+					break;
+				}
+			}
+		}
+	}
+	else if( strcmp( cmd, "kick") == 0)
+	{
+		for( i = 0; i < CLIENT_NUM; i ++)
+			client_close( &Clients[i], "kick");
+	}
+	else if( strcmp( cmd, "stats") == 0)
+	{
+		printf( "connects %ld pub q0 %ld q1 %ld dup %ld puback dropped %ld pings %ld bytes %ld\n", \
+			Stat.connects, Stat.pub0, Stat.pub1, Stat.dup, Stat.puback_drop, Stat.pings, Stat.bytes);
+	}
+	else if( strcmp( cmd, "quit") == 0)
+	{
+		exit( 0);
+	}
+}
+
+int main( int argc, char *argv[])
+{
+	struct sockaddr_in	sa;
+	struct pollfd		pfd[ CLIENT_NUM + 2];
+	char				line[512];
+	int					lfd, fd, opt, i, n;
+	int					one = 1;
+
+	while( ( opt = getopt( argc, argv, "p:d:r:")) != -1)
+	{
+		switch( opt)
+		{
+			case 'p': Cfg.port = atoi( optarg); break;
+			case 'd': Cfg.drop_pct = atoi( optarg); break;
+			case 'r': Cfg.connack_rc = atoi( optarg); break;
+			default:
+				fprintf( stderr, "usage: %s [-p port] [-d puback_drop_pct] [-r connack_rc]\n", argv[0]);
+				return 1;
+		}
+	}
+	signal( SIGPIPE, SIG_IGN);
+	srand( time( NULL));
+	for( i = 0; i < CLIENT_NUM; i ++)
+		Clients[i].fd = -1;
+
+	lfd = socket( AF_INET, SOCK_STREAM, 0);
+	setsockopt( lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one));
+	memset( &sa, 0, sizeof( sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons( Cfg.port);
+	sa.sin_addr.s_addr = htonl( INADDR_ANY);
+	if( bind( lfd, ( struct sockaddr *)&sa, sizeof( sa)) < 0 || listen( lfd, 4) < 0)
+	{
+		perror( "listen");
+		return 1;
+	}
+	log_ts( "listening on %d\n", Cfg.port);
+
+	while( 1)
+	{
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = 0;
+		pfd[1].events = POLLIN;
+		for( i = 0; i < CLIENT_NUM; i ++)
+		{
+			pfd[ i + 2].fd = Clients[i].fd;
+			pfd[ i + 2].events = POLLIN;
+		}
+		if( poll( pfd, CLIENT_NUM + 2, 1000) < 0 && errno != EINTR)
+			break;
+		if( pfd[0].revents & POLLIN)
+		{
+			fd = accept( lfd, NULL, NULL);
+			for( i = 0; i < CLIENT_NUM && fd >= 0; i ++)
+			{
+				if( Clients[i].fd < 0)
+				{
+					Clients[i].fd = fd;
+					log_ts( "accept client %d\n", i);
+					break;
+				}
+			}
+			if( i == CLIENT_NUM && fd >= 0)
+				close( fd);
+		}
+		if( pfd[1].revents & POLLIN)
+		{
+			if( fgets( line, sizeof( line), stdin) == NULL)
+				pfd[1].fd = -1;
+			else
+				console( line);
+		}
+		for( i = 0; i < CLIENT_NUM; i ++)
+		{
+			if( Clients[i].fd < 0 || ( pfd[ i + 2].revents & ( POLLIN | POLLHUP | POLLERR)) == 0)
+				continue;
+			n = read( Clients[i].fd, Clients[i].buf + Clients[i].len, RXBUF_LEN - Clients[i].len);
+			if( n <= 0)
+			{
+				client_close( &Clients[i], n == 0 ? "EOF" : "read");
+				continue;
+			}
+			Stat.bytes += n;
+			Clients[i].len += n;
+			client_parse( &Clients[i]);
+		}
+	}
+	return 0;
+}
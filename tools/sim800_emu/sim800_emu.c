@@ -0,0 +1,1642 @@
+/**
+* @file 		sim800_emu.c
+* @brief		PCģSIM800ģ飬Ӳgprs.cdtu.c.
+* @details		1. ģ̼õATָCIPSTART/CIPSEND/+RECEIVE/CMTI/CMGR/CMGL/CSQ/CBC
+*				2. ֶ֧·ӡ͸"+++"˳ģʽԼAT+CIPRXGETȡģʽAT+CIPACKѯ
+*				3. TCPӱŽӵķϣҪʵ
+*				4. Ӧʱʺʹע룬ͳʱ䡢
+*				5. ģʱӣAT+CLTS/AT+CCLK?/AT+CNTPʱ֮ǰ04/01/01
+*				6. AT+CIPSTARTʱҪȽʱ䣬AT+CDNSGIPŽӵĵַ
+*				7. ŵPDUʽAT+CMGF=0֮AT+CMGS/AT+CMGLPDUıĶгʱת8λPDU
+*
+*				루Linux
+*					cc -O2 -Wall -o sim800_emu tools/sim800_emu/sim800_emu.c
+*				У
+*					./sim800_emu -l 20 -C 300 -P /tmp/sim800
+*				̼߲Գ򣩴/tmp/sim800ģĴһ
+*				Ҳ -f ָһѾ򿪵ļsocketpairһˡ
+*
+*				׼ǿ̨ģⲿ¼
+*					sms <> <>		յһ
+*					smsp <> <PDU>		յһPDUʽĶţʮƣĵַ
+*					close <n>				رn
+*					csq <rssi>				ıźǿ
+*					cbc <mv>				ıѹ
+*					down					ģ
+*					boot					ģ¿
+*					ring					
+*					nitz [ms]				·ʱ䣬ԴһԱʱƫҪAT+CLTS=1
+*					dns <0|1>				ʧ/ָ
+*					stats					ӡͳ
+*					quit					˳
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define LINK_NUM		6			//SIM8006·
+#define LINE_MAX		600
+#define SEG_MAX			1460		//һ+RECEIVE
+#define SMS_NUM			50
+#define SMS_TEXT_MAX	160
+#define SMS_PDU_MAX		176			//PDUֽĵַ
+
+#define LINK_IDLE		0
+#define LINK_CONNECTING	1
+#define LINK_UP			2
+
+#define MODE_CMD		0			//ģʽ
+#define MODE_CIPSEND	1			//ȴCIPSEND
+#define MODE_SMS		2			//ȴ
+#define MODE_DATA		3			//͸ģʽ
+
+typedef struct out_s {
+	struct out_s	*next;
+	int64_t			due_ms;			//ʱܷ֮ȥ
+	int				len;
+	char			data[];
+}out_t;
+
+typedef struct {
+	int			fd;
+	int			state;
+	int			fail;				//עʧ
+	int64_t		start_ms;			//ӵʱ
+	int64_t		ready_ms;			//ӳɹ֮󣬼ʱ֪ͨ
+	char		prtl[4];
+	char		addr[64];
+	int			port;
+	int			notified;			//ȡģʽѾ+CIPRXGET: 1ݶ֮ǰ֪ͨ
+	long		tx;					//ֽAT+CIPACK
+	int64_t		dns_ms;				//ַʱҪõʱ
+}link_t;
+
+typedef struct {
+	int			used;
+	int			unread;
+	char		phone[24];
+	char		text[SMS_TEXT_MAX + 1];
+	char		stamp[24];
+	char		pdu[SMS_PDU_MAX * 2 + 1];		//PDUʽյĶţΪյʱtext
+}sms_t;
+
+static struct {
+	int			latency_ms;			//Ӧʱ
+	int			jitter_ms;
+	int			cnnt_ms;			//ʱ
+	int			attach_ms;			//CIICRʱ
+	int			sms_ms;				//ŵʱ
+	int			boot_ms;			//Readyʱ
+	int			guard_ms;			//+++ıʱ
+	int			loss_pct;			//
+	int			err_pct;			//ָERRORĸ
+	int			cnntfail_pct;		//ʧܵĸ
+	long		baud;				//ģ⴮ʣ0
+	int			trace;
+	const char	*bridge_host;		//ӶŽӵַ
+	int			dns_ms;				//ʱ
+}Cfg = { 0, 0, 300, 1000, 2000, 2000, 500, 0, 0, 0, 115200, 0, "127.0.0.1", 1500 };
+
+static struct {
+	long		cmds;
+	long		err_injected;
+	long		cnnt_ok;
+	long		cnnt_fail;
+	int64_t		cnnt_ms_total;
+	int64_t		cnnt_ms_max;
+	long		bytes_up;
+	long		bytes_down;
+	long		segs_up;
+	long		segs_down;
+	long		lost_up;
+	long		lost_down;
+	long		urcs;
+	long		sms_tx;
+	long		sms_rx;
+	long		dns;				//ĴCIPSTART
+	int64_t		first_cmd_ms;
+	int64_t		first_link_ms;		//һӽʱ
+}Stat;
+
+static struct {
+	int			fd;					//
+	int			on;					//
+	int64_t		boot_at_ms;			//ʱͷReady
+	int			echo;
+	int			mux;
+	int			trsp;
+	int			rxget;				//AT+CIPRXGET=1ȡģʽ
+	int			ip_state;			//0 INITIAL 1 START 2 GPRSACT 3 STATUS
+	int			rssi;
+	int			mv;
+	int			mode;
+	char		line[LINE_MAX];
+	int			line_len;
+	int			send_link;			//CIPSEND
+	int			send_left;
+	char		send_buf[SEG_MAX + 1];
+	int			send_len;
+	char		sms_phone[24];
+	char		sms_buf[SMS_PDU_MAX * 2 + 2];
+	int			sms_len;
+	int			sms_pdu_len;		//PDUʽAT+CMGSĳ
+	int			cmgf;				//0 PDUʽ 1 ıʽ
+	int			plus_cnt;			//ģʽյ+
+	int64_t		last_rx_ms;			//һյݵʱ
+	int64_t		plus_ms;			//յ+ʱ
+	int			cmgs_mr;
+	out_t		*out_head;
+	out_t		*out_tail;
+	int64_t		out_free_ms;		//ڿеʱ䣬ģⲨ
+	int			clts;				//AT+CLTS=1·ʱ
+	int			clk_set;			//ʱѾSNTPù¿Ҳ
+	int64_t		clk_ofs_ms;			//ģʱԱʱƫ
+	int			sapbr;				//SNTPõĳѾ
+	int			dns_fail;			//ʧ
+}Mdm;
+
+static link_t	Links[LINK_NUM];
+static sms_t	Sms[SMS_NUM];
+static volatile sig_atomic_t Quit;
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ( int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int chance( int pct)
+{
+	if( pct <= 0)
+		return 0;
+	return ( rand() % 100) < pct;
+}
+
+static int delay_ms( int base)
+{
+	if( Cfg.jitter_ms > 0)
+		base += rand() % ( Cfg.jitter_ms + 1);
+	return base;
+}
+
+static void trace( const char *dir, const char *data, int len)
+{
+	int i;
+	if( Cfg.trace == 0)
+		return;
+	fprintf( stderr, "%s ", dir);
+	for( i = 0; i < len && i < 80; i ++)
+	{
+		unsigned char c = data[i];
+		if( c == '\r')
+			fputs( "\\r", stderr);
+		else if( c == '\n')
+			fputs( "\\n", stderr);
+		else if( c < 0x20 || c > 0x7e)
+			fprintf( stderr, "\\x%02x", c);
+		else
+			fputc( c, stderr);
+	}
+	if( len > 80)
+		fprintf( stderr, "...(%d)", len);
+	fputc( '\n', stderr);
+}
+
+//ݷ봮ڵķͶУdelay֮󷢳
+static void emit_raw( int delay, const char *data, int len)
+{
+	out_t *o;
+	int64_t due = now_ms() + delay;
+
+	if( len <= 0)
+		return;
+	o = malloc( sizeof( out_t) + len);
+	if( o == NULL)
+		return;
+	memcpy( o->data, data, len);
+	o->len = len;
+	o->next = NULL;
+	//Ⱥ˳
+	if( Mdm.out_tail && Mdm.out_tail->due_ms > due)
+		due = Mdm.out_tail->due_ms;
+	o->due_ms = due;
+	if( Mdm.out_tail)
+		Mdm.out_tail->next = o;
+	else
+		Mdm.out_head = o;
+	Mdm.out_tail = o;
+}
+
+static void emit( int delay, const char *fmt, ...)
+{
+	char buf[LINE_MAX];
+	va_list ap;
+	int len;
+	va_start( ap, fmt);
+	len = vsnprintf( buf, sizeof( buf), fmt, ap);
+	va_end( ap);
+	if( len >= ( int)sizeof( buf))
+		len = sizeof( buf) - 1;
+	emit_raw( delay, buf, len);
+}
+
+static void urc( const char *fmt, ...)
+{
+	char buf[LINE_MAX];
+	va_list ap;
+	int len;
+	buf[0] = '\r';
+	buf[1] = '\n';
+	va_start( ap, fmt);
+	len = vsnprintf( buf + 2, sizeof( buf) - 4, fmt, ap);
+	va_end( ap);
+	if( len >= ( int)sizeof( buf) - 4)
+		len = sizeof( buf) - 5;
+	buf[ len + 2] = '\r';
+	buf[ len + 3] = '\n';
+	emit_raw( 0, buf, len + 4);
+	Stat.urcs ++;
+}
+
+//ѷͶеʱд
+static void flush_out(void)
+{
+	out_t *o;
+	int64_t now = now_ms();
+	int n;
+
+	while( ( o = Mdm.out_head) != NULL)
+	{
+		if( o->due_ms > now || Mdm.out_free_ms > now)
+			break;
+		n = write( Mdm.fd, o->data, o->len);
+		if( n < 0)
+		{
+			if( errno == EAGAIN || errno == EIO)
+				break;
+			perror( "write");
+			Quit = 1;
+			return;
+		}
+		trace( "<<", o->data, n);
+		if( Cfg.baud > 0)
+			Mdm.out_free_ms = now + ( int64_t)n * 10000 / Cfg.baud;
+		if( n < o->len)
+		{
+			memmove( o->data, o->data + n, o->len - n);
+			o->len -= n;
+			break;
+		}
+		Mdm.out_head = o->next;
+		if( Mdm.out_head == NULL)
+			Mdm.out_tail = NULL;
+		free( o);
+	}
+}
+
+static void ok( void)
+{
+	emit( delay_ms( Cfg.latency_ms), "\r\nOK\r\n");
+}
+
+static void error( void)
+{
+	emit( delay_ms( Cfg.latency_ms), "\r\nERROR\r\n");
+}
+
+static int link_of( int n)
+{
+	if( n < 0 || n >= LINK_NUM)
+		return -1;
+	return n;
+}
+
+static void link_close( int n)
+{
+	if( Links[n].fd >= 0)
+		close( Links[n].fd);
+	Links[n].fd = -1;
+	Links[n].state = LINK_IDLE;
+	Links[n].notified = 0;
+	Links[n].tx = 0;
+}
+
+//رӣ߿̨ģر
+static void link_lost( int n)
+{
+	if( Links[n].state == LINK_IDLE)
+		return;
+	link_close( n);
+	if( Mdm.mux)
+		urc( "%d, CLOSED", n);
+	else
+	{
+		urc( "CLOSED");
+		if( Mdm.mode == MODE_DATA)
+			Mdm.mode = MODE_CMD;
+	}
+}
+
+static void link_start( int n, const char *prtl, const char *addr, int port)
+{
+	struct sockaddr_in sa;
+	link_t *l = &Links[n];
+	int fd;
+
+	memset( l, 0, sizeof( *l));
+	l->fd = -1;
+	snprintf( l->prtl, sizeof( l->prtl), "%s", prtl);
+	snprintf( l->addr, sizeof( l->addr), "%s", addr);
+	l->port = port;
+	l->start_ms = now_ms();
+	l->state = LINK_CONNECTING;
+	l->fail = chance( Cfg.cnntfail_pct);
+	if( inet_addr( addr) == INADDR_NONE)
+	{
+		Stat.dns ++;
+		l->dns_ms = delay_ms( Cfg.dns_ms);
+		if( Mdm.dns_fail)
+			l->fail = 1;
+	}
+	if( l->fail)
+	{
+		l->ready_ms = l->start_ms + delay_ms( Cfg.cnnt_ms);
+		return;
+	}
+
+	fd = socket( AF_INET, strcmp( prtl, "UDP") ? SOCK_STREAM : SOCK_DGRAM, 0);
+	if( fd < 0)
+	{
+		l->fail = 1;
+		l->ready_ms = l->start_ms;
+		return;
+	}
+	fcntl( fd, F_SETFL, O_NONBLOCK);
+	memset( &sa, 0, sizeof( sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons( port);
+	inet_pton( AF_INET, Cfg.bridge_host, &sa.sin_addr);
+	if( connect( fd, ( struct sockaddr *)&sa, sizeof( sa)) < 0 && errno != EINPROGRESS)
+	{
+		close( fd);
+		l->fail = 1;
+		l->ready_ms = l->start_ms + delay_ms( Cfg.cnnt_ms);
+		return;
+	}
+	l->fd = fd;
+	l->ready_ms = 0;
+}
+
+//ɣɹʧܣ󷢳֪ͨ
+static void link_report( int n, int succeed)
+{
+	link_t *l = &Links[n];
+	int64_t cost = now_ms() - l->start_ms;
+
+	if( succeed)
+	{
+		l->state = LINK_UP;
+		Stat.cnnt_ok ++;
+		Stat.cnnt_ms_total += cost;
+		if( cost > Stat.cnnt_ms_max)
+			Stat.cnnt_ms_max = cost;
+		if( Stat.first_link_ms == 0)
+			Stat.first_link_ms = now_ms();
+		if( Mdm.trsp)
+		{
+			urc( "CONNECT");
+			Mdm.mode = MODE_DATA;
+			Mdm.last_rx_ms = now_ms();
+		}
+		else if( Mdm.mux)
+			urc( "%d, CONNECT OK", n);
+		else
+			urc( "CONNECT OK");
+	}
+	else
+	{
+		link_close( n);
+		Stat.cnnt_fail ++;
+		if( Mdm.mux)
+			urc( "%d, CONNECT FAIL", n);
+		else
+			urc( "CONNECT FAIL");
+	}
+}
+
+//д
+static void link_send( int n, const char *data, int len)
+{
+	if( Links[n].state != LINK_UP)
+		return;
+	if( chance( Cfg.loss_pct))
+	{
+		Stat.lost_up ++;
+		return;
+	}
+	if( write( Links[n].fd, data, len) < 0)
+		link_lost( n);
+	Links[n].tx += len;
+	Stat.bytes_up += len;
+	Stat.segs_up ++;
+}
+
+//ݣģĸʽ͸
+static void link_recv( int n)
+{
+	char buf[SEG_MAX];
+	char head[32];
+	int len;
+
+	//ȡģʽsocketAT+CIPRXGET=2socketĻ˷ͷ
+	if( Mdm.rxget && Mdm.trsp == 0)
+	{
+		if( Mdm.mux)
+			urc( "+CIPRXGET: 1,%d", n);
+		else
+			urc( "+CIPRXGET: 1");
+		Links[n].notified = 1;
+		return;
+	}
+	len = read( Links[n].fd, buf, sizeof( buf));
+	if( len <= 0)
+	{
+		if( len < 0 && errno == EAGAIN)
+			return;
+		link_lost( n);
+		return;
+	}
+	if( chance( Cfg.loss_pct))
+	{
+		Stat.lost_down ++;
+		return;
+	}
+	Stat.bytes_down += len;
+	Stat.segs_down ++;
+	if( Mdm.trsp || Mdm.mux == 0)
+	{
+		emit_raw( 0, buf, len);
+		return;
+	}
+	snprintf( head, sizeof( head), "\r\n+RECEIVE,%d,%d:\r\n", n, len);
+	emit_raw( 0, head, strlen( head));
+	emit_raw( 0, buf, len);
+}
+
+static void modem_boot( void)
+{
+	int i;
+	for( i = 0; i < LINK_NUM; i ++)
+		link_close( i);
+	Mdm.on = 0;
+	Mdm.echo = 1;
+	Mdm.mux = 0;
+	Mdm.trsp = 0;
+	Mdm.rxget = 0;
+	Mdm.cmgf = 0;
+	Mdm.ip_state = 0;
+	Mdm.mode = MODE_CMD;
+	Mdm.line_len = 0;
+	Mdm.boot_at_ms = now_ms() + Cfg.boot_ms;
+}
+
+static void modem_ready( void)
+{
+	Mdm.on = 1;
+	Mdm.boot_at_ms = 0;
+	urc( "RDY");
+	urc( "+CFUN: 1");
+	urc( "+CPIN: READY");
+	urc( "Call Ready");
+	urc( "SMS Ready");
+}
+
+static const char *ip_state_str( void)
+{
+	static const char *str[] = { "IP INITIAL", "IP START", "IP GPRSACT", "IP STATUS"};
+	int i;
+
+	if( Mdm.mux)
+	{
+		for( i = 0; i < LINK_NUM; i ++)
+			if( Links[i].state != LINK_IDLE)
+				return "IP PROCESSING";
+	}
+	else if( Links[0].state == LINK_UP)
+		return "CONNECT OK";
+	else if( Links[0].state == LINK_CONNECTING)
+		return "TCP CONNECTING";
+	return str[ Mdm.ip_state];
+}
+
+static int sms_store( const char *phone, const char *text, const char *pdu)
+{
+	int i;
+	time_t t = time( NULL);
+	struct tm *tm = localtime( &t);
+
+	for( i = 0; i < SMS_NUM; i ++)
+	{
+		if( Sms[i].used)
+			continue;
+		Sms[i].used = 1;
+		Sms[i].unread = 1;
+		snprintf( Sms[i].phone, sizeof( Sms[i].phone), "%s", phone);
+		snprintf( Sms[i].text, sizeof( Sms[i].text), "%s", text);
+		snprintf( Sms[i].pdu, sizeof( Sms[i].pdu), "%s", pdu);
+		strftime( Sms[i].stamp, sizeof( Sms[i].stamp), "%y/%m/%d,%H:%M:%S+32", tm);
+		return i + 1;
+	}
+	return -1;
+}
+
+// AT+XXX=a,"b",c ʽĲȥ
+static int split_args( char *s, char **argv, int max)
+{
+	int n = 0;
+	char *p = s;
+
+	while( *p && n < max)
+	{
+		while( *p == ' ')
+			p ++;
+		if( *p == '"')
+		{
+			argv[n++] = ++p;
+			while( *p && *p != '"')
+				p ++;
+			if( *p)
+				*p++ = 0;
+			while( *p && *p != ',')
+				p ++;
+		}
+		else
+		{
+			argv[n++] = p;
+			while( *p && *p != ',')
+				p ++;
+		}
+		if( *p == ',')
+			*p++ = 0;
+	}
+	return n;
+}
+
+static void cmd_cipstart( char *arg)
+{
+	char *argv[5];
+	int argc = split_args( arg, argv, 5);
+	int n = 0;
+
+	if( Mdm.mux)
+	{
+		if( argc < 4 || ( n = link_of( atoi( argv[0]))) < 0)
+		{
+			error();
+			return;
+		}
+		argv[0] = argv[1];
+		argv[1] = argv[2];
+		argv[2] = argv[3];
+	}
+	else if( argc < 3)
+	{
+		error();
+		return;
+	}
+	if( Mdm.ip_state < 2)
+	{
+		error();
+		return;
+	}
+	if( Links[n].state != LINK_IDLE)
+	{
+		if( Mdm.mux)
+			emit( delay_ms( Cfg.latency_ms), "\r\nERROR\r\n\r\n%d, ALREADY CONNECT\r\n", n);
+		else
+			emit( delay_ms( Cfg.latency_ms), "\r\nERROR\r\n\r\nALREADY CONNECT\r\n");
+		return;
+	}
+	ok();
+	link_start( n, argv[0], argv[1], atoi( argv[2]));
+}
+
+static void cmd_cipsend( char *arg)
+{
+	char *argv[2];
+	int argc = arg ? split_args( arg, argv, 2) : 0;
+	int n = 0, len = 0;
+
+	if( Mdm.mux)
+	{
+		if( argc < 1 || ( n = link_of( atoi( argv[0]))) < 0)
+		{
+			error();
+			return;
+		}
+		len = argc > 1 ? atoi( argv[1]) : 0;
+	}
+	else
+		len = argc > 0 ? atoi( argv[0]) : 0;
+	if( Links[n].state != LINK_UP || len <= 0 || len > SEG_MAX)
+	{
+		error();
+		return;
+	}
+	Mdm.send_link = n;
+	Mdm.send_left = len;
+	Mdm.send_len = 0;
+	Mdm.mode = MODE_CIPSEND;
+	emit( 0, "\r\n> ");
+}
+
+static void cmd_cipclose( char *arg)
+{
+	int n = 0;
+
+	if( Mdm.mux)
+	{
+		if( arg == NULL || ( n = link_of( atoi( arg))) < 0)
+		{
+			error();
+			return;
+		}
+	}
+	if( Links[n].state == LINK_IDLE)
+	{
+		error();
+		return;
+	}
+	link_close( n);
+	if( Mdm.mux)
+		emit( delay_ms( Cfg.latency_ms), "\r\n%d, CLOSE OK\r\n", n);
+	else
+		emit( delay_ms( Cfg.latency_ms), "\r\nCLOSE OK\r\n");
+}
+
+//AT+CIPRXGET=<0|1>  AT+CIPRXGET=2,[<n>,]<len>
+static void cmd_ciprxget( char *arg)
+{
+	char *argv[3];
+	int argc = arg ? split_args( arg, argv, 3) : 0;
+	int mode, n = 0, len, got, left = 0, d, eof;
+	char buf[SEG_MAX];
+	char head[48];
+
+	mode = argc > 0 ? atoi( argv[0]) : -1;
+	if( mode == 0 || mode == 1)
+	{
+		Mdm.rxget = mode;
+		ok();
+		return;
+	}
+	if( mode != 2 || Mdm.rxget == 0 || argc < 2 + Mdm.mux)
+	{
+		error();
+		return;
+	}
+	if( Mdm.mux && ( n = link_of( atoi( argv[1]))) < 0)
+	{
+		error();
+		return;
+	}
+	len = atoi( argv[1 + Mdm.mux]);
+	if( Links[n].state != LINK_UP || len <= 0 || len > SEG_MAX)
+	{
+		error();
+		return;
+	}
+	got = read( Links[n].fd, buf, len);
+	eof = got == 0;
+	if( got < 0)
+		got = 0;
+	else if( got > 0)
+		ioctl( Links[n].fd, FIONREAD, &left);
+	Stat.bytes_down += got;
+	if( got)
+		Stat.segs_down ++;
+	if( Mdm.mux)
+		snprintf( head, sizeof( head), "\r\n+CIPRXGET: 2,%d,%d,%d\r\n", n, got, left);
+	else
+		snprintf( head, sizeof( head), "\r\n+CIPRXGET: 2,%d,%d\r\n", got, left);
+	d = delay_ms( Cfg.latency_ms);
+	emit_raw( d, head, strlen( head));
+	emit_raw( d, buf, got);
+	emit_raw( d, "\r\nOK\r\n", 6);
+	if( left == 0)
+		Links[n].notified = 0;
+	//رӣʣµݶ֮ű
+	if( eof)
+		link_lost( n);
+}
+
+//+CIPACK: <txlen>,<acklen>,<nacklen>δȷϵֽȡsocketͶ
+static void cmd_cipack( char *arg)
+{
+	int n = 0;
+	int queued = 0;
+
+	if( Mdm.mux && ( arg == NULL || ( n = link_of( atoi( arg))) < 0))
+	{
+		error();
+		return;
+	}
+	if( Links[n].state != LINK_UP)
+	{
+		error();
+		return;
+	}
+	ioctl( Links[n].fd, TIOCOUTQ, &queued);
+	emit( delay_ms( Cfg.latency_ms), "\r\n+CIPACK: %ld,%ld,%d\r\n\r\nOK\r\n", Links[n].tx, Links[n].tx - queued, queued);
+}
+
+static void cmd_cipstatus( char *arg)
+{
+	int i;
+	link_t *l;
+	static const char *st[] = { "INITIAL", "CONNECTING", "CONNECTED"};
+
+	if( arg)
+	{
+		i = link_of( atoi( arg));
+		if( i < 0)
+		{
+			error();
+			return;
+		}
+		l = &Links[i];
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CIPSTATUS: %d,,\"%s\",\"%s\",\"%d\",\"%s\"\r\n\r\nOK\r\n", \
+			i, l->prtl, l->addr, l->port, st[ l->state]);
+		return;
+	}
+	emit( delay_ms( Cfg.latency_ms), "\r\nOK\r\n\r\nSTATE: %s\r\n", ip_state_str());
+	if( Mdm.mux == 0)
+		return;
+	for( i = 0; i < LINK_NUM; i ++)
+	{
+		l = &Links[i];
+		emit( 0, "\r\nC: %d,0,\"%s\",\"%s\",\"%d\",\"%s\"\r\n", i, l->prtl, l->addr, l->port, st[ l->state]);
+	}
+}
+
+static void cmd_cmgr( char *arg)
+{
+	int i = arg ? atoi( arg) : 0;
+	sms_t *m;
+
+	if( i < 1 || i > SMS_NUM)
+	{
+		error();
+		return;
+	}
+	m = &Sms[i - 1];
+	if( m->used == 0)
+	{
+		ok();
+		return;
+	}
+	emit( delay_ms( Cfg.latency_ms), "\r\n+CMGR: \"%s\",\"%s\",\"\",\"%s\"\r\n%s\r\n\r\nOK\r\n", \
+		m->unread ? "REC UNREAD" : "REC READ", m->phone, m->stamp, m->text);
+	m->unread = 0;
+}
+
+//ıĶת8λSMS-DELIVER
+static void sms_to_pdu( sms_t *m, char *out)
+{
+	const char	*ph = m->phone;
+	int			n, i, type = 0x81;
+
+	if( m->pdu[0])
+	{
+		strcpy( out, m->pdu);
+		return;
+	}
+	if( *ph == '+')
+	{
+		type = 0x91;
+		ph ++;
+	}
+	n = strlen( ph);
+	out += sprintf( out, "0004%02X%02X", n, type);
+	for( i = 0; i < n; i += 2)
+		out += sprintf( out, "%c%c", i + 1 < n ? ph[i + 1] : 'F', ph[i]);
+	//PID DCS ʱ ûݳ
+	out += sprintf( out, "000481101021436500%02X", ( int)strlen( m->text));
+	for( i = 0; m->text[i]; i ++)
+		out += sprintf( out, "%02X", ( uint8_t)m->text[i]);
+}
+
+//PDUʽAT+CMGL=<stat>0δ 1Ѷ 4ȫгĳȲĵַ
+static void cmd_cmgl_pdu( char *arg)
+{
+	char	pdu[SMS_PDU_MAX * 2 + 1];
+	int		stat = atoi( arg);
+	int		i;
+	int		d = delay_ms( Cfg.latency_ms);
+	sms_t	*m;
+
+	if( stat != 0 && stat != 1 && stat != 4)
+	{
+		error();
+		return;
+	}
+	for( i = 0; i < SMS_NUM; i ++)
+	{
+		m = &Sms[i];
+		if( m->used == 0 || ( stat != 4 && stat != !m->unread))
+			continue;
+		sms_to_pdu( m, pdu);
+		emit( d, "\r\n+CMGL: %d,%d,,%d\r\n%s", i + 1, !m->unread, ( int)strlen( pdu) / 2 - 1, pdu);
+		m->unread = 0;
+	}
+	emit( d, "\r\n\r\nOK\r\n");
+}
+
+//AT+CMGL=<stat>[,<mode>]modeΪ1ʱ򲻸ıŵ״̬
+static void cmd_cmgl( char *arg)
+{
+	char *argv[2];
+	int argc = arg ? split_args( arg, argv, 2) : 0;
+	int i, all, keep;
+	int d = delay_ms( Cfg.latency_ms);
+	sms_t *m;
+
+	if( argc < 1)
+	{
+		error();
+		return;
+	}
+	if( Mdm.cmgf == 0)
+	{
+		cmd_cmgl_pdu( argv[0]);
+		return;
+	}
+	all = strcasecmp( argv[0], "ALL") == 0;
+	if( all == 0 && strcasecmp( argv[0], "REC UNREAD") && strcasecmp( argv[0], "REC READ"))
+	{
+		error();
+		return;
+	}
+	keep = argc > 1 ? atoi( argv[1]) : 0;
+	for( i = 0; i < SMS_NUM; i ++)
+	{
+		m = &Sms[i];
+		if( m->used == 0)
+			continue;
+		if( all == 0 && ( strcasecmp( argv[0], "REC UNREAD") == 0) != m->unread)
+			continue;
+		//ÿŷֿͣģģڷֳɶ֡
+		emit( d, "\r\n+CMGL: %d,\"%s\",\"%s\",\"\",\"%s\"\r\n%s", \
+			i + 1, m->unread ? "REC UNREAD" : "REC READ", m->phone, m->stamp, m->text);
+		if( keep == 0)
+			m->unread = 0;
+	}
+	emit( d, "\r\n\r\nOK\r\n");
+}
+
+static void cmd_cmgd( char *arg)
+{
+	char *argv[2];
+	int argc = arg ? split_args( arg, argv, 2) : 0;
+	int i, flag;
+
+	if( argc < 1)
+	{
+		error();
+		return;
+	}
+	i = atoi( argv[0]);
+	flag = argc > 1 ? atoi( argv[1]) : 0;
+	if( flag == 0)
+	{
+		if( i >= 1 && i <= SMS_NUM)
+			Sms[i - 1].used = 0;
+	}
+	else
+	{
+		//1 ɾѶ 4 ɾȫ231һ
+		for( i = 0; i < SMS_NUM; i ++)
+		{
+			if( flag == 4 || Sms[i].unread == 0)
+				Sms[i].used = 0;
+		}
+	}
+	ok();
+}
+
+static void cmd_cpms( void)
+{
+	int i, used = 0;
+	for( i = 0; i < SMS_NUM; i ++)
+		used += Sms[i].used;
+	emit( delay_ms( Cfg.latency_ms), "\r\n+CPMS: \"SM\",%d,%d,\"SM\",%d,%d,\"SM\",%d,%d\r\n\r\nOK\r\n", \
+		used, SMS_NUM, used, SMS_NUM, used, SMS_NUM);
+}
+
+//ʱ+323215
+static void cmd_cclk( void)
+{
+	struct timespec	ts;
+	struct tm		tm;
+	time_t			t;
+
+	if( Mdm.clk_set == 0)
+	{
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CCLK: \"04/01/01,00:00:00+00\"\r\n\r\nOK\r\n");
+		return;
+	}
+	clock_gettime( CLOCK_REALTIME, &ts);
+	t = ts.tv_sec + ( ts.tv_nsec / 1000000 + Mdm.clk_ofs_ms) / 1000 + 8 * 3600;
+	gmtime_r( &t, &tm);
+	emit( delay_ms( Cfg.latency_ms), "\r\n+CCLK: \"%02d/%02d/%02d,%02d:%02d:%02d+32\"\r\n\r\nOK\r\n", \
+			tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+//AT+CNTP÷ʱʼͬ1s֮
+static void cmd_cntp( char *arg)
+{
+	if( arg)
+	{
+		ok();
+		return;
+	}
+	if( Mdm.sapbr == 0)
+	{
+		ok();
+		emit( delay_ms( 1000), "\r\n+CNTP: 61\r\n");
+		return;
+	}
+	ok();
+	Mdm.clk_set = 1;
+	Mdm.clk_ofs_ms = 0;
+	emit( delay_ms( 1000), "\r\n+CNTP: 1\r\n");
+}
+
+//AT+CDNSGIP=""ȻظOKĽ֪ͨ
+static void cmd_cdnsgip( char *arg)
+{
+	char	host[64];
+	int		n;
+
+	if( arg == NULL || Mdm.ip_state < 2)
+	{
+		error();
+		return;
+	}
+	if( *arg == '"')
+		arg ++;
+	n = strcspn( arg, "\"");
+	if( n == 0 || n >= ( int)sizeof( host))
+	{
+		error();
+		return;
+	}
+	memcpy( host, arg, n);
+	host[ n] = 0;
+	ok();
+	Stat.dns ++;
+	if( Mdm.dns_fail)
+		emit( delay_ms( Cfg.dns_ms), "\r\n+CDNSGIP: 0,8\r\n");
+	else
+		emit( delay_ms( Cfg.dns_ms), "\r\n+CDNSGIP: 1,\"%s\",\"%s\"\r\n", host, Cfg.bridge_host);
+}
+
+//һATָ
+static void at_command( char *line)
+{
+	char *arg = NULL;
+	char *cmd = line;
+
+	while( *cmd == ' ' || *cmd == '\n')
+		cmd ++;
+	if( *cmd == 0)
+		return;
+	if( Mdm.echo)
+		emit( 0, "%s\r", cmd);
+	if( Mdm.on == 0)
+		return;
+	Stat.cmds ++;
+	if( Stat.first_cmd_ms == 0)
+		Stat.first_cmd_ms = now_ms();
+	if( strncasecmp( cmd, "AT", 2))
+	{
+		error();
+		return;
+	}
+	cmd += 2;
+	arg = strchr( cmd, '=');
+	if( arg)
+		*arg++ = 0;
+
+	//ע룬ָ
+	if( *cmd && strcasecmp( cmd, "E0") && chance( Cfg.err_pct))
+	{
+		Stat.err_injected ++;
+		error();
+		return;
+	}
+
+	if( *cmd == 0 || strcasecmp( cmd, "E0") == 0 || strcasecmp( cmd, "E1") == 0)
+	{
+		if( *cmd)
+			Mdm.echo = cmd[1] == '1';
+		ok();
+	}
+	else if( strcasecmp( cmd, "O") == 0)
+	{
+		if( Mdm.trsp && Links[0].state == LINK_UP)
+		{
+			emit( delay_ms( Cfg.latency_ms), "\r\nCONNECT\r\n");
+			Mdm.mode = MODE_DATA;
+			Mdm.last_rx_ms = now_ms();
+		}
+		else
+			emit( delay_ms( Cfg.latency_ms), "\r\nNO CARRIER\r\n");
+	}
+	else if( strcasecmp( cmd, "+CPIN?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CPIN: READY\r\n\r\nOK\r\n");
+	else if( strcasecmp( cmd, "+CREG?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CREG: 0,1\r\n\r\nOK\r\n");
+	else if( strcasecmp( cmd, "+CGREG?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CGREG: 0,1\r\n\r\nOK\r\n");
+	else if( strcasecmp( cmd, "+CCALR?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CCALR: 1\r\n\r\nOK\r\n");
+	else if( strcasecmp( cmd, "+CSQ") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CSQ: %d,0\r\n\r\nOK\r\n", Mdm.rssi);
+	else if( strcasecmp( cmd, "+CBC") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CBC: 0,%d,%d\r\n\r\nOK\r\n", ( Mdm.mv - 3400) / 8, Mdm.mv);
+	else if( strcasecmp( cmd, "+COPS?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+COPS: 0,0,\"CHINA MOBILE\"\r\n\r\nOK\r\n");
+	else if( strcasecmp( cmd, "+CPOWD") == 0)
+	{
+		emit( delay_ms( Cfg.latency_ms), "\r\nNORMAL POWER DOWN\r\n");
+		modem_boot();
+	}
+	else if( strcasecmp( cmd, "+CIPMUX") == 0 && arg)
+	{
+		Mdm.mux = atoi( arg);
+		ok();
+	}
+	else if( strcasecmp( cmd, "+CIPMODE") == 0 && arg)
+	{
+		Mdm.trsp = atoi( arg);
+		ok();
+	}
+	else if( strcasecmp( cmd, "+CSTT") == 0)
+	{
+		Mdm.ip_state = 1;
+		ok();
+	}
+	else if( strcasecmp( cmd, "+CIICR") == 0)
+	{
+		if( Mdm.ip_state != 1)
+		{
+			error();
+			return;
+		}
+		Mdm.ip_state = 2;
+		emit( delay_ms( Cfg.attach_ms), "\r\nOK\r\n");
+	}
+	else if( strcasecmp( cmd, "+CIFSR") == 0)
+	{
+		if( Mdm.ip_state < 2)
+		{
+			error();
+			return;
+		}
+		Mdm.ip_state = 3;
+		emit( delay_ms( Cfg.latency_ms), "\r\n10.8.0.2\r\n");
+	}
+	else if( strcasecmp( cmd, "+CIPSHUT") == 0)
+	{
+		int i;
+		for( i = 0; i < LINK_NUM; i ++)
+			link_close( i);
+		Mdm.ip_state = 0;
+		emit( delay_ms( Cfg.latency_ms), "\r\nSHUT OK\r\n");
+	}
+	else if( strcasecmp( cmd, "+CIPSTATUS") == 0)
+		cmd_cipstatus( arg);
+	else if( strcasecmp( cmd, "+CIPSTART") == 0 && arg)
+		cmd_cipstart( arg);
+	else if( strcasecmp( cmd, "+CIPSEND") == 0)
+		cmd_cipsend( arg);
+	else if( strcasecmp( cmd, "+CIPCLOSE") == 0)
+		cmd_cipclose( arg);
+	else if( strcasecmp( cmd, "+CIPRXGET") == 0)
+		cmd_ciprxget( arg);
+	else if( strcasecmp( cmd, "+CIPACK") == 0)
+		cmd_cipack( arg);
+	else if( strcasecmp( cmd, "+CMGF") == 0 && arg)
+	{
+		Mdm.cmgf = atoi( arg) != 0;
+		ok();
+	}
+	else if( strcasecmp( cmd, "+CSCS") == 0 || \
+		strcasecmp( cmd, "+CIPCCFG") == 0 || strcasecmp( cmd, "+CDNSCFG") == 0 || strcasecmp( cmd, "+CIPTKA") == 0 || \
+		strcasecmp( cmd, "+CSCA") == 0 || strcasecmp( cmd, "+CNMI") == 0 || strcasecmp( cmd, "&D1") == 0 || \
+		strcasecmp( cmd, "+IPR") == 0 || strcasecmp( cmd, "&W") == 0)
+		ok();
+	else if( strcasecmp( cmd, "+CLTS?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CLTS: %d\r\n\r\nOK\r\n", Mdm.clts);
+	else if( strcasecmp( cmd, "+CLTS") == 0 && arg)
+	{
+		Mdm.clts = atoi( arg);
+		ok();
+	}
+	else if( strcasecmp( cmd, "+CCLK?") == 0)
+		cmd_cclk();
+	else if( strcasecmp( cmd, "+SAPBR") == 0 && arg)
+	{
+		//AT+SAPBR=1,1 򿪣Ѿ򿪵ʱظERRORAT+SAPBR=0,1 ر
+		if( arg[0] == '1' && Mdm.sapbr)
+		{
+			error();
+			return;
+		}
+		if( arg[0] == '1' || arg[0] == '0')
+			Mdm.sapbr = arg[0] == '1';
+		ok();
+	}
+	else if( strcasecmp( cmd, "+CNTPCID") == 0)
+		ok();
+	else if( strcasecmp( cmd, "+CDNSGIP") == 0)
+		cmd_cdnsgip( arg);
+	else if( strcasecmp( cmd, "+CNTP") == 0)
+		cmd_cntp( arg);
+	else if( strcasecmp( cmd, "+CSCA?") == 0)
+		emit( delay_ms( Cfg.latency_ms), "\r\n+CSCA: \"+8613800571500\",145\r\n\r\nOK\r\n");
+	else if( strcasecmp( cmd, "+CPMS?") == 0)
+		cmd_cpms();
+	else if( strcasecmp( cmd, "+CMGR") == 0)
+		cmd_cmgr( arg);
+	else if( strcasecmp( cmd, "+CMGD") == 0)
+		cmd_cmgd( arg);
+	else if( strcasecmp( cmd, "+CMGL") == 0)
+		cmd_cmgl( arg);
+	else if( strcasecmp( cmd, "+CMGS") == 0 && arg)
+	{
+		char *argv[1];
+		split_args( arg, argv, 1);
+		snprintf( Mdm.sms_phone, sizeof( Mdm.sms_phone), "%s", argv[0]);
+		Mdm.sms_pdu_len = Mdm.cmgf ? 0 : atoi( argv[0]);
+		Mdm.sms_len = 0;
+		Mdm.mode = MODE_SMS;
+		emit( 0, "\r\n> ");
+	}
+	else
+		error();
+}
+
+static void rx_cipsend( char c)
+{
+	Mdm.send_buf[ Mdm.send_len ++] = c;
+	Mdm.send_left --;
+	if( Mdm.send_left)
+		return;
+	link_send( Mdm.send_link, Mdm.send_buf, Mdm.send_len);
+	Mdm.mode = MODE_CMD;
+	if( Mdm.mux)
+		emit( delay_ms( Cfg.latency_ms), "\r\n%d, SEND OK\r\n", Mdm.send_link);
+	else
+		emit( delay_ms( Cfg.latency_ms), "\r\nSEND OK\r\n");
+}
+
+static void rx_sms( char c)
+{
+	int sca;
+
+	if( c == 0x1b)			//ESC ȡ
+	{
+		Mdm.mode = MODE_CMD;
+		ok();
+		return;
+	}
+	if( c == 0)
+		return;
+	//PDUʽֻҪʮƵַAT+CMGSĻв
+	if( Mdm.cmgf == 0 && c != 0x1a && isxdigit( ( uint8_t)c) == 0)
+		return;
+	if( c != 0x1a)
+	{
+		if( Mdm.sms_len < ( int)sizeof( Mdm.sms_buf) - 1)
+			Mdm.sms_buf[ Mdm.sms_len ++] = c;
+		return;
+	}
+	Mdm.sms_buf[ Mdm.sms_len] = 0;
+	Mdm.mode = MODE_CMD;
+	Stat.sms_tx ++;
+	if( Mdm.cmgf == 0)
+	{
+		//ҪʮƵݶԵϣĵַĳڵһֽ
+		sca = 0;
+		sscanf( Mdm.sms_buf, "%2x", &sca);
+		fprintf( stderr, "[sms] pdu %d: %s\n", Mdm.sms_pdu_len, Mdm.sms_buf);
+		if( Mdm.sms_len < 2 || Mdm.sms_len % 2 || Mdm.sms_pdu_len < 1 || Mdm.sms_pdu_len > SMS_PDU_MAX - 1 || \
+			Mdm.sms_len / 2 != Mdm.sms_pdu_len + 1 + sca)
+		{
+			emit( delay_ms( Cfg.sms_ms), "\r\n+CMS ERROR: 304\r\n");
+			return;
+		}
+		Mdm.cmgs_mr = ( Mdm.cmgs_mr + 1) & 0xff;
+		emit( delay_ms( Cfg.sms_ms), "\r\n+CMGS: %d\r\n\r\nOK\r\n", Mdm.cmgs_mr);
+		return;
+	}
+	fprintf( stderr, "[sms] to %s: %s\n", Mdm.sms_phone, Mdm.sms_buf);
+	if( Mdm.sms_len > SMS_TEXT_MAX)
+	{
+		emit( delay_ms( Cfg.sms_ms), "\r\n+CMS ERROR: 304\r\n");
+		return;
+	}
+	Mdm.cmgs_mr = ( Mdm.cmgs_mr + 1) & 0xff;
+	emit( delay_ms( Cfg.sms_ms), "\r\n+CMGS: %d\r\n\r\nOK\r\n", Mdm.cmgs_mr);
+}
+
+//͸ģʽµݣ"+++"ǰҪбʱ
+static void rx_data( char c, int64_t now)
+{
+	if( c == '+' && ( Mdm.plus_cnt > 0 || now - Mdm.last_rx_ms >= Cfg.guard_ms) && Mdm.plus_cnt < 3)
+	{
+		Mdm.plus_cnt ++;
+		if( Mdm.plus_cnt == 3)
+			Mdm.plus_ms = now;
+		return;
+	}
+	//˳У֮ǰ+Ҳ
+	if( Mdm.plus_cnt)
+		link_send( 0, "+++", Mdm.plus_cnt);
+	Mdm.plus_cnt = 0;
+	link_send( 0, &c, 1);
+}
+
+static void modem_rx( const char *buf, int len)
+{
+	int i;
+	int64_t now = now_ms();
+	char c;
+
+	trace( ">>", buf, len);
+	if( Mdm.mode == MODE_DATA)
+	{
+		//ֱתЧʸһЩ
+		if( Mdm.plus_cnt == 0 && memchr( buf, '+', len) == NULL)
+		{
+			link_send( 0, buf, len);
+			Mdm.last_rx_ms = now;
+			return;
+		}
+	}
+	for( i = 0; i < len; i ++)
+	{
+		c = buf[i];
+		switch( Mdm.mode)
+		{
+			case MODE_CIPSEND:
+				rx_cipsend( c);
+				break;
+			case MODE_SMS:
+				rx_sms( c);
+				break;
+			case MODE_DATA:
+				rx_data( c, now);
+				break;
+			default:
+				//ָ̼ʱѽβ0Ҳ
+				if( c == 0)
+					break;
+				if( c == '\r')
+				{
+					Mdm.line[ Mdm.line_len] = 0;
+					Mdm.line_len = 0;
+					at_command( Mdm.line);
+					break;
+				}
+				if( Mdm.line_len < LINE_MAX - 1)
+					Mdm.line[ Mdm.line_len ++] = c;
+				break;
+		}
+	}
+	if( Mdm.mode == MODE_DATA)
+		Mdm.last_rx_ms = now;
+}
+
+static void print_stats( FILE *fp)
+{
+	int64_t now = now_ms();
+
+	fprintf( fp, "cmds %ld  err_injected %ld  urcs %ld\n", Stat.cmds, Stat.err_injected, Stat.urcs);
+	fprintf( fp, "connect ok %ld fail %ld  avg %lld ms  max %lld ms\n", Stat.cnnt_ok, Stat.cnnt_fail, \
+		( long long)( Stat.cnnt_ok ? Stat.cnnt_ms_total / Stat.cnnt_ok : 0), ( long long)Stat.cnnt_ms_max);
+	if( Stat.first_link_ms)
+		fprintf( fp, "first AT -> first link %lld ms\n", ( long long)( Stat.first_link_ms - Stat.first_cmd_ms));
+	fprintf( fp, "up %ld B / %ld seg (lost %ld)  down %ld B / %ld seg (lost %ld)\n", Stat.bytes_up, Stat.segs_up, \
+		Stat.lost_up, Stat.bytes_down, Stat.segs_down, Stat.lost_down);
+	if( Stat.first_cmd_ms && now > Stat.first_cmd_ms)
+		fprintf( fp, "uplink %.1f B/s\n", Stat.bytes_up * 1000.0 / ( now - Stat.first_cmd_ms));
+	fprintf( fp, "sms tx %ld rx %ld\n", Stat.sms_tx, Stat.sms_rx);
+	fprintf( fp, "dns %ld\n", Stat.dns);
+}
+
+static void console( char *line)
+{
+	char *cmd = strtok( line, " \t\r\n");
+	char *a1, *a2;
+	int idx;
+
+	if( cmd == NULL)
+		return;
+	a1 = strtok( NULL, " \t\r\n");
+	a2 = strtok( NULL, "\r\n");
+	if( ( strcmp( cmd, "sms") == 0 || strcmp( cmd, "smsp") == 0) && a1 && a2)
+	{
+		if( cmd[3] == 'p')
+			idx = sms_store( a1, "", a2);
+		else
+			idx = sms_store( a1, a2, "");
+		if( idx < 0)
+		{
+			fprintf( stderr, "sms storage full\n");
+			return;
+		}
+		Stat.sms_rx ++;
+		urc( "+CMTI: \"SM\",%d", idx);
+	}
+	else if( strcmp( cmd, "close") == 0 && a1)
+	{
+		idx = link_of( atoi( a1));
+		if( idx >= 0)
+			link_lost( idx);
+	}
+	else if( strcmp( cmd, "csq") == 0 && a1)
+		Mdm.rssi = atoi( a1);
+	else if( strcmp( cmd, "cbc") == 0 && a1)
+		Mdm.mv = atoi( a1);
+	else if( strcmp( cmd, "down") == 0)
+	{
+		urc( "NORMAL POWER DOWN");
+		modem_boot();
+	}
+	else if( strcmp( cmd, "boot") == 0)
+		modem_boot();
+	else if( strcmp( cmd, "ring") == 0)
+		urc( "RING");
+	else if( strcmp( cmd, "nitz") == 0)
+	{
+		if( Mdm.clts == 0)
+		{
+			fprintf( stderr, "AT+CLTS=1 not set\n");
+			return;
+		}
+		Mdm.clk_set = 1;
+		Mdm.clk_ofs_ms = a1 ? atoll( a1) : 0;
+		urc( "*PSUTTZ: 18,1,30,12,0,0,\"+32\",0");
+		urc( "DST: 0");
+	}
+	else if( strcmp( cmd, "dns") == 0)
+		Mdm.dns_fail = a1 ? atoi( a1) : 1;
+	else if( strcmp( cmd, "stats") == 0)
+		print_stats( stdout);
+	else if( strcmp( cmd, "quit") == 0)
+		Quit = 1;
+	else
+		fprintf( stderr, "unknown command: %s\n", cmd);
+}
+
+static int open_pty( const char *link_path)
+{
+	int fd = posix_openpt( O_RDWR | O_NOCTTY);
+	struct termios tio;
+
+	if( fd < 0 || grantpt( fd) || unlockpt( fd))
+	{
+		perror( "pty");
+		exit( 1);
+	}
+	tcgetattr( fd, &tio);
+	cfmakeraw( &tio);
+	tcsetattr( fd, TCSANOW, &tio);
+	printf( "sim800_emu: %s\n", ptsname( fd));
+	if( link_path)
+	{
+		unlink( link_path);
+		if( symlink( ptsname( fd), link_path))
+			perror( "symlink");
+	}
+	fflush( stdout);
+	return fd;
+}
+
+static void on_signal( int sig)
+{
+	( void)sig;
+	Quit = 1;
+}
+
+static void usage( void)
+{
+	fprintf( stderr,
+		"usage: sim800_emu [options]\n"
+		"  -f fd     use an already opened fd (e.g. socketpair) instead of a pty\n"
+		"  -P path   symlink the pty slave to path\n"
+		"  -H host   bridge every link to host (default 127.0.0.1)\n"
+		"  -l ms     response latency        -j ms   latency jitter\n"
+		"  -C ms     connect latency         -a ms   CIICR latency\n"
+		"  -S ms     sms submit latency      -b ms   boot time\n"
+		"  -g ms     +++ guard time          -B baud uart rate, 0 = unlimited\n"
+		"  -L pct    packet loss             -e pct  AT error injection\n"
+		"  -F pct    connect failure         -s seed random seed\n"
+		"  -D ms     dns latency\n"
+		"  -t        trace uart traffic to stderr\n");
+	exit( 1);
+}
+
+int main( int argc, char **argv)
+{
+	struct pollfd pfd[LINK_NUM + 2];
+	int link_idx[LINK_NUM + 2];
+	char buf[2048];
+	char con[LINE_MAX];
+	int con_len = 0;
+	const char *pty_link = NULL;
+	int fd = -1;
+	int opt, i, n, npfd, timeout;
+	int64_t now;
+	unsigned seed = ( unsigned)time( NULL);
+
+	while( ( opt = getopt( argc, argv, "f:P:H:l:j:C:a:S:b:g:B:L:e:F:s:D:t")) != -1)
+	{
+		switch( opt)
+		{
+			case 'f': fd = atoi( optarg); break;
+			case 'P': pty_link = optarg; break;
+			case 'H': Cfg.bridge_host = optarg; break;
+			case 'l': Cfg.latency_ms = atoi( optarg); break;
+			case 'j': Cfg.jitter_ms = atoi( optarg); break;
+			case 'C': Cfg.cnnt_ms = atoi( optarg); break;
+			case 'a': Cfg.attach_ms = atoi( optarg); break;
+			case 'S': Cfg.sms_ms = atoi( optarg); break;
+			case 'b': Cfg.boot_ms = atoi( optarg); break;
+			case 'g': Cfg.guard_ms = atoi( optarg); break;
+			case 'B': Cfg.baud = atol( optarg); break;
+			case 'L': Cfg.loss_pct = atoi( optarg); break;
+			case 'e': Cfg.err_pct = atoi( optarg); break;
+			case 'F': Cfg.cnntfail_pct = atoi( optarg); break;
+			case 'D': Cfg.dns_ms = atoi( optarg); break;
+			case 's': seed = ( unsigned)atoi( optarg); break;
+			case 't': Cfg.trace = 1; break;
+			default: usage();
+		}
+	}
+	srand( seed);
+	signal( SIGINT, on_signal);
+	signal( SIGTERM, on_signal);
+	signal( SIGPIPE, SIG_IGN);
+
+	Mdm.fd = fd >= 0 ? fd : open_pty( pty_link);
+	fcntl( Mdm.fd, F_SETFL, O_NONBLOCK);
+	Mdm.rssi = 20;
+	Mdm.mv = 4000;
+	for( i = 0; i < LINK_NUM; i ++)
+		Links[i].fd = -1;
+	modem_boot();
+
+	while( !Quit)
+	{
+		now = now_ms();
+		if( Mdm.boot_at_ms && now >= Mdm.boot_at_ms)
+			modem_ready();
+		//+++֮󱣻ʱûݲ˳
+		if( Mdm.mode == MODE_DATA && Mdm.plus_cnt == 3 && now - Mdm.plus_ms >= Cfg.guard_ms)
+		{
+			Mdm.plus_cnt = 0;
+			Mdm.mode = MODE_CMD;
+			emit( 0, "\r\nOK\r\n");
+		}
+		for( i = 0; i < LINK_NUM; i ++)
+		{
+			link_t *l = &Links[i];
+			if( l->state != LINK_CONNECTING || l->ready_ms == 0 || now < l->ready_ms + l->dns_ms)
+				continue;
+			link_report( i, l->fail == 0 && l->fd >= 0);
+		}
+		flush_out();
+
+		npfd = 0;
+		pfd[npfd].fd = Mdm.fd;
+		pfd[npfd].events = POLLIN;
+		link_idx[npfd++] = -1;
+		pfd[npfd].fd = STDIN_FILENO;
+		pfd[npfd].events = POLLIN;
+		link_idx[npfd++] = -2;
+		for( i = 0; i < LINK_NUM; i ++)
+		{
+			if( Links[i].fd < 0)
+				continue;
+			//Ѿˣʱ֪ͨ
+			if( Links[i].state == LINK_CONNECTING && Links[i].ready_ms)
+				continue;
+			//Ѿ֪ͨˣȹ̼
+			if( Links[i].state == LINK_UP && Links[i].notified)
+				continue;
+			pfd[npfd].fd = Links[i].fd;
+			pfd[npfd].events = Links[i].state == LINK_CONNECTING ? POLLOUT : POLLIN;
+			link_idx[npfd++] = i;
+		}
+
+		timeout = 100;
+		if( Mdm.out_head)
+		{
+			int64_t due = Mdm.out_head->due_ms > Mdm.out_free_ms ? Mdm.out_head->due_ms : Mdm.out_free_ms;
+			timeout = due > now ? ( int)( due - now) : 0;
+			if( timeout > 100)
+				timeout = 100;
+		}
+		if( poll( pfd, npfd, timeout) < 0)
+		{
+			if( errno == EINTR)
+				continue;
+			perror( "poll");
+			break;
+		}
+		for( i = 0; i < npfd; i ++)
+		{
+			if( pfd[i].revents == 0)
+				continue;
+			if( link_idx[i] == -1)
+			{
+				n = read( Mdm.fd, buf, sizeof( buf));
+				if( n > 0)
+					modem_rx( buf, n);
+				else if( n == 0 && fd >= 0)
+					Quit = 1;
+			}
+			else if( link_idx[i] == -2)
+			{
+				n = read( STDIN_FILENO, con + con_len, sizeof( con) - 1 - con_len);
+				if( n <= 0)
+				{
+					pfd[i].fd = -1;
+					continue;
+				}
+				con_len += n;
+				con[ con_len] = 0;
+				while( ( opt = strcspn( con, "\n")) < con_len)
+				{
+					con[ opt] = 0;
+					console( con);
+					memmove( con, con + opt + 1, con_len - opt);
+					con_len -= opt + 1;
+				}
+				if( con_len >= ( int)sizeof( con) - 1)
+					con_len = 0;
+			}
+			else
+			{
+				link_t *l = &Links[ link_idx[i]];
+				if( l->state == LINK_CONNECTING)
+				{
+					int err = 0;
+					socklen_t sl = sizeof( err);
+					getsockopt( l->fd, SOL_SOCKET, SO_ERROR, &err, &sl);
+					if( err)
+						l->fail = 1;
+					//ģʱ֪ͨ
+					l->ready_ms = now_ms() + delay_ms( Cfg.cnnt_ms);
+					if( l->ready_ms == 0)
+						l->ready_ms = 1;
+					if( l->fail)
+					{
+						close( l->fd);
+						l->fd = -1;
+					}
+					else
+						setsockopt( l->fd, IPPROTO_TCP, TCP_NODELAY, &( int){1}, sizeof( int));
+				}
+				else
+					link_recv( link_idx[i]);
+			}
+		}
+	}
+	print_stats( stderr);
+	return 0;
+}
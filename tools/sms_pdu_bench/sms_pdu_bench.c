@@ -0,0 +1,256 @@
+/**
+* @file 		sms_pdu_bench.c
+* @brief		PCPDUʽ485ݵЧ.
+* @details		1. ͬȵmodbusӦ𣬱ȽıʽתʮƣPDUʽ8λҪĶ
+*				2. ͵Ĺֶα룬תɽշյSMS-DELIVER˳֮ƴӣԭһ
+*				3. ͳƱͽÿKBõCPU
+*
+*				루Linux
+*					cc -O2 -Wall -Iclass -Isdh_lib -I. -o sms_pdu_bench tools/sms_pdu_bench/sms_pdu_bench.c \
+*						class/smsPdu.c sdh_lib/modbusRTU_cli.c
+*				У
+*					./sms_pdu_bench [ÿֳȵӦ]
+*
+*				x86rdtscƽ̨PCϵֱӻɵƬϵģ
+*				ֻȽϲͬĲƬϵʱҪڰϲ⡣
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined( __x86_64__) || defined( __i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+#include "smsPdu.h"
+#include "modbusRTU_cli.h"
+
+//smsQueue.hһ
+#define SMSQ_TEXT_MAX		160
+#define SMSQ_PDU_MAX		255
+#define RX_BUF_LEN			256			//շĻ棬dtudataBufһ
+
+typedef struct {
+	int			regs;			//ӦļĴ
+	uint32_t	frames;
+	uint32_t	bytes;
+	uint32_t	text_sms;		//ıʽתʮ
+	uint32_t	text_cut;		//ıʽֱӷ͵ʱ0ضϵ֡
+	uint32_t	pdu_sms;
+	uint64_t	enc_ticks;
+	uint64_t	dec_ticks;
+	uint32_t	errs;
+}bench_t;
+
+static uint64_t ticks( void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ( uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+//һվӦregsּĴ
+static int modbus_sample( int regs, uint32_t seq, uint8_t *p)
+{
+	uint16_t	crc, val;
+	int			i, n = 0;
+
+	p[ n ++] = 1 + seq % 4;
+	p[ n ++] = 3;
+	p[ n ++] = regs * 2;
+	for( i = 0; i < regs; i ++)
+	{
+		val = ( i % 3 == 0) ? 0 : 2000 + i * 100 + ( ( seq / 4 + i) % 7) + ( rand() % 3);
+		p[ n ++] = val >> 8;
+		p[ n ++] = val & 0xff;
+	}
+	crc = CRC16( p, n);
+	p[ n ++] = crc >> 8;
+	p[ n ++] = crc & 0xff;
+	return n;
+}
+
+static int hexval( char c)
+{
+	return c >= 'A' ? c - 'A' + 10 : c - '0';
+}
+
+//ѷ͵SMS-SUBMITʮƣĳɽշյSMS-DELIVERֽڣ
+//շĺǷ͵Ŀĺ룬ֻĽ
+static int submit_to_deliver( const char *hex, uint8_t *out)
+{
+	uint8_t		sub[ SMS_PDU_LEN_MAX];
+	int			len = strlen( hex) / 2;
+	int			i, p, n, digits;
+
+	for( i = 0; i < len; i ++)
+		sub[i] = hexval( hex[ 2 * i]) << 4 | hexval( hex[ 2 * i + 1]);
+	n = 0;
+	out[ n ++] = 0;
+	out[ n ++] = ( sub[1] & 0x40) | 0x04;
+	digits = sub[3];
+	p = 3;
+	for( i = 0; i < 2 + ( digits + 1) / 2; i ++)
+		out[ n ++] = sub[ p ++];
+	out[ n ++] = sub[ p ++];			//PID
+	out[ n ++] = sub[ p ++];			//DCS
+	memcpy( out + n, "\x81\x10\x10\x21\x43\x65\x00", 7);
+	n += 7;
+	memcpy( out + n, sub + p, len - p);
+	return n + len - p;
+}
+
+static void shuffle( int *order, int n)
+{
+	int		i, j, t;
+
+	for( i = 0; i < n; i ++)
+		order[i] = i;
+	for( i = n - 1; i > 0; i --)
+	{
+		j = rand() % ( i + 1);
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+}
+
+//gprs.cķʽһյ֮ƴ
+static void round_trip( bench_t *b, uint8_t *data, int len, uint8_t ref)
+{
+	static char		hex[ SMS_PDU_PARTS_MAX][ SMS_PDU_LEN_MAX * 2 + 1];
+	static uint8_t	rx[ SMS_PDU_LEN_MAX];
+	uint8_t			head[ SMS_PDU_HEAD_MAX];
+	char			out[ RX_BUF_LEN];
+	int				plen[ SMS_PDU_PARTS_MAX];
+	int				order[ SMS_PDU_PARTS_MAX];
+	int				total = SmsPdu_parts( len);
+	int				seq, hl, n, k, pos, off = 0;
+	sms_pdu_t		msg;
+	uint64_t		t;
+
+	t = ticks();
+	for( seq = 1; seq <= total; seq ++)
+	{
+		n = SmsPdu_part_len( len, seq);
+		hl = SmsPdu_submit_head( head, "+8613900000000", n, ref, total, seq);
+		if( hl < 0)
+		{
+			b->errs ++;
+			return;
+		}
+		SmsPdu_hex( hex[ seq - 1], head, hl);
+		SmsPdu_hex( hex[ seq - 1] + 2 * hl, data + off, n);
+		off += n;
+	}
+	b->enc_ticks += ticks() - t;
+	b->pdu_sms += total;
+
+	memset( plen, 0, sizeof( plen));
+	shuffle( order, total);
+	for( k = 0; k < total; k ++)
+	{
+		n = submit_to_deliver( hex[ order[k]], rx);
+		t = ticks();
+		if( SmsPdu_decode( rx, n, &msg, NULL, 0) < 0 || msg.seq != order[k] + 1 || msg.total != total || \
+			strcmp( msg.phone, "+8613900000000"))
+		{
+			b->errs ++;
+			return;
+		}
+		plen[ msg.seq - 1] = SmsPdu_decode( rx, n, &msg, out + ( msg.seq - 1) * msg.cap, msg.cap);
+		b->dec_ticks += ticks() - t;
+	}
+	for( k = 0, pos = 0; k < total; k ++)
+	{
+		memmove( out + pos, out + k * msg.cap, plen[k]);
+		pos += plen[k];
+	}
+	if( pos != len || memcmp( out, data, len))
+		b->errs ++;
+}
+
+static void run( bench_t *b, uint32_t frames)
+{
+	uint8_t		data[ RX_BUF_LEN];
+	uint32_t	i;
+	int			len, n, off;
+
+	srand( 1);
+	for( i = 0; i < frames; i ++)
+	{
+		len = modbus_sample( b->regs, i, data);
+		b->frames ++;
+		b->bytes += len;
+		b->text_sms += ( 2 * len + SMSQ_TEXT_MAX - 1) / SMSQ_TEXT_MAX;
+		if( memchr( data, 0, len) || memchr( data, 0x1A, len))
+			b->text_cut ++;
+		//ͶŶһSMSQ_PDU_MAXķֿ
+		for( off = 0; off < len; off += n)
+		{
+			n = len - off > SMSQ_PDU_MAX ? SMSQ_PDU_MAX : len - off;
+			round_trip( b, data + off, n, i);
+		}
+	}
+}
+
+static void report( bench_t *b)
+{
+	double	kb = b->bytes / 1024.0;
+
+	printf( "regs %-4d frame %u B  frames %u\n", b->regs, b->bytes / b->frames, b->frames);
+	printf( "  sms/frame  text+hex %.2f  pdu %.2f  (text raw cut by 0x00/0x1A: %u frames)\n", \
+			( double)b->text_sms / b->frames, ( double)b->pdu_sms / b->frames, b->text_cut);
+#ifdef HAVE_TSC
+	printf( "  cycles/KB  encode %.0f  decode %.0f\n", b->enc_ticks / kb, b->dec_ticks / kb);
+#else
+	printf( "  ns/KB  encode %.0f  decode %.0f\n", b->enc_ticks / kb, b->dec_ticks / kb);
+#endif
+	printf( "  round trip errors %u\n", b->errs);
+}
+
+//7λĽ룺GSM 03.40"hellohello"
+static int check_7bit( void)
+{
+	static const uint8_t pdu[] = { 0x07, 0x91, 0x64, 0x07, 0x05, 0x80, 0x99, 0xF9, 0x04, 0x0B, 0x91, 0x64, 0x07, \
+		0x28, 0x14, 0x41, 0xF2, 0x00, 0x00, 0x11, 0x10, 0x10, 0x21, 0x43, 0x65, 0x00, 0x0A, 0xE8, 0x32, 0x9B, 0xFD, \
+		0x46, 0x97, 0xD9, 0xEC, 0x37};
+	char		text[32];
+	sms_pdu_t	msg;
+	int			n = SmsPdu_decode( pdu, sizeof( pdu), &msg, text, sizeof( text));
+
+	if( n != 10 || memcmp( text, "hellohello", 10) || strcmp( msg.phone, "+46708241142"))
+	{
+		printf( "7bit decode error\n");
+		return 1;
+	}
+	return 0;
+}
+
+int main( int argc, char *argv[])
+{
+	uint32_t	frames = argc > 1 ? strtoul( argv[1], NULL, 0) : 2000;
+	bench_t		benches[] = {
+		{ 10}, { 30}, { 60}, { 125},
+	};
+	uint32_t	errs = check_7bit();
+	size_t		i;
+
+	for( i = 0; i < sizeof( benches) / sizeof( benches[0]); i ++)
+	{
+		run( &benches[i], frames);
+		report( &benches[i]);
+		errs += benches[i].errs;
+	}
+	return errs ? 1 : 0;
+}
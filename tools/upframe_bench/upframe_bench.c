@@ -0,0 +1,184 @@
+/**
+* @file 		upframe_bench.c
+* @brief		PCж֡LZSSѹЧ.
+* @details		1. ģ485ѯӦıʽĴݣͶеĹϲһη
+*				2. ͳԭʼݡ֡֡ѹ֮ÿռõֽ
+*				3. ͳѹͽѹÿKBõCPUڣ⿪ݺԭһ
+*
+*				루Linux
+*					cc -O2 -Wall -DUPF_LZ_ENABLE=1 -Iclass -Isdh_lib -I. -o upframe_bench tools/upframe_bench/upframe_bench.c \
+*						class/upframe.c sdh_lib/modbusRTU_cli.c
+*				У
+*					./upframe_bench []
+*
+*				x86rdtscƽ̨PCϵֱӻɵƬϵģ
+*				ֻȽϲͬĲƬϵʱҪڰϲ⡣
+* @version	A001
+* @par Copyright (c):
+* 		XXX˾
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined( __x86_64__) || defined( __i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+#include "upframe.h"
+#include "modbusRTU_cli.h"
+
+//gprs.cķͶһ
+#define TCPSENDBUF_LEN		256
+#define TCPSEND_THRESHOLD	( TCPSENDBUF_LEN / 2)
+#define TCPIP_HEAD			40		//ÿη͵TCP/IPͷֻƿе
+
+typedef int ( *sample_fn)( uint32_t seq, char *buf);
+
+typedef struct {
+	const char	*name;
+	sample_fn	make;
+	uint32_t	samples;
+	uint32_t	sends;
+	uint64_t	raw;
+	uint64_t	framed;
+	uint64_t	lz;
+	uint64_t	lz_ticks;
+	uint64_t	unlz_ticks;
+	uint32_t	errs;
+}bench_t;
+
+static uint64_t ticks( void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ( uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+//4վӦ10ּĴֵ仯
+static int modbus_sample( uint32_t seq, char *buf)
+{
+	uint8_t		*p = ( uint8_t *)buf;
+	uint16_t	crc, val;
+	int			i, n = 0;
+
+	p[ n ++] = 1 + seq % 4;
+	p[ n ++] = 3;
+	p[ n ++] = 20;
+	for( i = 0; i < 10; i ++)
+	{
+		val = 2000 + i * 100 + ( ( seq / 4 + i) % 7) + ( rand() % 3);
+		p[ n ++] = val >> 8;
+		p[ n ++] = val & 0xff;
+	}
+	crc = CRC16( p, n);
+	p[ n ++] = crc >> 8;
+	p[ n ++] = crc & 0xff;
+	return n;
+}
+
+//ıʽĴ
+static int text_sample( uint32_t seq, char *buf)
+{
+	return sprintf( buf, "ID=%02u,T=%d.%02d,H=%d.%d,P=%d\r\n", ( unsigned)( seq % 4 + 1), \
+			20 + ( int)( seq % 5), rand() % 100, 40 + rand() % 20, rand() % 10, 1000 + rand() % 20);
+}
+
+static void send_batch( bench_t *b, char *batch, int len, uint32_t ts)
+{
+	char		frame[ TCPSENDBUF_LEN + UPF_OVERHEAD];
+	char		back[ TCPSENDBUF_LEN];
+	uint64_t	t;
+	uint32_t	ts2;
+	uint8_t		type;
+	int			n, m;
+
+	b->sends ++;
+	b->raw += len + TCPIP_HEAD;
+	b->framed += len + UPF_OVERHEAD + TCPIP_HEAD;
+
+	t = ticks();
+	n = Upf_pack( frame, sizeof( frame), UPF_DATA, ts, batch, len, 1);
+	b->lz_ticks += ticks() - t;
+	b->lz += n + TCPIP_HEAD;
+
+	t = ticks();
+	m = Upf_unpack( frame, n, &type, &ts2, back, sizeof( back));
+	b->unlz_ticks += ticks() - t;
+	if( m != len || memcmp( back, batch, len) || ts2 != ts || ( type & ~UPF_LZ) != UPF_DATA)
+		b->errs ++;
+}
+
+static void run( bench_t *b, uint32_t samples)
+{
+	char		batch[ TCPSENDBUF_LEN];
+	char		one[64];
+	int			len = 0;
+	int			n;
+	uint32_t	i;
+
+	srand( 1);
+	for( i = 0; i < samples; i ++)
+	{
+		n = b->make( i, one);
+		if( len + n >= TCPSENDBUF_LEN)
+		{
+			send_batch( b, batch, len, i);
+			len = 0;
+		}
+		memcpy( batch + len, one, n);
+		len += n;
+		b->samples ++;
+		//ͷͶһһͷȥ
+		if( len >= TCPSEND_THRESHOLD)
+		{
+			send_batch( b, batch, len, i);
+			len = 0;
+		}
+	}
+	if( len)
+		send_batch( b, batch, len, i);
+}
+
+static void report( bench_t *b)
+{
+	double	kb = ( b->raw - ( uint64_t)b->sends * TCPIP_HEAD) / 1024.0;
+
+	printf( "%-8s samples %u sends %u\n", b->name, b->samples, b->sends);
+	printf( "  bytes/sample  raw %.2f  framed %.2f  framed+lz %.2f  (incl. %d B TCP/IP per send)\n", \
+			( double)b->raw / b->samples, ( double)b->framed / b->samples, ( double)b->lz / b->samples, TCPIP_HEAD);
+	printf( "  payload ratio %.3f\n", ( double)( b->lz - ( uint64_t)b->sends * ( TCPIP_HEAD + UPF_OVERHEAD)) / \
+			( b->raw - ( uint64_t)b->sends * TCPIP_HEAD));
+#ifdef HAVE_TSC
+	printf( "  cycles/KB  pack+lz %.0f  unpack %.0f\n", b->lz_ticks / kb, b->unlz_ticks / kb);
+#else
+	printf( "  ns/KB  pack+lz %.0f  unpack %.0f\n", b->lz_ticks / kb, b->unlz_ticks / kb);
+#endif
+	printf( "  round trip errors %u\n", b->errs);
+}
+
+int main( int argc, char *argv[])
+{
+	uint32_t	samples = argc > 1 ? strtoul( argv[1], NULL, 0) : 20000;
+	bench_t		benches[] = {
+		{ "modbus", modbus_sample},
+		{ "text", text_sample},
+	};
+	uint32_t	errs = 0;
+	size_t		i;
+
+	for( i = 0; i < sizeof( benches) / sizeof( benches[0]); i ++)
+	{
+		run( &benches[i], samples);
+		report( &benches[i]);
+		errs += benches[i].errs;
+	}
+	return errs ? 1 : 0;
+}